@@ -15,6 +15,61 @@
 // OTA Configuration (GitHub latest release URL)
 #define OTA_UPDATE_URL              "https://github.com/slastra/esp32-ota-firmware/releases/latest/download/firmware.bin"
 #define OTA_RECV_TIMEOUT            5000
+#define OTA_RECV_BUF_SIZE           2048    // Bytes read from HTTP per call
+#define OTA_WRITE_BUFFERS           2       // Flash write buffers: one fills while another is written
+#define OTA_WRITE_BUF_SIZE          4096    // Bytes per esp_ota_write (one flash sector)
+#define OTA_WRITER_TASK_STACK_SIZE  3072
+#define OTA_TASK_STACK_SIZE         16384
+#define OTA_TASK_PRIORITY           5       // Update started from the Updates tile
+
+// Background OTA: checks now and then, downloads below the UI (LVGL is 4) and the
+// lookup transports (5), pauses while a scan is being resolved, applies when idle
+#define OTA_BACKGROUND_ENABLED      1
+#define OTA_BACKGROUND_TASK_PRIORITY 1
+#define OTA_BACKGROUND_MAX_KBPS     32      // Download cap, 0 = none
+#define OTA_BACKGROUND_POLL_MS      100     // Lookup check interval while paused
+#define OTA_BACKGROUND_FIRST_CHECK_MS   (2 * 60 * 1000)         // After boot
+#define OTA_BACKGROUND_CHECK_INTERVAL_MS (6 * 60 * 60 * 1000)   // Then this often
+#define OTA_BACKGROUND_APPLY_IDLE_MS    (5 * 60 * 1000)         // Restart into a ready update after this long untouched
+#define SCAN_RESULT_BUDGET_MS       1500    // Scan-to-result latency logged as over budget beyond this
+
+// Signed release manifest (manifest.json from scripts/release.sh), fetched before any image.
+// Nothing is downloaded if the running image already matches it.
+#define OTA_MANIFEST_ENABLED        1
+#define OTA_MANIFEST_URL            "https://github.com/slastra/esp32-ota-firmware/releases/latest/download/manifest.json"
+#define OTA_MANIFEST_MAX_SIZE       1024    // Largest manifest accepted
+
+// Resumable plain-image download: checkpoints in NVS, continued with HTTP Range
+#define OTA_RESUME_ENABLED          1
+#define OTA_CHECKPOINT_INTERVAL     (64 * 1024)     // Bytes between checkpoints (multiple of 4 KB)
+#define OTA_RESUME_RETRIES          5       // Reconnects per update before giving up
+#define OTA_RESUME_RETRY_DELAY_MS   1000    // First wait between attempts, doubled each time
+#define OTA_RESUME_WIFI_WAIT_MS     30000   // Longest wait for Wi-Fi to come back
+
+// Delta OTA: patch from the running version, published by scripts/release.sh
+// as firmware-<FIRMWARE_VERSION>.patch. Falls back to OTA_UPDATE_URL if none matches.
+#define OTA_DELTA_ENABLED           1
+#define OTA_DELTA_URL_PREFIX        "https://github.com/slastra/esp32-ota-firmware/releases/latest/download/firmware-"
+#define OTA_DELTA_WRITE_BUF_SIZE    4096    // Rebuilt image bytes per esp_ota_write (one flash sector)
+
+// Compressed full image (firmware.bin.hs from scripts/release.sh), tried before OTA_UPDATE_URL
+#define OTA_COMPRESSED_ENABLED      1
+#define OTA_COMPRESSED_URL          "https://github.com/slastra/esp32-ota-firmware/releases/latest/download/firmware.bin.hs"
+#define OTA_INFLATE_MAX_WINDOW_BITS 12      // Largest decompression window accepted (4 KB of RAM)
+
+// LAN sharing: each device serves its verified image at GET /ota/<app_sha256> on the
+// _esp32._tcp port and lists the digest in its mDNS TXT record. Updates with a signed
+// manifest try peers first; only OTA_P2P_SEEDERS devices per LAN go upstream without waiting.
+#define OTA_P2P_ENABLED             1
+#define OTA_P2P_SEEDERS             2       // Lowest device ids that fetch each release upstream
+#define OTA_P2P_WAIT_MS             (OTA_BACKGROUND_CHECK_INTERVAL_MS + 30 * 60 * 1000) // Background wait for a seeder (each checks once per interval)
+#define OTA_P2P_POLL_MS             60000   // Between browses while waiting
+#define OTA_P2P_QUERY_MS            2000    // mDNS browse time
+#define OTA_P2P_MAX_PEERS           16      // mDNS answers considered
+#define OTA_P2P_SERVER_PRIORITY     1       // Uploads run below the UI and lookups
+#define OTA_P2P_SERVER_STACK_SIZE   4096
+#define OTA_P2P_MAX_CONNECTIONS     3       // Open sockets; requests are served one at a time
+#define OTA_P2P_SEND_BUF_SIZE       4096    // Partition bytes per send
 
 // MQTT Configuration (Barcode Resolution)
 #define MQTT_BROKER_URI             "mqtt://desk.local:1883"
@@ -26,6 +81,22 @@
 #define MQTT_TASK_STACK_SIZE        8192    // Increased for large JSON parsing
 #define MQTT_TASK_PRIORITY          5
 #define MQTT_REQUEST_TIMEOUT_MS     10000
+#define MQTT_INLINE_IMAGES          1       // Ask the resolver to stream product images over MQTT
+#define MQTT_IMAGE_TOPIC_SUFFIX     "image" // Binary image chunks arrive on <response topic>/image
+#define MQTT_INLINE_IMAGE_TIMEOUT_MS 3000   // Fall back to HTTP if inline chunks stop arriving
+#define IMAGE_ETAG_CACHE_ENTRIES    4       // Images kept with their ETag for If-None-Match revalidation (~12.5 KB each)
+
+// CoAP Configuration (direct lookups over UDP instead of the broker; resolver needs COAP_PORT set)
+#define BARCODE_TRANSPORT_COAP      0       // 1 = look up over CoAP, 0 = MQTT
+#define COAP_RESOLVER_HOST          "desk.local"
+#define COAP_RESOLVER_PORT          5683
+#define COAP_ACK_TIMEOUT_MS         2000    // RFC 7252 ACK_TIMEOUT; doubles on each retransmission
+#define COAP_MAX_RETRANSMIT         4
+#define COAP_BLOCK_SZX              6       // Block2 size 2^(SZX+4) = 1024 bytes
+#define COAP_BLOCK_WINDOW           4       // Image block requests kept outstanding (RFC 7252 NSTART is 1; raised for the LAN)
+#define COAP_RESOLVE_RETRY_MS       5000    // Retry interval while the resolver's name does not resolve
+#define COAP_TASK_STACK_SIZE        6144
+#define COAP_TASK_PRIORITY          5
 
 // Color Theme - Indigo & Black
 #define PRIMARY_RED                 0x4B0082  // Indigo
@@ -51,7 +122,7 @@
 #define UI_CORNER_OFFSET            2
 
 // Progress update settings
-#define OTA_PROGRESS_UPDATE_DELAY_MS 100
+#define OTA_PROGRESS_SAMPLE_MS      200            // UI reads OTA progress this often
 
 // Power Management Configuration
 #define SCREEN_DIM_START_MS         (10 * 1000)    // Start dimming at 10s
@@ -60,6 +131,11 @@
 #define DIM_UPDATE_INTERVAL_MS      (1000)         // Update brightness every 1s
 #define DIM_TARGET_BRIGHTNESS       2              // Fixed dimmed brightness level
 #define LED_DIM_PERCENTAGE          20             // LED dimming percentage when screen dims
+#define POWER_TASK_STACK_SIZE       3072           // Makes the dim/off/wake transitions
+#define POWER_TASK_PRIORITY         5              // Above LVGL, so a wake lands before the next frame
+#define POWER_EVENT_QUEUE_LEN       8              // State changes a subscriber may fall behind by
+#define UI_POWER_TASK_STACK_SIZE    4096           // Applies power state changes to LVGL and the LED
+#define UI_POWER_TASK_PRIORITY      4              // Same as LVGL
 #define FADE_STEP_MS                50             // Fade animation step interval
 #define FADE_STEP_SIZE              4              // Brightness change per fade step
 
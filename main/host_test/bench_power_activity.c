@@ -0,0 +1,54 @@
+// Per-call cost of power_manager_reset_activity while the display is active,
+// the path every LVGL touch event takes, on freertos_posix.c
+
+#include "power_manager.h"
+#include "display_power.h"
+#include "esp_timer.h"
+#include "host_freertos.h"
+#include "host_log.h"
+#include "host_test.h"
+
+#define CALLS   2000000
+
+esp_err_t display_power_init(uint8_t initial_brightness, bool enable_fade)
+{
+    return ESP_OK;
+}
+
+esp_err_t display_power_set_brightness(uint8_t level, bool animate)
+{
+    return ESP_OK;
+}
+
+void display_power_deinit(void)
+{
+}
+
+int main(void)
+{
+    const power_config_t config = {
+        .dim_timeout_ms = 10000,
+        .off_timeout_ms = 20000,
+        .dim_brightness = 2,
+        .user_brightness = 80,
+    };
+    CHECK(power_manager_init(&config) == ESP_OK);
+
+    const unsigned long lines = host_log_lines, bytes = host_log_bytes;
+    const int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < CALLS; i++) {
+        power_manager_reset_activity(WAKE_SOURCE_TOUCH);
+    }
+    const int64_t took_us = esp_timer_get_time() - start_us;
+
+    printf("%d calls while active: %.1f ns per call, %.2f log lines and %.1f log bytes per call\n",
+           CALLS, took_us * 1000.0 / CALLS, (double)(host_log_lines - lines) / CALLS,
+           (double)(host_log_bytes - bytes) / CALLS);
+
+    // Staying active costs a store: no logging and no transitions
+    CHECK(host_log_lines == lines);
+    CHECK(power_manager_get_state() == POWER_STATE_ACTIVE);
+
+    power_manager_deinit();
+    return host_test_report();
+}
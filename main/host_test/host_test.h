@@ -0,0 +1,34 @@
+#pragma once
+
+// Minimal assertions for the host tests: a failed CHECK is reported and
+// counted, and host_test_report() turns the count into the exit status.
+
+#include <stdio.h>
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+static int host_test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define RUN(test) do { \
+        printf("%s\n", #test); \
+        test(); \
+    } while (0)
+
+static inline int host_test_report(void)
+{
+    if (host_test_failures) {
+        printf("%d check(s) failed\n", host_test_failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Timer service latency and state_mutex hold time while the display dims,
+// turns off and wakes, on freertos_posix.c. Threads stand in for the timer
+// service, the power task, LVGL and the ui_power subscriber; logging costs
+// what the console does at 115200 baud, 87 us per byte.
+
+#include "power_manager.h"
+#include "display_power.h"
+#include "app_config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host_freertos.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TIMER_SERVICE_PRIORITY  10      // On top, so its lateness is what its callbacks cost it
+#define ROUNDS                  10
+
+static const char *TAG = "ui_manager";
+
+esp_err_t display_power_init(uint8_t initial_brightness, bool enable_fade)
+{
+    return ESP_OK;
+}
+
+esp_err_t display_power_set_brightness(uint8_t level, bool animate)
+{
+    return ESP_OK;
+}
+
+void display_power_deinit(void)
+{
+}
+
+static void busy_us(int64_t us)
+{
+    const int64_t until = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < until) {
+    }
+}
+
+// LVGL renders a frame every 33 ms and holds its port lock for 20 ms of it
+static pthread_mutex_t lvgl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void lvgl_task(void *arg)
+{
+    for (;;) {
+        pthread_mutex_lock(&lvgl_lock);
+        busy_us(20000);
+        pthread_mutex_unlock(&lvgl_lock);
+        usleep(13000);
+    }
+}
+
+// What ui_power_event_task does under the LVGL lock: its log lines, the
+// LVGL timer and slider calls and an LED strip refresh
+static int ui_events;
+
+static void ui_power_event_task(void *arg)
+{
+    QueueHandle_t events = arg;
+    power_state_event_t event;
+    for (;;) {
+        if (xQueueReceive(events, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        pthread_mutex_lock(&lvgl_lock);
+        ESP_LOGI(TAG, "Power state changed: %d -> %d", event.old_state, event.new_state);
+        ESP_LOGI(TAG, "LED turned off with screen");
+        ESP_LOGI(TAG, "Sensor timer paused (200ms -> paused)");
+        ESP_LOGI(TAG, "Battery timer slowed (1s -> 5s)");
+        busy_us(1000);
+        ui_events++;
+        pthread_mutex_unlock(&lvgl_lock);
+    }
+}
+
+// Stands in for the fade timer and everything else sharing the timer service
+static void probe_callback(TimerHandle_t timer)
+{
+}
+
+int main(void)
+{
+    const bool idle = getenv("IDLE") != NULL;
+    if (!posix_use_priorities(TIMER_SERVICE_PRIORITY)) {
+        printf("No SCHED_FIFO here: running at normal priority, expect noisier figures\n");
+    }
+    host_log_us_per_byte = 87;
+
+    xTaskCreate(lvgl_task, "lvgl", 0, NULL, UI_POWER_TASK_PRIORITY, NULL);
+    TimerHandle_t probe = xTimerCreate("probe", 1, pdTRUE, NULL, probe_callback);
+
+    const power_config_t config = {
+        .dim_timeout_ms = 300,
+        .off_timeout_ms = 600,
+        .dim_brightness = 2,
+        .user_brightness = 80,
+    };
+    CHECK(power_manager_init(&config) == ESP_OK);
+    QueueHandle_t events;
+    CHECK(power_manager_subscribe(&events) == ESP_OK);
+    xTaskCreate(ui_power_event_task, "ui_power", 0, events, UI_POWER_TASK_PRIORITY, NULL);
+    TimerHandle_t power_timer = host_timer_find("power_timer");
+
+    // Leave the first dim to the timer, then start probing
+    usleep(100000);
+    xTimerStart(probe, 0);
+    posix_reset_stats();
+
+    // Each round: a 1 s swipe (a touch every 16 ms), then 1.5 s idle for the
+    // dim and the off. IDLE=1 in the environment runs as long with no touches.
+    if (idle) {
+        usleep(ROUNDS * 2500000);
+    }
+    for (int round = 0; round < (idle ? 0 : ROUNDS); round++) {
+        for (int t = 0; t < 1000; t += 16) {
+            power_manager_reset_activity(WAKE_SOURCE_TOUCH);
+            usleep(16000);
+        }
+        usleep(1500000);
+    }
+
+    const int64_t callback_us = posix_timer_max_callback_us(power_timer);
+    const int64_t hold_us = posix_mutex_max_hold_us();
+    printf("%d UI events: probe timer up to %.1f ms late, power timer callback used up to %.2f ms, "
+           "state_mutex held up to %.2f ms\n",
+           ui_events, posix_timer_max_late_us(probe) / 1000.0, callback_us / 1000.0, hold_us / 1000.0);
+
+    // The callback only notifies, and the mutex never waits on LVGL or logging.
+    // Every round dims and turns off; all but the first also wake.
+    CHECK(callback_us < 1000);
+    CHECK(hold_us < 1000);
+    CHECK(idle || ui_events == 3 * ROUNDS - 1);
+    return host_test_report();
+}
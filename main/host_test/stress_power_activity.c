@@ -0,0 +1,81 @@
+// Touches racing dim/off transitions on real threads (freertos_posix.c): the
+// deadline callback fires every 200 us on its own thread, far more often than
+// the real timer, and every touch must bring the display back.
+
+#include "power_manager.h"
+#include "display_power.h"
+#include "esp_timer.h"
+#include "host_freertos.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TOUCHES     3000
+#define DIM_MS      30
+#define OFF_MS      60
+
+esp_err_t display_power_init(uint8_t initial_brightness, bool enable_fade)
+{
+    return ESP_OK;
+}
+
+esp_err_t display_power_set_brightness(uint8_t level, bool animate)
+{
+    return ESP_OK;
+}
+
+void display_power_deinit(void)
+{
+}
+
+static void *fire_deadlines(void *timer)
+{
+    for (;;) {
+        usleep(200);
+        host_timer_fire(timer);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const int touches = argc > 1 ? atoi(argv[1]) : TOUCHES;
+    const power_config_t config = {
+        .dim_timeout_ms = DIM_MS,
+        .off_timeout_ms = OFF_MS,
+        .dim_brightness = 2,
+        .user_brightness = 80,
+    };
+    CHECK(power_manager_init(&config) == ESP_OK);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, fire_deadlines, host_timer_find("power_timer"));
+
+    int woke = 0, stuck = 0;
+    srand(1);
+    for (int i = 0; i < touches; i++) {
+        // Land anywhere from active through dim to off
+        usleep(rand() % (OFF_MS * 1000 + 20000));
+        const bool was_active = power_manager_get_state() == POWER_STATE_ACTIVE;
+        power_manager_reset_activity(WAKE_SOURCE_TOUCH);
+
+        // The power task makes the transition; give it 20 ms
+        const int64_t touched_us = esp_timer_get_time();
+        while (power_manager_get_state() != POWER_STATE_ACTIVE &&
+               esp_timer_get_time() - touched_us < 20000) {
+            usleep(50);
+        }
+        if (power_manager_get_state() != POWER_STATE_ACTIVE &&
+            power_manager_get_idle_time_ms() < DIM_MS) {
+            stuck++;
+        }
+        woke += !was_active;
+    }
+
+    printf("%d touches, %d woke the display, %d left it dimmed or off\n", touches, woke, stuck);
+    CHECK(stuck == 0);
+    CHECK(woke > 0);
+    return host_test_report();
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+#define CONFIG_WIFI_SSID            "host-test"
+#define CONFIG_WIFI_PASSWORD        "host-test"
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "esp_err.h"
+
+#define GPIO_NUM_9              9
+#define GPIO_INTR_HIGH_LEVEL    5
+
+static inline esp_err_t gpio_wakeup_enable(int gpio, int type) { return ESP_OK; }
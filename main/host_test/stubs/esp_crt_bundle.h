@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_crt_bundle.h: the host client speaks plain HTTP
+
+#include "esp_err.h"
+
+static inline esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_event.h
+
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
@@ -0,0 +1,241 @@
+// esp_http_client over plain sockets, enough for the firmware's GETs: one
+// request per connection, Content-Length bodies, headers passed to the event
+// handler as they are parsed. TLS is not spoken; point host_http_server at
+// a local server instead.
+
+#include "esp_http_client.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+const char *host_http_server;
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    int fd;
+    char request_headers[512];
+    int status;
+    int64_t content_length;
+    int64_t left;
+    char buffer[8192];          // Response bytes received past the headers
+    size_t buffered;
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    struct esp_http_client *client = calloc(1, sizeof(*client));
+    if (client) {
+        client->config = *config;
+        client->fd = -1;
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    size_t used = strlen(client->request_headers);
+    snprintf(client->request_headers + used, sizeof(client->request_headers) - used, "%s: %s\r\n", key, value);
+    return ESP_OK;
+}
+
+// Split "scheme://host[:port]/path" into host:port (or host_http_server) and path
+static bool split_url(const char *url, char *host, size_t host_size, char *port, const char **path)
+{
+    const char *authority = strstr(url, "://");
+    authority = authority ? authority + 3 : url;
+    *path = strchr(authority, '/');
+    if (!*path) {
+        *path = "/";
+    }
+    const char *server = host_http_server ? host_http_server : authority;
+    size_t len = host_http_server ? strlen(server) : (size_t)(*path - authority);
+    if (len >= host_size) {
+        return false;
+    }
+    memcpy(host, server, len);
+    host[len] = '\0';
+    char *colon = strchr(host, ':');
+    strcpy(port, colon ? colon + 1 : "80");
+    if (colon) {
+        *colon = '\0';
+    }
+    return true;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    char host[128], port[8];
+    const char *path;
+    if (!split_url(client->config.url, host, sizeof(host), port, &path)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM }, *addr;
+    if (getaddrinfo(host, port, &hints, &addr) != 0) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    const struct timeval timeout = {
+        .tv_sec = client->config.timeout_ms / 1000,
+        .tv_usec = client->config.timeout_ms % 1000 * 1000,
+    };
+    setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    const int connected = connect(client->fd, addr->ai_addr, addr->ai_addrlen);
+    freeaddrinfo(addr);
+    if (connected != 0) {
+        esp_http_client_close(client);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+
+    char request[1024];
+    const int len = snprintf(request, sizeof(request),
+                             "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n%s\r\n",
+                             path, host, client->request_headers);
+    client->buffered = 0;
+    client->status = 0;
+    return send(client->fd, request, len, MSG_NOSIGNAL) == len ? ESP_OK : ESP_FAIL;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    // Read until the blank line; whatever follows it is the start of the body
+    char *end = NULL;
+    while (!end) {
+        if (client->buffered == sizeof(client->buffer) - 1) {
+            return -1;
+        }
+        ssize_t got = recv(client->fd, client->buffer + client->buffered,
+                           sizeof(client->buffer) - 1 - client->buffered, 0);
+        if (got <= 0) {
+            return -1;
+        }
+        client->buffered += got;
+        client->buffer[client->buffered] = '\0';
+        end = strstr(client->buffer, "\r\n\r\n");
+    }
+    *end = '\0';
+
+    client->content_length = -1;
+    if (sscanf(client->buffer, "HTTP/1.%*d %d", &client->status) != 1) {
+        return -1;
+    }
+    for (char *line = strstr(client->buffer, "\r\n"); line; ) {
+        line += 2;
+        char *next = strstr(line, "\r\n");
+        if (next) {
+            *next = '\0';
+        }
+        char *colon = strchr(line, ':');
+        if (colon) {
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            if (strcasecmp(line, "Content-Length") == 0) {
+                client->content_length = atoll(value);
+            }
+            esp_http_client_event_t event = {
+                .event_id = HTTP_EVENT_ON_HEADER,
+                .client = client,
+                .user_data = client->config.user_data,
+                .header_key = line,
+                .header_value = value,
+            };
+            if (client->config.event_handler) {
+                client->config.event_handler(&event);
+            }
+        }
+        line = next;
+    }
+
+    const size_t body = client->buffer + client->buffered - (end + 4);
+    memmove(client->buffer, end + 4, body);
+    client->buffered = body;
+    client->left = client->content_length;
+    return client->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return client->content_length;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (client->left >= 0 && len > client->left) {
+        len = (int)client->left;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    int got;
+    if (client->buffered > 0) {
+        got = client->buffered < (size_t)len ? (int)client->buffered : len;
+        memcpy(buffer, client->buffer, got);
+        memmove(client->buffer, client->buffer + got, client->buffered - got);
+        client->buffered -= got;
+    } else {
+        got = (int)recv(client->fd, buffer, len, 0);
+        if (got <= 0) {
+            // Closed early reads as the end of the data, as on the target
+            return got < 0 ? -1 : 0;
+        }
+    }
+    if (client->left > 0) {
+        client->left -= got;
+    }
+    return got;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return client->left == 0;
+}
+
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len)
+{
+    char discard[512];
+    int total = 0, got;
+    while ((got = esp_http_client_read(client, discard, sizeof(discard))) > 0) {
+        total += got;
+    }
+    if (len) {
+        *len = total;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client)
+{
+    // host_http_server stands in for every host; nothing here redirects
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    free(client);
+    return ESP_OK;
+}
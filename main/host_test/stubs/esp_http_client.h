@@ -0,0 +1,59 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_http_client.h, implemented over plain
+// sockets by esp_http_client.c: HTTP/1.1, one request per connection
+
+#include "esp_err.h"
+
+#define ESP_ERR_HTTP_CONNECT    0x7002
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+    HTTP_EVENT_REDIRECT,
+} esp_http_client_event_id_t;
+
+typedef struct {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef struct {
+    const char *url;
+    int timeout_ms;
+    bool keep_alive_enable;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    int buffer_size;
+    int buffer_size_tx;
+    int max_redirection_count;
+    esp_err_t (*event_handler)(esp_http_client_event_t *evt);
+    void *user_data;
+} esp_http_client_config_t;
+
+/** Host only: when set ("127.0.0.1:8080"), every request goes there, keeping its path */
+extern const char *host_http_server;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client);
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len);
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_log.h. Every line is counted (see
+// host_log.h); warnings and errors go to stderr, the rest only with
+// HOST_TEST_VERBOSE set in the environment.
+
+#include "host_log.h"
+
+#include <stdio.h>   // IDF's headers bring it in too
+
+#define ESP_LOGE(tag, format, ...) host_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do { } while (0)
+#define ESP_LOGV(tag, format, ...) do { } while (0)
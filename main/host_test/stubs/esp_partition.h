@@ -0,0 +1,14 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_partition.h; tests provide the functions
+
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    const char *label;
+} esp_partition_t;
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size);
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256);
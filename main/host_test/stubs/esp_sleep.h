@@ -0,0 +1,25 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+    ESP_SLEEP_WAKEUP_TOUCHPAD,
+    ESP_SLEEP_WAKEUP_ULP,
+    ESP_SLEEP_WAKEUP_GPIO,
+    ESP_SLEEP_WAKEUP_UART,
+    ESP_SLEEP_WAKEUP_WIFI,
+    ESP_SLEEP_WAKEUP_COCPU,
+    ESP_SLEEP_WAKEUP_COCPU_TRAP_TRIG,
+    ESP_SLEEP_WAKEUP_BT,
+} esp_sleep_wakeup_cause_t;
+
+static inline esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) { return ESP_OK; }
+static inline esp_err_t esp_sleep_enable_gpio_wakeup(void) { return ESP_OK; }
+static inline esp_err_t esp_sleep_enable_uart_wakeup(int uart) { return ESP_OK; }
+static inline esp_err_t esp_light_sleep_start(void) { return ESP_OK; }
+static inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) { return ESP_SLEEP_WAKEUP_UNDEFINED; }
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host stand-in for ESP-IDF's esp_system.h; tests provide the functions
+
+#include "esp_err.h"
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host stand-in for esp_timer.h: the clock comes from the FreeRTOS stand-in
+// linked into the test (fake or monotonic)
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS API the firmware uses, implemented by
+// freertos_sim.c on a fake clock and by freertos_posix.c on threads (see
+// host_freertos.h)
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+
+#define configTICK_RATE_HZ      100
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
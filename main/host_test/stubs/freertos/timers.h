@@ -0,0 +1,13 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct host_timer *TimerHandle_t;
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           void (*callback)(TimerHandle_t));
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait);
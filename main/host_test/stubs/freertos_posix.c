@@ -0,0 +1,484 @@
+// FreeRTOS on threads and the monotonic clock (esp_timer_get_time comes from
+// host_log.c). Each task is a thread; timer callbacks run one at a time on a
+// timer service thread, from expiries counted in whole ticks as on the target.
+// Timer lateness, callback CPU time and mutex hold times are recorded.
+
+
+#include "host_freertos.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_TIMERS  8
+
+struct host_task {
+    pthread_t thread;
+    void (*entry)(void *);
+    void *arg;
+    UBaseType_t priority;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t bits;
+};
+
+struct host_timer {
+    const char *name;
+    TickType_t period;
+    bool auto_reload;
+    bool active;
+    int64_t expiry_us;
+    void (*callback)(TimerHandle_t);
+    int64_t max_late_us;
+    int64_t max_callback_us;
+};
+
+struct host_mutex {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool available;
+    bool is_mutex;
+    int64_t taken_us;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length, item_size, head, count;
+    uint8_t *items;
+};
+
+static __thread struct host_task *current_task;
+
+static struct host_timer timers[MAX_TIMERS];
+static int timer_count;
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_changed;
+static pthread_t timer_service;
+static int timer_service_priority;     // 0: no SCHED_FIFO
+static int64_t mutex_max_hold_us;
+
+static void init_cond(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec abs_time(int64_t us)
+{
+    return (struct timespec){ .tv_sec = us / 1000000, .tv_nsec = us % 1000000 * 1000 };
+}
+
+// Wait on cond until signalled or ticks pass; false on timeout
+static bool wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    const struct timespec until = abs_time(esp_timer_get_time() + (int64_t)ticks * HOST_TICK_US);
+    return pthread_cond_timedwait(cond, lock, &until) != ETIMEDOUT;
+}
+
+static int64_t thread_cpu_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool set_priority(pthread_t thread, int priority)
+{
+    const struct sched_param param = { .sched_priority = priority };
+    return pthread_setschedparam(thread, SCHED_FIFO, &param) == 0;
+}
+
+bool posix_use_priorities(int service_priority)
+{
+    // Try it on this thread, then put it back
+    if (!set_priority(pthread_self(), service_priority)) {
+        return false;
+    }
+    const struct sched_param normal = { .sched_priority = 0 };
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &normal);
+    timer_service_priority = service_priority;
+    return true;
+}
+
+// Tasks
+
+static void *task_thread(void *arg)
+{
+    current_task = arg;
+    current_task->entry(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(void (*entry)(void *), const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    task->entry = entry;
+    task->arg = arg;
+    task->priority = priority;
+    pthread_mutex_init(&task->lock, NULL);
+    init_cond(&task->notified);
+    if (pthread_create(&task->thread, NULL, task_thread, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    if (timer_service_priority) {
+        set_priority(task->thread, priority);
+    }
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task) {
+        pthread_exit(NULL);
+    }
+    // Any other thread stays blocked in xTaskNotifyWait: nothing notifies it again
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    task = task ? task : current_task;
+    return task ? task->priority : 0;
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority)
+{
+    task = task ? task : current_task;
+    if (task) {
+        task->priority = priority;
+        if (timer_service_priority) {
+            set_priority(task->thread, priority);
+        }
+    }
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    pthread_mutex_lock(&task->lock);
+    task->bits |= value;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait)
+{
+    struct host_task *task = current_task;
+    pthread_mutex_lock(&task->lock);
+    task->bits &= ~clear_on_entry;
+    while (task->bits == 0) {
+        if (!wait_ticks(&task->notified, &task->lock, wait)) {
+            pthread_mutex_unlock(&task->lock);
+            return pdFALSE;
+        }
+    }
+    if (value) {
+        *value = task->bits;
+    }
+    task->bits &= ~clear_on_exit;
+    pthread_mutex_unlock(&task->lock);
+    return pdTRUE;
+}
+
+unsigned posix_delay_divisor = 1;
+
+void vTaskDelay(TickType_t ticks)
+{
+    const struct timespec delay = abs_time((int64_t)ticks * HOST_TICK_US / posix_delay_divisor);
+    nanosleep(&delay, NULL);
+}
+
+// Timers
+
+static void *timer_service_thread(void *arg)
+{
+    pthread_mutex_lock(&timer_lock);
+    for (;;) {
+        struct host_timer *next = NULL;
+        for (int i = 0; i < timer_count; i++) {
+            if (timers[i].active && (!next || timers[i].expiry_us < next->expiry_us)) {
+                next = &timers[i];
+            }
+        }
+        if (!next) {
+            pthread_cond_wait(&timer_changed, &timer_lock);
+            continue;
+        }
+        if (esp_timer_get_time() < next->expiry_us) {
+            const struct timespec until = abs_time(next->expiry_us);
+            pthread_cond_timedwait(&timer_changed, &timer_lock, &until);
+            continue;
+        }
+
+        const int64_t late_us = esp_timer_get_time() - next->expiry_us;
+        next->max_late_us = late_us > next->max_late_us ? late_us : next->max_late_us;
+        next->active = next->auto_reload;
+        next->expiry_us += (int64_t)next->period * HOST_TICK_US;
+        void (*callback)(TimerHandle_t) = next->callback;
+
+        // Commands from the callback take timer_lock too
+        pthread_mutex_unlock(&timer_lock);
+        const int64_t start_us = thread_cpu_us();
+        callback(next);
+        const int64_t used_us = thread_cpu_us() - start_us;
+        pthread_mutex_lock(&timer_lock);
+        next->max_callback_us = used_us > next->max_callback_us ? used_us : next->max_callback_us;
+    }
+    return NULL;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           void (*callback)(TimerHandle_t))
+{
+    pthread_mutex_lock(&timer_lock);
+    if (timer_count == 0) {
+        init_cond(&timer_changed);
+        pthread_create(&timer_service, NULL, timer_service_thread, NULL);
+        if (timer_service_priority) {
+            set_priority(timer_service, timer_service_priority);
+        }
+    }
+    struct host_timer *timer = NULL;
+    if (timer_count < MAX_TIMERS) {
+        timer = &timers[timer_count++];
+        timer->name = name;
+        timer->period = period;
+        timer->auto_reload = auto_reload;
+        timer->callback = callback;
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return timer;
+}
+
+static BaseType_t timer_command(TimerHandle_t timer, bool active, TickType_t period)
+{
+    pthread_mutex_lock(&timer_lock);
+    if (period) {
+        timer->period = period;
+    }
+    timer->active = active;
+    timer->expiry_us = (esp_timer_get_time() / HOST_TICK_US + timer->period) * HOST_TICK_US;
+    pthread_cond_signal(&timer_changed);
+    pthread_mutex_unlock(&timer_lock);
+    return pdPASS;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait)
+{
+    return timer_command(timer, true, 0);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait)
+{
+    return timer_command(timer, false, 0);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait)
+{
+    return timer_command(timer, true, 0);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait)
+{
+    return timer_command(timer, true, period);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait)
+{
+    pthread_mutex_lock(&timer_lock);
+    timer->active = false;
+    timer->callback = NULL;
+    pthread_mutex_unlock(&timer_lock);
+    return pdPASS;
+}
+
+TimerHandle_t host_timer_find(const char *name)
+{
+    TimerHandle_t found = NULL;
+    pthread_mutex_lock(&timer_lock);
+    for (int i = 0; i < timer_count && !found; i++) {
+        if (timers[i].callback && strcmp(timers[i].name, name) == 0) {
+            found = &timers[i];
+        }
+    }
+    pthread_mutex_unlock(&timer_lock);
+    return found;
+}
+
+void host_timer_fire(TimerHandle_t timer)
+{
+    timer->callback(timer);
+}
+
+int64_t posix_timer_max_callback_us(TimerHandle_t timer)
+{
+    pthread_mutex_lock(&timer_lock);
+    const int64_t us = timer->max_callback_us;
+    pthread_mutex_unlock(&timer_lock);
+    return us;
+}
+
+int64_t posix_timer_max_late_us(TimerHandle_t timer)
+{
+    pthread_mutex_lock(&timer_lock);
+    const int64_t us = timer->max_late_us;
+    pthread_mutex_unlock(&timer_lock);
+    return us;
+}
+
+int64_t posix_mutex_max_hold_us(void)
+{
+    return __atomic_load_n(&mutex_max_hold_us, __ATOMIC_RELAXED);
+}
+
+void posix_reset_stats(void)
+{
+    pthread_mutex_lock(&timer_lock);
+    for (int i = 0; i < timer_count; i++) {
+        timers[i].max_late_us = 0;
+        timers[i].max_callback_us = 0;
+    }
+    pthread_mutex_unlock(&timer_lock);
+    __atomic_store_n(&mutex_max_hold_us, 0, __ATOMIC_RELAXED);
+}
+
+// Semaphores: a mutex starts given, a binary semaphore taken
+
+static struct host_mutex *create_semaphore(bool is_mutex)
+{
+    struct host_mutex *semaphore = calloc(1, sizeof(*semaphore));
+    pthread_mutex_init(&semaphore->lock, NULL);
+    init_cond(&semaphore->changed);
+    semaphore->available = is_mutex;
+    semaphore->is_mutex = is_mutex;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return create_semaphore(true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return create_semaphore(false);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    pthread_mutex_lock(&semaphore->lock);
+    while (!semaphore->available) {
+        if (!wait || !wait_ticks(&semaphore->changed, &semaphore->lock, wait)) {
+            pthread_mutex_unlock(&semaphore->lock);
+            return pdFALSE;
+        }
+    }
+    semaphore->available = false;
+    semaphore->taken_us = esp_timer_get_time();
+    pthread_mutex_unlock(&semaphore->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_lock(&semaphore->lock);
+    if (semaphore->is_mutex) {
+        const int64_t held_us = esp_timer_get_time() - semaphore->taken_us;
+        int64_t max_us = __atomic_load_n(&mutex_max_hold_us, __ATOMIC_RELAXED);
+        while (held_us > max_us &&
+               !__atomic_compare_exchange_n(&mutex_max_hold_us, &max_us, held_us, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+    semaphore->available = true;
+    pthread_cond_signal(&semaphore->changed);
+    pthread_mutex_unlock(&semaphore->lock);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_destroy(&semaphore->lock);
+    pthread_cond_destroy(&semaphore->changed);
+    free(semaphore);
+}
+
+// Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    init_cond(&queue->changed);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->items = calloc(length, item_size);
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (!wait || !wait_ticks(&queue->changed, &queue->lock, wait)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size,
+           item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (!wait || !wait_ticks(&queue->changed, &queue->lock, wait)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+    free(queue->items);
+    free(queue);
+}
@@ -0,0 +1,285 @@
+// FreeRTOS and esp_timer on a fake clock. The timer service is a list of
+// expiries that sim_advance_to() walks; expiries are whole ticks counted from
+// the tick a command ran in, as on the target. Each task is a thread, but
+// only one thing runs at a time: xTaskNotify hands over to the task and waits
+// until it blocks in xTaskNotifyWait again.
+
+#include "host_freertos.h"
+#include "freertos/queue.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TIMERS  8
+
+struct host_task {
+    pthread_t thread;
+    void (*entry)(void *);
+    void *arg;
+    uint32_t bits;
+    bool waiting;
+};
+
+struct host_timer {
+    const char *name;
+    TickType_t period;
+    bool auto_reload;
+    bool active;
+    int64_t expiry_us;
+    void (*callback)(TimerHandle_t);
+};
+
+struct host_queue {
+    UBaseType_t length, item_size, head, count;
+    uint8_t *items;
+};
+
+static int64_t now_us;
+static struct host_timer timers[MAX_TIMERS];
+static int timer_count;
+unsigned long sim_timer_wakeups;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+static __thread struct host_task *current_task;
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+// Tasks
+
+static void *task_thread(void *arg)
+{
+    struct host_task *task = arg;
+    current_task = task;
+    task->entry(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(void (*entry)(void *), const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    task->entry = entry;
+    task->arg = arg;
+    pthread_create(&task->thread, NULL, task_thread, task);
+
+    // Let it run up to its first wait
+    pthread_mutex_lock(&lock);
+    while (!task->waiting) {
+        pthread_cond_wait(&changed, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // The thread stays blocked in xTaskNotifyWait
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    pthread_mutex_lock(&lock);
+    task->bits |= value;
+    pthread_cond_broadcast(&changed);
+    if (task != current_task) {
+        while (!(task->waiting && task->bits == 0)) {
+            pthread_cond_wait(&changed, &lock);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t wait)
+{
+    struct host_task *task = current_task;
+    pthread_mutex_lock(&lock);
+    task->bits &= ~clear_on_entry;
+    task->waiting = true;
+    pthread_cond_broadcast(&changed);
+    while (task->bits == 0) {
+        pthread_cond_wait(&changed, &lock);
+    }
+    task->waiting = false;
+    if (value) {
+        *value = task->bits;
+    }
+    task->bits &= ~clear_on_exit;
+    pthread_mutex_unlock(&lock);
+    return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    now_us += (int64_t)ticks * HOST_TICK_US;
+}
+
+// Timers
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           void (*callback)(TimerHandle_t))
+{
+    if (timer_count == MAX_TIMERS) {
+        return NULL;
+    }
+    struct host_timer *timer = &timers[timer_count++];
+    timer->name = name;
+    timer->period = period;
+    timer->auto_reload = auto_reload;
+    timer->callback = callback;
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait)
+{
+    timer->active = true;
+    timer->expiry_us = (now_us / HOST_TICK_US + timer->period) * HOST_TICK_US;
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait)
+{
+    timer->active = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait)
+{
+    return xTimerStart(timer, wait);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait)
+{
+    timer->period = period;
+    return xTimerStart(timer, wait);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait)
+{
+    timer->active = false;
+    timer->callback = NULL;
+    return pdPASS;
+}
+
+TimerHandle_t host_timer_find(const char *name)
+{
+    for (int i = 0; i < timer_count; i++) {
+        if (timers[i].callback && strcmp(timers[i].name, name) == 0) {
+            return &timers[i];
+        }
+    }
+    return NULL;
+}
+
+void host_timer_fire(TimerHandle_t timer)
+{
+    timer->callback(timer);
+}
+
+int64_t sim_next_expiry_us(void)
+{
+    int64_t next = INT64_MAX;
+    for (int i = 0; i < timer_count; i++) {
+        if (timers[i].active && timers[i].expiry_us < next) {
+            next = timers[i].expiry_us;
+        }
+    }
+    return next;
+}
+
+void sim_advance_to(int64_t us)
+{
+    for (;;) {
+        struct host_timer *next = NULL;
+        for (int i = 0; i < timer_count; i++) {
+            if (timers[i].active && timers[i].expiry_us <= us &&
+                (!next || timers[i].expiry_us < next->expiry_us)) {
+                next = &timers[i];
+            }
+        }
+        if (!next) {
+            break;
+        }
+        now_us = next->expiry_us;
+        next->active = next->auto_reload;
+        next->expiry_us += (int64_t)next->period * HOST_TICK_US;
+        sim_timer_wakeups++;
+        next->callback(next);
+    }
+    now_us = us;
+}
+
+// Mutexes: nothing runs concurrently here
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return (SemaphoreHandle_t)calloc(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait)
+{
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+    free(mutex);
+}
+
+// Queues: receiving from an empty queue fails at once, there is nobody to wait for
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->items = calloc(length, item_size);
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    if (queue->count == queue->length) {
+        return pdFALSE;
+    }
+    memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size,
+           item, queue->item_size);
+    queue->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    if (queue->count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue->items);
+    free(queue);
+}
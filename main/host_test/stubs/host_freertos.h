@@ -0,0 +1,53 @@
+#pragma once
+
+// Test-side controls of the FreeRTOS stand-ins
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#define HOST_TICK_US    (1000000LL / configTICK_RATE_HZ)
+
+/** Timer created with this name, or NULL */
+TimerHandle_t host_timer_find(const char *name);
+
+/** Run a timer's callback now, on the calling thread */
+void host_timer_fire(TimerHandle_t timer);
+
+// freertos_sim.c: a fake clock that only moves when the test moves it. A
+// notified task runs to its next xTaskNotifyWait before xTaskNotify returns,
+// like a higher-priority task on a single core.
+
+/** Earliest expiry of an active timer, or INT64_MAX */
+int64_t sim_next_expiry_us(void);
+
+/** Move the clock to us, running every timer callback due on the way, in order */
+void sim_advance_to(int64_t us);
+
+/** Timer callbacks run so far */
+extern unsigned long sim_timer_wakeups;
+
+// freertos_posix.c runs tasks as threads on CLOCK_MONOTONIC, with a timer
+// service thread that runs the callbacks one at a time. host_timer_fire()
+// lets a test fire one from any thread, as often as it likes.
+
+/**
+ * Run tasks under SCHED_FIFO at their FreeRTOS priorities, and the timer
+ * service at service_priority. Call before creating anything. Returns false
+ * if the process may not, and everything stays at normal priority.
+ */
+bool posix_use_priorities(int service_priority);
+
+/** Longest a timer's callback ran (thread CPU time), and latest it started */
+int64_t posix_timer_max_callback_us(TimerHandle_t timer);
+int64_t posix_timer_max_late_us(TimerHandle_t timer);
+
+/** Longest any FreeRTOS mutex was held */
+int64_t posix_mutex_max_hold_us(void);
+
+/** vTaskDelay sleeps this many times shorter (1), for waits a test need not sit through */
+extern unsigned posix_delay_divisor;
+
+/** Forget the maxima so far */
+void posix_reset_stats(void);
@@ -0,0 +1,42 @@
+#include "host_log.h"
+#include "esp_timer.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+unsigned long host_log_lines;
+unsigned long host_log_bytes;
+unsigned host_log_us_per_byte;
+
+// Tests without a FreeRTOS stand-in get the monotonic clock
+__attribute__((weak)) int64_t esp_timer_get_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void host_log(char level, const char *tag, const char *format, ...)
+{
+    char line[256];
+    int len = snprintf(line, sizeof(line), "%c (%lu) %s: ", level,
+                       (unsigned long)(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    len += vsnprintf(line + len, sizeof(line) - len, format, args);
+    va_end(args);
+
+    host_log_lines++;
+    host_log_bytes += len + 1;
+    if (host_log_us_per_byte) {
+        int64_t until = esp_timer_get_time() + (int64_t)(len + 1) * host_log_us_per_byte;
+        while (esp_timer_get_time() < until) {
+        }
+    }
+    if (level != 'I' || getenv("HOST_TEST_VERBOSE")) {
+        fflush(stdout);
+        fprintf(stderr, "%s\n", line);
+    }
+}
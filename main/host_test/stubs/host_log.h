@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Lines and bytes logged so far, as esp_log would format them
+extern unsigned long host_log_lines;
+extern unsigned long host_log_bytes;
+
+// Busy-wait this long per byte logged, to cost console output (0 = free;
+// 87 is the ROM console at 115200 baud)
+extern unsigned host_log_us_per_byte;
+
+void host_log(char level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
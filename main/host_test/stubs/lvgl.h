@@ -0,0 +1,19 @@
+#pragma once
+
+// Host stand-in for the LVGL 8 image descriptor
+
+#include <stdint.h>
+
+#define LV_IMG_CF_TRUE_COLOR 4
+
+typedef struct {
+    struct {
+        uint32_t cf : 5;
+        uint32_t always_zero : 3;
+        uint32_t reserved : 2;
+        uint32_t w : 11;
+        uint32_t h : 11;
+    } header;
+    uint32_t data_size;
+    const uint8_t *data;
+} lv_img_dsc_t;
@@ -0,0 +1,103 @@
+// NVS in memory: a few blobs by key, shared by every handle
+
+#include "nvs.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_KEYS    8
+
+static struct {
+    char key[16];
+    void *value;
+    size_t length;
+} entries[MAX_KEYS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int find(const char *key)
+{
+    for (int i = 0; i < MAX_KEYS; i++) {
+        if (entries[i].value && strcmp(entries[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    pthread_mutex_lock(&lock);
+    const int i = find(key);
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    if (i >= 0 && out_value && *length < entries[i].length) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else if (i >= 0) {
+        if (out_value) {
+            memcpy(out_value, entries[i].value, entries[i].length);
+        }
+        *length = entries[i].length;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    pthread_mutex_lock(&lock);
+    int i = find(key);
+    for (int j = 0; i < 0 && j < MAX_KEYS; j++) {
+        if (!entries[j].value) {
+            i = j;
+        }
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (i >= 0) {
+        free(entries[i].value);
+        strncpy(entries[i].key, key, sizeof(entries[i].key) - 1);
+        entries[i].value = malloc(length ? length : 1);
+        memcpy(entries[i].value, value, length);
+        entries[i].length = length;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&lock);
+    const int i = find(key);
+    if (i >= 0) {
+        free(entries[i].value);
+        entries[i].value = NULL;
+    }
+    pthread_mutex_unlock(&lock);
+    return i >= 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void host_nvs_clear(void)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < MAX_KEYS; i++) {
+        free(entries[i].value);
+        entries[i].value = NULL;
+    }
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,164 @@
+// Checks image_placeholder_decode against a floating-point BlurHash decode:
+// every RGB565 channel must be within one step of the reference.
+
+#include "image_placeholder.h"
+#include "host_test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH       80
+#define HEIGHT      80
+#define HASHES      60
+
+static const char BASE83[] =
+    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~";
+
+static void encode83(uint32_t value, int len, char *out)
+{
+    for (int i = len - 1; i >= 0; i--) {
+        out[i] = BASE83[value % 83];
+        value /= 83;
+    }
+}
+
+static uint32_t decode83(const char *str, int len)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < len; i++) {
+        value = value * 83 + (uint32_t)(strchr(BASE83, str[i]) - BASE83);
+    }
+    return value;
+}
+
+// Random but well-formed hash with num_x x num_y components
+static void random_hash(int num_x, int num_y, char *hash)
+{
+    encode83((uint32_t)((num_x - 1) + (num_y - 1) * 9), 1, hash);
+    encode83((uint32_t)(rand() % 83), 1, hash + 1);
+    encode83((uint32_t)(rand() & 0xFFFFFF), 4, hash + 2);
+    for (int i = 1; i < num_x * num_y; i++) {
+        encode83((uint32_t)(rand() % (19 * 19 * 19)), 2, hash + 4 + i * 2);
+    }
+    hash[4 + 2 * num_x * num_y] = '\0';
+}
+
+static double srgb_to_linear(uint32_t value)
+{
+    double v = value / 255.0;
+    return v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+static int linear_to_srgb(double value)
+{
+    if (value <= 0) return 0;
+    if (value >= 1) return 255;
+    double v = value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1 / 2.4) - 0.055;
+    return (int)(v * 255 + 0.5);
+}
+
+static double sign_pow(double value, double exponent)
+{
+    return copysign(pow(fabs(value), exponent), value);
+}
+
+// The reference algorithm (github.com/woltapp/blurhash) in doubles, as 5/6/5-bit channels
+static void reference_decode(const char *hash, int width, int height, uint8_t *rgb)
+{
+    uint32_t size_flag = decode83(hash, 1);
+    int num_x = size_flag % 9 + 1;
+    int num_y = size_flag / 9 + 1;
+    double max_ac = (decode83(hash + 1, 1) + 1) / 166.0;
+
+    double colors[81][3];
+    uint32_t dc = decode83(hash + 2, 4);
+    colors[0][0] = srgb_to_linear(dc >> 16);
+    colors[0][1] = srgb_to_linear((dc >> 8) & 0xFF);
+    colors[0][2] = srgb_to_linear(dc & 0xFF);
+    for (int i = 1; i < num_x * num_y; i++) {
+        uint32_t ac = decode83(hash + 4 + i * 2, 2);
+        colors[i][0] = sign_pow(((int)(ac / 361) - 9) / 9.0, 2) * max_ac;
+        colors[i][1] = sign_pow(((int)(ac / 19 % 19) - 9) / 9.0, 2) * max_ac;
+        colors[i][2] = sign_pow(((int)(ac % 19) - 9) / 9.0, 2) * max_ac;
+    }
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double r = 0, g = 0, b = 0;
+            for (int j = 0; j < num_y; j++) {
+                for (int i = 0; i < num_x; i++) {
+                    double basis = cos(M_PI * x * i / width) * cos(M_PI * y * j / height);
+                    const double *c = colors[j * num_x + i];
+                    r += c[0] * basis;
+                    g += c[1] * basis;
+                    b += c[2] * basis;
+                }
+            }
+            *rgb++ = linear_to_srgb(r) >> 3;
+            *rgb++ = linear_to_srgb(g) >> 2;
+            *rgb++ = linear_to_srgb(b) >> 3;
+        }
+    }
+}
+
+// Largest per-channel difference in RGB565 steps, over HASHES random hashes
+static int worst_step_error(int num_x, int num_y, int *pixels_off)
+{
+    static uint8_t out[WIDTH * HEIGHT * 2];
+    static uint8_t ref[WIDTH * HEIGHT * 3];
+    char hash[4 + 2 * 81 + 1];
+    int worst = 0;
+
+    *pixels_off = 0;
+    for (int n = 0; n < HASHES; n++) {
+        random_hash(num_x, num_y, hash);
+        CHECK(image_placeholder_decode(hash, WIDTH, HEIGHT, out) == ESP_OK);
+        reference_decode(hash, WIDTH, HEIGHT, ref);
+
+        for (int p = 0; p < WIDTH * HEIGHT; p++) {
+            uint16_t rgb565 = (out[2 * p] << 8) | out[2 * p + 1];
+            int got[3] = { rgb565 >> 11, (rgb565 >> 5) & 0x3F, rgb565 & 0x1F };
+            int off = 0;
+            for (int c = 0; c < 3; c++) {
+                off = MAX(off, abs(got[c] - ref[3 * p + c]));
+            }
+            worst = MAX(worst, off);
+            if (off > 1) {
+                (*pixels_off)++;
+            }
+        }
+    }
+    return worst;
+}
+
+static void test_matches_reference(void)
+{
+    static const int sizes[][2] = { { 4, 3 }, { 1, 1 }, { 3, 4 }, { 6, 6 }, { 9, 9 } };
+    srand(26);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int pixels_off;
+        int worst = worst_step_error(sizes[i][0], sizes[i][1], &pixels_off);
+        printf("  %dx%d components: worst %d RGB565 step(s), %d pixel(s) more than one step off\n",
+               sizes[i][0], sizes[i][1], worst, pixels_off);
+        CHECK(worst <= 1);
+    }
+}
+
+static void test_rejects_malformed(void)
+{
+    static uint8_t out[4 * 4 * 2];
+    CHECK(image_placeholder_decode("", 4, 4, out) == ESP_ERR_INVALID_ARG);
+    CHECK(image_placeholder_decode("L00000", 4, 4, out) == ESP_ERR_INVALID_ARG);           // Length says 4x3
+    CHECK(image_placeholder_decode("00000\"", 4, 4, out) == ESP_ERR_INVALID_ARG);          // Not base83
+    CHECK(image_placeholder_decode("0000000", 4, 4, out) == ESP_ERR_INVALID_ARG);
+    CHECK(image_placeholder_decode("000000", 0, 4, out) == ESP_ERR_INVALID_ARG);
+    CHECK(image_placeholder_decode("000000", 4, 4, out) == ESP_OK);
+}
+
+int main(void)
+{
+    RUN(test_matches_reference);
+    RUN(test_rejects_malformed);
+    return host_test_report();
+}
@@ -0,0 +1,124 @@
+// Checks the LAN sharing protocol in ota_peer.c: the same range, path and
+// election cases tools/ota-peer-bench.js probes against its emulated peers.
+
+#include "ota_peer.h"
+#include "host_test.h"
+
+#include <string.h>
+
+#define IMAGE_LEN   1000
+
+static const char HEX[] = "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff";
+static const char ETAG[] = "\"00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff\"";
+
+static ota_peer_response_t plan(const char *range, const char *if_range)
+{
+    ota_peer_response_t response;
+    ota_peer_plan_response(range, if_range, ETAG, IMAGE_LEN, &response);
+    return response;
+}
+
+#define CHECK_PLAN(range, if_range, status_, first_, length_) do { \
+        ota_peer_response_t r = plan(range, if_range); \
+        CHECK(r.status == (status_) && r.first == (first_) && r.length == (length_)); \
+    } while (0)
+
+static void test_ranges(void)
+{
+    // Whole image
+    CHECK_PLAN(NULL, NULL, 200, 0, IMAGE_LEN);
+    CHECK_PLAN(NULL, ETAG, 200, 0, IMAGE_LEN);
+
+    // Resume: open-ended and closed ranges, with and without a matching If-Range
+    CHECK_PLAN("bytes=400-", NULL, 206, 400, 600);
+    CHECK_PLAN("bytes=400-", ETAG, 206, 400, 600);
+    CHECK_PLAN("bytes=0-99", NULL, 206, 0, 100);
+    CHECK_PLAN("bytes=999-999", NULL, 206, 999, 1);
+    CHECK_PLAN("bytes=900-5000", NULL, 206, 900, 100);     // Last byte clamped
+
+    // The peer now serves something else: start again from byte 0
+    CHECK_PLAN("bytes=400-", "\"stale\"", 200, 0, IMAGE_LEN);
+
+    // Past the end
+    CHECK_PLAN("bytes=1000-", NULL, 416, 0, 0);
+    CHECK_PLAN("bytes=5000-6000", ETAG, 416, 0, 0);
+
+    // Ranges this does not handle get the whole image
+    CHECK_PLAN("bytes=-100", NULL, 200, 0, IMAGE_LEN);       // Suffix
+    CHECK_PLAN("bytes=0-1,5-9", NULL, 200, 0, IMAGE_LEN);    // Several
+    CHECK_PLAN("bytes=9-5", NULL, 200, 0, IMAGE_LEN);        // Backwards
+    CHECK_PLAN("items=0-9", NULL, 200, 0, IMAGE_LEN);
+    CHECK_PLAN("bytes=1234567890-", NULL, 200, 0, IMAGE_LEN); // Too many digits
+    CHECK_PLAN("bytes=x-", NULL, 200, 0, IMAGE_LEN);
+
+    // Empty image: any range is past the end
+    ota_peer_response_t r;
+    ota_peer_plan_response("bytes=0-", NULL, ETAG, 0, &r);
+    CHECK(r.status == 416);
+}
+
+static void test_paths(void)
+{
+    uint8_t digest[32], expected[32];
+    char path[128];
+
+    CHECK(ota_peer_digest_from_hex(HEX, expected));
+
+    snprintf(path, sizeof(path), "/ota/%s", HEX);
+    CHECK(ota_peer_parse_path(path, digest) && memcmp(digest, expected, 32) == 0);
+    snprintf(path, sizeof(path), "/ota/%s?from=peer", HEX);
+    CHECK(ota_peer_parse_path(path, digest) && memcmp(digest, expected, 32) == 0);
+
+    // Upper case parses to the same digest; hex output is lower case
+    char upper[sizeof(HEX)], hex[OTA_PEER_DIGEST_HEX_LEN + 1];
+    for (size_t i = 0; i < sizeof(HEX); i++) {
+        upper[i] = (HEX[i] >= 'a' && HEX[i] <= 'f') ? HEX[i] - 'a' + 'A' : HEX[i];
+    }
+    snprintf(path, sizeof(path), "/ota/%s", upper);
+    CHECK(ota_peer_parse_path(path, digest) && memcmp(digest, expected, 32) == 0);
+    ota_peer_digest_to_hex(digest, hex);
+    CHECK(strcmp(hex, HEX) == 0);
+
+    // Bad paths are 404s
+    CHECK(!ota_peer_parse_path(NULL, digest));
+    CHECK(!ota_peer_parse_path("/ota/", digest));
+    CHECK(!ota_peer_parse_path("/ota/0011", digest));
+    snprintf(path, sizeof(path), "/ota/%s0", HEX);
+    CHECK(!ota_peer_parse_path(path, digest));
+    snprintf(path, sizeof(path), "/ota/%s/", HEX);
+    CHECK(!ota_peer_parse_path(path, digest));
+    snprintf(path, sizeof(path), "/otb/%s", HEX);
+    CHECK(!ota_peer_parse_path(path, digest));
+    snprintf(path, sizeof(path), "/ota/%.63sg", HEX);
+    CHECK(!ota_peer_parse_path(path, digest));
+    CHECK(!ota_peer_digest_from_hex(NULL, digest));
+}
+
+static void test_seeder_election(void)
+{
+    const char *peers[] = { "aa:03", "aa:01", "aa:05", "aa:01", "aa:02" };
+    const size_t count = sizeof(peers) / sizeof(peers[0]);
+
+    // Two seeders: aa:01 and aa:02 fetch upstream, everyone agrees
+    CHECK(ota_peer_is_seeder("aa:01", peers, count, 2));
+    CHECK(ota_peer_is_seeder("aa:02", peers, count, 2));
+    CHECK(!ota_peer_is_seeder("aa:03", peers, count, 2));
+    CHECK(!ota_peer_is_seeder("aa:05", peers, count, 2));
+
+    // A device that sees itself in the list (or duplicates) does not count them
+    CHECK(ota_peer_is_seeder("aa:02", peers, count, 2));
+    CHECK(!ota_peer_is_seeder("aa:04", peers, count, 3));
+    CHECK(ota_peer_is_seeder("aa:04", peers, count, 4));
+
+    // Alone on the LAN, or with no peers seen, a device seeds
+    CHECK(ota_peer_is_seeder("aa:09", NULL, 0, 1));
+    CHECK(!ota_peer_is_seeder("aa:09", NULL, 0, 0));
+}
+
+int main(void)
+{
+    RUN(test_ranges);
+    RUN(test_paths);
+    RUN(test_seeder_election);
+    return host_test_report();
+}
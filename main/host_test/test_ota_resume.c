@@ -0,0 +1,407 @@
+// Runs the plain-image OTA path (ota_apply_full in ota_manager.c, with
+// ota_resume.c and ota_writer.c) against an HTTP server in this process that
+// drops connections part way. NVS and the update slot live in memory and
+// survive between calls to ota_apply_full(), so a second call is a reboot.
+
+#include "../network/ota_manager.c"
+
+#include "host_freertos.h"
+#include "host_test.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define IMAGE_SIZE      (600 * 1024 + 123)
+#define SLOT_SIZE       (1024 * 1024)
+#define MAX_REQUESTS    16
+
+// The server: one image under one ETag, every response on its own connection
+
+static struct {
+    pthread_mutex_t lock;
+    int fd;
+    char address[32];
+    const uint8_t *image;
+    size_t size;
+    char etag[24];
+    long drop_after[MAX_REQUESTS];  // Body bytes before the connection is cut, -1 for all
+    int requests;
+    size_t first[MAX_REQUESTS];     // Where each response started
+    int status[MAX_REQUESTS];
+    size_t sent;                    // Body bytes, all responses
+} server = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static const char *header(const char *request, const char *name, char *value, size_t size)
+{
+    const char *at = strstr(request, name);
+    if (!at || sscanf(at + strlen(name), " %23[^\r\n]", value) != 1) {
+        return NULL;
+    }
+    value[size - 1] = '\0';
+    return value;
+}
+
+static void serve_one(int fd)
+{
+    char request[2048] = "";
+    size_t got = 0;
+    while (!strstr(request, "\r\n\r\n")) {
+        ssize_t n = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (n <= 0) {
+            return;
+        }
+        got += n;
+        request[got] = '\0';
+    }
+
+    pthread_mutex_lock(&server.lock);
+    const int index = server.requests < MAX_REQUESTS ? server.requests++ : MAX_REQUESTS - 1;
+    const uint8_t *image = server.image;
+    const size_t size = server.size;
+    char range[24], if_range[24], response[256];
+    size_t first = 0;
+    int status = 200;
+    const bool ranged = header(request, "\nRange:", range, sizeof(range)) &&
+                        sscanf(range, "bytes=%zu-", &first) == 1;
+    if (ranged && (!header(request, "\nIf-Range:", if_range, sizeof(if_range)) ||
+                   strcmp(if_range, server.etag) == 0)) {
+        status = first < size ? 206 : 416;
+    } else {
+        first = 0;
+    }
+    int len;
+    if (status == 416) {
+        len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%zu\r\n"
+                       "Content-Length: 0\r\n\r\n", size);
+        first = size;
+    } else if (status == 206) {
+        len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 206 Partial Content\r\nETag: %s\r\nContent-Range: bytes %zu-%zu/%zu\r\n"
+                       "Content-Length: %zu\r\n\r\n", server.etag, first, size - 1, size, size - first);
+    } else {
+        len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 200 OK\r\nETag: %s\r\nContent-Length: %zu\r\n\r\n", server.etag, size);
+    }
+    const long drop_after = server.drop_after[index];
+    server.first[index] = first;
+    server.status[index] = status;
+    pthread_mutex_unlock(&server.lock);
+
+    send(fd, response, len, MSG_NOSIGNAL);
+    size_t end = size;
+    if (drop_after >= 0 && first + drop_after < size) {
+        end = first + drop_after;
+    }
+    for (size_t at = first; at < end; ) {
+        ssize_t n = send(fd, image + at, end - at < 4096 ? end - at : 4096, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        at += n;
+        pthread_mutex_lock(&server.lock);
+        server.sent += n;
+        pthread_mutex_unlock(&server.lock);
+    }
+}
+
+static void *server_thread(void *arg)
+{
+    for (;;) {
+        int fd = accept(server.fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        serve_one(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static void server_start(void)
+{
+    server.fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    bind(server.fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(server.fd, 4);
+    getsockname(server.fd, (struct sockaddr *)&addr, &addr_len);
+    snprintf(server.address, sizeof(server.address), "127.0.0.1:%u", ntohs(addr.sin_port));
+    host_http_server = server.address;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, server_thread, NULL);
+}
+
+// Serve image from now on, cutting the first responses short as listed (ends with -1)
+static void server_reset(const uint8_t *image, const char *etag, const long *drops)
+{
+    pthread_mutex_lock(&server.lock);
+    server.image = image;
+    server.size = IMAGE_SIZE;
+    strcpy(server.etag, etag);
+    for (int i = 0; i < MAX_REQUESTS; i++) {
+        server.drop_after[i] = -1;
+    }
+    for (int i = 0; drops && drops[i] >= 0; i++) {
+        server.drop_after[i] = drops[i];
+    }
+    server.requests = 0;
+    server.sent = 0;
+    pthread_mutex_unlock(&server.lock);
+}
+
+// The update slot, and IDF calls the firmware makes around it
+
+static uint8_t slot_data[SLOT_SIZE];
+static const esp_partition_t slot = { .address = 0x110000, .size = SLOT_SIZE, .label = "ota_1" };
+static size_t write_offset;
+static int resumed_at = -1;
+static bool boot_set;
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return NULL;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return &slot;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    write_offset = 0;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *partition, size_t erase_size, size_t image_offset,
+                         esp_ota_handle_t *out_handle)
+{
+    write_offset = image_offset;
+    resumed_at = (int)image_offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (write_offset + size > SLOT_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(slot_data + write_offset, data, size);
+    write_offset += size;
+    return ESP_OK;
+}
+
+// Stands in for image validation: the slot must hold what the server serves
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (write_offset != server.size || memcmp(slot_data, server.image, server.size) != 0) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    boot_set = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size)
+{
+    if (offset + size > SLOT_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, slot_data + offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_restart(void)
+{
+    abort();
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 200000;
+}
+
+bool wifi_manager_is_connected(void)
+{
+    return true;
+}
+
+// Not on the plain-image path
+esp_err_t ota_manifest_parse(const char *text, size_t len, const char *running_version, ota_manifest_t *out)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t ota_p2p_find_sources(const uint8_t digest[32], ota_p2p_sources_t *sources)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void ota_p2p_advertise(void)
+{
+}
+
+// Tests
+
+static uint8_t image_a[IMAGE_SIZE], image_b[IMAGE_SIZE];
+
+// A fresh device: empty slot, no checkpoint
+static void power_on(void)
+{
+    host_nvs_clear();
+    memset(slot_data, 0xff, sizeof(slot_data));
+    boot_set = false;
+}
+
+// A reboot keeps NVS and flash
+static esp_err_t update(void)
+{
+    resumed_at = -1;
+    boot_set = false;
+    return ota_apply_full();
+}
+
+static void print_run(const char *name)
+{
+    printf("  %s: %d request(s), %zu bytes sent for a %d byte image:", name, server.requests,
+           server.sent, IMAGE_SIZE);
+    for (int i = 0; i < server.requests; i++) {
+        printf(" %d@%zu", server.status[i], server.first[i]);
+    }
+    printf("\n");
+}
+
+static void test_resume_within_run(void)
+{
+    power_on();
+    const long drops[] = { 150000, 200000, 1000, -1 };
+    server_reset(image_a, "\"a\"", drops);
+
+    CHECK(update() == ESP_OK);
+    print_run("drops within a run");
+    CHECK(boot_set);
+    CHECK(memcmp(slot_data, image_a, IMAGE_SIZE) == 0);
+    CHECK(server.requests == 4);
+
+    // Each retry asks from the last checkpoint the flash writer confirmed
+    CHECK(server.status[0] == 200);
+    for (int i = 1; i < server.requests; i++) {
+        CHECK(server.status[i] == 206);
+        CHECK(server.first[i] > 0 && server.first[i] % OTA_CHECKPOINT_INTERVAL == 0);
+        CHECK(server.first[i] >= server.first[i - 1]);
+    }
+    CHECK(server.first[1] <= 150000 && server.first[2] <= server.first[1] + 200000);
+    CHECK(server.sent < IMAGE_SIZE + 3 * (OTA_CHECKPOINT_INTERVAL + OTA_WRITE_BUFFERS * OTA_WRITE_BUF_SIZE));
+
+    // Done: nothing left to resume
+    CHECK(!ota_resume_available(NULL, NULL));
+}
+
+// Every attempt of a run dropped: the run gives up with a checkpoint in NVS
+static void fail_first_run(const uint8_t *image, const char *etag)
+{
+    long drops[OTA_RESUME_RETRIES + 2];
+    for (int i = 0; i <= OTA_RESUME_RETRIES; i++) {
+        drops[i] = 100000;
+    }
+    drops[OTA_RESUME_RETRIES + 1] = -1;
+    server_reset(image, etag, drops);
+    CHECK(update() != ESP_OK);
+    CHECK(!boot_set);
+    CHECK(server.requests == OTA_RESUME_RETRIES + 1);
+}
+
+static void test_resume_after_reboot(void)
+{
+    power_on();
+    fail_first_run(image_a, "\"a\"");
+    size_t offset = 0, size = 0;
+    CHECK(ota_resume_available(&offset, &size));
+    CHECK(offset > 0 && size == IMAGE_SIZE);
+
+    server_reset(image_a, "\"a\"", NULL);
+    CHECK(update() == ESP_OK);
+    print_run("after a reboot");
+    CHECK(boot_set);
+    CHECK(server.requests == 1 && server.status[0] == 206 && server.first[0] == offset);
+    CHECK(resumed_at == (int)offset);
+    CHECK(memcmp(slot_data, image_a, IMAGE_SIZE) == 0);
+}
+
+static void test_image_replaced(void)
+{
+    power_on();
+    fail_first_run(image_a, "\"a\"");
+    CHECK(ota_resume_available(NULL, NULL));
+
+    // A new release went up meanwhile: If-Range gets all of it
+    server_reset(image_b, "\"b\"", NULL);
+    CHECK(update() == ESP_OK);
+    print_run("image replaced");
+    CHECK(boot_set);
+    CHECK(server.requests == 1 && server.status[0] == 200);
+    CHECK(resumed_at == -1);
+    CHECK(memcmp(slot_data, image_b, IMAGE_SIZE) == 0);
+}
+
+static void test_corrupted_prefix(void)
+{
+    power_on();
+    fail_first_run(image_a, "\"a\"");
+    CHECK(ota_resume_available(NULL, NULL));
+
+    // Flash no longer holds what was checkpointed: start over without a Range
+    slot_data[1000] ^= 0x01;
+    server_reset(image_a, "\"a\"", NULL);
+    CHECK(update() == ESP_OK);
+    print_run("corrupted prefix");
+    CHECK(boot_set);
+    CHECK(server.requests == 1 && server.status[0] == 200);
+    CHECK(resumed_at == -1);
+    CHECK(memcmp(slot_data, image_a, IMAGE_SIZE) == 0);
+}
+
+int main(void)
+{
+    srand(1);
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        image_a[i] = (uint8_t)rand();
+        image_b[i] = (uint8_t)rand();
+    }
+    // Back-off between attempts is seconds on the device
+    posix_delay_divisor = 1000;
+    server_start();
+
+    RUN(test_resume_within_run);
+    RUN(test_resume_after_reboot);
+    RUN(test_image_replaced);
+    RUN(test_corrupted_prefix);
+    return host_test_report();
+}
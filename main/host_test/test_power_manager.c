@@ -0,0 +1,166 @@
+// Runs power_manager.c on the fake clock in freertos_sim.c: counts timer
+// wakeups over a simulated hour of use and checks each dim/off transition
+// lands in order, no earlier than its deadline and within a tick of it.
+
+#include "power_manager.h"
+#include "display_power.h"
+#include "esp_timer.h"
+#include "host_freertos.h"
+#include "host_log.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+
+#define DIM_MS  10000
+#define OFF_MS  20000
+
+static const power_config_t config = {
+    .dim_timeout_ms = DIM_MS,
+    .off_timeout_ms = OFF_MS,
+    .dim_brightness = 2,
+    .user_brightness = 80,
+};
+
+static uint8_t brightness;
+
+esp_err_t display_power_init(uint8_t initial_brightness, bool enable_fade)
+{
+    brightness = initial_brightness;
+    return ESP_OK;
+}
+
+esp_err_t display_power_set_brightness(uint8_t level, bool animate)
+{
+    brightness = level;
+    return ESP_OK;
+}
+
+void display_power_deinit(void)
+{
+}
+
+// Activity as LVGL reports it: a 5 s swipe (PRESSING at 60 Hz), taps and a scan
+static int64_t *activity;
+static int activity_count;
+
+static void add_activity(int64_t us)
+{
+    activity = realloc(activity, (activity_count + 1) * sizeof(*activity));
+    activity[activity_count++] = us;
+}
+
+static void test_idle_hour(void)
+{
+    const int64_t end_us = 3600LL * 1000000;
+    for (int64_t t = 60000000; t < 65000000; t += 16667) {
+        add_activity(t);
+    }
+    add_activity(300000000);
+    add_activity(303000000);
+    add_activity(1000000000);
+    add_activity(2000000000);
+
+    QueueHandle_t events;
+    CHECK(power_manager_init(&config) == ESP_OK);
+    CHECK(power_manager_subscribe(&events) == ESP_OK);
+    const unsigned long wakeups_before = sim_timer_wakeups;
+    const unsigned long logs_before = host_log_lines;
+
+    // After each activity the display should dim, then go off
+    const power_state_t expected[2] = { POWER_STATE_DIM, POWER_STATE_OFF };
+    const int64_t timeouts_us[2] = { DIM_MS * 1000LL, OFF_MS * 1000LL };
+    int64_t last_activity_us = esp_timer_get_time();
+    int stage = 0, transitions = 0, next = 0;
+    int64_t worst_late_us = 0, total_late_us = 0;
+
+    for (;;) {
+        const int64_t next_activity_us = next < activity_count ? activity[next] : end_us;
+        const int64_t next_timer_us = sim_next_expiry_us();
+
+        if (next_timer_us <= next_activity_us) {
+            sim_advance_to(next_timer_us);
+            power_state_event_t event;
+            while (xQueueReceive(events, &event, 0) == pdTRUE) {
+                CHECK(stage < 2 && event.new_state == expected[stage]);
+                if (stage < 2) {
+                    const int64_t late_us = next_timer_us - (last_activity_us + timeouts_us[stage]);
+                    CHECK(late_us >= 0 && late_us <= HOST_TICK_US);
+                    worst_late_us = MAX(worst_late_us, late_us);
+                    total_late_us += late_us;
+                }
+                stage++;
+                transitions++;
+            }
+            continue;
+        }
+
+        sim_advance_to(next_activity_us);
+        if (next == activity_count) {
+            break;
+        }
+        next++;
+        last_activity_us = next_activity_us;
+        power_manager_reset_activity(WAKE_SOURCE_TOUCH);
+
+        // Waking from dim or off happens before reset_activity returns
+        CHECK(power_manager_get_state() == POWER_STATE_ACTIVE);
+        CHECK(brightness == config.user_brightness);
+        power_state_event_t event;
+        while (xQueueReceive(events, &event, 0) == pdTRUE) {
+            CHECK(event.new_state == POWER_STATE_ACTIVE);
+        }
+        stage = 0;
+    }
+
+    const unsigned long wakeups = sim_timer_wakeups - wakeups_before;
+    printf("  %d activity calls, %lu timer wakeups in 1 h, %d transitions: "
+           "late by %.1f ms on average, %.1f ms at worst, %lu log lines\n",
+           activity_count, wakeups, transitions,
+           transitions ? total_late_us / 1000.0 / transitions : 0, worst_late_us / 1000.0,
+           host_log_lines - logs_before);
+
+    // Five idle stretches: a dim and an off each, plus one early wakeup for
+    // the swipe and one for the second tap, which moved the armed dim deadline
+    CHECK(transitions == 10);
+    CHECK(wakeups <= 12);
+    CHECK(power_manager_get_state() == POWER_STATE_OFF);
+    CHECK(brightness == 0);
+
+    power_manager_deinit();
+    free(activity);
+}
+
+static void test_force_state(void)
+{
+    QueueHandle_t events;
+    CHECK(power_manager_init(&config) == ESP_OK);
+    CHECK(power_manager_subscribe(&events) == ESP_OK);
+    const int64_t start_us = esp_timer_get_time();
+
+    // Forced off while active: idle time takes over again at the dim deadline
+    CHECK(power_manager_force_state(POWER_STATE_OFF) == ESP_OK);
+    CHECK(brightness == 0);
+    power_manager_reset_activity(WAKE_SOURCE_BUTTON);
+    CHECK(power_manager_get_state() == POWER_STATE_ACTIVE);
+
+    sim_advance_to(start_us + DIM_MS * 1000LL - 1);
+    CHECK(power_manager_get_state() == POWER_STATE_ACTIVE);
+    sim_advance_to(start_us + DIM_MS * 1000LL + HOST_TICK_US);
+    CHECK(power_manager_get_state() == POWER_STATE_DIM);
+    CHECK(brightness == config.dim_brightness);
+    CHECK(uxQueueMessagesWaiting(events) == 3);
+
+    // Nothing is armed once off
+    sim_advance_to(start_us + OFF_MS * 1000LL + HOST_TICK_US);
+    CHECK(power_manager_get_state() == POWER_STATE_OFF);
+    CHECK(sim_next_expiry_us() == INT64_MAX);
+
+    power_manager_deinit();
+}
+
+int main(void)
+{
+    RUN(test_idle_hour);
+    RUN(test_force_state);
+    return host_test_report();
+}
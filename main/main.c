@@ -16,11 +16,27 @@
 #include "ui/ui_components.h"
 #include "network/wifi_manager.h"
 #include "network/ota_manager.h"
+#include "network/ota_p2p.h"
 #include "network/mqtt_barcode.h"
+#include "network/coap_barcode.h"
+#include "network/image_downloader.h"
+#include "power/power_manager.h"
 #include "led_manager.h"
 
 static const char *TAG = "c6_touch_starter";
 
+#if OTA_BACKGROUND_ENABLED
+// A scan is being resolved: background OTA downloads wait for it
+static bool lookup_in_flight(void)
+{
+#if BARCODE_TRANSPORT_COAP
+    return coap_barcode_is_busy() || image_downloader_is_busy();
+#else
+    return mqtt_barcode_is_busy() || image_downloader_is_busy();
+#endif
+}
+#endif
+
 void app_main(void)
 {
     ESP_LOGI(TAG, "Starting ESP32-C6 Touch Starter - Firmware %s", FIRMWARE_VERSION);
@@ -51,10 +67,13 @@ void app_main(void)
     wifi_manager_set_status_callback(ui_components_update_wifi_status);
     
     ota_manager_set_status_callback(ui_components_update_ota_status);
-    ota_manager_set_progress_callback(ui_components_update_ota_progress);
     ota_manager_set_progress_bar_show_callback(ui_components_show_progress_bar);
     ota_manager_set_progress_bar_hide_callback(ui_components_hide_progress_bar);
     ota_manager_set_progress_bar_set_callback(ui_components_set_progress_value);
+#if OTA_BACKGROUND_ENABLED
+    ota_manager_set_busy_callback(lookup_in_flight);
+    ota_manager_set_idle_time_callback(power_manager_get_idle_time_ms);
+#endif
 
     // Start WiFi connection
     ESP_ERROR_CHECK(wifi_manager_start());
@@ -66,14 +85,27 @@ void app_main(void)
     ESP_ERROR_CHECK(mdns_service_add("ESP32-C6-Touch", "_esp32", "_tcp", 80, NULL, 0));
     ESP_LOGI(TAG, "mDNS initialized - hostname: esp32-c6-touch.local");
 
+#if OTA_P2P_ENABLED
+    // Serve this device's image to others on the LAN, so fewer fetch it upstream
+    if (ota_p2p_start() != ESP_OK) {
+        ESP_LOGW(TAG, "OTA peer sharing unavailable");
+    }
+#endif
+
+#if BARCODE_TRANSPORT_COAP
+    // Initialize CoAP barcode lookup (resolver host is resolved via mDNS)
+    ESP_LOGI(TAG, "Initializing CoAP barcode system...");
+    esp_err_t lookup_err = coap_barcode_init();
+#else
     // Initialize MQTT barcode lookup system
     ESP_LOGI(TAG, "Initializing MQTT barcode system...");
-    esp_err_t mqtt_err = mqtt_barcode_init();
-    if (mqtt_err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to initialize MQTT barcode system: %s", esp_err_to_name(mqtt_err));
+    esp_err_t lookup_err = mqtt_barcode_init();
+#endif
+    if (lookup_err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to initialize barcode lookup system: %s", esp_err_to_name(lookup_err));
         ESP_LOGW(TAG, "Barcode resolution will not be available");
     } else {
-        ESP_LOGI(TAG, "MQTT barcode system initialized successfully");
+        ESP_LOGI(TAG, "Barcode lookup system initialized successfully");
     }
 
     // Enable power management with automatic light sleep
@@ -85,6 +117,11 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
     ESP_LOGI(TAG, "Power management configured - automatic light sleep enabled (40-160MHz)");
 
+#if OTA_BACKGROUND_ENABLED
+    // Look for updates now and then, without getting in the way of scanning
+    ota_manager_start_background_checks();
+#endif
+
     ESP_LOGI(TAG, "Application started successfully");
     
     // Subscribe main task to watchdog
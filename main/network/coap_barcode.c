@@ -0,0 +1,831 @@
+#include "coap_barcode.h"
+#include "image_downloader.h"
+#include "app_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "coap_barcode";
+
+// RFC 7252 message fields
+#define COAP_VERSION            1
+#define COAP_TYPE_CON           0
+#define COAP_TYPE_ACK           2
+#define COAP_TYPE_RST           3
+#define COAP_CODE_EMPTY         0x00
+#define COAP_CODE_GET           0x01
+#define COAP_CODE_CONTENT       0x45    // 2.05
+#define COAP_CODE_NOT_FOUND     0x84    // 4.04
+#define COAP_OPTION_URI_PATH    11
+#define COAP_OPTION_URI_QUERY   15
+#define COAP_OPTION_BLOCK2      23
+#define COAP_OPTION_SIZE2       28
+#define COAP_PAYLOAD_MARKER     0xFF
+#define COAP_TOKEN_LEN          4       // The token is the lookup request ID
+
+#define COAP_BLOCK_SIZE         (16 << COAP_BLOCK_SZX)
+#define COAP_TX_BUFFER_SIZE     512                     // Image requests carry the source URL as a query
+#define COAP_RX_BUFFER_SIZE     (COAP_BLOCK_SIZE + 64)  // One block plus header and options
+#define COAP_LOOKUP_MAX_SIZE    2048                    // Same JSON limit as the MQTT path
+#define COAP_POLL_MS            50                      // How often a wait checks for a newer scan
+
+// Lookup handed from the UI to the CoAP task
+typedef struct {
+    char barcode[32];
+    uint32_t request_id;
+    mqtt_barcode_callback_t callback;
+} coap_lookup_job_t;
+
+// Fields of a received message; payload points into the receive buffer
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t message_id;
+    uint8_t token_len;
+    uint32_t token;
+    bool has_block2;
+    uint32_t block_num;
+    bool block_more;
+    uint32_t size2;
+    const uint8_t *payload;
+    size_t payload_len;
+} coap_message_t;
+
+// One outstanding request of the image block window
+typedef struct {
+    uint32_t num;
+    uint16_t message_id;
+    int64_t retransmit_at_ms;
+    uint32_t timeout_ms;
+    uint8_t attempts;
+    bool in_use;
+    bool acked;                 // Empty ACK seen; the block follows as a separate response
+    bool received;
+    size_t len;
+    uint8_t *data;              // COAP_BLOCK_SIZE bytes
+} coap_block_slot_t;
+
+static struct {
+    int sock;
+    QueueHandle_t jobs;         // Length 1: a newer scan replaces one not yet started
+    TaskHandle_t task;
+    struct sockaddr_in resolver;
+    bool resolved;
+    uint16_t message_id;
+    char client_id[32];
+    uint8_t tx[COAP_TX_BUFFER_SIZE];
+    uint8_t rx[COAP_RX_BUFFER_SIZE];
+    char lookup_body[COAP_LOOKUP_MAX_SIZE + 1];
+    size_t lookup_len;
+    uint32_t packets;           // Datagrams sent and received, for per-scan logging
+    bool initialized;
+    volatile bool busy;         // run_lookup() in progress
+    const char *status_message;
+} coap_state = { .sock = -1 };
+
+static int64_t now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * A newer scan is queued; whatever is running gives up at its next wait
+ */
+static bool superseded(void)
+{
+    return uxQueueMessagesWaiting(coap_state.jobs) > 0;
+}
+
+static size_t encode_uint(uint32_t value, uint8_t *out)
+{
+    uint8_t reversed[4];
+    size_t len = 0;
+    while (value) {
+        reversed[len++] = value & 0xFF;
+        value >>= 8;
+    }
+    for (size_t i = 0; i < len; i++) {
+        out[i] = reversed[len - 1 - i];
+    }
+    return len;
+}
+
+/**
+ * Option delta or length as a nibble plus extended bytes
+ */
+static uint8_t option_nibble(uint32_t value, uint8_t *ext, size_t *ext_len)
+{
+    if (value < 13) {
+        return value;
+    }
+    if (value < 269) {
+        ext[(*ext_len)++] = value - 13;
+        return 13;
+    }
+    ext[(*ext_len)++] = (value - 269) >> 8;
+    ext[(*ext_len)++] = (value - 269) & 0xFF;
+    return 14;
+}
+
+/**
+ * Append one option, delta-encoded against the previous option number
+ * @return New write position, or 0 if the message does not fit
+ */
+static size_t put_option(size_t pos, uint16_t *last_number, uint16_t number, const uint8_t *value, size_t len)
+{
+    uint8_t ext[4];
+    size_t ext_len = 0;
+    uint8_t delta_nibble = option_nibble(number - *last_number, ext, &ext_len);
+    uint8_t len_nibble = option_nibble(len, ext, &ext_len);
+
+    if (pos + 1 + ext_len + len > COAP_TX_BUFFER_SIZE) {
+        return 0;
+    }
+    coap_state.tx[pos++] = (delta_nibble << 4) | len_nibble;
+    memcpy(coap_state.tx + pos, ext, ext_len);
+    pos += ext_len;
+    if (len > 0) {
+        memcpy(coap_state.tx + pos, value, len);
+        pos += len;
+    }
+    *last_number = number;
+    return pos;
+}
+
+/**
+ * Append one option per separator-delimited part of a string ("a/b" or "k=v&k2=v2")
+ */
+static size_t put_split_option(size_t pos, uint16_t *last_number, uint16_t number, const char *text, char separator)
+{
+    while (pos && text && *text) {
+        const char *end = strchr(text, separator);
+        size_t len = end ? (size_t)(end - text) : strlen(text);
+        if (len > 0) {
+            pos = put_option(pos, last_number, number, (const uint8_t *)text, len);
+        }
+        text = end ? end + 1 : NULL;
+    }
+    return pos;
+}
+
+/**
+ * Build a confirmable GET for one block of path[/id]?query into the transmit buffer
+ *
+ * path is split on '/'; id, if given, is one more Uri-Path option taken
+ * verbatim, so a barcode holding '/' stays one segment.
+ *
+ * The resolver always answers with the block size asked for, so block
+ * numbers count in COAP_BLOCK_SIZE units.
+ *
+ * @return Message length, or 0 if it does not fit
+ */
+static size_t build_get(uint16_t message_id, uint32_t token, const char *path, const char *id,
+                        const char *query, uint32_t block_num)
+{
+    uint8_t *buf = coap_state.tx;
+    buf[0] = (COAP_VERSION << 6) | (COAP_TYPE_CON << 4) | COAP_TOKEN_LEN;
+    buf[1] = COAP_CODE_GET;
+    buf[2] = message_id >> 8;
+    buf[3] = message_id & 0xFF;
+    buf[4] = token >> 24;
+    buf[5] = token >> 16;
+    buf[6] = token >> 8;
+    buf[7] = token & 0xFF;
+
+    size_t pos = 8;
+    uint16_t last_number = 0;
+    uint8_t value[4];
+    pos = put_split_option(pos, &last_number, COAP_OPTION_URI_PATH, path, '/');
+    if (pos && id) {
+        pos = put_option(pos, &last_number, COAP_OPTION_URI_PATH, (const uint8_t *)id, strlen(id));
+    }
+    pos = put_split_option(pos, &last_number, COAP_OPTION_URI_QUERY, query, '&');
+    if (pos) {
+        pos = put_option(pos, &last_number, COAP_OPTION_BLOCK2, value,
+                         encode_uint((block_num << 4) | COAP_BLOCK_SZX, value));
+    }
+    // An empty Size2 on the first block asks for the total size
+    if (pos && block_num == 0) {
+        pos = put_option(pos, &last_number, COAP_OPTION_SIZE2, value, 0);
+    }
+    return pos;
+}
+
+static bool read_extended(const uint8_t *buf, size_t len, size_t *pos, uint32_t *value)
+{
+    if (*value == 13) {
+        if (*pos + 1 > len) {
+            return false;
+        }
+        *value = buf[(*pos)++] + 13;
+    } else if (*value == 14) {
+        if (*pos + 2 > len) {
+            return false;
+        }
+        *value = ((buf[*pos] << 8) | buf[*pos + 1]) + 269;
+        *pos += 2;
+    } else if (*value == 15) {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_message(const uint8_t *buf, size_t len, coap_message_t *msg)
+{
+    if (len < 4 || (buf[0] >> 6) != COAP_VERSION) {
+        return false;
+    }
+    memset(msg, 0, sizeof(*msg));
+    msg->type = (buf[0] >> 4) & 0x03;
+    msg->token_len = buf[0] & 0x0F;
+    msg->code = buf[1];
+    msg->message_id = (buf[2] << 8) | buf[3];
+    if (msg->token_len > 8 || len < 4 + (size_t)msg->token_len) {
+        return false;
+    }
+    for (int i = 0; i < msg->token_len && i < 4; i++) {
+        msg->token = (msg->token << 8) | buf[4 + i];
+    }
+
+    size_t pos = 4 + msg->token_len;
+    uint32_t number = 0;
+    while (pos < len) {
+        if (buf[pos] == COAP_PAYLOAD_MARKER) {
+            msg->payload = buf + pos + 1;
+            msg->payload_len = len - pos - 1;
+            break;
+        }
+        uint32_t delta = buf[pos] >> 4;
+        uint32_t opt_len = buf[pos] & 0x0F;
+        pos++;
+        if (!read_extended(buf, len, &pos, &delta) || !read_extended(buf, len, &pos, &opt_len) ||
+            pos + opt_len > len) {
+            return false;
+        }
+        number += delta;
+
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < opt_len && i < 4; i++) {
+            value = (value << 8) | buf[pos + i];
+        }
+        if (number == COAP_OPTION_BLOCK2) {
+            msg->has_block2 = true;
+            msg->block_num = value >> 4;
+            msg->block_more = (value & 0x08) != 0;
+        } else if (number == COAP_OPTION_SIZE2) {
+            msg->size2 = value;
+        }
+        pos += opt_len;
+    }
+    return true;
+}
+
+static void send_datagram(const uint8_t *data, size_t len)
+{
+    if (send(coap_state.sock, data, len, 0) < 0) {
+        ESP_LOGW(TAG, "send failed: errno %d", errno);
+    }
+    coap_state.packets++;
+}
+
+static void send_empty_ack(uint16_t message_id)
+{
+    uint8_t ack[4] = {
+        (COAP_VERSION << 6) | (COAP_TYPE_ACK << 4), COAP_CODE_EMPTY, message_id >> 8, message_id & 0xFF
+    };
+    send_datagram(ack, sizeof(ack));
+}
+
+/**
+ * Wait up to timeout_ms for a message from the resolver
+ *
+ * Confirmable messages (separate responses) are acknowledged here, wanted
+ * or not, so the resolver stops retransmitting them.
+ */
+static bool receive_message(int timeout_ms, coap_message_t *msg)
+{
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    setsockopt(coap_state.sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int len = recv(coap_state.sock, coap_state.rx, sizeof(coap_state.rx), 0);
+    if (len <= 0) {
+        return false;
+    }
+    coap_state.packets++;
+    if (!parse_message(coap_state.rx, len, msg)) {
+        return false;
+    }
+    if (msg->type == COAP_TYPE_CON) {
+        send_empty_ack(msg->message_id);
+    }
+    return true;
+}
+
+static uint32_t initial_ack_timeout(void)
+{
+    // ACK_RANDOM_FACTOR 1.5
+    return COAP_ACK_TIMEOUT_MS + esp_random() % (COAP_ACK_TIMEOUT_MS / 2 + 1);
+}
+
+/**
+ * Send one confirmable GET and wait for its response, piggybacked or separate
+ * @return ESP_OK with the response in msg, ESP_ERR_TIMEOUT, ESP_FAIL on reset,
+ *         ESP_ERR_INVALID_STATE if a newer scan is waiting
+ */
+static esp_err_t exchange(uint32_t token, const char *path, const char *id, const char *query,
+                          uint32_t block_num, int64_t deadline_ms, coap_message_t *msg)
+{
+    uint16_t message_id = ++coap_state.message_id;
+    size_t len = build_get(message_id, token, path, id, query, block_num);
+    if (len == 0) {
+        ESP_LOGE(TAG, "Request for %s does not fit in %d bytes", path, COAP_TX_BUFFER_SIZE);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t timeout_ms = initial_ack_timeout();
+    int64_t retransmit_at = now_ms() + timeout_ms;
+    int attempts = 0;
+    bool acked = false;
+    send_datagram(coap_state.tx, len);
+
+    while (true) {
+        if (superseded()) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        int64_t now = now_ms();
+        if (now >= deadline_ms) {
+            return ESP_ERR_TIMEOUT;
+        }
+        if (!acked && now >= retransmit_at) {
+            if (attempts >= COAP_MAX_RETRANSMIT) {
+                return ESP_ERR_TIMEOUT;
+            }
+            attempts++;
+            timeout_ms *= 2;
+            retransmit_at = now + timeout_ms;
+            ESP_LOGW(TAG, "Retransmitting request %u (attempt %d)", message_id, attempts + 1);
+            send_datagram(coap_state.tx, len);
+        }
+
+        int64_t wake = acked || retransmit_at > deadline_ms ? deadline_ms : retransmit_at;
+        int wait = wake - now > COAP_POLL_MS ? COAP_POLL_MS : (int)(wake - now);
+        if (!receive_message(wait > 0 ? wait : 1, msg)) {
+            continue;
+        }
+
+        if (msg->message_id == message_id && msg->type == COAP_TYPE_RST) {
+            return ESP_FAIL;
+        }
+        if (msg->message_id == message_id && msg->type == COAP_TYPE_ACK) {
+            if (msg->code == COAP_CODE_EMPTY) {
+                acked = true;   // Slow lookup: the response follows on its own
+                continue;
+            }
+            return msg->token == token ? ESP_OK : ESP_FAIL;
+        }
+        if (msg->type != COAP_TYPE_ACK && msg->code != COAP_CODE_EMPTY &&
+            msg->token_len == COAP_TOKEN_LEN && msg->token == token &&
+            (!msg->has_block2 || msg->block_num == block_num)) {
+            return ESP_OK;
+        }
+    }
+}
+
+/**
+ * GET /lookup/<barcode>?d=<client id> into lookup_body, following Block2
+ */
+static esp_err_t fetch_lookup(const coap_lookup_job_t *job, int64_t deadline_ms)
+{
+    char query[48];
+    snprintf(query, sizeof(query), "d=%s", coap_state.client_id);
+
+    coap_state.lookup_len = 0;
+    for (uint32_t num = 0; ; num++) {
+        coap_message_t msg;
+        esp_err_t err = exchange(job->request_id, "lookup", job->barcode, query, num, deadline_ms, &msg);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (msg.code != COAP_CODE_CONTENT) {
+            ESP_LOGW(TAG, "Lookup answered %d.%02d", msg.code >> 5, msg.code & 0x1F);
+            return ESP_FAIL;
+        }
+
+        size_t room = COAP_LOOKUP_MAX_SIZE - coap_state.lookup_len;
+        size_t len = msg.payload_len < room ? msg.payload_len : room;
+        memcpy(coap_state.lookup_body + coap_state.lookup_len, msg.payload, len);
+        coap_state.lookup_len += len;
+
+        if (!msg.has_block2 || !msg.block_more || coap_state.lookup_len >= COAP_LOOKUP_MAX_SIZE) {
+            break;
+        }
+    }
+    coap_state.lookup_body[coap_state.lookup_len] = '\0';
+    return ESP_OK;
+}
+
+static void send_block_request(coap_block_slot_t *slot, uint32_t token, const char *path, const char *query)
+{
+    size_t len = build_get(slot->message_id, token, path, NULL, query, slot->num);
+    if (len > 0) {
+        send_datagram(coap_state.tx, len);
+    }
+}
+
+/**
+ * Pull the product image block-wise into the image downloader's inline path
+ *
+ * Block 0 brings the total size (Size2). After that up to COAP_BLOCK_WINDOW
+ * block requests stay outstanding, so the transfer costs about one round
+ * trip per window instead of one per block, and finished blocks are handed
+ * over in order. If this fails, the downloader's inline timeout falls back to
+ * an HTTP GET of the same URL.
+ *
+ * @param request_id Lookup request ID (token, and the ID the downloader waits for)
+ * @param image_url Resolver image URL, e.g. http://desk.local:3000/image/<id>?url=...&w=80&h=80
+ * @param deadline_ms Give up at this time
+ */
+static esp_err_t fetch_image(uint32_t request_id, const char *image_url, int64_t deadline_ms)
+{
+    // Same path and query as the HTTP proxy: image/<id> and url=...&w=..&h=..
+    const char *path = strstr(image_url, "://");
+    path = path ? strchr(path + 3, '/') : NULL;
+    if (path == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    path++;
+    const char *query = strchr(path, '?');
+    size_t path_len = query ? (size_t)(query - path) : strlen(path);
+    char path_buf[64];
+    if (path_len >= sizeof(path_buf)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(path_buf, path, path_len);
+    path_buf[path_len] = '\0';
+    if (query) {
+        query++;
+    }
+
+    coap_message_t msg;
+    esp_err_t err = exchange(request_id, path_buf, NULL, query, 0, deadline_ms, &msg);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (msg.code == COAP_CODE_NOT_FOUND) {
+        image_downloader_inline_data(request_id, 0, 0, NULL, 0);
+        return ESP_OK;
+    }
+    if (msg.code != COAP_CODE_CONTENT) {
+        return ESP_FAIL;
+    }
+    size_t total = msg.has_block2 ? msg.size2 : msg.payload_len;
+    if (total == 0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    err = image_downloader_inline_data(request_id, total, 0, msg.payload, msg.payload_len);
+    if (err != ESP_OK || !msg.has_block2 || !msg.block_more) {
+        return err;
+    }
+
+    uint32_t block_count = (total + COAP_BLOCK_SIZE - 1) / COAP_BLOCK_SIZE;
+    uint8_t *window = malloc(COAP_BLOCK_WINDOW * COAP_BLOCK_SIZE);
+    if (window == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    coap_block_slot_t slots[COAP_BLOCK_WINDOW] = {0};
+    for (int i = 0; i < COAP_BLOCK_WINDOW; i++) {
+        slots[i].data = window + i * COAP_BLOCK_SIZE;
+    }
+
+    uint32_t next_request = 1;
+    uint32_t next_deliver = 1;
+    while (err == ESP_OK && next_deliver < block_count) {
+        int64_t now = now_ms();
+
+        // Keep the window full
+        for (int i = 0; i < COAP_BLOCK_WINDOW && next_request < block_count; i++) {
+            if (!slots[i].in_use) {
+                coap_block_slot_t *slot = &slots[i];
+                slot->num = next_request++;
+                slot->message_id = ++coap_state.message_id;
+                slot->timeout_ms = initial_ack_timeout();
+                slot->retransmit_at_ms = now + slot->timeout_ms;
+                slot->attempts = 0;
+                slot->in_use = true;
+                slot->acked = false;
+                slot->received = false;
+                send_block_request(slot, request_id, path_buf, query);
+            }
+        }
+
+        if (superseded()) {
+            err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        if (now >= deadline_ms) {
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+
+        // Retransmit unanswered requests with exponential backoff
+        int64_t wake = deadline_ms;
+        for (int i = 0; i < COAP_BLOCK_WINDOW && err == ESP_OK; i++) {
+            coap_block_slot_t *slot = &slots[i];
+            if (!slot->in_use || slot->received || slot->acked) {
+                continue;
+            }
+            if (now >= slot->retransmit_at_ms) {
+                if (slot->attempts >= COAP_MAX_RETRANSMIT) {
+                    err = ESP_ERR_TIMEOUT;
+                    break;
+                }
+                slot->attempts++;
+                slot->timeout_ms *= 2;
+                slot->retransmit_at_ms = now + slot->timeout_ms;
+                send_block_request(slot, request_id, path_buf, query);
+            }
+            if (slot->retransmit_at_ms < wake) {
+                wake = slot->retransmit_at_ms;
+            }
+        }
+        if (err != ESP_OK) {
+            break;
+        }
+
+        int wait = wake - now > COAP_POLL_MS ? COAP_POLL_MS : (int)(wake - now);
+        if (receive_message(wait > 0 ? wait : 1, &msg)) {
+            for (int i = 0; i < COAP_BLOCK_WINDOW; i++) {
+                coap_block_slot_t *slot = &slots[i];
+                if (!slot->in_use || slot->received) {
+                    continue;
+                }
+                bool by_id = msg.message_id == slot->message_id &&
+                             (msg.type == COAP_TYPE_ACK || msg.type == COAP_TYPE_RST);
+                bool separate = msg.type != COAP_TYPE_ACK && msg.code != COAP_CODE_EMPTY &&
+                                msg.token == request_id && msg.has_block2 && msg.block_num == slot->num;
+                if (!by_id && !separate) {
+                    continue;
+                }
+                if (msg.type == COAP_TYPE_RST) {
+                    err = ESP_FAIL;
+                } else if (msg.code == COAP_CODE_EMPTY) {
+                    slot->acked = true;
+                } else if (msg.code != COAP_CODE_CONTENT || !msg.has_block2 || msg.block_num != slot->num) {
+                    err = ESP_FAIL;
+                } else {
+                    slot->len = msg.payload_len < COAP_BLOCK_SIZE ? msg.payload_len : COAP_BLOCK_SIZE;
+                    memcpy(slot->data, msg.payload, slot->len);
+                    slot->received = true;
+                }
+                break;
+            }
+        }
+
+        // Hand finished blocks to the downloader in order
+        bool delivered = true;
+        while (err == ESP_OK && delivered) {
+            delivered = false;
+            for (int i = 0; i < COAP_BLOCK_WINDOW; i++) {
+                coap_block_slot_t *slot = &slots[i];
+                if (slot->in_use && slot->received && slot->num == next_deliver) {
+                    err = image_downloader_inline_data(request_id, total, (size_t)slot->num * COAP_BLOCK_SIZE,
+                                                       slot->data, slot->len);
+                    slot->in_use = false;
+                    next_deliver++;
+                    delivered = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(window);
+    return err;
+}
+
+/**
+ * Run one scan: lookup, result callback, then the image
+ */
+static void run_lookup(const coap_lookup_job_t *job)
+{
+    int64_t start_ms = now_ms();
+    uint32_t packets_before = coap_state.packets;
+    mqtt_barcode_result_t result;
+
+    ESP_LOGI(TAG, "Starting barcode lookup for: %s", job->barcode);
+    esp_err_t err = fetch_lookup(job, start_ms + MQTT_REQUEST_TIMEOUT_MS);
+    if (err == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Lookup %u superseded by a newer scan", job->request_id);
+        return;
+    }
+    if (err == ESP_OK) {
+        err = mqtt_barcode_parse_response(coap_state.lookup_body, coap_state.lookup_len, &result);
+    }
+    if (err == ESP_OK && result.request_id != job->request_id) {
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Barcode lookup failed for request ID %u: %s", job->request_id, esp_err_to_name(err));
+        if (err == ESP_ERR_TIMEOUT) {
+            // The resolver may have moved; look the name up again before the next scan
+            coap_state.resolved = false;
+            coap_state.status_message = "Timeout";
+        }
+        memset(&result, 0, sizeof(result));
+        strncpy(result.barcode, job->barcode, sizeof(result.barcode) - 1);
+        result.success = false;
+        result.request_id = job->request_id;
+    } else {
+        coap_state.status_message = "Ready";
+        ESP_LOGI(TAG, "Lookup %u answered in %lld ms, %u packets",
+                 job->request_id, now_ms() - start_ms, coap_state.packets - packets_before);
+    }
+
+    job->callback(&result);
+
+    // The callback has started the downloader's inline wait for this request ID
+    if (err != ESP_OK || !result.success || !result.image_inline || result.image_url[0] == '\0') {
+        return;
+    }
+    err = fetch_image(job->request_id, result.image_url, now_ms() + MQTT_INLINE_IMAGE_TIMEOUT_MS);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Scan %u complete in %lld ms, %u packets",
+                 job->request_id, now_ms() - start_ms, coap_state.packets - packets_before);
+    } else if (err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Block-wise image fetch for %u failed (%s), waiting for HTTP fallback",
+                 job->request_id, esp_err_to_name(err));
+    }
+}
+
+static esp_err_t resolve_resolver(void)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", COAP_RESOLVER_PORT);
+
+    int err = getaddrinfo(COAP_RESOLVER_HOST, port, &hints, &res);
+    if (err != 0 || res == NULL) {
+        ESP_LOGW(TAG, "Cannot resolve %s (error %d)", COAP_RESOLVER_HOST, err);
+        coap_state.status_message = "Resolving";
+        return ESP_FAIL;
+    }
+    memcpy(&coap_state.resolver, res->ai_addr, sizeof(coap_state.resolver));
+    freeaddrinfo(res);
+
+    // A connected UDP socket only receives datagrams from the resolver
+    if (connect(coap_state.sock, (struct sockaddr *)&coap_state.resolver, sizeof(coap_state.resolver)) != 0) {
+        ESP_LOGE(TAG, "connect failed: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    coap_state.resolved = true;
+    coap_state.status_message = "Ready";
+    ESP_LOGI(TAG, "Resolver %s at %s:%d", COAP_RESOLVER_HOST, inet_ntoa(coap_state.resolver.sin_addr), COAP_RESOLVER_PORT);
+    return ESP_OK;
+}
+
+static void coap_task(void *arg)
+{
+    coap_lookup_job_t job;
+
+    while (1) {
+        if (!coap_state.resolved && resolve_resolver() != ESP_OK) {
+            // Fail scans that arrive before the resolver is known instead of leaving them hanging
+            if (xQueueReceive(coap_state.jobs, &job, pdMS_TO_TICKS(COAP_RESOLVE_RETRY_MS)) == pdTRUE) {
+                mqtt_barcode_result_t result = {0};
+                strncpy(result.barcode, job.barcode, sizeof(result.barcode) - 1);
+                result.request_id = job.request_id;
+                job.callback(&result);
+            }
+            continue;
+        }
+
+        if (xQueuePeek(coap_state.jobs, &job, portMAX_DELAY) == pdTRUE) {
+            // Busy before the job leaves the queue, so is_busy() never sees a gap
+            coap_state.busy = true;
+            if (xQueueReceive(coap_state.jobs, &job, 0) == pdTRUE) {
+                run_lookup(&job);
+            }
+            coap_state.busy = false;
+        }
+    }
+}
+
+/**
+ * Initialize the CoAP lookup transport
+ */
+esp_err_t coap_barcode_init(void)
+{
+    if (coap_state.initialized) {
+        ESP_LOGW(TAG, "CoAP barcode system already initialized");
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "Initializing CoAP barcode lookup system");
+
+    // Same client ID as the MQTT transport; the resolver uses it for per-device fairness
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(coap_state.client_id, sizeof(coap_state.client_id),
+             "%s_%02x%02x%02x", MQTT_CLIENT_ID_PREFIX, mac[3], mac[4], mac[5]);
+    coap_state.message_id = esp_random() & 0xFFFF;
+
+    coap_state.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (coap_state.sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    coap_state.jobs = xQueueCreate(1, sizeof(coap_lookup_job_t));
+    if (coap_state.jobs == NULL) {
+        ESP_LOGE(TAG, "Failed to create lookup queue");
+        close(coap_state.sock);
+        coap_state.sock = -1;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(coap_task, "coap_barcode", COAP_TASK_STACK_SIZE, NULL,
+                    COAP_TASK_PRIORITY, &coap_state.task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create CoAP task");
+        vQueueDelete(coap_state.jobs);
+        close(coap_state.sock);
+        coap_state.sock = -1;
+        return ESP_ERR_NO_MEM;
+    }
+
+    coap_state.status_message = "Resolving";
+    coap_state.initialized = true;
+    ESP_LOGI(TAG, "CoAP barcode system initialized (client %s, resolver %s:%d)",
+             coap_state.client_id, COAP_RESOLVER_HOST, COAP_RESOLVER_PORT);
+    return ESP_OK;
+}
+
+/**
+ * Lookup barcode information via CoAP
+ */
+esp_err_t coap_barcode_lookup(const char *barcode, mqtt_barcode_callback_t callback)
+{
+    if (!coap_state.initialized) {
+        ESP_LOGE(TAG, "CoAP barcode system not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (barcode == NULL || callback == NULL) {
+        ESP_LOGE(TAG, "Invalid parameters for barcode lookup");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    coap_lookup_job_t job = {0};
+    strncpy(job.barcode, barcode, sizeof(job.barcode) - 1);
+    job.request_id = esp_random();
+    job.callback = callback;
+
+    // Replaces a scan not yet started; a running one notices and gives up
+    xQueueOverwrite(coap_state.jobs, &job);
+    return ESP_OK;
+}
+
+/**
+ * Check if the resolver address is known
+ */
+bool coap_barcode_is_connected(void)
+{
+    return coap_state.initialized && coap_state.resolved;
+}
+
+/**
+ * Check if a scan is queued or being looked up
+ */
+bool coap_barcode_is_busy(void)
+{
+    return coap_state.initialized && (coap_state.busy || uxQueueMessagesWaiting(coap_state.jobs) > 0);
+}
+
+/**
+ * Get transport status string
+ */
+const char* coap_barcode_get_status(void)
+{
+    if (!coap_state.initialized) {
+        return "Not initialized";
+    }
+    return coap_state.status_message ? coap_state.status_message : "Resolving";
+}
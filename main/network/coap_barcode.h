@@ -0,0 +1,57 @@
+#pragma once
+
+#include "esp_err.h"
+#include "mqtt_barcode.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the CoAP lookup transport
+ *
+ * Alternative to MQTT, selected with BARCODE_TRANSPORT_COAP. Each lookup is
+ * a confirmable GET straight to the resolver's CoAP endpoint, answered in
+ * the ACK or, for slow lookups, after an empty ACK. The product image is
+ * then pulled block-wise into the image downloader's inline path, which
+ * falls back to HTTP if it does not complete. There is no connection and
+ * no keepalive traffic between scans.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t coap_barcode_init(void);
+
+/**
+ * @brief Lookup barcode information via CoAP
+ *
+ * Returns immediately; the callback runs on the CoAP task. A new lookup
+ * cancels one still in progress, whose callback is then never called.
+ *
+ * @param barcode Barcode string to lookup
+ * @param callback Callback function for result (same result type as the MQTT transport)
+ * @return ESP_OK if queued, error code otherwise
+ */
+esp_err_t coap_barcode_lookup(const char *barcode, mqtt_barcode_callback_t callback);
+
+/**
+ * @brief Check if the resolver address is known
+ * @return true once COAP_RESOLVER_HOST has resolved, false otherwise
+ */
+bool coap_barcode_is_connected(void);
+
+/**
+ * @brief Check if a scan is queued or being looked up
+ * @return true until its callback has run and its block-wise image is done
+ */
+bool coap_barcode_is_busy(void);
+
+/**
+ * @brief Get transport status string
+ * @return Status string (for UI display)
+ */
+const char* coap_barcode_get_status(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,10 +4,12 @@
 
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 
 static const char *TAG = "image_downloader";
@@ -16,6 +18,17 @@ static const char *TAG = "image_downloader";
 #define MAX_IMAGE_SIZE          (50 * 1024)    // 50KB max
 #define DOWNLOAD_TIMEOUT_MS     10000           // 10 second timeout
 #define HTTP_BUFFER_SIZE        4096            // 4KB chunks
+#define ETAG_MAX_LEN            48              // Resolver tags are 34 chars including quotes
+#define INLINE_COPY_RECHECK_US  5000            // Timeout retry while a chunk is being copied in
+
+// Recently downloaded image kept for conditional GET revalidation
+typedef struct {
+    char url[256];
+    char etag[ETAG_MAX_LEN];
+    uint8_t *data;
+    size_t size;
+    uint32_t last_used;
+} etag_cache_entry_t;
 
 // Download state
 typedef struct {
@@ -26,10 +39,26 @@ typedef struct {
     void *user_data;
     bool busy;
     char url[256];
+    int64_t start_us;               // For time-to-image logging
+    char etag[ETAG_MAX_LEN];        // ETag of the current response
+    etag_cache_entry_t *cached;     // Local copy being revalidated, if any
+    
+    // Inline (MQTT/CoAP) delivery
+    bool inline_active;
+    bool inline_copying;            // A chunk is being written into the buffer
+    uint32_t inline_request_id;
+    esp_timer_handle_t inline_timer;
 } download_state_t;
 
 static download_state_t download_state = {0};
 
+// Only the download task touches this, and only one download runs at a time
+static etag_cache_entry_t etag_cache[IMAGE_ETAG_CACHE_ENTRIES];
+static uint32_t etag_cache_clock = 0;
+
+// Guards inline_active and inline_copying between the transport task and the timeout timer
+static portMUX_TYPE inline_lock = portMUX_INITIALIZER_UNLOCKED;
+
 /**
  * HTTP event handler for image download
  */
@@ -51,6 +80,12 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             download_state.data_size += evt->data_len;
             break;
             
+        case HTTP_EVENT_ON_HEADER:
+            if (strcasecmp(evt->header_key, "ETag") == 0) {
+                strncpy(download_state.etag, evt->header_value, sizeof(download_state.etag) - 1);
+            }
+            break;
+            
         case HTTP_EVENT_ON_FINISH:
             ESP_LOGI(TAG, "Image download completed: %d bytes", download_state.data_size);
             break;
@@ -65,6 +100,56 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+/**
+ * Find the cached copy of a URL
+ */
+static etag_cache_entry_t *etag_cache_find(const char *url)
+{
+    for (int i = 0; i < IMAGE_ETAG_CACHE_ENTRIES; i++) {
+        if (etag_cache[i].data && strcmp(etag_cache[i].url, url) == 0) {
+            return &etag_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Remember a downloaded image and its ETag, replacing the least recently used slot
+ */
+static void etag_cache_store(const char *url, const char *etag, const uint8_t *data, size_t size)
+{
+    etag_cache_entry_t *slot = etag_cache_find(url);
+    
+    if (!slot) {
+        slot = &etag_cache[0];
+        for (int i = 0; i < IMAGE_ETAG_CACHE_ENTRIES; i++) {
+            if (!etag_cache[i].data) {
+                slot = &etag_cache[i];
+                break;
+            }
+            if (etag_cache[i].last_used < slot->last_used) {
+                slot = &etag_cache[i];
+            }
+        }
+    }
+    
+    if (slot->size != size) {
+        free(slot->data);
+        slot->data = malloc(size);
+        slot->size = size;
+        if (!slot->data) {
+            ESP_LOGW(TAG, "No memory to cache image for revalidation");
+            slot->size = 0;
+            return;
+        }
+    }
+    
+    memcpy(slot->data, data, size);
+    strncpy(slot->url, url, sizeof(slot->url) - 1);
+    strncpy(slot->etag, etag, sizeof(slot->etag) - 1);
+    slot->last_used = ++etag_cache_clock;
+}
+
 /**
  * Download task function
  */
@@ -91,6 +176,12 @@ static void download_task(void *param)
         goto cleanup;
     }
     
+    // Revalidate instead of re-downloading pixels we already have
+    download_state.cached = etag_cache_find(download_state.url);
+    if (download_state.cached) {
+        esp_http_client_set_header(client, "If-None-Match", download_state.cached->etag);
+    }
+    
     // Perform HTTP GET request
     esp_err_t err = esp_http_client_perform(client);
     if (err != ESP_OK) {
@@ -101,10 +192,18 @@ static void download_task(void *param)
     
     // Check HTTP status
     int status_code = esp_http_client_get_status_code(client);
-    if (status_code != 200) {
+    if (status_code == 304 && download_state.cached) {
+        // Our copy is current; hand it back as if it had just been downloaded
+        memcpy(download_state.buffer, download_state.cached->data, download_state.cached->size);
+        download_state.data_size = download_state.cached->size;
+        download_state.cached->last_used = ++etag_cache_clock;
+    } else if (status_code != 200) {
         ESP_LOGW(TAG, "HTTP request returned status %d", status_code);
         snprintf(result.error_msg, sizeof(result.error_msg), "HTTP %d", status_code);
         goto cleanup;
+    } else if (download_state.etag[0] != '\0' && download_state.data_size > 0) {
+        etag_cache_store(download_state.url, download_state.etag,
+                         download_state.buffer, download_state.data_size);
     }
     
     // Success - prepare result
@@ -112,7 +211,9 @@ static void download_task(void *param)
         result.data = download_state.buffer;
         result.size = download_state.data_size;
         result.success = true;
-        ESP_LOGI(TAG, "Image downloaded successfully: %d bytes", download_state.data_size);
+        ESP_LOGI(TAG, "Image downloaded successfully: %d bytes, ready in %lld ms via %s",
+                 download_state.data_size, (esp_timer_get_time() - download_state.start_us) / 1000,
+                 status_code == 304 ? "HTTP 304 (not modified)" : "HTTP");
     } else {
         strncpy(result.error_msg, "No data received", sizeof(result.error_msg) - 1);
     }
@@ -134,6 +235,96 @@ cleanup:
     vTaskDelete(NULL);
 }
 
+/**
+ * Claim the inline transfer for completion; only one of data/timeout wins
+ */
+static bool take_inline_active(void)
+{
+    portENTER_CRITICAL(&inline_lock);
+    bool was_active = download_state.inline_active;
+    download_state.inline_active = false;
+    portEXIT_CRITICAL(&inline_lock);
+    return was_active;
+}
+
+/**
+ * Claim the inline transfer for the timeout, unless a chunk is being copied in
+ */
+static bool take_inline_for_timeout(bool *copying)
+{
+    portENTER_CRITICAL(&inline_lock);
+    *copying = download_state.inline_copying;
+    bool was_active = download_state.inline_active && !*copying;
+    if (was_active) {
+        download_state.inline_active = false;
+    }
+    portEXIT_CRITICAL(&inline_lock);
+    return was_active;
+}
+
+/**
+ * Finish an inline transfer and report the result
+ */
+static void finish_inline(bool success, const char *error_msg)
+{
+    if (!take_inline_active()) {
+        return;
+    }
+    esp_timer_stop(download_state.inline_timer);
+    
+    image_download_result_t result = {0};
+    if (success) {
+        result.data = download_state.buffer;
+        result.size = download_state.data_size;
+        result.success = true;
+        ESP_LOGI(TAG, "Inline image received: %d bytes, ready in %lld ms inline",
+                 download_state.data_size, (esp_timer_get_time() - download_state.start_us) / 1000);
+    } else {
+        strncpy(result.error_msg, error_msg, sizeof(result.error_msg) - 1);
+    }
+    
+    if (download_state.callback) {
+        download_state.callback(&result, download_state.user_data);
+    }
+    
+    download_state.busy = false;
+}
+
+/**
+ * Inline chunks stopped arriving - fetch the image over HTTP instead
+ */
+static void inline_timeout_callback(void *arg)
+{
+    bool copying;
+    if (!take_inline_for_timeout(&copying)) {
+        if (copying) {
+            // The HTTP fallback would write into the same buffer: let the chunk land first
+            esp_timer_start_once(download_state.inline_timer, INLINE_COPY_RECHECK_US);
+        }
+        return;
+    }
+    
+    ESP_LOGW(TAG, "Inline image timed out after %d bytes", download_state.data_size);
+    
+    char fallback_url[sizeof(download_state.url)];
+    strncpy(fallback_url, download_state.url, sizeof(fallback_url));
+    image_download_callback_t callback = download_state.callback;
+    void *user_data = download_state.user_data;
+    download_state.busy = false;
+    
+    if (fallback_url[0] != '\0' &&
+        image_downloader_download_async(fallback_url, callback, user_data) == ESP_OK) {
+        ESP_LOGI(TAG, "Falling back to HTTP download");
+        return;
+    }
+    
+    image_download_result_t result = {0};
+    strncpy(result.error_msg, "Inline image timeout", sizeof(result.error_msg) - 1);
+    if (callback) {
+        callback(&result, user_data);
+    }
+}
+
 esp_err_t image_downloader_init(void)
 {
     ESP_LOGI(TAG, "Initializing image downloader");
@@ -177,6 +368,10 @@ esp_err_t image_downloader_download_async(const char *url,
     download_state.callback = callback;
     download_state.user_data = user_data;
     download_state.busy = true;
+    download_state.start_us = esp_timer_get_time();
+    download_state.etag[0] = '\0';
+    download_state.cached = NULL;
+    memset(download_state.url, 0, sizeof(download_state.url));
     strncpy(download_state.url, url, sizeof(download_state.url) - 1);
     
     // Create download task
@@ -198,6 +393,129 @@ esp_err_t image_downloader_download_async(const char *url,
     return ESP_OK;
 }
 
+esp_err_t image_downloader_receive_inline_async(uint32_t request_id,
+                                                const char *fallback_url,
+                                                image_download_callback_t callback,
+                                                void *user_data)
+{
+    if (!callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // A new lookup supersedes an inline image that is still arriving
+    if (download_state.busy && take_inline_active()) {
+        ESP_LOGW(TAG, "Abandoning inline image for request %u", download_state.inline_request_id);
+        esp_timer_stop(download_state.inline_timer);
+        download_state.busy = false;
+    }
+    
+    if (download_state.busy) {
+        ESP_LOGW(TAG, "Download already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (fallback_url && strlen(fallback_url) >= sizeof(download_state.url)) {
+        ESP_LOGE(TAG, "URL too long");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    if (download_state.inline_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = inline_timeout_callback,
+            .name = "inline_img",
+        };
+        esp_err_t err = esp_timer_create(&timer_args, &download_state.inline_timer);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create inline timeout timer: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+    
+    // Reset download state; chunks are written straight into the download buffer
+    download_state.data_size = 0;
+    download_state.callback = callback;
+    download_state.user_data = user_data;
+    download_state.busy = true;
+    download_state.start_us = esp_timer_get_time();
+    download_state.inline_request_id = request_id;
+    memset(download_state.url, 0, sizeof(download_state.url));
+    if (fallback_url) {
+        strncpy(download_state.url, fallback_url, sizeof(download_state.url) - 1);
+    }
+    
+    portENTER_CRITICAL(&inline_lock);
+    download_state.inline_active = true;
+    portEXIT_CRITICAL(&inline_lock);
+    
+    esp_timer_stop(download_state.inline_timer);
+    esp_timer_start_once(download_state.inline_timer, MQTT_INLINE_IMAGE_TIMEOUT_MS * 1000);
+    
+    ESP_LOGI(TAG, "Waiting for inline image for request %u", request_id);
+    return ESP_OK;
+}
+
+/**
+ * Write one chunk of the active inline image; called with inline_copying set
+ */
+static esp_err_t inline_chunk(size_t total_size, size_t offset, const uint8_t *data, size_t len)
+{
+    if (total_size == 0) {
+        finish_inline(false, "No image available");
+        return ESP_OK;
+    }
+    
+    if (total_size > download_state.buffer_size) {
+        ESP_LOGW(TAG, "Inline image too large: %d bytes", total_size);
+        finish_inline(false, "Image too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    // QoS 1 may redeliver a chunk; anything before the write position is a duplicate
+    if (offset + len <= download_state.data_size) {
+        return ESP_OK;
+    }
+    
+    // Out-of-order data leaves a gap; let the timeout fall back to HTTP
+    if (offset != download_state.data_size || offset + len > total_size) {
+        ESP_LOGW(TAG, "Unexpected inline data at offset %d (have %d of %d)",
+                 offset, download_state.data_size, total_size);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    memcpy(download_state.buffer + offset, data, len);
+    download_state.data_size += len;
+    
+    if (download_state.data_size == total_size) {
+        finish_inline(true, NULL);
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t image_downloader_inline_data(uint32_t request_id,
+                                       size_t total_size,
+                                       size_t offset,
+                                       const uint8_t *data,
+                                       size_t len)
+{
+    // Until the chunk is in, the timeout cannot hand the buffer to an HTTP fallback
+    portENTER_CRITICAL(&inline_lock);
+    bool active = download_state.inline_active && request_id == download_state.inline_request_id;
+    download_state.inline_copying = active;
+    portEXIT_CRITICAL(&inline_lock);
+    if (!active) {
+        ESP_LOGD(TAG, "Ignoring inline data for request %u", request_id);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_err_t ret = inline_chunk(total_size, offset, data, len);
+    
+    portENTER_CRITICAL(&inline_lock);
+    download_state.inline_copying = false;
+    portEXIT_CRITICAL(&inline_lock);
+    return ret;
+}
+
 lv_img_dsc_t* image_downloader_create_lvgl_img(const uint8_t *data, 
                                                size_t size,
                                                uint16_t width,
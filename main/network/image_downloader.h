@@ -33,6 +33,11 @@ esp_err_t image_downloader_init(void);
 
 /**
  * @brief Download image from URL asynchronously
+ *
+ * The last IMAGE_ETAG_CACHE_ENTRIES images are kept with their ETag. Fetching
+ * one of those URLs again sends If-None-Match, and a 304 is reported as a
+ * normal success carrying the cached bytes.
+ *
  * @param url Image URL to download
  * @param callback Callback function for result
  * @param user_data User data to pass to callback
@@ -42,6 +47,39 @@ esp_err_t image_downloader_download_async(const char *url,
                                           image_download_callback_t callback,
                                           void *user_data);
 
+/**
+ * @brief Wait for an image streamed inline over MQTT or CoAP
+ *
+ * Chunks are reassembled straight into the download buffer as the lookup
+ * transport feeds them in. If they stop arriving within
+ * MQTT_INLINE_IMAGE_TIMEOUT_MS the image is fetched from fallback_url instead.
+ *
+ * @param request_id Lookup request ID the chunks are tagged with
+ * @param fallback_url HTTP image URL to use on timeout (may be NULL)
+ * @param callback Callback function for result
+ * @param user_data User data to pass to callback
+ * @return ESP_OK if waiting started, error code otherwise
+ */
+esp_err_t image_downloader_receive_inline_async(uint32_t request_id,
+                                                const char *fallback_url,
+                                                image_download_callback_t callback,
+                                                void *user_data);
+
+/**
+ * @brief Feed one piece of an inline image (called by the lookup transport)
+ * @param request_id Request ID from the chunk header
+ * @param total_size Total image size in bytes (0 = resolver has no image)
+ * @param offset Byte offset of this data within the image
+ * @param data Chunk payload
+ * @param len Payload length in bytes
+ * @return ESP_OK if accepted, ESP_ERR_INVALID_STATE if not expected
+ */
+esp_err_t image_downloader_inline_data(uint32_t request_id,
+                                       size_t total_size,
+                                       size_t offset,
+                                       const uint8_t *data,
+                                       size_t len);
+
 /**
  * @brief Create LVGL image descriptor from downloaded data
  * @param data Raw image data (JPEG)
@@ -1,4 +1,5 @@
 #include "mqtt_barcode.h"
+#include "image_downloader.h"
 #include "app_config.h"
 
 #include "freertos/FreeRTOS.h"
@@ -21,6 +22,9 @@ static const char *TAG = "mqtt_barcode";
 // Event bits for connection status
 #define MQTT_CONNECTED_BIT    BIT0
 
+// Inline image chunk header: request_id, total_size, offset (u32) + width, height (u16), big-endian
+#define IMAGE_CHUNK_HEADER_SIZE 16
+
 // Request tracking structure
 typedef struct {
     uint32_t request_id;
@@ -36,7 +40,14 @@ static struct {
     EventGroupHandle_t event_group;
     char client_id[32];
     char response_topic[64];
+    char image_topic[72];
     barcode_request_t pending_request;
+    struct {
+        uint32_t request_id;
+        uint32_t total_size;
+        uint32_t offset;
+        bool active;            // Later fragments of this chunk are still arriving
+    } image_rx;
     bool initialized;
     const char* status_message;
 } mqtt_state = {0};
@@ -60,6 +71,8 @@ static void generate_client_id(void) {
     // Create response topic
     snprintf(mqtt_state.response_topic, sizeof(mqtt_state.response_topic),
              "%s/%s", MQTT_BARCODE_RESPONSE_TOPIC, mqtt_state.client_id);
+    snprintf(mqtt_state.image_topic, sizeof(mqtt_state.image_topic),
+             "%s/%s", mqtt_state.response_topic, MQTT_IMAGE_TOPIC_SUFFIX);
     
     ESP_LOGI(TAG, "Generated client ID: %s", mqtt_state.client_id);
     ESP_LOGI(TAG, "Response topic: %s", mqtt_state.response_topic);
@@ -107,9 +120,9 @@ static void request_timeout_callback(TimerHandle_t timer) {
 }
 
 /**
- * Handle barcode lookup response from MQTT
+ * Parse a resolver lookup response into a result
  */
-static void handle_barcode_response(const char* data, int len) {
+esp_err_t mqtt_barcode_parse_response(const char *data, int len, mqtt_barcode_result_t *result) {
     ESP_LOGI(TAG, "Parsing JSON response: %d bytes", len);
     
     // Limit JSON size to prevent stack overflow
@@ -122,7 +135,7 @@ static void handle_barcode_response(const char* data, int len) {
     if (json == NULL) {
         ESP_LOGE(TAG, "Failed to parse JSON response (len=%d)", len);
         ESP_LOGE(TAG, "JSON preview: %.100s...", data);
-        return;
+        return ESP_ERR_INVALID_RESPONSE;
     }
     
     cJSON *request_id_item = cJSON_GetObjectItem(json, "request_id");
@@ -130,35 +143,27 @@ static void handle_barcode_response(const char* data, int len) {
     cJSON *barcode_item = cJSON_GetObjectItem(json, "barcode");
     cJSON *product_item = cJSON_GetObjectItem(json, "product");
     cJSON *lookup_time_item = cJSON_GetObjectItem(json, "lookup_time_ms");
+    cJSON *image_inline_item = cJSON_GetObjectItem(json, "image_inline");
     
     if (!request_id_item || !success_item || !barcode_item) {
         ESP_LOGE(TAG, "Invalid JSON response format");
         cJSON_Delete(json);
-        return;
-    }
-    
-    uint32_t response_request_id = (uint32_t)cJSON_GetNumberValue(request_id_item);
-    
-    // Check if this matches our pending request
-    if (!mqtt_state.pending_request.active || 
-        mqtt_state.pending_request.request_id != response_request_id) {
-        ESP_LOGW(TAG, "Received response for unknown/expired request ID %u", response_request_id);
-        cJSON_Delete(json);
-        return;
+        return ESP_ERR_INVALID_RESPONSE;
     }
     
-    ESP_LOGI(TAG, "Received barcode response for request %u", response_request_id);
-    
-    mqtt_barcode_result_t result = {0};
+    memset(result, 0, sizeof(*result));
     
     // Basic fields
-    strncpy(result.barcode, cJSON_GetStringValue(barcode_item), sizeof(result.barcode) - 1);
-    result.success = cJSON_IsTrue(success_item);
-    result.request_id = response_request_id;
-    result.lookup_time_ms = lookup_time_item ? (uint32_t)cJSON_GetNumberValue(lookup_time_item) : 0;
+    if (cJSON_IsString(barcode_item)) {
+        strncpy(result->barcode, cJSON_GetStringValue(barcode_item), sizeof(result->barcode) - 1);
+    }
+    result->success = cJSON_IsTrue(success_item);
+    result->request_id = (uint32_t)cJSON_GetNumberValue(request_id_item);
+    result->lookup_time_ms = lookup_time_item ? (uint32_t)cJSON_GetNumberValue(lookup_time_item) : 0;
+    result->image_inline = cJSON_IsTrue(image_inline_item);
     
     // Product information (if available)
-    if (result.success && cJSON_IsObject(product_item)) {
+    if (result->success && cJSON_IsObject(product_item)) {
         cJSON *name_item = cJSON_GetObjectItem(product_item, "name");
         cJSON *brand_item = cJSON_GetObjectItem(product_item, "brand");
         cJSON *model_item = cJSON_GetObjectItem(product_item, "model");
@@ -166,34 +171,60 @@ static void handle_barcode_response(const char* data, int len) {
         cJSON *price_item = cJSON_GetObjectItem(product_item, "price");
         cJSON *description_item = cJSON_GetObjectItem(product_item, "description");
         cJSON *image_url_item = cJSON_GetObjectItem(product_item, "image_url");
+        cJSON *placeholder_item = cJSON_GetObjectItem(product_item, "placeholder");
         
         if (name_item && cJSON_IsString(name_item)) {
-            strncpy(result.name, cJSON_GetStringValue(name_item), sizeof(result.name) - 1);
+            strncpy(result->name, cJSON_GetStringValue(name_item), sizeof(result->name) - 1);
         }
         if (brand_item && cJSON_IsString(brand_item)) {
-            strncpy(result.brand, cJSON_GetStringValue(brand_item), sizeof(result.brand) - 1);
+            strncpy(result->brand, cJSON_GetStringValue(brand_item), sizeof(result->brand) - 1);
         }
         if (model_item && cJSON_IsString(model_item)) {
-            strncpy(result.model, cJSON_GetStringValue(model_item), sizeof(result.model) - 1);
+            strncpy(result->model, cJSON_GetStringValue(model_item), sizeof(result->model) - 1);
         }
         if (category_item && cJSON_IsString(category_item)) {
-            strncpy(result.category, cJSON_GetStringValue(category_item), sizeof(result.category) - 1);
+            strncpy(result->category, cJSON_GetStringValue(category_item), sizeof(result->category) - 1);
         }
         if (price_item && cJSON_IsString(price_item)) {
-            strncpy(result.price, cJSON_GetStringValue(price_item), sizeof(result.price) - 1);
+            strncpy(result->price, cJSON_GetStringValue(price_item), sizeof(result->price) - 1);
         }
         if (description_item && cJSON_IsString(description_item)) {
-            strncpy(result.description, cJSON_GetStringValue(description_item), sizeof(result.description) - 1);
+            strncpy(result->description, cJSON_GetStringValue(description_item), sizeof(result->description) - 1);
         }
         if (image_url_item && cJSON_IsString(image_url_item)) {
-            strncpy(result.image_url, cJSON_GetStringValue(image_url_item), sizeof(result.image_url) - 1);
+            strncpy(result->image_url, cJSON_GetStringValue(image_url_item), sizeof(result->image_url) - 1);
+        }
+        if (placeholder_item && cJSON_IsString(placeholder_item)) {
+            strncpy(result->placeholder, cJSON_GetStringValue(placeholder_item), sizeof(result->placeholder) - 1);
         }
         
-        ESP_LOGI(TAG, "Product found: %s by %s (%s)", result.name, result.brand, result.price);
+        ESP_LOGI(TAG, "Product found: %s by %s (%s)", result->name, result->brand, result->price);
     } else {
-        ESP_LOGI(TAG, "Product not found for barcode: %s", result.barcode);
+        ESP_LOGI(TAG, "Product not found for barcode: %s", result->barcode);
+    }
+    
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+/**
+ * Handle barcode lookup response from MQTT
+ */
+static void handle_barcode_response(const char* data, int len) {
+    mqtt_barcode_result_t result;
+    if (mqtt_barcode_parse_response(data, len, &result) != ESP_OK) {
+        return;
+    }
+    
+    // Check if this matches our pending request
+    if (!mqtt_state.pending_request.active || 
+        mqtt_state.pending_request.request_id != result.request_id) {
+        ESP_LOGW(TAG, "Received response for unknown/expired request ID %u", result.request_id);
+        return;
     }
     
+    ESP_LOGI(TAG, "Received barcode response for request %u", result.request_id);
+    
     // Call callback with result
     if (mqtt_state.pending_request.callback) {
         mqtt_state.pending_request.callback(&result);
@@ -201,7 +232,45 @@ static void handle_barcode_response(const char* data, int len) {
     
     // Cleanup
     clear_pending_request();
-    cJSON_Delete(json);
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Handle an inline image chunk, possibly split across several MQTT_EVENT_DATA fragments
+ */
+static void handle_image_chunk(esp_mqtt_event_handle_t event) {
+    const uint8_t *data = (const uint8_t *)event->data;
+    size_t len = event->data_len;
+    uint32_t payload_offset;
+    
+    if (event->current_data_offset == 0) {
+        if (len < IMAGE_CHUNK_HEADER_SIZE) {
+            ESP_LOGW(TAG, "Image chunk too short (%d bytes)", event->data_len);
+            mqtt_state.image_rx.active = false;
+            return;
+        }
+        mqtt_state.image_rx.request_id = read_be32(data);
+        mqtt_state.image_rx.total_size = read_be32(data + 4);
+        mqtt_state.image_rx.offset = read_be32(data + 8);
+        data += IMAGE_CHUNK_HEADER_SIZE;
+        len -= IMAGE_CHUNK_HEADER_SIZE;
+        payload_offset = mqtt_state.image_rx.offset;
+    } else {
+        payload_offset = mqtt_state.image_rx.offset + event->current_data_offset - IMAGE_CHUNK_HEADER_SIZE;
+    }
+    
+    // Remember whether more fragments of this chunk are coming (they carry no topic)
+    mqtt_state.image_rx.active = event->current_data_offset + event->data_len < event->total_data_len;
+    
+    image_downloader_inline_data(mqtt_state.image_rx.request_id, mqtt_state.image_rx.total_size,
+                                 payload_offset, data, len);
+}
+
+static bool topic_matches(esp_mqtt_event_handle_t event, const char *topic) {
+    return event->topic_len == (int)strlen(topic) && strncmp(event->topic, topic, event->topic_len) == 0;
 }
 
 /**
@@ -219,6 +288,11 @@ static void mqtt_event_handler(void *args, esp_event_base_t base, int32_t event_
             int msg_id = esp_mqtt_client_subscribe(mqtt_state.client, mqtt_state.response_topic, 1);
             ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", mqtt_state.response_topic, msg_id);
             
+#if MQTT_INLINE_IMAGES
+            msg_id = esp_mqtt_client_subscribe(mqtt_state.client, mqtt_state.image_topic, 1);
+            ESP_LOGI(TAG, "Subscribed to %s, msg_id=%d", mqtt_state.image_topic, msg_id);
+#endif
+            
             xEventGroupSetBits(mqtt_state.event_group, MQTT_CONNECTED_BIT);
             break;
             
@@ -241,9 +315,19 @@ static void mqtt_event_handler(void *args, esp_event_base_t base, int32_t event_
             break;
             
         case MQTT_EVENT_DATA:
+            // Only the first fragment of a message carries the topic
+            if (event->current_data_offset > 0) {
+                if (mqtt_state.image_rx.active) {
+                    handle_image_chunk(event);
+                }
+                break;
+            }
+            
             ESP_LOGI(TAG, "MQTT Data received on topic: %.*s", event->topic_len, event->topic);
-            if (strncmp(event->topic, mqtt_state.response_topic, event->topic_len) == 0) {
+            if (topic_matches(event, mqtt_state.response_topic)) {
                 handle_barcode_response(event->data, event->data_len);
+            } else if (topic_matches(event, mqtt_state.image_topic)) {
+                handle_image_chunk(event);
             }
             break;
             
@@ -427,6 +511,11 @@ esp_err_t mqtt_barcode_lookup(const char *barcode, mqtt_barcode_callback_t callb
     cJSON_AddItemToObject(json, "request_id", request_id_item);
     cJSON_AddItemToObject(json, "timestamp", timestamp_item);
     
+#if MQTT_INLINE_IMAGES
+    // Opt in to receiving the product image as binary chunks on the image topic
+    cJSON_AddStringToObject(json, "image_transport", "mqtt");
+#endif
+    
     char *json_string = cJSON_Print(json);
     if (json_string == NULL) {
         ESP_LOGE(TAG, "Failed to serialize JSON request");
@@ -473,6 +562,13 @@ bool mqtt_barcode_is_connected(void) {
     return (bits & MQTT_CONNECTED_BIT) != 0;
 }
 
+/**
+ * Check if a lookup is waiting for its response
+ */
+bool mqtt_barcode_is_busy(void) {
+    return mqtt_state.initialized && mqtt_state.pending_request.active;
+}
+
 /**
  * Get connection status string
  */
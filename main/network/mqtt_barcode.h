@@ -20,7 +20,9 @@ typedef struct {
     char price[32];             // Price information
     char description[256];      // Product description (optional)
     char image_url[256];        // Product image URL (optional)
+    char placeholder[48];       // BlurHash preview of the product image (optional)
     bool success;               // Whether lookup was successful
+    bool image_inline;          // Image follows as binary chunks on the image topic
     uint32_t request_id;        // Request correlation ID
     uint32_t lookup_time_ms;    // Time taken for lookup
 } mqtt_barcode_result_t;
@@ -50,12 +52,27 @@ void mqtt_barcode_deinit(void);
  */
 esp_err_t mqtt_barcode_lookup(const char *barcode, mqtt_barcode_callback_t callback);
 
+/**
+ * @brief Parse a resolver lookup response (shared with the CoAP transport)
+ * @param data JSON response
+ * @param len Length in bytes (anything past 2048 bytes is ignored)
+ * @param result Filled in on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the JSON is malformed
+ */
+esp_err_t mqtt_barcode_parse_response(const char *data, int len, mqtt_barcode_result_t *result);
+
 /**
  * @brief Check if MQTT client is connected
  * @return true if connected, false otherwise
  */
 bool mqtt_barcode_is_connected(void);
 
+/**
+ * @brief Check if a lookup is waiting for its response
+ * @return true from mqtt_barcode_lookup() until its callback or timeout
+ */
+bool mqtt_barcode_is_busy(void);
+
 /**
  * @brief Get connection status string
  * @return Status string (for UI display)
@@ -0,0 +1,283 @@
+#include "ota_delta.h"
+#include "../app_config.h"
+#include "mbedtls/sha256.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_delta";
+
+#define DELTA_MAGIC         "EDP1"
+#define DELTA_HEADER_SIZE   80      // magic, old_size, new_size, flags, 2 x SHA-256
+#define DELTA_OP_COPY       0
+#define DELTA_OP_INSERT     1
+#define DELTA_OP_SEEK       2
+
+typedef enum {
+    DELTA_STATE_HEADER,
+    DELTA_STATE_COMMAND,
+    DELTA_STATE_INSERT,
+    DELTA_STATE_DONE,
+} delta_state_t;
+
+struct ota_delta {
+    delta_state_t state;
+    ota_delta_read_fn read_old;
+    ota_delta_write_fn write_new;
+    void *ctx;
+
+    size_t old_size;
+    uint8_t old_digest[32];
+    size_t new_size;
+    uint8_t new_digest[32];
+
+    uint8_t header[DELTA_HEADER_SIZE];
+    size_t header_len;
+    uint32_t command;               // Varint being decoded
+    int command_shift;
+    size_t insert_left;             // Literal bytes still to come
+
+    size_t old_pos;                 // Read position in the old image
+    size_t produced;                // New image bytes decoded (buffered or written)
+    size_t written;                 // New image bytes handed to write_new
+    mbedtls_sha256_context sha;
+
+    uint8_t out[OTA_DELTA_WRITE_BUF_SIZE];
+    size_t out_len;
+};
+
+static uint32_t read_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t flush_output(ota_delta_t *delta)
+{
+    if (delta->out_len == 0) {
+        return ESP_OK;
+    }
+    mbedtls_sha256_update(&delta->sha, delta->out, delta->out_len);
+    esp_err_t err = delta->write_new(delta->out, delta->out_len, delta->ctx);
+    delta->written += delta->out_len;
+    delta->out_len = 0;
+    return err;
+}
+
+static esp_err_t emit(ota_delta_t *delta, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        size_t n = sizeof(delta->out) - delta->out_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(delta->out + delta->out_len, data, n);
+        delta->out_len += n;
+        delta->produced += n;
+        data += n;
+        len -= n;
+        if (delta->out_len == sizeof(delta->out)) {
+            esp_err_t err = flush_output(delta);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+// Old image bytes are read straight into the output buffer
+static esp_err_t copy_old(ota_delta_t *delta, size_t len)
+{
+    while (len > 0) {
+        size_t n = sizeof(delta->out) - delta->out_len;
+        if (n > len) {
+            n = len;
+        }
+        esp_err_t err = delta->read_old(delta->old_pos, delta->out + delta->out_len, n, delta->ctx);
+        if (err != ESP_OK) {
+            return err;
+        }
+        delta->out_len += n;
+        delta->produced += n;
+        delta->old_pos += n;
+        len -= n;
+        if (delta->out_len == sizeof(delta->out)) {
+            err = flush_output(delta);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_header(ota_delta_t *delta)
+{
+    const uint8_t *h = delta->header;
+    if (memcmp(h, DELTA_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a delta patch");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    size_t old_size = read_le32(h + 4);
+    delta->new_size = read_le32(h + 8);
+    memcpy(delta->new_digest, h + 48, 32);
+    if (old_size != delta->old_size || memcmp(h + 16, delta->old_digest, 32) != 0) {
+        ESP_LOGW(TAG, "Patch was made for a different image (%u bytes)", (unsigned)old_size);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    ESP_LOGI(TAG, "Patch matches running image, rebuilding %u bytes", (unsigned)delta->new_size);
+    return ESP_OK;
+}
+
+static esp_err_t run_command(ota_delta_t *delta)
+{
+    uint32_t op = delta->command & 3;
+    uint32_t n = delta->command >> 2;
+
+    if (op == DELTA_OP_SEEK) {
+        // Zigzag-encoded signed offset
+        int64_t offset = (n & 1) ? -(int64_t)((n + 1) >> 1) : (int64_t)(n >> 1);
+        int64_t pos = (int64_t)delta->old_pos + offset;
+        if (pos < 0 || pos > (int64_t)delta->old_size) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        delta->old_pos = (size_t)pos;
+        return ESP_OK;
+    }
+    if (op != DELTA_OP_COPY && op != DELTA_OP_INSERT) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (n > delta->new_size - delta->produced) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (op == DELTA_OP_COPY) {
+        if (delta->old_pos > delta->old_size || n > delta->old_size - delta->old_pos) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        return copy_old(delta, n);
+    }
+    // INSERT also moves the old read position past the bytes it replaces
+    delta->insert_left = n;
+    delta->old_pos += n;
+    delta->state = DELTA_STATE_INSERT;
+    return ESP_OK;
+}
+
+ota_delta_t *ota_delta_create(size_t old_size, const uint8_t old_digest[32],
+                              ota_delta_read_fn read_old, ota_delta_write_fn write_new,
+                              void *ctx)
+{
+    ota_delta_t *delta = calloc(1, sizeof(ota_delta_t));
+    if (!delta) {
+        return NULL;
+    }
+    delta->state = DELTA_STATE_HEADER;
+    delta->read_old = read_old;
+    delta->write_new = write_new;
+    delta->ctx = ctx;
+    delta->old_size = old_size;
+    memcpy(delta->old_digest, old_digest, 32);
+    mbedtls_sha256_init(&delta->sha);
+    mbedtls_sha256_starts(&delta->sha, 0);
+    return delta;
+}
+
+esp_err_t ota_delta_feed(ota_delta_t *delta, const uint8_t *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && err == ESP_OK) {
+        switch (delta->state) {
+        case DELTA_STATE_HEADER: {
+            size_t n = DELTA_HEADER_SIZE - delta->header_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(delta->header + delta->header_len, data, n);
+            delta->header_len += n;
+            data += n;
+            len -= n;
+            if (delta->header_len == DELTA_HEADER_SIZE) {
+                err = parse_header(delta);
+                delta->state = delta->new_size > 0 ? DELTA_STATE_COMMAND : DELTA_STATE_DONE;
+            }
+            break;
+        }
+
+        case DELTA_STATE_COMMAND: {
+            uint8_t byte = *data++;
+            len--;
+            if (delta->command_shift > 28) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            delta->command |= (uint32_t)(byte & 0x7f) << delta->command_shift;
+            delta->command_shift += 7;
+            if (!(byte & 0x80)) {
+                err = run_command(delta);
+                delta->command = 0;
+                delta->command_shift = 0;
+            }
+            break;
+        }
+
+        case DELTA_STATE_INSERT: {
+            size_t n = delta->insert_left < len ? delta->insert_left : len;
+            err = emit(delta, data, n);
+            delta->insert_left -= n;
+            data += n;
+            len -= n;
+            if (delta->insert_left == 0) {
+                delta->state = DELTA_STATE_COMMAND;
+            }
+            break;
+        }
+
+        case DELTA_STATE_DONE:
+            // Trailing bytes after the last command are ignored
+            return ESP_OK;
+        }
+
+        if (delta->state == DELTA_STATE_COMMAND && delta->produced == delta->new_size) {
+            delta->state = DELTA_STATE_DONE;
+        }
+    }
+    return err;
+}
+
+esp_err_t ota_delta_finish(ota_delta_t *delta)
+{
+    if (delta->state != DELTA_STATE_DONE) {
+        ESP_LOGE(TAG, "Patch ended after %u of %u bytes", (unsigned)delta->produced, (unsigned)delta->new_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = flush_output(delta);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&delta->sha, digest);
+    if (memcmp(digest, delta->new_digest, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Rebuilt image does not match the patch's SHA-256");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+size_t ota_delta_new_size(const ota_delta_t *delta)
+{
+    return delta->new_size;
+}
+
+size_t ota_delta_written(const ota_delta_t *delta)
+{
+    return delta->written;
+}
+
+void ota_delta_free(ota_delta_t *delta)
+{
+    if (delta) {
+        mbedtls_sha256_free(&delta->sha);
+        free(delta);
+    }
+}
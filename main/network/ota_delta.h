@@ -0,0 +1,92 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Streaming delta patch decoder
+ *
+ * Rebuilds a firmware image from the running one and a patch made by
+ * scripts/ota_delta.py (format described there). The patch is fed in as it
+ * arrives from the network; old image bytes are fetched through read_old
+ * at whatever offsets the patch refers to, and the new image leaves through
+ * write_new strictly in order, in OTA_DELTA_WRITE_BUF_SIZE pieces. RAM use
+ * is the decoder itself, independent of image and patch size.
+ */
+typedef struct ota_delta ota_delta_t;
+
+/**
+ * @brief Read bytes of the image the patch applies to
+ * @param offset Byte offset within the old image
+ * @param buf Destination
+ * @param len Bytes to read
+ * @param ctx Context given to ota_delta_create()
+ * @return ESP_OK on success, error code otherwise
+ */
+typedef esp_err_t (*ota_delta_read_fn)(size_t offset, void *buf, size_t len, void *ctx);
+
+/**
+ * @brief Append bytes of the rebuilt image
+ * @param data Next bytes of the new image
+ * @param len Byte count
+ * @param ctx Context given to ota_delta_create()
+ * @return ESP_OK on success, error code otherwise
+ */
+typedef esp_err_t (*ota_delta_write_fn)(const void *data, size_t len, void *ctx);
+
+/**
+ * @brief Create a decoder for patches against one specific image
+ * @param old_size Size of the image the patch must have been made from
+ * @param old_digest Its SHA-256 as esp_partition_get_sha256() reports it
+ * @param read_old Old image reader
+ * @param write_new New image writer
+ * @param ctx Passed to both callbacks
+ * @return Decoder, or NULL if out of memory
+ */
+ota_delta_t *ota_delta_create(size_t old_size, const uint8_t old_digest[32],
+                              ota_delta_read_fn read_old, ota_delta_write_fn write_new,
+                              void *ctx);
+
+/**
+ * @brief Feed the next piece of the patch
+ * @param delta Decoder
+ * @param data Patch bytes
+ * @param len Byte count
+ * @return ESP_OK to continue, ESP_ERR_INVALID_VERSION if the patch was made
+ *         for a different image, ESP_ERR_INVALID_RESPONSE if it is corrupt,
+ *         or the error a callback returned
+ */
+esp_err_t ota_delta_feed(ota_delta_t *delta, const uint8_t *data, size_t len);
+
+/**
+ * @brief Flush the last output and check the rebuilt image
+ * @param delta Decoder
+ * @return ESP_OK if the whole image was produced and its SHA-256 matches
+ *         the patch header, ESP_ERR_INVALID_CRC on a mismatch,
+ *         ESP_ERR_INVALID_SIZE if the patch ended early
+ */
+esp_err_t ota_delta_finish(ota_delta_t *delta);
+
+/**
+ * @brief Size of the image being rebuilt (0 until the header has arrived)
+ */
+size_t ota_delta_new_size(const ota_delta_t *delta);
+
+/**
+ * @brief Bytes of the new image produced so far
+ */
+size_t ota_delta_written(const ota_delta_t *delta);
+
+/**
+ * @brief Free a decoder
+ */
+void ota_delta_free(ota_delta_t *delta);
+
+#ifdef __cplusplus
+}
+#endif
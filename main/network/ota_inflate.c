@@ -0,0 +1,215 @@
+#include "ota_inflate.h"
+#include "../app_config.h"
+#include "mbedtls/sha256.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_inflate";
+
+#define INFLATE_MAGIC       "EHS1"
+#define INFLATE_HEADER_SIZE 44      // magic, window/lookahead bits, flags, size, SHA-256
+
+struct ota_inflate {
+    ota_delta_write_fn write_new;
+    void *ctx;
+
+    uint8_t header[INFLATE_HEADER_SIZE];
+    size_t header_len;
+    uint8_t window_bits;
+    uint8_t lookahead_bits;
+    size_t image_size;
+    uint8_t digest[32];
+
+    uint32_t bit_buf;               // Unread bits, most significant first
+    int bit_count;
+
+    uint8_t *window;                // Ring of the last 2^window_bits output bytes
+    size_t head;                    // Next write position in the ring
+    size_t produced;
+    size_t written;
+    mbedtls_sha256_context sha;
+};
+
+static uint32_t read_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t flush_window(ota_inflate_t *inflate)
+{
+    if (inflate->head == 0) {
+        return ESP_OK;
+    }
+    mbedtls_sha256_update(&inflate->sha, inflate->window, inflate->head);
+    esp_err_t err = inflate->write_new(inflate->window, inflate->head, inflate->ctx);
+    inflate->written += inflate->head;
+    return err;
+}
+
+static esp_err_t put_byte(ota_inflate_t *inflate, uint8_t byte)
+{
+    inflate->window[inflate->head++] = byte;
+    inflate->produced++;
+    if (inflate->head == ((size_t)1 << inflate->window_bits)) {
+        // The ring is full: write it out, then keep it as history
+        esp_err_t err = flush_window(inflate);
+        inflate->head = 0;
+        return err;
+    }
+    return ESP_OK;
+}
+
+static uint32_t take_bits(ota_inflate_t *inflate, int count)
+{
+    inflate->bit_count -= count;
+    return (inflate->bit_buf >> inflate->bit_count) & ((1u << count) - 1);
+}
+
+static esp_err_t parse_header(ota_inflate_t *inflate)
+{
+    const uint8_t *h = inflate->header;
+    if (memcmp(h, INFLATE_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a compressed image");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    inflate->window_bits = h[4];
+    inflate->lookahead_bits = h[5];
+    inflate->image_size = read_le32(h + 8);
+    memcpy(inflate->digest, h + 12, 32);
+    if (inflate->window_bits < 4 || inflate->window_bits > OTA_INFLATE_MAX_WINDOW_BITS ||
+        inflate->lookahead_bits < 3 || inflate->lookahead_bits >= inflate->window_bits ||
+        1 + inflate->window_bits + inflate->lookahead_bits > 25) {
+        ESP_LOGE(TAG, "Unsupported window %u/%u", inflate->window_bits, inflate->lookahead_bits);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    inflate->window = calloc(1, (size_t)1 << inflate->window_bits);
+    if (!inflate->window) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Decompressing %u byte image, %u byte window",
+             (unsigned)inflate->image_size, 1u << inflate->window_bits);
+    return ESP_OK;
+}
+
+ota_inflate_t *ota_inflate_create(ota_delta_write_fn write_new, void *ctx)
+{
+    ota_inflate_t *inflate = calloc(1, sizeof(ota_inflate_t));
+    if (!inflate) {
+        return NULL;
+    }
+    inflate->write_new = write_new;
+    inflate->ctx = ctx;
+    mbedtls_sha256_init(&inflate->sha);
+    mbedtls_sha256_starts(&inflate->sha, 0);
+    return inflate;
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *inflate, const uint8_t *data, size_t len)
+{
+    if (inflate->header_len < INFLATE_HEADER_SIZE) {
+        size_t n = INFLATE_HEADER_SIZE - inflate->header_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(inflate->header + inflate->header_len, data, n);
+        inflate->header_len += n;
+        data += n;
+        len -= n;
+        if (inflate->header_len < INFLATE_HEADER_SIZE) {
+            return ESP_OK;
+        }
+        esp_err_t err = parse_header(inflate);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    const int backref_bits = 1 + inflate->window_bits + inflate->lookahead_bits;
+    const size_t mask = ((size_t)1 << inflate->window_bits) - 1;
+
+    while (inflate->produced < inflate->image_size) {
+        // Top up to at least 25 bits, enough for any supported token
+        while (inflate->bit_count <= 24 && len > 0) {
+            inflate->bit_buf = (inflate->bit_buf << 8) | *data++;
+            inflate->bit_count += 8;
+            len--;
+        }
+        if (inflate->bit_count < 1) {
+            break;
+        }
+
+        bool literal = (inflate->bit_buf >> (inflate->bit_count - 1)) & 1;
+        if (literal) {
+            if (inflate->bit_count < 9) {
+                break;
+            }
+            take_bits(inflate, 1);
+            esp_err_t err = put_byte(inflate, take_bits(inflate, 8));
+            if (err != ESP_OK) {
+                return err;
+            }
+            continue;
+        }
+
+        if (inflate->bit_count < backref_bits) {
+            break;
+        }
+        take_bits(inflate, 1);
+        size_t distance = take_bits(inflate, inflate->window_bits) + 1;
+        size_t count = take_bits(inflate, inflate->lookahead_bits) + 1;
+        if (distance > inflate->produced || count > inflate->image_size - inflate->produced) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        while (count-- > 0) {
+            esp_err_t err = put_byte(inflate, inflate->window[(inflate->head - distance) & mask]);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    // Anything after the last token is zero padding
+    return ESP_OK;
+}
+
+esp_err_t ota_inflate_finish(ota_inflate_t *inflate)
+{
+    if (inflate->header_len < INFLATE_HEADER_SIZE || inflate->produced != inflate->image_size) {
+        ESP_LOGE(TAG, "Stream ended after %u of %u bytes",
+                 (unsigned)inflate->produced, (unsigned)inflate->image_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = flush_window(inflate);
+    inflate->head = 0;
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&inflate->sha, digest);
+    if (memcmp(digest, inflate->digest, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Decompressed image does not match its SHA-256");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+size_t ota_inflate_image_size(const ota_inflate_t *inflate)
+{
+    return inflate->image_size;
+}
+
+size_t ota_inflate_written(const ota_inflate_t *inflate)
+{
+    return inflate->written;
+}
+
+void ota_inflate_free(ota_inflate_t *inflate)
+{
+    if (inflate) {
+        mbedtls_sha256_free(&inflate->sha);
+        free(inflate->window);
+        free(inflate);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "esp_err.h"
+#include "ota_delta.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Streaming decompressor for compressed firmware images
+ *
+ * Expands an image made by scripts/ota_compress.py (heatshrink, format
+ * described there) as it arrives from the network. Output is assembled in
+ * the decompression window itself and handed to write_new one window at a
+ * time, so RAM use is the window (at most 2^OTA_INFLATE_MAX_WINDOW_BITS
+ * bytes) plus a few dozen bytes of state.
+ */
+typedef struct ota_inflate ota_inflate_t;
+
+/**
+ * @brief Create a decompressor
+ * @param write_new Receives the decompressed image in order
+ * @param ctx Passed to write_new
+ * @return Decompressor, or NULL if out of memory
+ */
+ota_inflate_t *ota_inflate_create(ota_delta_write_fn write_new, void *ctx);
+
+/**
+ * @brief Feed the next piece of the compressed image
+ * @param inflate Decompressor
+ * @param data Compressed bytes
+ * @param len Byte count
+ * @return ESP_OK to continue, ESP_ERR_INVALID_RESPONSE if the stream is
+ *         corrupt, ESP_ERR_NOT_SUPPORTED if its window is too large,
+ *         ESP_ERR_NO_MEM, or the error write_new returned
+ */
+esp_err_t ota_inflate_feed(ota_inflate_t *inflate, const uint8_t *data, size_t len);
+
+/**
+ * @brief Flush the last output and check the decompressed image
+ * @param inflate Decompressor
+ * @return ESP_OK if the whole image was produced and its SHA-256 matches
+ *         the header, ESP_ERR_INVALID_CRC on a mismatch,
+ *         ESP_ERR_INVALID_SIZE if the stream ended early
+ */
+esp_err_t ota_inflate_finish(ota_inflate_t *inflate);
+
+/**
+ * @brief Size of the decompressed image (0 until the header has arrived)
+ */
+size_t ota_inflate_image_size(const ota_inflate_t *inflate);
+
+/**
+ * @brief Decompressed bytes handed to write_new so far
+ */
+size_t ota_inflate_written(const ota_inflate_t *inflate);
+
+/**
+ * @brief Free a decompressor
+ */
+void ota_inflate_free(ota_inflate_t *inflate);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,45 +1,147 @@
 #include "ota_manager.h"
+#include "ota_delta.h"
+#include "ota_inflate.h"
+#include "ota_manifest.h"
+#include "ota_p2p.h"
+#include "ota_resume.h"
+#include "ota_writer.h"
 #include "wifi_manager.h"
 #include "../app_config.h"
 #include "esp_ota_ops.h"
-#include "esp_https_ota.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "esp_timer.h"
+#include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/timers.h"
 #include "esp_log.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 static const char *TAG = "ota_manager";
 
 // OTA state
 static bool ota_in_progress = false;
+static const char *failure_status = "OTA: Download failed";
+static bool failure_transient = false;     // Worth retrying: the connection or transfer failed
+
+// Background mode: low priority, capped, paused while the device is in use
+static volatile bool background = false;
+static TaskHandle_t ota_task_handle = NULL;
+static TimerHandle_t background_timer = NULL;
+
+// Signed description of the latest release, if it could be fetched this session
+static ota_manifest_t manifest;
+static bool manifest_valid = false;
+
+// Progress, published by the OTA task and sampled by the UI
+static atomic_size_t progress_written;
+static atomic_size_t progress_total;
 
 // Callbacks
 static ota_status_callback_t status_callback = NULL;
-static ota_progress_callback_t progress_callback = NULL;
 static ota_progress_bar_callback_t progress_bar_show_callback = NULL;
 static ota_progress_bar_callback_t progress_bar_hide_callback = NULL;
 static void (*progress_bar_set_callback)(int percentage) = NULL;
+static ota_busy_callback_t busy_callback = NULL;
+static ota_idle_time_callback_t idle_time_callback = NULL;
 
 // Forward declarations
 static void ota_task(void *param);
 
+// Background updates stay off the screen until there is something to act on
+static void report_status(const char *status, uint32_t color)
+{
+    if (status_callback && !background) {
+        status_callback(status, color);
+    }
+}
+
 esp_err_t ota_manager_init(void)
 {
     ESP_LOGI(TAG, "Initializing OTA Manager");
     ota_in_progress = false;
+#if OTA_RESUME_ENABLED
+    size_t offset, image_size;
+    if (ota_resume_available(&offset, &image_size)) {
+        ESP_LOGI(TAG, "Interrupted download can resume at %u of %u bytes",
+                 (unsigned)offset, (unsigned)image_size);
+    }
+#endif
     return ESP_OK;
 }
 
+static void ota_start_task(bool in_background)
+{
+    ESP_LOGI(TAG, "Creating %s OTA update task...", in_background ? "background" : "foreground");
+    ota_in_progress = true;
+    background = in_background;
+    if (xTaskCreate(ota_task, "ota_task", OTA_TASK_STACK_SIZE, NULL,
+                    in_background ? OTA_BACKGROUND_TASK_PRIORITY : OTA_TASK_PRIORITY,
+                    &ota_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create OTA task");
+        ota_in_progress = false;
+    }
+}
+
 void ota_manager_start_update(void)
 {
+    if (ota_in_progress && background) {
+        // The user is waiting now: drop the cap and the pauses, and restart once done
+        ESP_LOGI(TAG, "Background update moved to the foreground");
+        background = false;
+        vTaskPrioritySet(ota_task_handle, OTA_TASK_PRIORITY);
+        report_status("OTA: Please wait...", PRIMARY_RED);
+        return;
+    }
     if (ota_in_progress) {
         ESP_LOGW(TAG, "OTA update already in progress");
         return;
     }
     
-    ESP_LOGI(TAG, "Creating OTA update task...");
-    xTaskCreate(ota_task, "ota_task", 16384, NULL, 5, NULL);
+    ota_start_task(false);
+}
+
+void ota_manager_start_background_update(void)
+{
+    if (ota_in_progress) {
+        return;
+    }
+    if (!wifi_manager_is_connected()) {
+        ESP_LOGI(TAG, "No WiFi, background update check skipped");
+        return;
+    }
+    ota_start_task(true);
+}
+
+static void background_timer_callback(TimerHandle_t timer)
+{
+    // First check shortly after boot, then at the regular interval
+    // (in ms / tick period: pdMS_TO_TICKS overflows on hours at a 1 kHz tick)
+    xTimerChangePeriod(timer, OTA_BACKGROUND_CHECK_INTERVAL_MS / portTICK_PERIOD_MS, 0);
+    ota_manager_start_background_update();
+}
+
+void ota_manager_start_background_checks(void)
+{
+#if !OTA_MANIFEST_ENABLED
+    // Without the manifest a check cannot tell an up-to-date device from one behind
+    ESP_LOGW(TAG, "Background update checks need OTA_MANIFEST_ENABLED");
+    return;
+#endif
+    if (background_timer) {
+        return;
+    }
+    background_timer = xTimerCreate("ota_check", OTA_BACKGROUND_FIRST_CHECK_MS / portTICK_PERIOD_MS,
+                                    pdTRUE, NULL, background_timer_callback);
+    if (!background_timer || xTimerStart(background_timer, 0) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start background update checks");
+    }
 }
 
 void ota_manager_abort_update(void)
@@ -52,14 +154,20 @@ bool ota_manager_is_in_progress(void)
     return ota_in_progress;
 }
 
-void ota_manager_set_status_callback(ota_status_callback_t callback)
+bool ota_manager_is_background(void)
 {
-    status_callback = callback;
+    return ota_in_progress && background;
 }
 
-void ota_manager_set_progress_callback(ota_progress_callback_t callback)
+void ota_manager_get_progress(size_t *written, size_t *total)
 {
-    progress_callback = callback;
+    *written = atomic_load_explicit(&progress_written, memory_order_relaxed);
+    *total = atomic_load_explicit(&progress_total, memory_order_relaxed);
+}
+
+void ota_manager_set_status_callback(ota_status_callback_t callback)
+{
+    status_callback = callback;
 }
 
 void ota_manager_set_progress_bar_show_callback(ota_progress_bar_callback_t callback)
@@ -77,113 +185,786 @@ void ota_manager_set_progress_bar_set_callback(void (*callback)(int percentage))
     progress_bar_set_callback = callback;
 }
 
-static void ota_task(void *param)
+void ota_manager_set_busy_callback(ota_busy_callback_t callback)
 {
-    ESP_LOGI(TAG, "Starting OTA update task...");
-    ota_in_progress = true;
-    
-    // Show connecting status
-    if (status_callback) {
-        status_callback("OTA: Connecting...", LIGHT_RED);
+    busy_callback = callback;
+}
+
+void ota_manager_set_idle_time_callback(ota_idle_time_callback_t callback)
+{
+    idle_time_callback = callback;
+}
+
+// Download size, duration and heap high-water mark of one update attempt
+typedef struct {
+    int64_t start_us;
+    size_t heap_before;
+    size_t heap_min;
+    size_t downloaded;
+} ota_stats_t;
+
+static void ota_stats_start(ota_stats_t *stats)
+{
+    stats->start_us = esp_timer_get_time();
+    stats->heap_before = esp_get_free_heap_size();
+    stats->heap_min = stats->heap_before;
+    stats->downloaded = 0;
+}
+
+static void ota_stats_sample(ota_stats_t *stats, size_t received)
+{
+    size_t heap_free = esp_get_free_heap_size();
+    if (heap_free < stats->heap_min) {
+        stats->heap_min = heap_free;
     }
-    
+    stats->downloaded += received;
+}
+
+static void ota_stats_log(const ota_stats_t *stats, const char *method, size_t image_size)
+{
+    int64_t elapsed_ms = (esp_timer_get_time() - stats->start_us) / 1000;
+    ESP_LOGI(TAG, "%s update: %u bytes downloaded for %u byte image in %lld ms (%lld KB/s of image), peak heap use %u bytes",
+             method, (unsigned)stats->downloaded, (unsigned)image_size, elapsed_ms,
+             elapsed_ms > 0 ? (int64_t)image_size / elapsed_ms : 0,
+             (unsigned)(stats->heap_before - stats->heap_min));
+}
+
+// Running image (read by the patch decoder) and the pipeline into the inactive slot
+typedef struct {
+    const esp_partition_t *running;
+    ota_writer_t *writer;
+    ota_resume_t *resume;           // Checkpoints, for downloads written as received
+    size_t base_offset;             // Image offset the writer started at
+} stream_io_t;
+
+// Response headers a resumed download checks
+typedef struct {
+    char etag[72];
+    char content_range[64];
+} stream_headers_t;
+
+// A decoder that rebuilds the image from what is downloaded
+typedef struct {
+    const char *name;
+    void (*begin)(void *decoder, int64_t content_length);      // Optional
+    esp_err_t (*feed)(void *decoder, const uint8_t *data, size_t len);
+    esp_err_t (*finish)(void *decoder);
+    size_t (*image_size)(const void *decoder);
+} stream_decoder_t;
+
+static esp_err_t stream_write_update(const void *data, size_t len, void *ctx)
+{
+    stream_io_t *io = ctx;
+    atomic_fetch_add_explicit(&progress_written, len, memory_order_relaxed);
+    if (io->resume) {
+        ota_resume_update(io->resume, data, len, io->base_offset + ota_writer_flashed(io->writer));
+    }
+    return ota_writer_write(io->writer, data, len);
+}
+
+static esp_err_t stream_http_event_handler(esp_http_client_event_t *evt)
+{
+    stream_headers_t *headers = evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && headers) {
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            strncpy(headers->etag, evt->header_value, sizeof(headers->etag) - 1);
+        } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+            strncpy(headers->content_range, evt->header_value, sizeof(headers->content_range) - 1);
+        }
+    }
+    return ESP_OK;
+}
+
+// Open a GET request, following redirects (GitHub release assets redirect to a CDN)
+static esp_err_t http_open_following_redirects(esp_http_client_handle_t client, int *status,
+                                               stream_headers_t *headers)
+{
+    for (int redirects = 0; ; redirects++) {
+        memset(headers, 0, sizeof(*headers));
+        esp_err_t err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (esp_http_client_fetch_headers(client) < 0) {
+            return ESP_FAIL;
+        }
+        *status = esp_http_client_get_status_code(client);
+        if (*status < 300 || *status >= 400 || *status == 304 || redirects == 3) {
+            return ESP_OK;
+        }
+        esp_http_client_flush_response(client, NULL);
+        esp_http_client_set_redirection(client);
+        esp_http_client_close(client);
+    }
+}
+
+// Pace of a background download since it last started or paused
+typedef struct {
+    int64_t start_us;
+    size_t received;
+} ota_throttle_t;
+
+/**
+ * Called before each read of a background download. While the device is in
+ * use nothing is read: the receive window fills and the server stalls,
+ * leaving the air and the flash to the lookup. Otherwise reads are spaced
+ * to stay under OTA_BACKGROUND_MAX_KBPS.
+ */
+static void ota_background_yield(ota_throttle_t *throttle, size_t last_len)
+{
+    throttle->received += last_len;
+    if (!background) {
+        return;
+    }
+    if (busy_callback && busy_callback()) {
+        int64_t paused_us = esp_timer_get_time();
+        while (background && busy_callback()) {
+            vTaskDelay(pdMS_TO_TICKS(OTA_BACKGROUND_POLL_MS));
+        }
+        ESP_LOGD(TAG, "Paused %lld ms for a lookup", (esp_timer_get_time() - paused_us) / 1000);
+        // The cap applies from here on; the time paused is not caught up
+        throttle->start_us = esp_timer_get_time();
+        throttle->received = 0;
+        return;
+    }
+#if OTA_BACKGROUND_MAX_KBPS > 0
+    int64_t due_us = throttle->start_us + (int64_t)throttle->received * 1000000 / (OTA_BACKGROUND_MAX_KBPS * 1024);
+    int64_t ahead_ms = (due_us - esp_timer_get_time()) / 1000;
+    if (ahead_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(ahead_ms));
+    }
+#endif
+}
+
+/**
+ * Download url through a decoder into the inactive slot. Network receive
+ * and decoding run here while ota_writer erases and writes flash on its own
+ * task. Returns ESP_OK once the image is verified and set to boot,
+ * ESP_ERR_NOT_FOUND if the server has no such file; anything else means the
+ * caller should try another way. On failure failure_status says why and
+ * failure_transient whether trying again could help. With io->resume the
+ * download continues from its checkpoint.
+ */
+static esp_err_t ota_stream_update(const char *url, const stream_decoder_t *decoder, void *state,
+                                   stream_io_t *io, ota_stats_t *stats)
+{
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (!update_partition) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    stream_headers_t headers;
     esp_http_client_config_t config = {
-        .url = OTA_UPDATE_URL,
+        .url = url,
         .timeout_ms = OTA_RECV_TIMEOUT,
-        .keep_alive_enable = true,
         .crt_bundle_attach = esp_crt_bundle_attach,
         .buffer_size = 4096,
         .buffer_size_tx = 4096,
-        .max_redirection_count = 3,
+        .event_handler = stream_http_event_handler,
+        .user_data = &headers,
     };
-    
-    esp_https_ota_config_t ota_config = {
-        .http_config = &config,
-    };
-    
-    ESP_LOGI(TAG, "Attempting to download update from %s", config.url);
-    
-    // Use advanced OTA API for progress tracking
-    esp_https_ota_handle_t https_ota_handle = NULL;
-    esp_err_t ret = esp_https_ota_begin(&ota_config, &https_ota_handle);
-    
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "ESP HTTPS OTA Begin failed: %s", esp_err_to_name(ret));
-        if (status_callback) {
-            status_callback("OTA: Connection failed", DARK_RED);
-        }
-        ota_in_progress = false;
-        vTaskDelete(NULL);
-        return;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return ESP_ERR_NO_MEM;
     }
-    
-    // Get total image size
-    int image_size = esp_https_ota_get_image_size(https_ota_handle);
-    ESP_LOGI(TAG, "Image size: %d bytes", image_size);
-    
-    // Show initial progress
-    if (status_callback) {
-        status_callback("OTA: Please wait...", PRIMARY_RED);
+
+    size_t offset = io->resume ? ota_resume_offset(io->resume) : 0;
+    if (offset > 0) {
+        // If-Range: the rest of the same file, or all of it if it changed
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%u-", (unsigned)offset);
+        esp_http_client_set_header(client, "Range", range);
+        esp_http_client_set_header(client, "If-Range", ota_resume_etag(io->resume));
+        ESP_LOGI(TAG, "Resuming %s update at %u bytes: %s", decoder->name, (unsigned)offset, url);
+    } else {
+        ESP_LOGI(TAG, "Trying %s update: %s", decoder->name, url);
     }
-    if (progress_bar_show_callback) {
-        progress_bar_show_callback();
+    failure_status = "OTA: Connection failed";
+    failure_transient = true;
+    int status = 0;
+    esp_err_t err = http_open_following_redirects(client, &status, &headers);
+    int64_t content_length = esp_http_client_get_content_length(client);
+    if (err == ESP_OK && io->resume && (status == 200 || status == 206 || status == 416)) {
+        // 206 continues from the checkpoint, 200 starts over, 416 drops the checkpoint
+        err = ota_resume_accept(io->resume, status, headers.content_range, headers.etag, content_length);
+        offset = ota_resume_offset(io->resume);
+    } else if (err == ESP_OK && status != 200) {
+        ESP_LOGI(TAG, "No %s update available (HTTP %d)", decoder->name, status);
+        err = ESP_ERR_NOT_FOUND;
     }
-    
-    // Download loop with progress updates
-    while (1) {
-        ret = esp_https_ota_perform(https_ota_handle);
-        if (ret != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+    if (err != ESP_OK) {
+        esp_http_client_cleanup(client);
+        return err;
+    }
+    if (decoder->begin) {
+        decoder->begin(state, content_length >= 0 ? (int64_t)offset + content_length : -1);
+    }
+
+    failure_status = "OTA: Download failed";
+    esp_ota_handle_t ota_handle = 0;
+    uint8_t *buf = malloc(OTA_RECV_BUF_SIZE);
+    if (!buf) {
+        err = ESP_ERR_NO_MEM;
+    } else if (offset > 0) {
+        err = esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, offset, &ota_handle);
+    } else {
+        err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    }
+    bool ota_begun = (err == ESP_OK);
+    if (ota_begun) {
+        io->writer = ota_writer_start(ota_handle);
+        io->base_offset = offset;
+        if (!io->writer) {
+            err = ESP_ERR_NO_MEM;
+        }
+    }
+
+    atomic_store_explicit(&progress_written, offset, memory_order_relaxed);
+    atomic_store_explicit(&progress_total, 0, memory_order_relaxed);
+    size_t downloaded = 0;
+    bool progress_shown = false;
+    ota_throttle_t throttle = {
+        .start_us = esp_timer_get_time(),
+    };
+    int len = 0;
+    while (err == ESP_OK) {
+        ota_background_yield(&throttle, len);
+        len = esp_http_client_read(client, (char *)buf, OTA_RECV_BUF_SIZE);
+        if (len < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        if (len == 0) {
+            if (!esp_http_client_is_complete_data_received(client)) {
+                err = ESP_ERR_TIMEOUT;
+            }
             break;
         }
-        
-        // Calculate and update progress
-        int downloaded = esp_https_ota_get_image_len_read(https_ota_handle);
-        int percentage = (image_size > 0) ? (downloaded * 100) / image_size : 0;
-        
-        if (progress_callback) {
-            progress_callback(percentage, downloaded / 1024, image_size / 1024);
+        downloaded += len;
+        err = decoder->feed(state, buf, len);
+        ota_stats_sample(stats, len);
+
+        // The UI samples progress on its own timer; nothing here waits for it
+        if (!progress_shown && !background && err == ESP_OK && decoder->image_size(state) > 0) {
+            progress_shown = true;
+            atomic_store_explicit(&progress_total, decoder->image_size(state), memory_order_relaxed);
+            report_status("OTA: Please wait...", PRIMARY_RED);
+            if (progress_bar_show_callback) {
+                progress_bar_show_callback();
+            }
         }
-        
-        // Update every 100ms
-        vTaskDelay(pdMS_TO_TICKS(OTA_PROGRESS_UPDATE_DELAY_MS));
     }
-    
-    if (ret == ESP_OK) {
-        // Show flash writing status
-        if (status_callback) {
-            status_callback("OTA: Writing to flash...", LIGHT_RED);
+    esp_http_client_cleanup(client);
+    free(buf);
+
+    if (err == ESP_OK) {
+        err = decoder->finish(state);
+    }
+    if (io->writer) {
+        // Drain the pipeline even after an error so the writer task exits
+        esp_err_t write_err = ota_writer_finish(io->writer);
+        io->writer = NULL;
+        if (write_err != ESP_OK) {
+            failure_status = "OTA: Flash write failed";
+            failure_transient = false;
+            if (err == ESP_OK) {
+                err = write_err;
+            }
+        } else if (io->resume && err != ESP_OK) {
+            // Everything received is in flash now; keep the last checkpoint it covers
+            ota_resume_checkpoint(io->resume, ota_resume_offset(io->resume));
         }
+    }
+    if (err == ESP_OK) {
         if (progress_bar_set_callback) {
             progress_bar_set_callback(100);
         }
-        
-        ret = esp_https_ota_finish(https_ota_handle);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "OTA update successful! Restarting...");
-            if (status_callback) {
-                status_callback("OTA: Success!", PRIMARY_RED);
+        report_status("OTA: Verifying...", LIGHT_RED);
+        err = esp_ota_end(ota_handle);
+        ota_begun = false;
+        if (err == ESP_OK && manifest_valid) {
+            // The image must be the one the signed manifest describes
+            uint8_t digest[32];
+            err = esp_partition_get_sha256(update_partition, digest);
+            if (err == ESP_OK && memcmp(digest, manifest.app_sha256, sizeof(digest)) != 0) {
+                ESP_LOGE(TAG, "Image does not match the manifest for %s", manifest.version);
+                err = ESP_ERR_INVALID_CRC;
             }
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            esp_restart();
+        }
+        if (err == ESP_OK) {
+            err = esp_ota_set_boot_partition(update_partition);
+        }
+        if (io->resume) {
+            // Complete or rejected, there is nothing left to resume
+            ota_resume_clear();
+        }
+        if (err == ESP_OK) {
+            ota_stats_log(stats, decoder->name, decoder->image_size(state));
         } else {
-            ESP_LOGE(TAG, "ESP HTTPS OTA finish failed: %s", esp_err_to_name(ret));
-            if (status_callback) {
-                status_callback("OTA: Flash write failed", DARK_RED);
+            failure_status = "OTA: Image invalid";
+            failure_transient = false;
+        }
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "%s update failed after %u bytes: %s",
+                 decoder->name, (unsigned)downloaded, esp_err_to_name(err));
+    }
+    if (ota_begun) {
+        esp_ota_abort(ota_handle);
+    }
+    if (progress_shown && err != ESP_OK && progress_bar_hide_callback) {
+        progress_bar_hide_callback();
+    }
+    return err;
+}
+
+#if OTA_DELTA_ENABLED
+static esp_err_t delta_feed(void *state, const uint8_t *data, size_t len) { return ota_delta_feed(state, data, len); }
+static esp_err_t delta_finish(void *state) { return ota_delta_finish(state); }
+static size_t delta_image_size(const void *state) { return ota_delta_new_size(state); }
+
+static const stream_decoder_t delta_decoder = {
+    .name = "Delta",
+    .feed = delta_feed,
+    .finish = delta_finish,
+    .image_size = delta_image_size,
+};
+
+static esp_err_t delta_read_running(size_t offset, void *buf, size_t len, void *ctx)
+{
+    stream_io_t *io = ctx;
+    return esp_partition_read(io->running, offset, buf, len);
+}
+
+// Update with a patch against the running version, if one was published
+static esp_err_t ota_apply_delta(void)
+{
+    ota_stats_t stats;
+    ota_stats_start(&stats);
+
+    stream_io_t io = {
+        .running = esp_ota_get_running_partition(),
+    };
+    if (!io.running) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Size and digest of the running image identify which patch applies
+    uint8_t running_digest[32];
+    esp_image_metadata_t metadata = {0};
+    const esp_partition_pos_t running_pos = {
+        .offset = io.running->address,
+        .size = io.running->size,
+    };
+    esp_err_t err = esp_image_get_metadata(&running_pos, &metadata);
+    if (err == ESP_OK) {
+        err = esp_partition_get_sha256(io.running, running_digest);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot identify running image: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    char url[160];
+    snprintf(url, sizeof(url), "%s%s.patch", OTA_DELTA_URL_PREFIX, FIRMWARE_VERSION);
+    ota_delta_t *delta = ota_delta_create(metadata.image_len, running_digest,
+                                          delta_read_running, stream_write_update, &io);
+    if (!delta) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = ota_stream_update(url, &delta_decoder, delta, &io, &stats);
+    ota_delta_free(delta);
+    return err;
+}
+#endif
+
+#if OTA_COMPRESSED_ENABLED
+static esp_err_t inflate_feed(void *state, const uint8_t *data, size_t len) { return ota_inflate_feed(state, data, len); }
+static esp_err_t inflate_finish(void *state) { return ota_inflate_finish(state); }
+static size_t inflate_image_size(const void *state) { return ota_inflate_image_size(state); }
+
+static const stream_decoder_t inflate_decoder = {
+    .name = "Compressed",
+    .feed = inflate_feed,
+    .finish = inflate_finish,
+    .image_size = inflate_image_size,
+};
+
+// Update with the compressed full image
+static esp_err_t ota_apply_compressed(void)
+{
+    ota_stats_t stats;
+    ota_stats_start(&stats);
+
+    stream_io_t io = {0};
+    ota_inflate_t *inflate = ota_inflate_create(stream_write_update, &io);
+    if (!inflate) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = ota_stream_update(OTA_COMPRESSED_URL, &inflate_decoder, inflate, &io, &stats);
+    ota_inflate_free(inflate);
+    return err;
+}
+#endif
+
+// The plain image needs no decoding: bytes go straight to the writer
+typedef struct {
+    stream_io_t *io;
+    size_t image_size;
+} raw_image_t;
+
+static void raw_begin(void *state, int64_t content_length)
+{
+    raw_image_t *raw = state;
+    raw->image_size = content_length > 0 ? (size_t)content_length : 0;
+}
+
+static esp_err_t raw_feed(void *state, const uint8_t *data, size_t len)
+{
+    raw_image_t *raw = state;
+    return stream_write_update(data, len, raw->io);
+}
+
+static esp_err_t raw_finish(void *state)
+{
+    // esp_ota_end() validates the image
+    return ESP_OK;
+}
+
+static size_t raw_image_size(const void *state)
+{
+    const raw_image_t *raw = state;
+    return raw->image_size;
+}
+
+static const stream_decoder_t raw_decoder = {
+    .name = "Full",
+    .begin = raw_begin,
+    .feed = raw_feed,
+    .finish = raw_finish,
+    .image_size = raw_image_size,
+};
+
+// Wait out a dropped connection before the next attempt
+static void ota_wait_before_retry(int attempt)
+{
+    vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_RETRY_DELAY_MS << attempt));
+    for (int waited = 0; !wifi_manager_is_connected() && waited < OTA_RESUME_WIFI_WAIT_MS; waited += 500) {
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+}
+
+// One attempt at the plain image from url, continuing from a checkpoint if there is one
+static esp_err_t ota_download_plain(const char *url, ota_stats_t *stats)
+{
+    stream_io_t io = {0};
+#if OTA_RESUME_ENABLED
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition) {
+        io.resume = ota_resume_start(update_partition);
+    }
+#endif
+    raw_image_t raw = {
+        .io = &io,
+    };
+    esp_err_t err = ota_stream_update(url, &raw_decoder, &raw, &io, stats);
+    ota_resume_free(io.resume);
+    return err;
+}
+
+// Update with the plain image, continuing from a checkpoint after a drop or reboot
+static esp_err_t ota_apply_full(void)
+{
+    ota_stats_t stats;
+    ota_stats_start(&stats);
+
+    esp_err_t err;
+    for (int attempt = 0; ; attempt++) {
+        err = ota_download_plain(OTA_UPDATE_URL, &stats);
+        if (err == ESP_OK || err == ESP_ERR_NOT_FOUND || !failure_transient || attempt == OTA_RESUME_RETRIES) {
+            return err;
+        }
+        ESP_LOGW(TAG, "Download interrupted, retry %d of %d", attempt + 1, OTA_RESUME_RETRIES);
+        report_status("OTA: Reconnecting...", LIGHT_RED);
+        ota_wait_before_retry(attempt);
+    }
+}
+
+#if OTA_P2P_ENABLED
+/**
+ * Fetch the release from devices on the LAN that already hold it. Peers
+ * are not trusted: the flashed image must match the signed manifest like
+ * any other, and a peer whose image did not is not asked again. A
+ * background update on a device that is not a seeder waits, up to
+ * OTA_P2P_WAIT_MS, for a seeder to bring the release onto the LAN.
+ */
+static esp_err_t ota_apply_from_peers(void)
+{
+    ota_stats_t stats;
+    ota_stats_start(&stats);
+
+    char rejected[OTA_P2P_MAX_SOURCES][OTA_P2P_URL_SIZE];
+    size_t rejected_count = 0;
+    int64_t give_up_us = esp_timer_get_time() + (int64_t)OTA_P2P_WAIT_MS * 1000;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    bool attempted = false;
+    for (;;) {
+        ota_p2p_sources_t sources;
+        if (ota_p2p_find_sources(manifest.app_sha256, &sources) != ESP_OK) {
+            err = ESP_ERR_NOT_FOUND;
+            break;
+        }
+        for (size_t i = 0; i < sources.count; i++) {
+            bool known_bad = false;
+            for (size_t j = 0; j < rejected_count && !known_bad; j++) {
+                known_bad = strcmp(rejected[j], sources.urls[i]) == 0;
+            }
+            if (known_bad) {
+                continue;
+            }
+            attempted = true;
+            err = ota_download_plain(sources.urls[i], &stats);
+            if (err == ESP_OK) {
+                return ESP_OK;
+            }
+            if (!failure_transient && err != ESP_ERR_NOT_FOUND && rejected_count < OTA_P2P_MAX_SOURCES) {
+                ESP_LOGW(TAG, "Not using %s again", sources.urls[i]);
+                strcpy(rejected[rejected_count++], sources.urls[i]);
             }
         }
-    } else {
-        ESP_LOGE(TAG, "ESP HTTPS OTA perform failed: %s", esp_err_to_name(ret));
-        if (status_callback) {
-            status_callback("OTA: Download failed", DARK_RED);
+        // Promoted to the foreground, a seeder, or waited long enough: go upstream
+        if (!background || sources.seeder || esp_timer_get_time() >= give_up_us) {
+            break;
+        }
+        ESP_LOGI(TAG, "Waiting for a seeder to fetch %s", manifest.version);
+        for (int waited = 0; background && waited < OTA_P2P_POLL_MS; waited += 1000) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+    }
+#if OTA_RESUME_ENABLED
+    // A checkpoint carries the peer's ETag, so upstream would refuse it and
+    // ota_task would skip delta and compressed only to start the plain image over
+    if (attempted) {
+        ota_resume_clear();
+    }
+#endif
+    return err;
+}
+#endif
+
+#if OTA_MANIFEST_ENABLED
+/**
+ * Fetch and check the signed release manifest. ESP_ERR_NOT_FOUND means the
+ * server has none (HTTP 404); the update then goes ahead without it.
+ * ESP_ERR_INVALID_CRC or ESP_ERR_INVALID_RESPONSE means it did not verify.
+ * Anything else means it could not be fetched, and nothing should be.
+ */
+static esp_err_t ota_fetch_manifest(void)
+{
+    stream_headers_t headers;
+    esp_http_client_config_t config = {
+        .url = OTA_MANIFEST_URL,
+        .timeout_ms = OTA_RECV_TIMEOUT,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .event_handler = stream_http_event_handler,
+        .user_data = &headers,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    char *text = malloc(OTA_MANIFEST_MAX_SIZE);
+    if (!client || !text) {
+        if (client) {
+            esp_http_client_cleanup(client);
+        }
+        free(text);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int status = 0;
+    size_t len = 0;
+    esp_err_t err = http_open_following_redirects(client, &status, &headers);
+    if (err == ESP_OK && status == 404) {
+        ESP_LOGI(TAG, "No manifest published");
+        err = ESP_ERR_NOT_FOUND;
+    } else if (err == ESP_OK && status != 200) {
+        ESP_LOGW(TAG, "Manifest request failed (HTTP %d)", status);
+        err = ESP_FAIL;
+    } else if (err == ESP_OK) {
+        for (;;) {
+            int n = esp_http_client_read(client, text + len, OTA_MANIFEST_MAX_SIZE - len);
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+            if (len == OTA_MANIFEST_MAX_SIZE) {
+                err = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+        }
+        if (err == ESP_OK && !esp_http_client_is_complete_data_received(client)) {
+            err = ESP_ERR_TIMEOUT;
+        }
+    }
+    esp_http_client_cleanup(client);
+
+    if (err == ESP_OK) {
+        err = ota_manifest_parse(text, len, FIRMWARE_VERSION, &manifest);
+    } else if (err == ESP_ERR_INVALID_SIZE) {
+        ESP_LOGE(TAG, "Manifest larger than %d bytes", OTA_MANIFEST_MAX_SIZE);
+        err = ESP_ERR_INVALID_RESPONSE;
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Manifest download failed: %s", esp_err_to_name(err));
+    }
+    free(text);
+    return err;
+}
+
+// Whether the running image is the release the manifest describes
+static bool ota_running_is_latest(void)
+{
+    uint8_t digest[32];
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (!running || esp_partition_get_sha256(running, digest) != ESP_OK) {
+        return false;
+    }
+    if (memcmp(digest, manifest.app_sha256, sizeof(digest)) == 0) {
+        return true;
+    }
+    if (strcmp(manifest.version, FIRMWARE_VERSION) == 0) {
+        ESP_LOGW(TAG, "Running %s, but not the published build; updating", FIRMWARE_VERSION);
+    }
+    return false;
+}
+#endif
+
+// A background update is set to boot, so any reboot applies it. Restart
+// sooner only once nobody has used the device for a while, or on request.
+static void ota_wait_until_idle(void)
+{
+    ESP_LOGI(TAG, "Background update ready, restarting after %d s idle",
+             OTA_BACKGROUND_APPLY_IDLE_MS / 1000);
+    if (status_callback) {
+        status_callback("OTA: Update ready", PRIMARY_RED);
+    }
+    while (background) {
+        bool idle = idle_time_callback && idle_time_callback() >= OTA_BACKGROUND_APPLY_IDLE_MS &&
+                    !(busy_callback && busy_callback());
+        if (idle) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+static void ota_restart_into_update(void)
+{
+    if (background) {
+#if OTA_P2P_ENABLED
+        // Until the restart, the rest of the LAN can fetch the staged image from here
+        ota_p2p_advertise();
+#endif
+        ota_wait_until_idle();
+    }
+    ESP_LOGI(TAG, "OTA update successful! Restarting...");
+    report_status("OTA: Success!", PRIMARY_RED);
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    esp_restart();
+}
+
+static void ota_task(void *param)
+{
+    ESP_LOGI(TAG, "Starting OTA update task...");
+    ota_in_progress = true;
+    
+    // Show connecting status
+    report_status("OTA: Connecting...", LIGHT_RED);
+    
+    // The manifest says whether there is anything to download, and which ways
+    bool try_delta = true;
+    bool try_compressed = true;
+    bool try_full = true;
+    esp_err_t ret = ESP_OK;
+    manifest_valid = false;
+#if OTA_MANIFEST_ENABLED
+    ret = ota_fetch_manifest();
+    if (ret == ESP_OK) {
+        manifest_valid = true;
+        try_delta = manifest.has_delta;
+        try_compressed = manifest.has_compressed;
+        ESP_LOGI(TAG, "Latest release %s, %u bytes", manifest.version, (unsigned)manifest.size);
+        if (ota_running_is_latest()) {
+            ESP_LOGI(TAG, "Already running %s", manifest.version);
+            report_status("OTA: Up to date", PRIMARY_RED);
+            ota_in_progress = false;
+            vTaskDelete(NULL);
+            return;
+        }
+    } else if (ret != ESP_ERR_NOT_FOUND) {
+        if (ret == ESP_ERR_INVALID_CRC || ret == ESP_ERR_INVALID_RESPONSE) {
+            // Someone else's manifest: do not fetch images from where it came from
+            ESP_LOGE(TAG, "Manifest rejected: %s", esp_err_to_name(ret));
+            failure_status = "OTA: Bad manifest";
+        } else {
+            // Published but unreachable: without it there is no telling whether
+            // this device is up to date, nor checking what it would download
+            ESP_LOGE(TAG, "Manifest unavailable: %s", esp_err_to_name(ret));
+            failure_status = "OTA: Connection failed";
+        }
+        try_delta = false;
+        try_compressed = false;
+        try_full = false;
+    }
+#endif
+
+    // Unattended, only a release the signed manifest vouches for is worth a download and reboot
+    if (background && !manifest_valid) {
+        ESP_LOGI(TAG, "No verified manifest, background update skipped");
+        ota_in_progress = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+#if OTA_P2P_ENABLED
+    // A device on the LAN may hold the release already; the manifest says which image to ask for
+    if (manifest_valid && ota_apply_from_peers() == ESP_OK) {
+        ota_restart_into_update();
+    }
+#endif
+
+    // An interrupted plain download is finished first: the other ways would overwrite it
+#if OTA_RESUME_ENABLED
+    if (ota_resume_available(NULL, NULL)) {
+        try_delta = false;
+        try_compressed = false;
+    }
+#endif
+#if OTA_DELTA_ENABLED
+    // A patch against the running version is a fraction of the full image
+    if (try_delta && ota_apply_delta() == ESP_OK) {
+        ota_restart_into_update();
+    }
+#endif
+#if OTA_COMPRESSED_ENABLED
+    // Otherwise the full image, compressed
+    if (try_compressed && ota_apply_compressed() == ESP_OK) {
+        ota_restart_into_update();
+    }
+#endif
+    
+    if (try_full) {
+        ret = ota_apply_full();
+        if (ret == ESP_OK) {
+            ota_restart_into_update();
         }
-        esp_https_ota_abort(https_ota_handle);
     }
     
-    // Hide progress bar on completion/failure
+    ESP_LOGE(TAG, "OTA update failed: %s", esp_err_to_name(ret));
+    report_status(failure_status, DARK_RED);
+    
+    // Hide progress bar on failure
     if (progress_bar_hide_callback) {
         progress_bar_hide_callback();
     }
     
     ota_in_progress = false;
     vTaskDelete(NULL);
-}
\ No newline at end of file
+}
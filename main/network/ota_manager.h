@@ -3,23 +3,30 @@
 #include "esp_err.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 // OTA Manager initialization and control
 esp_err_t ota_manager_init(void);
-void ota_manager_start_update(void);
+void ota_manager_start_update(void);                // Foreground; also hurries a background update along
+void ota_manager_start_background_update(void);     // Low priority, capped, applied when idle
+void ota_manager_start_background_checks(void);     // Background update now and then (OTA_BACKGROUND_*)
 void ota_manager_abort_update(void);
 
 // Status queries
 bool ota_manager_is_in_progress(void);
+bool ota_manager_is_background(void);              // The update in progress is a background one
+void ota_manager_get_progress(size_t *written, size_t *total);     // Bytes written to flash of total (0 until known)
 
 // Callback types for status updates
 typedef void (*ota_status_callback_t)(const char* status, uint32_t color);
-typedef void (*ota_progress_callback_t)(int percentage, size_t downloaded_kb, size_t total_kb);
 typedef void (*ota_progress_bar_callback_t)(void);
+typedef bool (*ota_busy_callback_t)(void);          // Device in use: background downloads wait
+typedef uint32_t (*ota_idle_time_callback_t)(void); // Milliseconds since the user last did anything
 
 // Callback registration
 void ota_manager_set_status_callback(ota_status_callback_t callback);
-void ota_manager_set_progress_callback(ota_progress_callback_t callback);
 void ota_manager_set_progress_bar_show_callback(ota_progress_bar_callback_t callback);
 void ota_manager_set_progress_bar_hide_callback(ota_progress_bar_callback_t callback);
-void ota_manager_set_progress_bar_set_callback(void (*callback)(int percentage));
\ No newline at end of file
+void ota_manager_set_progress_bar_set_callback(void (*callback)(int percentage));
+void ota_manager_set_busy_callback(ota_busy_callback_t callback);
+void ota_manager_set_idle_time_callback(ota_idle_time_callback_t callback);
\ No newline at end of file
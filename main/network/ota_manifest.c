@@ -0,0 +1,104 @@
+#include "ota_manifest.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/base64.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_manifest";
+
+#define MANIFEST_SIGNATURE_MAX 80   // DER ECDSA P-256 signature, at most 72 bytes
+
+// Release signing key, embedded by CMakeLists.txt (EMBED_TXTFILES, NUL included)
+extern const uint8_t ota_manifest_key_pem_start[] asm("_binary_ota_manifest_key_pem_start");
+extern const uint8_t ota_manifest_key_pem_end[] asm("_binary_ota_manifest_key_pem_end");
+
+static esp_err_t verify_signature(const char *payload, size_t payload_len,
+                                  const char *signature_b64, size_t signature_b64_len)
+{
+    uint8_t signature[MANIFEST_SIGNATURE_MAX];
+    size_t signature_len = 0;
+    if (mbedtls_base64_decode(signature, sizeof(signature), &signature_len,
+                              (const unsigned char *)signature_b64, signature_b64_len) != 0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    uint8_t hash[32];
+    mbedtls_sha256((const unsigned char *)payload, payload_len, hash, 0);
+
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    esp_err_t err = ESP_ERR_INVALID_CRC;
+    int ret = mbedtls_pk_parse_public_key(&key, ota_manifest_key_pem_start,
+                                          ota_manifest_key_pem_end - ota_manifest_key_pem_start);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Bad built-in manifest key: -0x%04x", -ret);
+        err = ESP_ERR_INVALID_STATE;
+    } else if (mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, hash, sizeof(hash), signature, signature_len) == 0) {
+        err = ESP_OK;
+    }
+    mbedtls_pk_free(&key);
+    return err;
+}
+
+static bool parse_hex(const char *hex, uint8_t *out, size_t len)
+{
+    if (!hex || strlen(hex) != len * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        char *end;
+        out[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t ota_manifest_parse(const char *text, size_t len, const char *running_version,
+                             ota_manifest_t *manifest)
+{
+    const char *newline = memchr(text, '\n', len);
+    if (!newline) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    size_t payload_len = newline - text;
+    const char *signature = newline + 1;
+    size_t signature_len = len - payload_len - 1;
+    while (signature_len > 0 && (signature[signature_len - 1] == '\n' || signature[signature_len - 1] == '\r')) {
+        signature_len--;
+    }
+
+    esp_err_t err = verify_signature(text, payload_len, signature, signature_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Manifest signature does not verify");
+        return err;
+    }
+
+    cJSON *json = cJSON_ParseWithLength(text, payload_len);
+    if (!json) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memset(manifest, 0, sizeof(*manifest));
+    cJSON *version = cJSON_GetObjectItem(json, "version");
+    cJSON *size = cJSON_GetObjectItem(json, "size");
+    cJSON *app_sha256 = cJSON_GetObjectItem(json, "app_sha256");
+    cJSON *deltas = cJSON_GetObjectItem(json, "deltas");
+    cJSON *compressed_size = cJSON_GetObjectItem(json, "compressed_size");
+    if (!cJSON_IsString(version) || strlen(version->valuestring) >= sizeof(manifest->version) ||
+        !cJSON_IsNumber(size) || size->valuedouble <= 0 ||
+        !parse_hex(cJSON_GetStringValue(app_sha256), manifest->app_sha256, sizeof(manifest->app_sha256))) {
+        err = ESP_ERR_INVALID_RESPONSE;
+    } else {
+        strcpy(manifest->version, version->valuestring);
+        manifest->size = (size_t)size->valuedouble;
+        manifest->has_delta = cJSON_IsObject(deltas) && cJSON_GetObjectItem(deltas, running_version) != NULL;
+        manifest->has_compressed = cJSON_IsNumber(compressed_size);
+    }
+    cJSON_Delete(json);
+    return err;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A release as described by its signed manifest.json
+ *
+ * scripts/ota_manifest.py documents the format: one JSON line, then a base64
+ * ECDSA P-256 signature of that line, checked against the public key built
+ * into the firmware (network/ota_manifest_key.pem).
+ */
+typedef struct {
+    char version[24];
+    size_t size;                    // Plain image size
+    uint8_t app_sha256[32];         // What esp_partition_get_sha256() will report for it
+    bool has_delta;                 // A patch from the version asked about is published
+    bool has_compressed;            // firmware.bin.hs is published
+} ota_manifest_t;
+
+/**
+ * @brief Check a downloaded manifest's signature and read it
+ * @param text Manifest as downloaded
+ * @param len Byte count
+ * @param running_version Version to look for among the published patches
+ * @param manifest Filled in on success
+ * @return ESP_OK, ESP_ERR_INVALID_CRC if the signature does not verify,
+ *         ESP_ERR_INVALID_RESPONSE if it is malformed (or cannot be parsed in
+ *         the memory available), ESP_ERR_INVALID_STATE if the built-in key is bad
+ */
+esp_err_t ota_manifest_parse(const char *text, size_t len, const char *running_version,
+                             ota_manifest_t *manifest);
+
+#ifdef __cplusplus
+}
+#endif
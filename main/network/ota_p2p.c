@@ -0,0 +1,281 @@
+#include "ota_p2p.h"
+#include "ota_peer.h"
+#include "../app_config.h"
+#include "esp_http_server.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "mdns.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "ota_p2p";
+
+#define MDNS_SERVICE    "_esp32"
+#define MDNS_PROTO      "_tcp"
+#define P2P_PORT        80      // As advertised by main.c
+
+// The image this device serves
+typedef struct {
+    const esp_partition_t *partition;
+    size_t image_len;
+    uint8_t digest[32];
+    char etag[OTA_PEER_DIGEST_HEX_LEN + 3];
+} offered_image_t;
+
+static offered_image_t offered;
+static SemaphoreHandle_t offered_mutex = NULL;
+static httpd_handle_t server = NULL;
+static char device_id[13];              // Wi-Fi MAC in hex: orders devices for seeder election
+
+static esp_err_t send_all(httpd_req_t *req, const char *data, size_t len)
+{
+    while (len > 0) {
+        int sent = httpd_send(req, data, len);
+        if (sent <= 0) {
+            return ESP_FAIL;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+// GET /ota/<digest>: the offered image, whole or one byte range
+static esp_err_t image_get_handler(httpd_req_t *req)
+{
+    offered_image_t image;
+    xSemaphoreTake(offered_mutex, portMAX_DELAY);
+    image = offered;
+    xSemaphoreGive(offered_mutex);
+
+    uint8_t digest[32];
+    if (!ota_peer_parse_path(req->uri, digest) || !image.partition ||
+        memcmp(digest, image.digest, sizeof(digest)) != 0) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such image");
+    }
+
+    // A truncated If-Range cannot match the ETag, so it still counts as present
+    char range[48];
+    char if_range[72];
+    bool has_range = httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK;
+    bool has_if_range = httpd_req_get_hdr_value_str(req, "If-Range", if_range, sizeof(if_range)) != ESP_ERR_NOT_FOUND;
+    ota_peer_response_t response;
+    ota_peer_plan_response(has_range ? range : NULL, has_if_range ? if_range : NULL,
+                           image.etag, image.image_len, &response);
+
+    // Written by hand: httpd_resp_send_chunk() would drop Content-Length, which resuming needs
+    char header[256];
+    int header_len;
+    if (response.status == 416) {
+        header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                              "Content-Range: bytes */%u\r\n"
+                              "Content-Length: 0\r\n\r\n",
+                              (unsigned)image.image_len);
+        return send_all(req, header, header_len);
+    }
+    header_len = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %s\r\n"
+                          "Content-Type: application/octet-stream\r\n"
+                          "Content-Length: %u\r\n"
+                          "ETag: %s\r\n"
+                          "Accept-Ranges: bytes\r\n",
+                          response.status == 206 ? "206 Partial Content" : "200 OK",
+                          (unsigned)response.length, image.etag);
+    if (response.status == 206) {
+        header_len += snprintf(header + header_len, sizeof(header) - header_len,
+                               "Content-Range: bytes %u-%u/%u\r\n",
+                               (unsigned)response.first, (unsigned)(response.first + response.length - 1),
+                               (unsigned)image.image_len);
+    }
+    header_len += snprintf(header + header_len, sizeof(header) - header_len, "\r\n");
+
+    char *buf = malloc(OTA_P2P_SEND_BUF_SIZE);
+    if (!buf) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    }
+    esp_err_t err = send_all(req, header, header_len);
+    size_t offset = response.first;
+    size_t end = response.first + response.length;
+    while (err == ESP_OK && offset < end) {
+        size_t len = end - offset < OTA_P2P_SEND_BUF_SIZE ? end - offset : OTA_P2P_SEND_BUF_SIZE;
+        err = esp_partition_read(image.partition, offset, buf, len);
+        if (err == ESP_OK) {
+            err = send_all(req, buf, len);
+        }
+        offset += len;
+    }
+    free(buf);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Served bytes %u-%u of %s", (unsigned)response.first, (unsigned)end,
+                 image.partition->label);
+    } else {
+        // Returning an error closes the connection, which is all a cut-short body allows
+        ESP_LOGW(TAG, "Upload stopped at %u of %u bytes", (unsigned)(offset - response.first),
+                 (unsigned)response.length);
+    }
+    return err;
+}
+
+esp_err_t ota_p2p_start(void)
+{
+    if (server) {
+        return ESP_OK;
+    }
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(device_id, sizeof(device_id), "%02x%02x%02x%02x%02x%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    offered_mutex = xSemaphoreCreateMutex();
+    if (!offered_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = P2P_PORT;
+    config.task_priority = OTA_P2P_SERVER_PRIORITY;
+    config.stack_size = OTA_P2P_SERVER_STACK_SIZE;
+    config.max_open_sockets = OTA_P2P_MAX_CONNECTIONS;
+    config.lru_purge_enable = true;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start peer server: %s", esp_err_to_name(err));
+        server = NULL;
+        return err;
+    }
+    const httpd_uri_t image_uri = {
+        .uri = OTA_PEER_PATH_PREFIX "*",
+        .method = HTTP_GET,
+        .handler = image_get_handler,
+    };
+    httpd_register_uri_handler(server, &image_uri);
+
+    ota_p2p_advertise();
+    return ESP_OK;
+}
+
+void ota_p2p_advertise(void)
+{
+    if (!offered_mutex) {
+        return;
+    }
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *boot = esp_ota_get_boot_partition();
+    offered_image_t image = {
+        .partition = (boot && boot != running) ? boot : running,
+    };
+    if (!image.partition) {
+        return;
+    }
+
+    esp_image_metadata_t metadata = {0};
+    const esp_partition_pos_t pos = {
+        .offset = image.partition->address,
+        .size = image.partition->size,
+    };
+    esp_err_t err = esp_image_get_metadata(&pos, &metadata);
+    if (err == ESP_OK) {
+        err = esp_partition_get_sha256(image.partition, image.digest);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot identify image in %s: %s", image.partition->label, esp_err_to_name(err));
+        return;
+    }
+    image.image_len = metadata.image_len;
+    char hex[OTA_PEER_DIGEST_HEX_LEN + 1];
+    ota_peer_digest_to_hex(image.digest, hex);
+    snprintf(image.etag, sizeof(image.etag), "\"%s\"", hex);
+
+    xSemaphoreTake(offered_mutex, portMAX_DELAY);
+    offered = image;
+    xSemaphoreGive(offered_mutex);
+
+    char len_text[12];
+    snprintf(len_text, sizeof(len_text), "%u", (unsigned)image.image_len);
+    mdns_txt_item_t txt[] = {
+        { "id", device_id },
+        { "ota", hex },
+        { "ota_len", len_text },
+    };
+    err = mdns_service_txt_set(MDNS_SERVICE, MDNS_PROTO, txt, sizeof(txt) / sizeof(txt[0]));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to advertise image: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Offering %s image %.16s... (%u bytes)", image.partition->label, hex,
+             (unsigned)image.image_len);
+}
+
+static const char *txt_value(const mdns_result_t *result, const char *key)
+{
+    for (size_t i = 0; i < result->txt_count; i++) {
+        if (strcmp(result->txt[i].key, key) == 0) {
+            return result->txt[i].value;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t ota_p2p_find_sources(const uint8_t digest[32], ota_p2p_sources_t *sources)
+{
+    memset(sources, 0, sizeof(*sources));
+    sources->seeder = true;
+
+    mdns_result_t *results = NULL;
+    esp_err_t err = mdns_query_ptr(MDNS_SERVICE, MDNS_PROTO, OTA_P2P_QUERY_MS, OTA_P2P_MAX_PEERS, &results);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Peer browse failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    char hex[OTA_PEER_DIGEST_HEX_LEN + 1];
+    ota_peer_digest_to_hex(digest, hex);
+    const char *peer_ids[OTA_P2P_MAX_PEERS];
+    size_t peer_count = 0;
+    for (const mdns_result_t *result = results; result; result = result->next) {
+        // Devices without an id run firmware that does not share
+        const char *id = txt_value(result, "id");
+        if (!id || strcmp(id, device_id) == 0 || peer_count == OTA_P2P_MAX_PEERS) {
+            continue;
+        }
+        peer_ids[peer_count++] = id;
+
+        const char *ota = txt_value(result, "ota");
+        if (!ota || strcasecmp(ota, hex) != 0 || sources->count == OTA_P2P_MAX_SOURCES) {
+            continue;
+        }
+        for (const mdns_ip_addr_t *addr = result->addr; addr; addr = addr->next) {
+            if (addr->addr.type == ESP_IPADDR_TYPE_V4) {
+                snprintf(sources->urls[sources->count++], OTA_P2P_URL_SIZE,
+                         "http://" IPSTR ":%u" OTA_PEER_PATH_PREFIX "%s",
+                         IP2STR(&addr->addr.u_addr.ip4), result->port, hex);
+                break;
+            }
+        }
+    }
+    sources->seeder = ota_peer_is_seeder(device_id, peer_ids, peer_count, OTA_P2P_SEEDERS);
+    mdns_query_results_free(results);
+
+    // Shuffle, so devices looking at the same moment do not all pick the same peer
+    for (size_t i = sources->count; i > 1; i--) {
+        size_t j = esp_random() % i;
+        char url[OTA_P2P_URL_SIZE];
+        memcpy(url, sources->urls[i - 1], OTA_P2P_URL_SIZE);
+        memcpy(sources->urls[i - 1], sources->urls[j], OTA_P2P_URL_SIZE);
+        memcpy(sources->urls[j], url, OTA_P2P_URL_SIZE);
+    }
+    ESP_LOGI(TAG, "%u of %u peers hold the release; %s", (unsigned)sources->count,
+             (unsigned)peer_count, sources->seeder ? "seeding from upstream" : "leaving upstream to the seeders");
+    return ESP_OK;
+}
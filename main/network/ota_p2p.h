@@ -0,0 +1,55 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_P2P_MAX_SOURCES     4       // Peers tried per look
+#define OTA_P2P_URL_SIZE        112     // http://<IPv4>:<port>/ota/<64 hex digits>
+
+/**
+ * @brief Devices on the LAN holding a release, from one mDNS browse
+ */
+typedef struct {
+    size_t count;
+    char urls[OTA_P2P_MAX_SOURCES][OTA_P2P_URL_SIZE];
+    bool seeder;                    // This device is one of the OTA_P2P_SEEDERS that fetch upstream
+} ota_p2p_sources_t;
+
+/**
+ * @brief Serve this device's image to its peers and advertise it
+ *
+ * Starts a small HTTP server on the port _esp32._tcp advertises (see
+ * ota_peer.h for the protocol), at OTA_P2P_SERVER_PRIORITY so uploads
+ * wait behind the UI and lookups. Requests are answered one at a time.
+ * Call after mdns_service_add().
+ */
+esp_err_t ota_p2p_start(void);
+
+/**
+ * @brief Offer the newest verified image: the one staged to boot if any, else the running one
+ *
+ * Hashes the partition and updates the mDNS TXT record (id, ota, ota_len).
+ * Call again once an update has been set to boot.
+ */
+void ota_p2p_advertise(void);
+
+/**
+ * @brief Browse for peers offering the image with this digest
+ *
+ * Blocks for up to OTA_P2P_QUERY_MS. Sources are in random order, so
+ * devices looking at the same time spread over the peers.
+ * @param digest app_sha256 from the signed manifest
+ * @param sources Filled in
+ * @return ESP_OK, or the mDNS error (sources is then empty and seeder set)
+ */
+esp_err_t ota_p2p_find_sources(const uint8_t digest[32], ota_p2p_sources_t *sources);
+
+#ifdef __cplusplus
+}
+#endif
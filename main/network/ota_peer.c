@@ -0,0 +1,125 @@
+#include "ota_peer.h"
+#include <stdlib.h>
+#include <string.h>
+
+void ota_peer_digest_to_hex(const uint8_t digest[32], char *hex)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 32; i++) {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[OTA_PEER_DIGEST_HEX_LEN] = '\0';
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Parse exactly 64 hex digits ending at end (or a NUL if end is NULL)
+static bool parse_digest(const char *hex, const char *end, uint8_t digest[32])
+{
+    size_t len = end ? (size_t)(end - hex) : strlen(hex);
+    if (len != OTA_PEER_DIGEST_HEX_LEN) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        int high = hex_value(hex[2 * i]);
+        int low = hex_value(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        digest[i] = (uint8_t)(high << 4 | low);
+    }
+    return true;
+}
+
+bool ota_peer_digest_from_hex(const char *hex, uint8_t digest[32])
+{
+    return hex && parse_digest(hex, NULL, digest);
+}
+
+bool ota_peer_parse_path(const char *path, uint8_t digest[32])
+{
+    size_t prefix_len = strlen(OTA_PEER_PATH_PREFIX);
+    if (!path || strncmp(path, OTA_PEER_PATH_PREFIX, prefix_len) != 0) {
+        return false;
+    }
+    const char *hex = path + prefix_len;
+    return parse_digest(hex, hex + strcspn(hex, "?"), digest);
+}
+
+// Parse a decimal byte position (at most 9 digits: far beyond any app slot)
+static bool parse_position(const char *text, const char **end, size_t *value)
+{
+    size_t digits = strspn(text, "0123456789");
+    if (digits == 0 || digits > 9) {
+        return false;
+    }
+    *value = (size_t)strtoul(text, NULL, 10);
+    *end = text + digits;
+    return true;
+}
+
+void ota_peer_plan_response(const char *range, const char *if_range, const char *etag,
+                            size_t image_len, ota_peer_response_t *response)
+{
+    response->status = 200;
+    response->first = 0;
+    response->length = image_len;
+
+    if (!range || (if_range && (!etag || strcmp(if_range, etag) != 0))) {
+        return;
+    }
+    static const char unit[] = "bytes=";
+    if (strncmp(range, unit, sizeof(unit) - 1) != 0) {
+        return;
+    }
+    const char *p = range + sizeof(unit) - 1;
+    size_t first, last = image_len > 0 ? image_len - 1 : 0;
+    if (!parse_position(p, &p, &first) || *p++ != '-') {
+        return;
+    }
+    if (*p != '\0' && (!parse_position(p, &p, &last) || *p != '\0' || last < first)) {
+        return;
+    }
+    if (first >= image_len) {
+        response->status = 416;
+        response->length = 0;
+        return;
+    }
+    if (last >= image_len) {
+        last = image_len - 1;
+    }
+    response->status = 206;
+    response->first = first;
+    response->length = last - first + 1;
+}
+
+bool ota_peer_is_seeder(const char *own_id, const char *const *peer_ids, size_t count, int seeders)
+{
+    int lower = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(peer_ids[i], own_id) >= 0) {
+            continue;
+        }
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) {
+            seen = strcmp(peer_ids[j], peer_ids[i]) == 0;
+        }
+        if (!seen) {
+            lower++;
+        }
+    }
+    return lower < seeders;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Protocol between devices sharing a release on the LAN
+ *
+ * A device that holds a verified image serves it at
+ * GET /ota/<app_sha256 hex>, with ETag "<app_sha256 hex>" and single
+ * byte ranges (Range, If-Range), and advertises the digest in the TXT
+ * record of its _esp32._tcp mDNS service. The digest comes from the signed
+ * manifest, so whoever downloads from a peer checks the image it flashed
+ * against that, not against anything the peer says.
+ *
+ * Nothing here depends on ESP-IDF; ota_p2p.c does the serving and discovery.
+ */
+
+#define OTA_PEER_PATH_PREFIX    "/ota/"
+#define OTA_PEER_DIGEST_HEX_LEN 64
+
+// What to send for one request
+typedef struct {
+    int status;                     // 200, 206 or 416
+    size_t first;                   // First image byte sent
+    size_t length;                  // Bytes sent
+} ota_peer_response_t;
+
+/**
+ * @brief Lower-case hex of a SHA-256 digest
+ * @param hex At least OTA_PEER_DIGEST_HEX_LEN + 1 bytes
+ */
+void ota_peer_digest_to_hex(const uint8_t digest[32], char *hex);
+
+/**
+ * @brief Parse 64 hex digits (either case)
+ * @return false if hex is not exactly a digest
+ */
+bool ota_peer_digest_from_hex(const char *hex, uint8_t digest[32]);
+
+/**
+ * @brief Digest asked for by a request path (OTA_PEER_PATH_PREFIX + hex, query ignored)
+ */
+bool ota_peer_parse_path(const char *path, uint8_t digest[32]);
+
+/**
+ * @brief Decide how to answer a request for an image of image_len bytes
+ *
+ * "bytes=N-" and "bytes=N-M" give 206 (416 if N is past the end). No
+ * Range, an If-Range that differs from etag, or a Range this does not
+ * handle (several ranges, suffix ranges) give the whole image with 200.
+ * @param range Range header, or NULL
+ * @param if_range If-Range header, or NULL
+ * @param etag ETag the image is served under
+ */
+void ota_peer_plan_response(const char *range, const char *if_range, const char *etag,
+                            size_t image_len, ota_peer_response_t *response);
+
+/**
+ * @brief Whether this device fetches a release upstream itself
+ *
+ * Every device on the LAN makes the same choice from the ids it sees: the
+ * seeders lowest ids fetch from upstream and the rest wait for one of them.
+ * @param own_id This device's id
+ * @param peer_ids Ids of the other devices seen (duplicates and own_id are ignored)
+ * @param count Number of peer_ids
+ * @param seeders Devices per LAN that fetch upstream
+ */
+bool ota_peer_is_seeder(const char *own_id, const char *const *peer_ids, size_t count, int seeders);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,293 @@
+#include "ota_resume.h"
+#include "../app_config.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_resume";
+
+#define RESUME_NVS_NAMESPACE "ota"
+#define RESUME_NVS_KEY       "resume"
+#define RESUME_VERSION       1
+#define RESUME_ETAG_MAX      72
+#define RESUME_READ_SIZE     4096
+
+// What NVS holds between sessions
+typedef struct {
+    uint32_t version;
+    uint32_t partition_address;
+    uint32_t image_size;
+    uint32_t offset;                // Bytes known to be in flash
+    uint8_t digest[32];             // SHA-256 of those bytes
+    char etag[RESUME_ETAG_MAX];
+} checkpoint_t;
+
+struct ota_resume {
+    const esp_partition_t *partition;
+    checkpoint_t saved;             // Last checkpoint written to NVS
+    size_t offset;                  // Image bytes hashed so far
+    mbedtls_sha256_context sha;
+    bool pending;                   // A checkpoint waiting for its bytes to reach flash
+    size_t pending_offset;
+    uint8_t pending_digest[32];
+};
+
+static esp_err_t checkpoint_load(checkpoint_t *checkpoint)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(RESUME_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t len = sizeof(*checkpoint);
+    err = nvs_get_blob(nvs, RESUME_NVS_KEY, checkpoint, &len);
+    nvs_close(nvs);
+    if (err == ESP_OK && (len != sizeof(*checkpoint) || checkpoint->version != RESUME_VERSION)) {
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    return err;
+}
+
+static void checkpoint_save(const checkpoint_t *checkpoint)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, RESUME_NVS_KEY, checkpoint, sizeof(*checkpoint));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Checkpoint not saved: %s", esp_err_to_name(err));
+    }
+}
+
+void ota_resume_clear(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_erase_key(nvs, RESUME_NVS_KEY) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+}
+
+bool ota_resume_available(size_t *offset, size_t *image_size)
+{
+    checkpoint_t checkpoint;
+    if (checkpoint_load(&checkpoint) != ESP_OK || checkpoint.offset == 0) {
+        return false;
+    }
+    if (offset) {
+        *offset = checkpoint.offset;
+    }
+    if (image_size) {
+        *image_size = checkpoint.image_size;
+    }
+    return true;
+}
+
+static void session_restart(ota_resume_t *resume)
+{
+    mbedtls_sha256_free(&resume->sha);
+    mbedtls_sha256_init(&resume->sha);
+    mbedtls_sha256_starts(&resume->sha, 0);
+    resume->offset = 0;
+    resume->pending = false;
+}
+
+// Hash what flash holds below the checkpoint; true if it is what was checkpointed
+static bool verify_prefix(ota_resume_t *resume, const checkpoint_t *checkpoint)
+{
+    uint8_t *buf = malloc(RESUME_READ_SIZE);
+    if (!buf) {
+        return false;
+    }
+    esp_err_t err = ESP_OK;
+    for (size_t pos = 0; pos < checkpoint->offset && err == ESP_OK; pos += RESUME_READ_SIZE) {
+        size_t n = checkpoint->offset - pos;
+        if (n > RESUME_READ_SIZE) {
+            n = RESUME_READ_SIZE;
+        }
+        err = esp_partition_read(resume->partition, pos, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&resume->sha, buf, n);
+        }
+    }
+    free(buf);
+
+    uint8_t digest[32];
+    mbedtls_sha256_context copy;
+    mbedtls_sha256_init(&copy);
+    mbedtls_sha256_clone(&copy, &resume->sha);
+    mbedtls_sha256_finish(&copy, digest);
+    mbedtls_sha256_free(&copy);
+    return err == ESP_OK && memcmp(digest, checkpoint->digest, sizeof(digest)) == 0;
+}
+
+ota_resume_t *ota_resume_start(const esp_partition_t *partition)
+{
+    ota_resume_t *resume = calloc(1, sizeof(ota_resume_t));
+    if (!resume) {
+        return NULL;
+    }
+    resume->partition = partition;
+    resume->saved.version = RESUME_VERSION;
+    resume->saved.partition_address = partition->address;
+    mbedtls_sha256_init(&resume->sha);
+    mbedtls_sha256_starts(&resume->sha, 0);
+
+    checkpoint_t checkpoint;
+    if (checkpoint_load(&checkpoint) != ESP_OK || checkpoint.offset == 0) {
+        return resume;
+    }
+    if (checkpoint.partition_address != partition->address || checkpoint.offset > partition->size ||
+        checkpoint.offset > checkpoint.image_size) {
+        ESP_LOGI(TAG, "Checkpoint is for another slot, starting over");
+    } else if (!verify_prefix(resume, &checkpoint)) {
+        ESP_LOGW(TAG, "First %" PRIu32 " bytes in flash no longer match the checkpoint, starting over",
+                 checkpoint.offset);
+    } else {
+        ESP_LOGI(TAG, "Resuming at %" PRIu32 " of %" PRIu32 " bytes", checkpoint.offset, checkpoint.image_size);
+        resume->saved = checkpoint;
+        resume->offset = checkpoint.offset;
+        return resume;
+    }
+    session_restart(resume);
+    ota_resume_clear();
+    return resume;
+}
+
+size_t ota_resume_offset(const ota_resume_t *resume)
+{
+    return resume->offset;
+}
+
+const char *ota_resume_etag(const ota_resume_t *resume)
+{
+    return resume->saved.etag;
+}
+
+size_t ota_resume_image_size(const ota_resume_t *resume)
+{
+    return resume->saved.image_size;
+}
+
+bool ota_resume_parse_content_range(const char *content_range, size_t *first, size_t *last, size_t *total)
+{
+    if (!content_range || strncmp(content_range, "bytes ", 6) != 0) {
+        return false;
+    }
+    char *end;
+    const char *p = content_range + 6;
+    *first = strtoul(p, &end, 10);
+    if (end == p || *end != '-') {
+        return false;
+    }
+    p = end + 1;
+    *last = strtoul(p, &end, 10);
+    if (end == p || *end != '/' || *last < *first) {
+        return false;
+    }
+    p = end + 1;
+    if (*p == '*') {
+        *total = 0;
+        return p[1] == '\0';
+    }
+    *total = strtoul(p, &end, 10);
+    return end != p && *end == '\0' && *last < *total;
+}
+
+esp_err_t ota_resume_accept(ota_resume_t *resume, int status, const char *content_range,
+                            const char *etag, int64_t content_length)
+{
+    if (status == 206 && resume->offset > 0) {
+        size_t first, last, total;
+        if (ota_resume_parse_content_range(content_range, &first, &last, &total) &&
+            first == resume->offset && total == resume->saved.image_size) {
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Unexpected range \"%s\" for offset %u, starting over",
+                 content_range ? content_range : "", (unsigned)resume->offset);
+    } else if (status == 200) {
+        if (resume->offset > 0) {
+            ESP_LOGI(TAG, "Image changed on the server, starting over");
+        }
+        session_restart(resume);
+        resume->saved.offset = 0;
+        resume->saved.image_size = content_length > 0 ? (uint32_t)content_length : 0;
+        resume->saved.etag[0] = '\0';
+        if (etag && strlen(etag) < RESUME_ETAG_MAX) {
+            strcpy(resume->saved.etag, etag);
+        } else {
+            // Without an ETag a later session could splice two different images
+            ESP_LOGW(TAG, "No usable ETag, download cannot be resumed");
+        }
+        ota_resume_clear();
+        return ESP_OK;
+    }
+    session_restart(resume);
+    resume->saved.offset = 0;
+    ota_resume_clear();
+    return ESP_ERR_INVALID_RESPONSE;
+}
+
+static void save_pending(ota_resume_t *resume, size_t flashed)
+{
+    if (!resume->pending || resume->pending_offset > flashed) {
+        return;
+    }
+    resume->pending = false;
+    if (resume->saved.etag[0] == '\0' || resume->saved.image_size == 0) {
+        return;
+    }
+    resume->saved.offset = resume->pending_offset;
+    memcpy(resume->saved.digest, resume->pending_digest, sizeof(resume->saved.digest));
+    checkpoint_save(&resume->saved);
+    ESP_LOGD(TAG, "Checkpoint at %u bytes", (unsigned)resume->pending_offset);
+}
+
+void ota_resume_update(ota_resume_t *resume, const void *data, size_t len, size_t flashed)
+{
+    const uint8_t *p = data;
+
+    while (len > 0) {
+        // Hash up to the next checkpoint boundary, then snapshot the digest there
+        size_t to_boundary = OTA_CHECKPOINT_INTERVAL - (resume->offset % OTA_CHECKPOINT_INTERVAL);
+        size_t n = len < to_boundary ? len : to_boundary;
+        mbedtls_sha256_update(&resume->sha, p, n);
+        resume->offset += n;
+        p += n;
+        len -= n;
+
+        if (resume->offset % OTA_CHECKPOINT_INTERVAL == 0) {
+            mbedtls_sha256_context copy;
+            mbedtls_sha256_init(&copy);
+            mbedtls_sha256_clone(&copy, &resume->sha);
+            mbedtls_sha256_finish(&copy, resume->pending_digest);
+            mbedtls_sha256_free(&copy);
+            resume->pending_offset = resume->offset;
+            resume->pending = true;
+        }
+    }
+    save_pending(resume, flashed);
+}
+
+void ota_resume_checkpoint(ota_resume_t *resume, size_t flashed)
+{
+    save_pending(resume, flashed);
+}
+
+void ota_resume_free(ota_resume_t *resume)
+{
+    if (resume) {
+        mbedtls_sha256_free(&resume->sha);
+        free(resume);
+    }
+}
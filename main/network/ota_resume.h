@@ -0,0 +1,109 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Checkpoints of a plain-image download, kept in NVS across reboots
+ *
+ * While the image streams into the inactive slot, every
+ * OTA_CHECKPOINT_INTERVAL bytes that have reached flash are recorded with
+ * the SHA-256 of everything before them and the server's ETag. A later
+ * session re-hashes that prefix from flash, and if it still matches asks
+ * for the rest with Range and If-Range. If the file changed on the server,
+ * the server answers 200 and the download starts over.
+ *
+ * Offsets are image offsets, so this only fits downloads that are written
+ * to flash as received (not patches or compressed images).
+ */
+typedef struct ota_resume ota_resume_t;
+
+/**
+ * @brief Whether NVS holds a checkpoint (not yet checked against flash)
+ * @param offset Set to the checkpointed byte count if not NULL
+ * @param image_size Set to the image size if not NULL
+ */
+bool ota_resume_available(size_t *offset, size_t *image_size);
+
+/**
+ * @brief Start a session for a download into partition
+ *
+ * Loads the checkpoint for this partition and re-hashes the prefix it
+ * covers; a checkpoint whose prefix no longer matches flash is dropped.
+ * @return Session, offset 0 if there is nothing to resume, or NULL if out of memory
+ */
+ota_resume_t *ota_resume_start(const esp_partition_t *partition);
+
+/**
+ * @brief Image bytes already in flash: where the next request should start
+ */
+size_t ota_resume_offset(const ota_resume_t *resume);
+
+/**
+ * @brief ETag the checkpoint was made against, for If-Range ("" if none)
+ */
+const char *ota_resume_etag(const ota_resume_t *resume);
+
+/**
+ * @brief Check the server's answer to a request from ota_resume_offset()
+ *
+ * 206 with a Content-Range starting at the offset continues the download.
+ * 200 means the whole file follows: the session restarts at 0 under the
+ * new ETag.
+ * @param status HTTP status
+ * @param content_range Content-Range header, or NULL
+ * @param etag ETag header, or NULL
+ * @param content_length Content-Length of this response
+ * @return ESP_OK to stream the body from ota_resume_offset(),
+ *         ESP_ERR_INVALID_RESPONSE if the body cannot be used (the
+ *         checkpoint is dropped; ask again from 0)
+ */
+esp_err_t ota_resume_accept(ota_resume_t *resume, int status, const char *content_range,
+                            const char *etag, int64_t content_length);
+
+/**
+ * @brief Total image size, from the response ota_resume_accept() took
+ */
+size_t ota_resume_image_size(const ota_resume_t *resume);
+
+/**
+ * @brief Account for the next image bytes, in order
+ * @param resume Session
+ * @param data Bytes passed on to flash
+ * @param len Byte count
+ * @param flashed Image bytes known to be in flash; a checkpoint at or
+ *                below it is saved to NVS
+ */
+void ota_resume_update(ota_resume_t *resume, const void *data, size_t len, size_t flashed);
+
+/**
+ * @brief Save the last checkpoint at or below flashed (after a failure)
+ */
+void ota_resume_checkpoint(ota_resume_t *resume, size_t flashed);
+
+/**
+ * @brief Erase the checkpoint (the image was completed or rejected)
+ */
+void ota_resume_clear(void);
+
+/**
+ * @brief Free a session (the checkpoint in NVS stays)
+ */
+void ota_resume_free(ota_resume_t *resume);
+
+/**
+ * @brief Parse "bytes <first>-<last>/<total>" ("*" total gives 0)
+ * @return true if content_range is well formed
+ */
+bool ota_resume_parse_content_range(const char *content_range, size_t *first, size_t *last, size_t *total);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,146 @@
+#include "ota_writer.h"
+#include "../app_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ota_writer";
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} write_buf_t;
+
+struct ota_writer {
+    esp_ota_handle_t ota_handle;
+    QueueHandle_t full;             // Buffers waiting for flash (NULL = stop)
+    QueueHandle_t free;             // Buffers ready to be filled
+    SemaphoreHandle_t stopped;
+    write_buf_t bufs[OTA_WRITE_BUFFERS];
+    write_buf_t *filling;
+    volatile esp_err_t err;         // First flash error, set by the writer task
+    volatile size_t flashed;        // Bytes written so far, set by the writer task
+};
+
+static void writer_task(void *param)
+{
+    ota_writer_t *writer = param;
+    write_buf_t *buf;
+
+    while (xQueueReceive(writer->full, &buf, portMAX_DELAY) == pdTRUE && buf != NULL) {
+        if (writer->err == ESP_OK) {
+            esp_err_t err = esp_ota_write(writer->ota_handle, buf->data, buf->len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(err));
+                writer->err = err;
+            } else {
+                writer->flashed += buf->len;
+            }
+        }
+        buf->len = 0;
+        xQueueSend(writer->free, &buf, portMAX_DELAY);
+    }
+    xSemaphoreGive(writer->stopped);
+    vTaskDelete(NULL);
+}
+
+static void writer_free(ota_writer_t *writer)
+{
+    for (int i = 0; i < OTA_WRITE_BUFFERS; i++) {
+        free(writer->bufs[i].data);
+    }
+    if (writer->full) {
+        vQueueDelete(writer->full);
+    }
+    if (writer->free) {
+        vQueueDelete(writer->free);
+    }
+    if (writer->stopped) {
+        vSemaphoreDelete(writer->stopped);
+    }
+    free(writer);
+}
+
+ota_writer_t *ota_writer_start(esp_ota_handle_t ota_handle)
+{
+    ota_writer_t *writer = calloc(1, sizeof(ota_writer_t));
+    if (!writer) {
+        return NULL;
+    }
+    writer->ota_handle = ota_handle;
+    writer->full = xQueueCreate(OTA_WRITE_BUFFERS + 1, sizeof(write_buf_t *));
+    writer->free = xQueueCreate(OTA_WRITE_BUFFERS, sizeof(write_buf_t *));
+    writer->stopped = xSemaphoreCreateBinary();
+    bool ok = writer->full && writer->free && writer->stopped;
+    for (int i = 0; ok && i < OTA_WRITE_BUFFERS; i++) {
+        writer->bufs[i].data = malloc(OTA_WRITE_BUF_SIZE);
+        ok = writer->bufs[i].data != NULL;
+    }
+    if (!ok) {
+        writer_free(writer);
+        return NULL;
+    }
+
+    writer->filling = &writer->bufs[0];
+    for (int i = 1; i < OTA_WRITE_BUFFERS; i++) {
+        write_buf_t *buf = &writer->bufs[i];
+        xQueueSend(writer->free, &buf, 0);
+    }
+    if (xTaskCreate(writer_task, "ota_writer", OTA_WRITER_TASK_STACK_SIZE, writer,
+                    uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        writer_free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+esp_err_t ota_writer_write(ota_writer_t *writer, const void *data, size_t len)
+{
+    const uint8_t *src = data;
+
+    while (len > 0) {
+        if (writer->err != ESP_OK) {
+            return writer->err;
+        }
+        size_t n = OTA_WRITE_BUF_SIZE - writer->filling->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(writer->filling->data + writer->filling->len, src, n);
+        writer->filling->len += n;
+        src += n;
+        len -= n;
+
+        if (writer->filling->len == OTA_WRITE_BUF_SIZE) {
+            // Hand the full buffer to flash; wait only if no other is free
+            xQueueSend(writer->full, &writer->filling, portMAX_DELAY);
+            xQueueReceive(writer->free, &writer->filling, portMAX_DELAY);
+        }
+    }
+    return writer->err;
+}
+
+size_t ota_writer_flashed(const ota_writer_t *writer)
+{
+    return writer->flashed;
+}
+
+esp_err_t ota_writer_finish(ota_writer_t *writer)
+{
+    write_buf_t *stop = NULL;
+
+    if (writer->filling->len > 0) {
+        xQueueSend(writer->full, &writer->filling, portMAX_DELAY);
+    }
+    xQueueSend(writer->full, &stop, portMAX_DELAY);
+    xSemaphoreTake(writer->stopped, portMAX_DELAY);
+
+    esp_err_t err = writer->err;
+    writer_free(writer);
+    return err;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Double-buffered writer into an OTA partition
+ *
+ * Flash erase and write run on their own task while the caller keeps
+ * receiving and decoding. Data is gathered into OTA_WRITE_BUF_SIZE buffers;
+ * with OTA_WRITE_BUFFERS of them one can be filled while the other is
+ * written. ota_writer_write() only blocks when every buffer is waiting
+ * for flash.
+ */
+typedef struct ota_writer ota_writer_t;
+
+/**
+ * @brief Start a writer for an OTA handle from esp_ota_begin()
+ * @param ota_handle Destination; stays owned by the caller
+ * @return Writer, or NULL if out of memory
+ */
+ota_writer_t *ota_writer_start(esp_ota_handle_t ota_handle);
+
+/**
+ * @brief Queue image bytes for flash
+ * @param writer Writer
+ * @param data Next bytes of the image
+ * @param len Byte count
+ * @return ESP_OK, or the first error esp_ota_write() returned
+ */
+esp_err_t ota_writer_write(ota_writer_t *writer, const void *data, size_t len);
+
+/**
+ * @brief Bytes esp_ota_write() has accepted so far (may lag ota_writer_write)
+ */
+size_t ota_writer_flashed(const ota_writer_t *writer);
+
+/**
+ * @brief Write out what is still buffered, stop the task and free the writer
+ * @param writer Writer
+ * @return ESP_OK if every byte reached flash, otherwise the first error
+ */
+esp_err_t ota_writer_finish(ota_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
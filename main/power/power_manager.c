@@ -11,28 +11,37 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/timers.h"
+#include <stdatomic.h>
+#include <string.h>
 
 static const char *TAG = "power_manager";
 
-// Maximum number of state change callbacks
-#define MAX_CALLBACKS 5
+// Maximum number of state change subscribers
+#define MAX_SUBSCRIBERS 5
+
+// Power task notification bits: a deadline passed, or activity while not active
+#define POWER_EVENT_DEADLINE        (1u << 0)
+#define POWER_EVENT_WAKE(source)    (1u << (1 + (source)))
 
 // Power management context
 typedef struct {
-    power_state_t current_state;
+    _Atomic power_state_t current_state;
     power_state_t previous_state;
-    int64_t last_activity_us;
+    atomic_uint_least32_t last_activity_ms;   // 32-bit so storing it needs no lock
     power_config_t config;
     
     // Thread safety
     SemaphoreHandle_t state_mutex;
     
-    // FreeRTOS timer for state management
+    // One-shot FreeRTOS timer, armed for the next dim/off deadline
     TimerHandle_t state_timer;
     
-    // State change callbacks
-    power_state_cb_t callbacks[MAX_CALLBACKS];
-    uint8_t callback_count;
+    // Makes the transitions the timer and wakes ask for
+    TaskHandle_t power_task;
+    
+    // One queue per state change subscriber
+    QueueHandle_t subscribers[MAX_SUBSCRIBERS];
+    uint8_t subscriber_count;
     
     // Initialization flag
     bool initialized;
@@ -42,9 +51,16 @@ static power_context_t ctx = {0};
 
 // Forward declarations
 static void power_timer_callback(TimerHandle_t timer);
+static void power_task(void *arg);
 static esp_err_t transition_to_state(power_state_t new_state);
+static void arm_next_transition(uint32_t activity_ms);
 static const char* state_to_string(power_state_t state);
 
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
 const char* wake_source_to_string(wake_source_t source) {
     switch (source) {
         case WAKE_SOURCE_TOUCH: return "Touch";
@@ -75,8 +91,8 @@ esp_err_t power_manager_init(const power_config_t *config)
     ctx.config = *config;
     ctx.current_state = POWER_STATE_ACTIVE;
     ctx.previous_state = POWER_STATE_ACTIVE;
-    ctx.last_activity_us = esp_timer_get_time();
-    ctx.callback_count = 0;
+    atomic_store(&ctx.last_activity_ms, now_ms());
+    ctx.subscriber_count = 0;
     
     // Create mutex for thread safety
     ctx.state_mutex = xSemaphoreCreateMutex();
@@ -85,11 +101,12 @@ esp_err_t power_manager_init(const power_config_t *config)
         return ESP_ERR_NO_MEM;
     }
     
-    // Create FreeRTOS timer for power state management
+    // Create FreeRTOS timer for power state management; the period is
+    // replaced with the time to the next deadline each time it is armed
     ctx.state_timer = xTimerCreate(
         "power_timer",
-        pdMS_TO_TICKS(1000),  // 1 second period
-        pdTRUE,               // Auto-reload
+        pdMS_TO_TICKS(config->dim_timeout_ms) + 1,
+        pdFALSE,              // One-shot
         NULL,                 // Timer ID (unused)
         power_timer_callback  // Callback function
     );
@@ -109,9 +126,19 @@ esp_err_t power_manager_init(const power_config_t *config)
         return ret;
     }
     
+    if (xTaskCreate(power_task, "power_task", POWER_TASK_STACK_SIZE, NULL,
+                    POWER_TASK_PRIORITY, &ctx.power_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create power task");
+        display_power_deinit();
+        vSemaphoreDelete(ctx.state_mutex);
+        xTimerDelete(ctx.state_timer, 0);
+        return ESP_ERR_NO_MEM;
+    }
+    
     // Start the power timer
     if (xTimerStart(ctx.state_timer, pdMS_TO_TICKS(100)) != pdPASS) {
         ESP_LOGE(TAG, "Failed to start power timer");
+        vTaskDelete(ctx.power_task);
         display_power_deinit();
         vSemaphoreDelete(ctx.state_mutex);
         xTimerDelete(ctx.state_timer, 0);
@@ -128,33 +155,42 @@ esp_err_t power_manager_init(const power_config_t *config)
     return ESP_OK;
 }
 
-esp_err_t power_manager_register_state_callback(power_state_cb_t callback)
+esp_err_t power_manager_subscribe(QueueHandle_t *queue)
 {
     if (!ctx.initialized) {
         ESP_LOGE(TAG, "Power manager not initialized");
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (callback == NULL) {
-        ESP_LOGE(TAG, "Callback cannot be NULL");
+    if (queue == NULL) {
+        ESP_LOGE(TAG, "Queue cannot be NULL");
         return ESP_ERR_INVALID_ARG;
     }
     
+    QueueHandle_t events = xQueueCreate(POWER_EVENT_QUEUE_LEN, sizeof(power_state_event_t));
+    if (events == NULL) {
+        ESP_LOGE(TAG, "Failed to create subscriber queue");
+        return ESP_ERR_NO_MEM;
+    }
+    
     if (xSemaphoreTake(ctx.state_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        ESP_LOGE(TAG, "Failed to acquire mutex for callback registration");
+        ESP_LOGE(TAG, "Failed to acquire mutex for subscription");
+        vQueueDelete(events);
         return ESP_ERR_TIMEOUT;
     }
     
-    if (ctx.callback_count >= MAX_CALLBACKS) {
+    if (ctx.subscriber_count >= MAX_SUBSCRIBERS) {
         xSemaphoreGive(ctx.state_mutex);
-        ESP_LOGE(TAG, "Maximum number of callbacks reached");
+        ESP_LOGE(TAG, "Maximum number of subscribers reached");
+        vQueueDelete(events);
         return ESP_ERR_NO_MEM;
     }
     
-    ctx.callbacks[ctx.callback_count++] = callback;
+    ctx.subscribers[ctx.subscriber_count++] = events;
     xSemaphoreGive(ctx.state_mutex);
     
-    ESP_LOGI(TAG, "Registered state callback #%d", ctx.callback_count);
+    *queue = events;
+    ESP_LOGI(TAG, "Added state subscriber #%d", ctx.subscriber_count);
     return ESP_OK;
 }
 
@@ -164,18 +200,17 @@ void power_manager_reset_activity(wake_source_t source)
         return;
     }
     
-    int64_t now = esp_timer_get_time();
-    int64_t old_time = ctx.last_activity_us;
-    ctx.last_activity_us = now;
-    
-    ESP_LOGI(TAG, "Activity reset by %s (idle was %.1fs)",
-             wake_source_to_string(source),
-             (now - old_time) / 1000000.0);
-    
-    // If we were dimmed or off, transition back to active
-    if (ctx.current_state != POWER_STATE_ACTIVE) {
-        transition_to_state(POWER_STATE_ACTIVE);
+    // Called on every touch event, so while active this is only a store: the
+    // armed timer finds the later activity when it fires and re-arms.
+    // The power task reads the time again after each transition, so activity
+    // racing a dim still brings the display back.
+    atomic_store(&ctx.last_activity_ms, now_ms());
+    if (atomic_load(&ctx.current_state) == POWER_STATE_ACTIVE) {
+        return;
     }
+    
+    // Dimmed or off: the power task transitions back to active
+    xTaskNotify(ctx.power_task, POWER_EVENT_WAKE(source), eSetBits);
 }
 
 power_state_t power_manager_get_state(void)
@@ -220,8 +255,7 @@ uint32_t power_manager_get_idle_time_ms(void)
         return 0;
     }
     
-    int64_t now = esp_timer_get_time();
-    return (uint32_t)((now - ctx.last_activity_us) / 1000);
+    return now_ms() - atomic_load(&ctx.last_activity_ms);
 }
 
 esp_err_t power_manager_force_state(power_state_t state)
@@ -231,7 +265,10 @@ esp_err_t power_manager_force_state(power_state_t state)
     }
     
     ESP_LOGW(TAG, "Forcing state transition to %s", state_to_string(state));
-    return transition_to_state(state);
+    esp_err_t ret = transition_to_state(state);
+    // Idle time takes over again at the next deadline
+    arm_next_transition(atomic_load(&ctx.last_activity_ms));
+    return ret;
 }
 
 void power_manager_deinit(void)
@@ -249,9 +286,18 @@ void power_manager_deinit(void)
         ctx.state_timer = NULL;
     }
     
+    if (ctx.power_task) {
+        vTaskDelete(ctx.power_task);
+        ctx.power_task = NULL;
+    }
+    
     // Cleanup display power
     display_power_deinit();
     
+    for (uint8_t i = 0; i < ctx.subscriber_count; i++) {
+        vQueueDelete(ctx.subscribers[i]);
+    }
+    
     // Delete mutex
     if (ctx.state_mutex) {
         vSemaphoreDelete(ctx.state_mutex);
@@ -278,9 +324,6 @@ static esp_err_t transition_to_state(power_state_t new_state)
         return ESP_OK; // No change needed
     }
     
-    ESP_LOGI(TAG, "State transition: %s -> %s", 
-             state_to_string(old_state), state_to_string(new_state));
-    
     // Update state
     ctx.previous_state = old_state;
     ctx.current_state = new_state;
@@ -302,53 +345,98 @@ static esp_err_t transition_to_state(power_state_t new_state)
             break;
     }
     
+    // Post to every subscriber without waiting: the mutex is held only this long
+    const power_state_event_t event = { .old_state = old_state, .new_state = new_state };
+    int dropped = 0;
+    for (uint8_t i = 0; i < ctx.subscriber_count; i++) {
+        if (xQueueSend(ctx.subscribers[i], &event, 0) != pdTRUE) {
+            dropped++;
+        }
+    }
+    
+    xSemaphoreGive(ctx.state_mutex);
+    
+    ESP_LOGI(TAG, "State transition: %s -> %s", 
+             state_to_string(old_state), state_to_string(new_state));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to update display for state %s: %s", 
                  state_to_string(new_state), esp_err_to_name(ret));
     }
-    
-    // Notify all registered callbacks
-    for (uint8_t i = 0; i < ctx.callback_count; i++) {
-        if (ctx.callbacks[i]) {
-            ctx.callbacks[i](old_state, new_state);
-        }
+    if (dropped > 0) {
+        ESP_LOGW(TAG, "%d subscriber(s) too far behind for the %s event", dropped, state_to_string(new_state));
     }
-    
-    xSemaphoreGive(ctx.state_mutex);
     return ret;
 }
 
-static void power_timer_callback(TimerHandle_t timer)
+// State machine: where idle_ms of inactivity leads
+static power_state_t state_for_idle(uint32_t idle_ms)
 {
-    if (!ctx.initialized) {
+    if (idle_ms >= ctx.config.off_timeout_ms) {
+        return POWER_STATE_OFF;
+    } else if (idle_ms >= ctx.config.dim_timeout_ms) {
+        return POWER_STATE_DIM;
+    }
+    return POWER_STATE_ACTIVE;
+}
+
+// Arm the timer for the next dim/off deadline after activity at activity_ms,
+// or stop it if the display is already off: no wakeups until the next activity
+static void arm_next_transition(uint32_t activity_ms)
+{
+    uint32_t idle_ms = now_ms() - activity_ms;
+    uint32_t deadline_ms;
+    if (idle_ms < ctx.config.dim_timeout_ms) {
+        deadline_ms = ctx.config.dim_timeout_ms;
+    } else if (idle_ms < ctx.config.off_timeout_ms) {
+        deadline_ms = ctx.config.off_timeout_ms;
+    } else {
+        xTimerStop(ctx.state_timer, 0);
         return;
     }
+    // Round up so the timer never fires before the deadline
+    TickType_t ticks = (deadline_ms - idle_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    if (xTimerChangePeriod(ctx.state_timer, ticks > 0 ? ticks : 1, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to arm power timer");
+    }
+}
+
+// Bring the state in line with the idle time and arm the next deadline
+static void update_state(void)
+{
+    // Activity may land while transitioning; evaluate again if it did
+    uint32_t activity_ms;
+    do {
+        activity_ms = atomic_load(&ctx.last_activity_ms);
+        power_state_t target_state = state_for_idle(now_ms() - activity_ms);
+        if (target_state != ctx.current_state) {
+            transition_to_state(target_state);
+        }
+    } while (activity_ms != atomic_load(&ctx.last_activity_ms));
     
-    uint32_t idle_time_ms = power_manager_get_idle_time_ms();
-    
-    // State machine logic
-    power_state_t target_state = ctx.current_state;
+    arm_next_transition(activity_ms);
+}
+
+static void power_task(void *arg)
+{
+    uint32_t events;
     
-    if (idle_time_ms >= ctx.config.off_timeout_ms) {
-        target_state = POWER_STATE_OFF;
-    } else if (idle_time_ms >= ctx.config.dim_timeout_ms) {
-        target_state = POWER_STATE_DIM;
-    } else {
-        target_state = POWER_STATE_ACTIVE;
+    while (1) {
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+        if (events & ~POWER_EVENT_DEADLINE) {
+            ESP_LOGI(TAG, "Woken by %s", wake_source_to_string(__builtin_ctz(events >> 1)));
+        }
+        update_state();
     }
-    
-    // Transition if state should change
-    if (target_state != ctx.current_state) {
-        transition_to_state(target_state);
+}
+
+// Runs in the timer service task: hand the transition to the power task
+static void power_timer_callback(TimerHandle_t timer)
+{
+    if (!ctx.initialized) {
+        return;
     }
     
-    // Periodic logging (every 10 seconds)
-    static uint8_t log_counter = 0;
-    if (++log_counter >= 10) {
-        ESP_LOGI(TAG, "State: %s, Idle: %.1fs", 
-                 state_to_string(ctx.current_state), idle_time_ms / 1000.0);
-        log_counter = 0;
-    }
+    xTaskNotify(ctx.power_task, POWER_EVENT_DEADLINE, eSetBits);
 }
 
 static const char* state_to_string(power_state_t state)
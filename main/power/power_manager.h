@@ -1,6 +1,8 @@
 #pragma once
 
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -44,11 +46,12 @@ typedef struct {
 } power_config_t;
 
 /**
- * @brief Callback function for power state changes
- * @param old_state Previous power state
- * @param new_state New power state
+ * @brief Power state change, as posted to subscribers
  */
-typedef void (*power_state_cb_t)(power_state_t old_state, power_state_t new_state);
+typedef struct {
+    power_state_t old_state;        /**< Previous power state */
+    power_state_t new_state;        /**< New power state */
+} power_state_event_t;
 
 /**
  * @brief Initialize power management system
@@ -58,11 +61,16 @@ typedef void (*power_state_cb_t)(power_state_t old_state, power_state_t new_stat
 esp_err_t power_manager_init(const power_config_t *config);
 
 /**
- * @brief Register callback for power state changes
- * @param callback Callback function to register
+ * @brief Subscribe to power state changes
+ *
+ * Every transition posts a power_state_event_t to the returned queue without
+ * blocking; the subscriber drains it from its own task. A subscriber more than
+ * POWER_EVENT_QUEUE_LEN events behind misses the newer ones. The queue is
+ * deleted by power_manager_deinit().
+ * @param queue Set to the subscriber's queue
  * @return ESP_OK on success, error code on failure
  */
-esp_err_t power_manager_register_state_callback(power_state_cb_t callback);
+esp_err_t power_manager_subscribe(QueueHandle_t *queue);
 
 /**
  * @brief Reset activity timer (wake up system)
@@ -0,0 +1,319 @@
+#include "image_placeholder.h"
+
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "image_placeholder";
+
+// BlurHash supports up to 9x9 components
+#define MAX_COMPONENTS          9
+
+static const char BASE83_CHARS[] =
+    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~";
+
+// sRGB (0-255) to linear light, Q12
+static const uint16_t srgb_to_linear_q12[256] = {
+       0,    1,    2,    4,    5,    6,    7,    9,   10,   11,   12,   14,
+      15,   16,   18,   20,   21,   23,   25,   27,   29,   31,   33,   35,
+      37,   40,   42,   45,   48,   50,   53,   56,   59,   62,   66,   69,
+      72,   76,   79,   83,   87,   91,   95,   99,  103,  107,  112,  116,
+     121,  126,  131,  136,  141,  146,  151,  156,  162,  168,  173,  179,
+     185,  191,  197,  204,  210,  217,  223,  230,  237,  244,  251,  258,
+     265,  273,  280,  288,  296,  304,  312,  320,  329,  337,  346,  354,
+     363,  372,  381,  390,  400,  409,  419,  429,  438,  448,  458,  469,
+     479,  490,  500,  511,  522,  533,  544,  556,  567,  579,  590,  602,
+     614,  626,  639,  651,  664,  676,  689,  702,  715,  729,  742,  756,
+     769,  783,  797,  811,  826,  840,  855,  869,  884,  899,  914,  930,
+     945,  961,  976,  992, 1008, 1025, 1041, 1058, 1074, 1091, 1108, 1125,
+    1142, 1160, 1177, 1195, 1213, 1231, 1249, 1268, 1286, 1305, 1324, 1343,
+    1362, 1381, 1400, 1420, 1440, 1460, 1480, 1500, 1521, 1541, 1562, 1583,
+    1604, 1625, 1647, 1668, 1690, 1712, 1734, 1756, 1778, 1801, 1824, 1846,
+    1869, 1893, 1916, 1940, 1963, 1987, 2011, 2035, 2060, 2084, 2109, 2134,
+    2159, 2184, 2210, 2235, 2261, 2287, 2313, 2339, 2366, 2392, 2419, 2446,
+    2473, 2501, 2528, 2556, 2584, 2612, 2640, 2668, 2697, 2725, 2754, 2783,
+    2813, 2842, 2872, 2902, 2931, 2962, 2992, 3022, 3053, 3084, 3115, 3146,
+    3178, 3209, 3241, 3273, 3305, 3338, 3370, 3403, 3436, 3469, 3502, 3535,
+    3569, 3603, 3637, 3671, 3705, 3740, 3775, 3810, 3845, 3880, 3916, 3951,
+    3987, 4023, 4060, 4096,
+};
+
+// Linear light (Q12) to sRGB (0-255) below 256, where the curve is too steep for the table below
+static const uint8_t linear_to_srgb_low[256] = {
+      0,   1,   2,   2,   3,   4,   5,   6,   6,   7,   8,   9,  10,  10,  11,  12,
+     13,  13,  14,  15,  15,  16,  16,  17,  18,  18,  19,  19,  20,  20,  21,  21,
+     22,  22,  23,  23,  23,  24,  24,  25,  25,  25,  26,  26,  27,  27,  27,  28,
+     28,  29,  29,  29,  30,  30,  30,  31,  31,  31,  32,  32,  32,  33,  33,  33,
+     34,  34,  34,  34,  35,  35,  35,  36,  36,  36,  36,  37,  37,  37,  38,  38,
+     38,  38,  39,  39,  39,  40,  40,  40,  40,  41,  41,  41,  41,  42,  42,  42,
+     42,  43,  43,  43,  43,  43,  44,  44,  44,  44,  45,  45,  45,  45,  46,  46,
+     46,  46,  46,  47,  47,  47,  47,  48,  48,  48,  48,  48,  49,  49,  49,  49,
+     49,  50,  50,  50,  50,  50,  51,  51,  51,  51,  51,  52,  52,  52,  52,  52,
+     53,  53,  53,  53,  53,  54,  54,  54,  54,  54,  55,  55,  55,  55,  55,  55,
+     56,  56,  56,  56,  56,  57,  57,  57,  57,  57,  57,  58,  58,  58,  58,  58,
+     58,  59,  59,  59,  59,  59,  59,  60,  60,  60,  60,  60,  60,  61,  61,  61,
+     61,  61,  61,  62,  62,  62,  62,  62,  62,  63,  63,  63,  63,  63,  63,  64,
+     64,  64,  64,  64,  64,  64,  65,  65,  65,  65,  65,  65,  66,  66,  66,  66,
+     66,  66,  66,  67,  67,  67,  67,  67,  67,  67,  68,  68,  68,  68,  68,  68,
+     68,  69,  69,  69,  69,  69,  69,  69,  70,  70,  70,  70,  70,  70,  70,  71,
+};
+
+// Linear light (Q12 >> 2) to sRGB (0-255)
+static const uint8_t linear_to_srgb[1024] = {
+      0,   5,   8,  11,  14,  16,  19,  21,  23,  24,  26,  27,  29,  30,  32,  33,
+     34,  35,  36,  38,  39,  40,  41,  42,  43,  44,  45,  46,  46,  47,  48,  49,
+     50,  51,  51,  52,  53,  54,  55,  55,  56,  57,  57,  58,  59,  59,  60,  61,
+     61,  62,  63,  63,  64,  65,  65,  66,  66,  67,  68,  68,  69,  69,  70,  70,
+     71,  72,  72,  73,  73,  74,  74,  75,  75,  76,  76,  77,  77,  78,  78,  79,
+     79,  80,  80,  81,  81,  82,  82,  83,  83,  83,  84,  84,  85,  85,  86,  86,
+     87,  87,  87,  88,  88,  89,  89,  90,  90,  90,  91,  91,  92,  92,  92,  93,
+     93,  94,  94,  94,  95,  95,  96,  96,  96,  97,  97,  97,  98,  98,  99,  99,
+     99, 100, 100, 100, 101, 101, 101, 102, 102, 103, 103, 103, 104, 104, 104, 105,
+    105, 105, 106, 106, 106, 107, 107, 107, 108, 108, 108, 109, 109, 109, 110, 110,
+    110, 111, 111, 111, 112, 112, 112, 112, 113, 113, 113, 114, 114, 114, 115, 115,
+    115, 116, 116, 116, 117, 117, 117, 117, 118, 118, 118, 119, 119, 119, 119, 120,
+    120, 120, 121, 121, 121, 121, 122, 122, 122, 123, 123, 123, 123, 124, 124, 124,
+    125, 125, 125, 125, 126, 126, 126, 127, 127, 127, 127, 128, 128, 128, 128, 129,
+    129, 129, 129, 130, 130, 130, 131, 131, 131, 131, 132, 132, 132, 132, 133, 133,
+    133, 133, 134, 134, 134, 134, 135, 135, 135, 135, 136, 136, 136, 136, 137, 137,
+    137, 137, 138, 138, 138, 138, 139, 139, 139, 139, 140, 140, 140, 140, 140, 141,
+    141, 141, 141, 142, 142, 142, 142, 143, 143, 143, 143, 144, 144, 144, 144, 144,
+    145, 145, 145, 145, 146, 146, 146, 146, 146, 147, 147, 147, 147, 148, 148, 148,
+    148, 149, 149, 149, 149, 149, 150, 150, 150, 150, 150, 151, 151, 151, 151, 152,
+    152, 152, 152, 152, 153, 153, 153, 153, 153, 154, 154, 154, 154, 155, 155, 155,
+    155, 155, 156, 156, 156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158,
+    158, 159, 159, 159, 159, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161, 162,
+    162, 162, 162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165,
+    165, 165, 165, 165, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 168, 168,
+    168, 168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 171, 171,
+    171, 171, 171, 171, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 173, 174,
+    174, 174, 174, 174, 175, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 177,
+    177, 177, 177, 177, 177, 178, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179,
+    180, 180, 180, 180, 180, 180, 181, 181, 181, 181, 181, 181, 182, 182, 182, 182,
+    182, 182, 183, 183, 183, 183, 183, 183, 184, 184, 184, 184, 184, 184, 185, 185,
+    185, 185, 185, 185, 186, 186, 186, 186, 186, 186, 187, 187, 187, 187, 187, 187,
+    188, 188, 188, 188, 188, 188, 189, 189, 189, 189, 189, 189, 190, 190, 190, 190,
+    190, 190, 191, 191, 191, 191, 191, 191, 191, 192, 192, 192, 192, 192, 192, 193,
+    193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 194, 194, 195, 195, 195, 195,
+    195, 195, 196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 197, 198,
+    198, 198, 198, 198, 198, 198, 199, 199, 199, 199, 199, 199, 200, 200, 200, 200,
+    200, 200, 200, 201, 201, 201, 201, 201, 201, 202, 202, 202, 202, 202, 202, 202,
+    203, 203, 203, 203, 203, 203, 203, 204, 204, 204, 204, 204, 204, 204, 205, 205,
+    205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 206, 207, 207, 207, 207, 207,
+    207, 207, 208, 208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209, 209,
+    210, 210, 210, 210, 210, 210, 210, 211, 211, 211, 211, 211, 211, 211, 211, 212,
+    212, 212, 212, 212, 212, 212, 213, 213, 213, 213, 213, 213, 213, 214, 214, 214,
+    214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 215, 216, 216, 216, 216,
+    216, 216, 216, 217, 217, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218, 218,
+    218, 218, 219, 219, 219, 219, 219, 219, 219, 220, 220, 220, 220, 220, 220, 220,
+    220, 221, 221, 221, 221, 221, 221, 221, 222, 222, 222, 222, 222, 222, 222, 222,
+    223, 223, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 224, 224, 224, 225,
+    225, 225, 225, 225, 225, 225, 225, 226, 226, 226, 226, 226, 226, 226, 226, 227,
+    227, 227, 227, 227, 227, 227, 227, 228, 228, 228, 228, 228, 228, 228, 229, 229,
+    229, 229, 229, 229, 229, 229, 230, 230, 230, 230, 230, 230, 230, 230, 231, 231,
+    231, 231, 231, 231, 231, 231, 232, 232, 232, 232, 232, 232, 232, 232, 233, 233,
+    233, 233, 233, 233, 233, 233, 234, 234, 234, 234, 234, 234, 234, 234, 234, 235,
+    235, 235, 235, 235, 235, 235, 235, 236, 236, 236, 236, 236, 236, 236, 236, 237,
+    237, 237, 237, 237, 237, 237, 237, 238, 238, 238, 238, 238, 238, 238, 238, 238,
+    239, 239, 239, 239, 239, 239, 239, 239, 240, 240, 240, 240, 240, 240, 240, 240,
+    240, 241, 241, 241, 241, 241, 241, 241, 241, 242, 242, 242, 242, 242, 242, 242,
+    242, 242, 243, 243, 243, 243, 243, 243, 243, 243, 244, 244, 244, 244, 244, 244,
+    244, 244, 244, 245, 245, 245, 245, 245, 245, 245, 245, 246, 246, 246, 246, 246,
+    246, 246, 246, 246, 247, 247, 247, 247, 247, 247, 247, 247, 247, 248, 248, 248,
+    248, 248, 248, 248, 248, 248, 249, 249, 249, 249, 249, 249, 249, 249, 250, 250,
+    250, 250, 250, 250, 250, 250, 250, 251, 251, 251, 251, 251, 251, 251, 251, 251,
+    252, 252, 252, 252, 252, 252, 252, 252, 252, 253, 253, 253, 253, 253, 253, 253,
+    253, 253, 254, 254, 254, 254, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255,
+};
+
+// Quarter-wave sine, Q14: sin(i * pi / 256) for i = 0..128
+static const int16_t sin_q14[129] = {
+        0,   201,   402,   603,   804,  1005,  1205,  1406,  1606,  1806,
+     2006,  2205,  2404,  2603,  2801,  2999,  3196,  3393,  3590,  3786,
+     3981,  4176,  4370,  4563,  4756,  4948,  5139,  5330,  5520,  5708,
+     5897,  6084,  6270,  6455,  6639,  6823,  7005,  7186,  7366,  7545,
+     7723,  7900,  8076,  8250,  8423,  8595,  8765,  8935,  9102,  9269,
+     9434,  9598,  9760,  9921, 10080, 10238, 10394, 10549, 10702, 10853,
+    11003, 11151, 11297, 11442, 11585, 11727, 11866, 12004, 12140, 12274,
+    12406, 12537, 12665, 12792, 12916, 13039, 13160, 13279, 13395, 13510,
+    13623, 13733, 13842, 13949, 14053, 14155, 14256, 14354, 14449, 14543,
+    14635, 14724, 14811, 14896, 14978, 15059, 15137, 15213, 15286, 15357,
+    15426, 15493, 15557, 15619, 15679, 15736, 15791, 15843, 15893, 15941,
+    15986, 16029, 16069, 16107, 16143, 16176, 16207, 16235, 16261, 16284,
+    16305, 16324, 16340, 16353, 16364, 16373, 16379, 16383, 16384,
+};
+
+// sign(v) * v^2 for v = (q - 9) / 9, q = 0..18, Q14
+static const int16_t ac_sign_pow_q14[19] = {
+    -16384, -12945, -9911, -7282, -5057, -3236, -1820, -809, -202, 0,
+       202,    809,  1820,  3236,  5057,  7282,  9911, 12945, 16384,
+};
+
+static bool decode83(const char *str, int len, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int i = 0; i < len; i++) {
+        const char *p = strchr(BASE83_CHARS, str[i]);
+        if (str[i] == '\0' || p == NULL) {
+            return false;
+        }
+        result = result * 83 + (uint32_t)(p - BASE83_CHARS);
+    }
+    *value = result;
+    return true;
+}
+
+// Cosine for a phase where 512 units is one full turn, Q14
+static int32_t cos_table_q14(uint32_t phase)
+{
+    phase = (phase + 128) & 511;  // cos(x) = sin(x + pi/2)
+    if (phase <= 128) return sin_q14[phase];
+    if (phase <= 256) return sin_q14[256 - phase];
+    if (phase <= 384) return -sin_q14[phase - 256];
+    return -sin_q14[512 - phase];
+}
+
+// cos(pi * k / n), Q14; interpolates between table steps in 1/64ths
+static int32_t cos_pi_q14(uint32_t k, uint32_t n)
+{
+    uint32_t phase = ((k % (2 * n)) * (256 << 6) + n / 2) / n;
+    int32_t a = cos_table_q14(phase >> 6);
+    int32_t b = cos_table_q14((phase >> 6) + 1);
+    return a + (((b - a) * (int32_t)(phase & 63) + 32) >> 6);
+}
+
+static uint8_t linear_q12_to_srgb(int32_t value)
+{
+    if (value <= 0) return 0;
+    if (value >= 4096) return 255;
+    if (value < 256) return linear_to_srgb_low[value];
+    return linear_to_srgb[value >> 2];
+}
+
+esp_err_t image_placeholder_decode(const char *hash, uint16_t width, uint16_t height, uint8_t *out)
+{
+    if (!hash || !out || width == 0 || height == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t hash_len = strlen(hash);
+    uint32_t size_flag;
+    if (hash_len < 6 || !decode83(hash, 1, &size_flag)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int num_x = (size_flag % 9) + 1;
+    int num_y = (size_flag / 9) + 1;
+    if (hash_len != (size_t)(4 + 2 * num_x * num_y)) {
+        ESP_LOGW(TAG, "Invalid BlurHash length %u for %dx%d components", (unsigned)hash_len, num_x, num_y);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t quantised_max;
+    uint32_t dc;
+    if (!decode83(hash + 1, 1, &quantised_max) || !decode83(hash + 2, 4, &dc)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int32_t max_ac_q16 = (int32_t)(((quantised_max + 1) * 65536 + 83) / 166);
+
+    // Component colors in linear light, Q16: up to 81 terms are summed per
+    // pixel, and near black one Q12 unit is most of an sRGB step
+    int32_t colors[MAX_COMPONENTS * MAX_COMPONENTS][3];
+    colors[0][0] = srgb_to_linear_q12[(dc >> 16) & 0xFF] << 4;
+    colors[0][1] = srgb_to_linear_q12[(dc >> 8) & 0xFF] << 4;
+    colors[0][2] = srgb_to_linear_q12[dc & 0xFF] << 4;
+
+    for (int i = 1; i < num_x * num_y; i++) {
+        uint32_t ac;
+        if (!decode83(hash + 4 + i * 2, 2, &ac) || ac >= 19 * 19 * 19) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        colors[i][0] = (ac_sign_pow_q14[ac / (19 * 19)] * max_ac_q16) >> 14;
+        colors[i][1] = (ac_sign_pow_q14[(ac / 19) % 19] * max_ac_q16) >> 14;
+        colors[i][2] = (ac_sign_pow_q14[ac % 19] * max_ac_q16) >> 14;
+    }
+
+    // Horizontal basis is shared by every row, so compute it once
+    int16_t *cos_x = malloc(sizeof(int16_t) * num_x * width);
+    if (!cos_x) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < num_x; i++) {
+        for (int x = 0; x < width; x++) {
+            cos_x[i * width + x] = (int16_t)cos_pi_q14((uint32_t)x * i, width);
+        }
+    }
+
+    for (int y = 0; y < height; y++) {
+        // The basis is separable: fold the vertical cosines into per-row colors
+        int32_t row[MAX_COMPONENTS][3] = {0};
+        for (int j = 0; j < num_y; j++) {
+            int32_t cy = cos_pi_q14((uint32_t)y * j, height);
+            for (int i = 0; i < num_x; i++) {
+                const int32_t *c = colors[j * num_x + i];
+                row[i][0] += (c[0] * cy) >> 14;
+                row[i][1] += (c[1] * cy) >> 14;
+                row[i][2] += (c[2] * cy) >> 14;
+            }
+        }
+
+        for (int x = 0; x < width; x++) {
+            int64_t r = 0, g = 0, b = 0;
+            for (int i = 0; i < num_x; i++) {
+                int32_t cx = cos_x[i * width + x];
+                r += (int64_t)row[i][0] * cx;
+                g += (int64_t)row[i][1] * cx;
+                b += (int64_t)row[i][2] * cx;
+            }
+
+            // Q16 sums back to Q12, rounded
+            uint16_t rgb565 = ((linear_q12_to_srgb((int32_t)((r + (1 << 17)) >> 18)) >> 3) << 11) |
+                              ((linear_q12_to_srgb((int32_t)((g + (1 << 17)) >> 18)) >> 2) << 5) |
+                              (linear_q12_to_srgb((int32_t)((b + (1 << 17)) >> 18)) >> 3);
+
+            // Big-endian like the resolver's RGB565 images
+            *out++ = rgb565 >> 8;
+            *out++ = rgb565 & 0xFF;
+        }
+    }
+
+    free(cos_x);
+    return ESP_OK;
+}
+
+lv_img_dsc_t* image_placeholder_create_lvgl_img(const char *hash, uint16_t width, uint16_t height)
+{
+    size_t size = (size_t)width * height * 2;
+
+    lv_img_dsc_t *img_dsc = malloc(sizeof(lv_img_dsc_t));
+    if (!img_dsc) {
+        ESP_LOGE(TAG, "Failed to allocate placeholder descriptor");
+        return NULL;
+    }
+
+    uint8_t *img_data = malloc(size);
+    if (!img_data) {
+        ESP_LOGE(TAG, "Failed to allocate placeholder data buffer");
+        free(img_dsc);
+        return NULL;
+    }
+
+    esp_err_t err = image_placeholder_decode(hash, width, height, img_data);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to decode placeholder '%s': %s", hash, esp_err_to_name(err));
+        free(img_data);
+        free(img_dsc);
+        return NULL;
+    }
+
+    img_dsc->data = img_data;
+    img_dsc->data_size = size;
+    img_dsc->header.cf = LV_IMG_CF_TRUE_COLOR;  // RGB565 format
+    img_dsc->header.w = width;
+    img_dsc->header.h = height;
+    img_dsc->header.always_zero = 0;
+    img_dsc->header.reserved = 0;
+
+    ESP_LOGI(TAG, "Placeholder decoded: %dx%d from '%s'", width, height, hash);
+    return img_dsc;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "esp_err.h"
+#include "lvgl.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Decode a BlurHash string into big-endian RGB565 pixels
+ *
+ * Uses integer-only math (Q16 colors, interpolated Q14 cosine table) so the decode stays
+ * cheap on the FPU-less ESP32-C6. Output byte order matches the resolver's
+ * RGB565 images (LV_COLOR_16_SWAP).
+ *
+ * @param hash BlurHash string (e.g. 28 chars for 4x3 components)
+ * @param width Output width in pixels
+ * @param height Output height in pixels
+ * @param out Output buffer, at least width * height * 2 bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the hash is malformed
+ */
+esp_err_t image_placeholder_decode(const char *hash, uint16_t width, uint16_t height, uint8_t *out);
+
+/**
+ * @brief Create an LVGL RGB565 image descriptor from a BlurHash string
+ * @param hash BlurHash string from the lookup response
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @return LVGL image descriptor (free with image_downloader_free_lvgl_img) or NULL
+ */
+lv_img_dsc_t* image_placeholder_create_lvgl_img(const char *hash, uint16_t width, uint16_t height);
+
+#ifdef __cplusplus
+}
+#endif
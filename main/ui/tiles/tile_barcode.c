@@ -3,10 +3,14 @@
 #include "ui_theme.h"
 #include "barcode_manager.h"
 #include "network/mqtt_barcode.h"
+#include "network/coap_barcode.h"
 #include "network/image_downloader.h"
+#include "network/ota_manager.h"
+#include "image_placeholder.h"
 #include "app_config.h"
 #include "ui_manager.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
 
 static const char *TAG = "tile_barcode";
@@ -21,16 +25,60 @@ static lv_obj_t *product_model_label = NULL;
 static lv_obj_t *product_price_label = NULL;
 static lv_obj_t *mqtt_status_label = NULL;
 
-// Image state
+// Image state (holds the BlurHash placeholder until the real image arrives)
 static lv_img_dsc_t *current_img_dsc = NULL;
 
 // Current barcode being processed
 static char current_barcode[32] = {0};
+static int64_t scan_time_us = 0;
 
-// Function to update MQTT status dynamically
+// Scan-to-screen latency, tagged with what the OTA manager was doing meanwhile
+static void log_scan_latency(const char *what)
+{
+    int64_t elapsed_ms = (esp_timer_get_time() - scan_time_us) / 1000;
+    const char *ota = !ota_manager_is_in_progress() ? "idle" :
+                      ota_manager_is_background() ? "background" : "foreground";
+    if (elapsed_ms > SCAN_RESULT_BUDGET_MS) {
+        ESP_LOGW(TAG, "Scan to %s: %lld ms, over the %d ms budget (OTA %s)",
+                 what, elapsed_ms, SCAN_RESULT_BUDGET_MS, ota);
+    } else {
+        ESP_LOGI(TAG, "Scan to %s: %lld ms (OTA %s)", what, elapsed_ms, ota);
+    }
+}
+
+// Lookup transport, chosen at build time
+#if BARCODE_TRANSPORT_COAP
+#define TRANSPORT_NAME              "CoAP"
+#define transport_lookup            coap_barcode_lookup
+#define transport_is_connected      coap_barcode_is_connected
+#define transport_get_status        coap_barcode_get_status
+#else
+#define TRANSPORT_NAME              "MQTT"
+#define transport_lookup            mqtt_barcode_lookup
+#define transport_is_connected      mqtt_barcode_is_connected
+#define transport_get_status        mqtt_barcode_get_status
+#endif
+
+// Function to update transport status dynamically
 static void update_mqtt_status_label(void) {
     if (mqtt_status_label) {
-        lv_label_set_text_fmt(mqtt_status_label, "MQTT: %s", mqtt_barcode_get_status());
+        lv_label_set_text_fmt(mqtt_status_label, TRANSPORT_NAME ": %s", transport_get_status());
+    }
+}
+
+// Show an image in the product slot, releasing whatever was there before
+static void show_product_image(lv_img_dsc_t *img_dsc) {
+    lv_img_dsc_t *previous = current_img_dsc;
+    current_img_dsc = img_dsc;
+    
+    if (product_image) {
+        lv_obj_clear_flag(product_image, LV_OBJ_FLAG_HIDDEN);
+        lv_img_set_src(product_image, img_dsc);
+    }
+    
+    // Free only after the widget points at the new descriptor
+    if (previous) {
+        image_downloader_free_lvgl_img(previous);
     }
 }
 
@@ -41,6 +89,7 @@ static void image_download_callback(const image_download_result_t *result, void
     }
     
     ESP_LOGI(TAG, "Image download result: success=%d", result->success);
+    log_scan_latency("image");
     
     // Hide spinner now that download is complete (success or failure)
     if (image_spinner) {
@@ -51,18 +100,9 @@ static void image_download_callback(const image_download_result_t *result, void
         // Create LVGL image descriptor for RGB565 data (80x80 pixels)
         lv_img_dsc_t *img_dsc = image_downloader_create_lvgl_img(result->data, result->size, 80, 80);
         if (img_dsc) {
-            // Free previous image if any
-            if (current_img_dsc) {
-                image_downloader_free_lvgl_img(current_img_dsc);
-            }
-            current_img_dsc = img_dsc;
-            
-            // Show and update image widget
-            if (product_image) {
-                lv_obj_clear_flag(product_image, LV_OBJ_FLAG_HIDDEN);
-                lv_img_set_src(product_image, img_dsc);
-                ESP_LOGI(TAG, "RGB565 product image displayed");
-            }
+            // Replaces the placeholder, if one was shown
+            show_product_image(img_dsc);
+            ESP_LOGI(TAG, "RGB565 product image displayed");
         } else {
             ESP_LOGW(TAG, "Failed to create LVGL image descriptor");
             // Hide image widget if descriptor creation fails
@@ -86,6 +126,7 @@ static void mqtt_lookup_result_callback(const mqtt_barcode_result_t *result) {
     }
     
     ESP_LOGI(TAG, "MQTT lookup result: success=%d, barcode=%s", result->success, result->barcode);
+    log_scan_latency("result");
     
     // Update status
     if (status_label) {
@@ -131,10 +172,26 @@ static void mqtt_lookup_result_callback(const mqtt_barcode_result_t *result) {
             lv_label_set_text(product_price_label, result->price);
         }
         
+        // Show the BlurHash preview while the real image downloads
+        if (strlen(result->image_url) > 0 && strlen(result->placeholder) > 0) {
+            lv_img_dsc_t *placeholder_dsc = image_placeholder_create_lvgl_img(result->placeholder, 80, 80);
+            if (placeholder_dsc) {
+                show_product_image(placeholder_dsc);
+            }
+        }
+        
         // Download product image if available
         if (strlen(result->image_url) > 0) {
-            ESP_LOGI(TAG, "Downloading product image: %s", result->image_url);
-            esp_err_t err = image_downloader_download_async(result->image_url, image_download_callback, NULL);
+            esp_err_t err;
+            if (result->image_inline) {
+                // Resolver streams the image over the lookup transport; HTTP is only the fallback
+                ESP_LOGI(TAG, "Receiving product image inline for request %u", result->request_id);
+                err = image_downloader_receive_inline_async(result->request_id, result->image_url,
+                                                            image_download_callback, NULL);
+            } else {
+                ESP_LOGI(TAG, "Downloading product image: %s", result->image_url);
+                err = image_downloader_download_async(result->image_url, image_download_callback, NULL);
+            }
             if (err != ESP_OK) {
                 ESP_LOGW(TAG, "Failed to start image download: %s", esp_err_to_name(err));
                 // Hide spinner and image widget if download fails
@@ -188,6 +245,7 @@ static void barcode_received_callback(const barcode_data_t* barcode)
         
         // Store current barcode
         strncpy(current_barcode, barcode->data, sizeof(current_barcode) - 1);
+        scan_time_us = esp_timer_get_time();
         
         // Update barcode display
         if (barcode_label) {
@@ -222,13 +280,13 @@ static void barcode_received_callback(const barcode_data_t* barcode)
             lv_obj_clear_flag(image_spinner, LV_OBJ_FLAG_HIDDEN);
         }
         
-        // Check MQTT connection status
-        if (!mqtt_barcode_is_connected()) {
+        // Check transport connection status
+        if (!transport_is_connected()) {
             if (status_label) {
-                lv_label_set_text(status_label, "MQTT Disconnected");
+                lv_label_set_text(status_label, TRANSPORT_NAME " Disconnected");
                 lv_obj_set_style_text_color(status_label, ui_theme_get_error_text_color(), 0);
             }
-            ESP_LOGW(TAG, "MQTT not connected, cannot lookup barcode");
+            ESP_LOGW(TAG, TRANSPORT_NAME " not connected, cannot lookup barcode");
             return;
         }
         
@@ -238,13 +296,13 @@ static void barcode_received_callback(const barcode_data_t* barcode)
             lv_obj_set_style_text_color(status_label, ui_theme_get_muted_text_color(), 0);
         }
         
-        // Update MQTT status
+        // Update transport status
         update_mqtt_status_label();
         
-        // Start MQTT lookup
-        esp_err_t err = mqtt_barcode_lookup(barcode->data, mqtt_lookup_result_callback);
+        // Start lookup
+        esp_err_t err = transport_lookup(barcode->data, mqtt_lookup_result_callback);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to start MQTT lookup: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to start " TRANSPORT_NAME " lookup: %s", esp_err_to_name(err));
             if (status_label) {
                 lv_label_set_text(status_label, "Lookup Failed");
                 lv_obj_set_style_text_color(status_label, ui_theme_get_error_text_color(), 0);
@@ -332,9 +390,9 @@ TILE_CREATE_FUNCTION(barcode)
     lv_obj_set_width(product_price_label, LV_HOR_RES - 30);
     lv_obj_set_style_text_align(product_price_label, LV_TEXT_ALIGN_CENTER, 0);
     
-    // MQTT connection status (bottom)
+    // Transport connection status (bottom)
     mqtt_status_label = lv_label_create(parent);
-    lv_label_set_text(mqtt_status_label, "MQTT: Initializing");
+    lv_label_set_text(mqtt_status_label, TRANSPORT_NAME ": Initializing");
     lv_obj_align(mqtt_status_label, LV_ALIGN_BOTTOM_MID, 0, -10);
     lv_obj_set_style_text_font(mqtt_status_label, &lv_font_montserrat_12, 0);
     lv_obj_set_style_text_color(mqtt_status_label, ui_theme_get_muted_text_color(), 0);
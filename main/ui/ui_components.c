@@ -15,6 +15,9 @@ lv_obj_t *g_ota_status_label = NULL;
 lv_obj_t *g_ota_progress_bar = NULL;
 lv_obj_t *g_ip_status_label = NULL;
 
+// Samples OTA progress while the bar is shown
+static lv_timer_t *ota_progress_timer = NULL;
+
 void ui_components_update_wifi_status(const char* status, uint32_t color)
 {
     if (g_wifi_status_label != NULL && lvgl_port_lock(0)) {
@@ -44,24 +47,31 @@ void ui_components_update_ota_status(const char* status, uint32_t color)
     }
 }
 
-void ui_components_update_ota_progress(int percentage, size_t downloaded_kb, size_t total_kb)
+// Runs in the LVGL task, so the lock is already held
+static void ota_progress_timer_cb(lv_timer_t *timer)
 {
-    if (g_ota_progress_bar != NULL && lvgl_port_lock(0)) {
-        // Update progress bar
-        lv_bar_set_value(g_ota_progress_bar, percentage, LV_ANIM_OFF);
-        
-        // Update status text with progress
-        char status_text[100];
-        if (total_kb > 0) {
-            snprintf(status_text, sizeof(status_text), "OTA: %zu/%zu KB", 
-                     downloaded_kb, total_kb);
-        } else {
-            snprintf(status_text, sizeof(status_text), "OTA: %zu KB", 
-                     downloaded_kb);
-        }
-        lv_label_set_text(g_ota_status_label, status_text);
-        
-        lvgl_port_unlock();
+    size_t written, total;
+    ota_manager_get_progress(&written, &total);
+    if (g_ota_progress_bar == NULL || g_ota_status_label == NULL) {
+        return;
+    }
+
+    char status_text[100];
+    if (total > 0) {
+        lv_bar_set_value(g_ota_progress_bar, (int)((written * 100) / total), LV_ANIM_OFF);
+        snprintf(status_text, sizeof(status_text), "OTA: %zu/%zu KB",
+                 written / 1024, total / 1024);
+    } else {
+        snprintf(status_text, sizeof(status_text), "OTA: %zu KB", written / 1024);
+    }
+    lv_label_set_text(g_ota_status_label, status_text);
+}
+
+static void ota_progress_timer_stop(void)
+{
+    if (ota_progress_timer != NULL) {
+        lv_timer_del(ota_progress_timer);
+        ota_progress_timer = NULL;
     }
 }
 
@@ -70,6 +80,9 @@ void ui_components_show_progress_bar(void)
     if (g_ota_progress_bar != NULL && lvgl_port_lock(0)) {
         lv_obj_clear_flag(g_ota_progress_bar, LV_OBJ_FLAG_HIDDEN);
         lv_bar_set_value(g_ota_progress_bar, 0, LV_ANIM_OFF);
+        if (ota_progress_timer == NULL) {
+            ota_progress_timer = lv_timer_create(ota_progress_timer_cb, OTA_PROGRESS_SAMPLE_MS, NULL);
+        }
         lvgl_port_unlock();
     }
 }
@@ -77,6 +90,7 @@ void ui_components_show_progress_bar(void)
 void ui_components_hide_progress_bar(void)
 {
     if (g_ota_progress_bar != NULL && lvgl_port_lock(0)) {
+        ota_progress_timer_stop();
         lv_obj_add_flag(g_ota_progress_bar, LV_OBJ_FLAG_HIDDEN);
         lvgl_port_unlock();
     }
@@ -85,6 +99,8 @@ void ui_components_hide_progress_bar(void)
 void ui_components_set_progress_value(int percentage)
 {
     if (g_ota_progress_bar != NULL && lvgl_port_lock(0)) {
+        // A fixed value ends sampling so later status text is not overwritten
+        ota_progress_timer_stop();
         lv_bar_set_value(g_ota_progress_bar, percentage, LV_ANIM_OFF);
         lvgl_port_unlock();
     }
@@ -104,8 +120,9 @@ void ui_components_button_event_handler(lv_event_t * e)
         lv_obj_t * btn_label = lv_obj_get_child(btn, 0);
         ui_theme_apply_button_pressed_style(btn, btn_label);
         
-        // Start OTA update if WiFi is connected and not already in progress
-        if (!ota_manager_is_in_progress() && wifi_manager_is_connected()) {
+        // Start OTA update if WiFi is connected and not already in progress;
+        // a background update moves to the foreground (or restarts if ready)
+        if (ota_manager_is_background() || (!ota_manager_is_in_progress() && wifi_manager_is_connected())) {
             ota_manager_start_update();
         } else if (!ota_manager_is_in_progress()) {
             ESP_LOGW(TAG, "WiFi not connected - cannot start OTA update");
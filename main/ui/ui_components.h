@@ -13,9 +13,8 @@ extern lv_obj_t *g_ip_status_label;
 void ui_components_update_wifi_status(const char* status, uint32_t color);
 void ui_components_update_ip_status(const char* ip_address, uint32_t color);
 void ui_components_update_ota_status(const char* status, uint32_t color);
-void ui_components_update_ota_progress(int percentage, size_t downloaded_kb, size_t total_kb);
 
-// Progress bar control
+// Progress bar control (while shown, the bar samples ota_manager_get_progress)
 void ui_components_show_progress_bar(void);
 void ui_components_hide_progress_bar(void);
 void ui_components_set_progress_value(int percentage);
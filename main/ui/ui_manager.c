@@ -165,8 +165,8 @@ static esp_err_t init_universal_touch_detection(esp_lcd_touch_handle_t touch_han
 
 
 
-// Power state callback to handle UI updates on power state changes
-static void ui_power_state_callback(power_state_t old_state, power_state_t new_state)
+// Apply a power state change to the UI; called with the LVGL lock held
+static void ui_apply_power_state(power_state_t old_state, power_state_t new_state)
 {
     ESP_LOGI(TAG, "Power state changed: %s -> %s", 
              old_state == POWER_STATE_ACTIVE ? "Active" :
@@ -272,6 +272,21 @@ static void ui_power_state_callback(power_state_t old_state, power_state_t new_s
     }
 }
 
+// Drains power state changes, so neither the power task nor the timer service
+// waits on LVGL or the LED strip
+static void ui_power_event_task(void *arg)
+{
+    QueueHandle_t events = (QueueHandle_t)arg;
+    power_state_event_t event;
+    
+    while (1) {
+        if (xQueueReceive(events, &event, portMAX_DELAY) == pdTRUE && lvgl_port_lock(0)) {
+            ui_apply_power_state(event.old_state, event.new_state);
+            lvgl_port_unlock();
+        }
+    }
+}
+
 /**
  * @brief Initialize LVGL port with display and touch drivers
  * 
@@ -537,9 +552,12 @@ void ui_manager_create_main_screen(void)
         if (power_manager_init(&pm_config) != ESP_OK) {
             ESP_LOGE(TAG, "Failed to initialize power management system");
         } else {
-            // Register callback for power state changes
-            if (power_manager_register_state_callback(ui_power_state_callback) != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to register power state callback");
+            // Follow power state changes from a task of our own
+            QueueHandle_t power_events;
+            if (power_manager_subscribe(&power_events) != ESP_OK ||
+                xTaskCreate(ui_power_event_task, "ui_power", UI_POWER_TASK_STACK_SIZE, power_events,
+                            UI_POWER_TASK_PRIORITY, NULL) != pdPASS) {
+                ESP_LOGE(TAG, "Failed to subscribe to power state changes");
             }
             
             // Configure light sleep wake sources
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+ESP32-C6 Touch Starter - Compressed OTA image tool
+
+Compresses a firmware image for main/network/ota_inflate.c, which
+decompresses it on the device while it streams into esp_ota_write. The
+stream is heatshrink (LZSS) with a 2^WINDOW_BITS byte window, so the
+device needs that much RAM and no more.
+
+Usage:
+  ota_compress.py compress FIRMWARE.bin OUT.hs   # write a compressed image
+  ota_compress.py decompress IN.hs OUT.bin       # expand and verify it
+  ota_compress.py stats FIRMWARE.bin             # size and time
+
+Layout (little endian):
+  header  "EHS1", u8 window_bits, u8 lookahead_bits, u16 flags (0),
+          u32 image size, SHA-256 of the image[32]
+  stream  heatshrink bitstream, most significant bit first:
+            1 + 8 bits              literal byte
+            0 + window_bits bits    back-reference distance - 1
+              + lookahead_bits bits length - 1
+          zero-padded to a whole byte.
+
+The stream is the same as heatshrink -e -w <window_bits> -l <lookahead_bits>.
+"""
+
+import hashlib
+import struct
+import sys
+import time
+
+MAGIC = b'EHS1'
+HEADER = struct.Struct('<4sBBHI32s')
+
+WINDOW_BITS = 12        # 4 KB window: the decoder's RAM
+LOOKAHEAD_BITS = 5      # Matches up to 32 bytes
+MIN_MATCH = 3           # A back-reference (18 bits) beats literals from 3 bytes on
+MAX_CHAIN = 32          # Candidates tried per position
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.bits = 0
+
+    def put(self, value, count):
+        self.acc = (self.acc << count) | value
+        self.bits += count
+        while self.bits >= 8:
+            self.bits -= 8
+            self.out.append((self.acc >> self.bits) & 0xff)
+        self.acc &= (1 << self.bits) - 1
+
+    def finish(self):
+        if self.bits:
+            self.out.append((self.acc << (8 - self.bits)) & 0xff)
+        return bytes(self.out)
+
+
+def compress(data, window_bits=WINDOW_BITS, lookahead_bits=LOOKAHEAD_BITS):
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    chains = {}
+    writer = BitWriter()
+
+    def remember(pos):
+        if pos + MIN_MATCH <= len(data):
+            chain = chains.setdefault(data[pos:pos + MIN_MATCH], [])
+            chain.append(pos)
+            if len(chain) > 2 * MAX_CHAIN:
+                del chain[:MAX_CHAIN]
+
+    pos = 0
+    while pos < len(data):
+        best_len = 0
+        best_dist = 0
+        limit = min(max_len, len(data) - pos)
+        if limit >= MIN_MATCH:
+            for candidate in reversed(chains.get(data[pos:pos + MIN_MATCH], ())[-MAX_CHAIN:]):
+                dist = pos - candidate
+                if dist > window:
+                    break
+                if data[candidate:candidate + limit] == data[pos:pos + limit]:
+                    length = limit
+                else:
+                    length = MIN_MATCH
+                    while length < limit and data[candidate + length] == data[pos + length]:
+                        length += 1
+                if length > best_len:
+                    best_len = length
+                    best_dist = dist
+                    if length == limit:
+                        break
+
+        if best_len >= MIN_MATCH:
+            writer.put(0, 1)
+            writer.put(best_dist - 1, window_bits)
+            writer.put(best_len - 1, lookahead_bits)
+            for i in range(pos, pos + best_len):
+                remember(i)
+            pos += best_len
+        else:
+            writer.put(1, 1)
+            writer.put(data[pos], 8)
+            remember(pos)
+            pos += 1
+
+    header = HEADER.pack(MAGIC, window_bits, lookahead_bits, 0, len(data), hashlib.sha256(data).digest())
+    return header + writer.finish()
+
+
+def decompress(blob):
+    magic, window_bits, lookahead_bits, _flags, size, digest = HEADER.unpack_from(blob)
+    if magic != MAGIC:
+        raise ValueError('not a compressed image')
+
+    out = bytearray()
+    acc = 0
+    bits = 0
+    pos = HEADER.size
+
+    def take(count):
+        nonlocal acc, bits, pos
+        while bits < count:
+            acc = (acc << 8) | blob[pos]
+            pos += 1
+            bits += 8
+        bits -= count
+        value = (acc >> bits) & ((1 << count) - 1)
+        acc &= (1 << bits) - 1
+        return value
+
+    while len(out) < size:
+        if take(1):
+            out.append(take(8))
+        else:
+            dist = take(window_bits) + 1
+            length = take(lookahead_bits) + 1
+            for _ in range(length):
+                out.append(out[-dist] if dist <= len(out) else 0)
+    if len(out) != size or hashlib.sha256(out).digest() != digest:
+        raise ValueError('decompressed image does not match')
+    return bytes(out)
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def main(argv):
+    if len(argv) == 3 and argv[0] == 'compress':
+        blob = compress(read(argv[1]))
+        with open(argv[2], 'wb') as f:
+            f.write(blob)
+        print(f'{argv[2]}: {len(blob)} bytes')
+    elif len(argv) == 3 and argv[0] == 'decompress':
+        data = decompress(read(argv[1]))
+        with open(argv[2], 'wb') as f:
+            f.write(data)
+        print(f'{argv[2]}: {len(data)} bytes, digest verified')
+    elif len(argv) == 2 and argv[0] == 'stats':
+        data = read(argv[1])
+        started = time.perf_counter()
+        blob = compress(data)
+        compressed = time.perf_counter()
+        decompress(blob)
+        expanded = time.perf_counter()
+        print(f'image {len(data)} bytes, compressed {len(blob)} bytes ({100.0 * len(blob) / len(data):.1f}%), '
+              f'window {1 << WINDOW_BITS} bytes')
+        print(f'compress {1000 * (compressed - started):.0f} ms, '
+              f'decompress {1000 * (expanded - compressed):.0f} ms (host)')
+    else:
+        print(__doc__.split('\n\n')[2], file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""
+ESP32-C6 Touch Starter - Delta OTA patch tool
+
+Builds a patch that turns one firmware image into another, in the format
+main/network/ota_delta.c applies on the device while streaming it from the
+network: the running partition is read at random offsets, the new image is
+written strictly in order, and nothing larger than a flash page is held in
+RAM.
+
+Usage:
+  ota_delta.py create OLD.bin NEW.bin PATCH   # write a patch
+  ota_delta.py apply OLD.bin PATCH OUT.bin    # rebuild NEW.bin and verify it
+  ota_delta.py stats OLD.bin NEW.bin          # patch size and create/apply time
+
+Patch layout (little endian):
+  header   "EDP1", u32 old_size, u32 new_size, u32 flags (0),
+           old image digest[32], SHA-256 of the new image[32]
+  commands varint v, op = v & 3, n = v >> 2
+             0 COPY    n bytes from the old image at the read position
+             1 INSERT  n literal bytes that follow the command (the read
+                       position advances by n as well)
+             2 SEEK    move the read position by zigzag-decoded n
+  until new_size bytes have been produced.
+
+The old image digest is what esp_partition_get_sha256() reports for the
+running app: the SHA-256 appended to the image by the build.
+"""
+
+import hashlib
+import struct
+import sys
+import time
+
+MAGIC = b'EDP1'
+HEADER = struct.Struct('<4sIII32s32s')
+
+OP_COPY = 0
+OP_INSERT = 1
+OP_SEEK = 2
+
+BLOCK = 16              # Anchor length; the old image is indexed every BLOCK bytes
+MIN_COPY = 8            # Shorter matches are cheaper as literals
+MISMATCH_RUN = 8        # Mismatching bytes tolerated before an aligned region ends
+IMAGE_HASH_APPENDED = 23  # esp_image_header_t.hash_appended
+
+
+def image_digest(image):
+    """Digest the device reports for this image once it is running."""
+    if len(image) > 32 + IMAGE_HASH_APPENDED and image[IMAGE_HASH_APPENDED] == 1:
+        return image[-32:]
+    return hashlib.sha256(image).digest()
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def unzigzag(value):
+    return (value >> 1) if not value & 1 else -((value + 1) >> 1)
+
+
+def find_regions(old, new):
+    """
+    Return (new_start, old_start, length) aligned regions of new covered by old.
+
+    Anchors are exact BLOCK-byte matches found through an index of the old
+    image. Each region is then grown forward while new keeps following old,
+    tolerating short mismatches (changed call targets, addresses, version
+    strings), which become INSERTs inside the region.
+    """
+    index = {}
+    for offset in range(0, len(old) - BLOCK + 1, BLOCK):
+        index.setdefault(old[offset:offset + BLOCK], offset)
+
+    regions = []
+    covered = 0         # new[:covered] is already in a region
+    delta = None        # old - new of the last region, tried first
+    pos = 0
+    while pos <= len(new) - BLOCK:
+        key = new[pos:pos + BLOCK]
+        if delta is not None and 0 <= pos + delta <= len(old) - BLOCK \
+                and old[pos + delta:pos + delta + BLOCK] == key:
+            start_old = pos + delta
+        else:
+            start_old = index.get(key)
+            if start_old is None:
+                pos += 1
+                continue
+
+        start_new = pos
+        while start_new > covered and start_old > 0 and new[start_new - 1] == old[start_old - 1]:
+            start_new -= 1
+            start_old -= 1
+        length = pos + BLOCK - start_new
+        limit = min(len(new) - start_new, len(old) - start_old)
+        misses = 0
+        while length + misses < limit:
+            if new[start_new + length + misses] == old[start_old + length + misses]:
+                length += misses + 1
+                misses = 0
+            elif misses < MISMATCH_RUN:
+                misses += 1
+            else:
+                break
+
+        regions.append((start_new, start_old, length))
+        covered = pos = start_new + length
+        delta = start_old - start_new
+    return regions
+
+
+def encode_region(out, new, old, new_start, old_start, length):
+    """COPY the matching runs of an aligned region, INSERT the rest."""
+    def same(i):
+        return new[new_start + i] == old[old_start + i]
+
+    i = 0
+    while i < length:
+        j = i
+        while j < length and same(j):
+            j += 1
+        if j - i >= MIN_COPY or (j == length and j > i):
+            out += varint((j - i) << 2 | OP_COPY)
+            i = j
+            continue
+        # Literal run, up to the next match worth a COPY
+        k = i
+        while k < length:
+            if same(k):
+                run = k
+                while run < length and run - k < MIN_COPY and same(run):
+                    run += 1
+                if run - k >= MIN_COPY or run == length:
+                    break
+                k = run
+            else:
+                k += 1
+        out += varint((k - i) << 2 | OP_INSERT)
+        out += new[new_start + i:new_start + k]
+        i = k
+
+
+def create_patch(old, new):
+    out = bytearray(HEADER.pack(MAGIC, len(old), len(new), 0,
+                                image_digest(old), hashlib.sha256(new).digest()))
+    new_pos = 0
+    old_pos = 0
+    for new_start, old_start, length in find_regions(old, new):
+        if new_start > new_pos:
+            out += varint((new_start - new_pos) << 2 | OP_INSERT)
+            out += new[new_pos:new_start]
+            old_pos += new_start - new_pos
+        if old_start != old_pos:
+            out += varint(zigzag(old_start - old_pos) << 2 | OP_SEEK)
+        encode_region(out, new, old, new_start, old_start, length)
+        new_pos = new_start + length
+        old_pos = old_start + length
+    if new_pos < len(new):
+        out += varint((len(new) - new_pos) << 2 | OP_INSERT)
+        out += new[new_pos:]
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    magic, old_size, new_size, _flags, old_digest, new_digest = HEADER.unpack_from(patch)
+    if magic != MAGIC:
+        raise ValueError('not a delta patch')
+    if old_size != len(old) or old_digest != image_digest(old):
+        raise ValueError('patch does not apply to this image')
+
+    new = bytearray()
+    pos = HEADER.size
+    old_pos = 0
+    while len(new) < new_size:
+        value = 0
+        shift = 0
+        while True:
+            byte = patch[pos]
+            pos += 1
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        op, n = value & 3, value >> 2
+        if op == OP_COPY:
+            if old_pos + n > len(old):
+                raise ValueError('COPY past the end of the old image')
+            new += old[old_pos:old_pos + n]
+            old_pos += n
+        elif op == OP_INSERT:
+            new += patch[pos:pos + n]
+            pos += n
+            old_pos += n
+        elif op == OP_SEEK:
+            old_pos += unzigzag(n)
+        else:
+            raise ValueError('bad command')
+    if len(new) != new_size or hashlib.sha256(new).digest() != new_digest:
+        raise ValueError('reconstructed image does not match')
+    return bytes(new)
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def main(argv):
+    if len(argv) == 4 and argv[0] == 'create':
+        patch = create_patch(read(argv[1]), read(argv[2]))
+        with open(argv[3], 'wb') as f:
+            f.write(patch)
+        print(f'{argv[3]}: {len(patch)} bytes')
+    elif len(argv) == 4 and argv[0] == 'apply':
+        new = apply_patch(read(argv[1]), read(argv[2]))
+        with open(argv[3], 'wb') as f:
+            f.write(new)
+        print(f'{argv[3]}: {len(new)} bytes, digest verified')
+    elif len(argv) == 3 and argv[0] == 'stats':
+        old, new = read(argv[1]), read(argv[2])
+        started = time.perf_counter()
+        patch = create_patch(old, new)
+        created = time.perf_counter()
+        apply_patch(old, patch)
+        applied = time.perf_counter()
+        print(f'old {len(old)} bytes, new {len(new)} bytes, patch {len(patch)} bytes '
+              f'({100.0 * len(patch) / len(new):.1f}% of full image)')
+        print(f'create {1000 * (created - started):.0f} ms, apply {1000 * (applied - created):.0f} ms (host)')
+    else:
+        print(__doc__.split('\n\n')[2], file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
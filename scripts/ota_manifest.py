@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+ESP32-C6 Touch Starter - Signed release manifest tool
+
+Writes the manifest.json that scripts/release.sh publishes next to each
+release. Before downloading anything, the device fetches it (a few hundred
+bytes) and checks the signature against main/network/ota_manifest_key.pem.
+It then compares app_sha256 with its running image and downloads only when
+they differ. A patch is tried only if one is listed for its version.
+Signing and verification use the openssl command line tool.
+
+Usage:
+  ota_manifest.py create VERSION FIRMWARE.bin KEY.pem OUT [PATCH...]   # sign a manifest
+  ota_manifest.py verify MANIFEST PUBLIC.pem                          # check one
+  ota_manifest.py keygen KEY.pem PUBLIC.pem                           # new P-256 key pair
+
+Layout (two lines):
+  {"version":"v3.0.13","size":N,"sha256":"<hex>","app_sha256":"<hex>",
+   "compressed_size":N,"deltas":{"v3.0.12":N,...}}
+  base64 ECDSA P-256 / SHA-256 signature (DER) of the first line
+
+sha256 is the digest of firmware.bin. app_sha256 is what
+esp_partition_get_sha256() reports once the image runs (see ota_delta.py).
+compressed_size is present when firmware.bin.hs sits next to firmware.bin.
+deltas maps each version with a published firmware-<version>.patch to the
+patch size.
+"""
+
+import base64
+import hashlib
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+from ota_delta import image_digest
+
+PATCH_NAME = re.compile(r'firmware-(v\d+\.\d+\.\d+)\.patch$')
+
+
+def openssl(*args, data=None):
+    return subprocess.run(['openssl', *args], input=data, capture_output=True, check=True).stdout
+
+
+def sign(payload, key_path):
+    return openssl('dgst', '-sha256', '-sign', key_path, data=payload)
+
+
+def verify(payload, signature, public_path):
+    with tempfile.NamedTemporaryFile() as sig:
+        sig.write(signature)
+        sig.flush()
+        result = subprocess.run(['openssl', 'dgst', '-sha256', '-verify', public_path, '-signature', sig.name],
+                                input=payload, capture_output=True)
+    return result.returncode == 0
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def create_manifest(version, firmware_path, key_path, patch_paths):
+    firmware = read(firmware_path)
+    manifest = {
+        'version': version,
+        'size': len(firmware),
+        'sha256': hashlib.sha256(firmware).hexdigest(),
+        'app_sha256': image_digest(firmware).hex(),
+    }
+    compressed_path = firmware_path + '.hs'
+    if os.path.exists(compressed_path):
+        manifest['compressed_size'] = os.path.getsize(compressed_path)
+    deltas = {}
+    for path in patch_paths:
+        match = PATCH_NAME.search(path)
+        if not match:
+            raise ValueError(f'{path}: not named firmware-v<version>.patch')
+        deltas[match.group(1)] = os.path.getsize(path)
+    manifest['deltas'] = deltas
+
+    payload = json.dumps(manifest, separators=(',', ':')).encode()
+    return payload + b'\n' + base64.b64encode(sign(payload, key_path)) + b'\n'
+
+
+def split_manifest(blob):
+    payload, _, rest = blob.partition(b'\n')
+    return payload, base64.b64decode(rest.strip())
+
+
+def main(argv):
+    if len(argv) >= 5 and argv[0] == 'create':
+        blob = create_manifest(argv[1], argv[2], argv[3], argv[5:])
+        with open(argv[4], 'wb') as f:
+            f.write(blob)
+        print(f'{argv[4]}: {len(blob)} bytes')
+    elif len(argv) == 3 and argv[0] == 'verify':
+        payload, signature = split_manifest(read(argv[1]))
+        if not verify(payload, signature, argv[2]):
+            print(f'{argv[1]}: signature does not match {argv[2]}', file=sys.stderr)
+            return 1
+        manifest = json.loads(payload)
+        print(f'{argv[1]}: {manifest["version"]}, {manifest["size"]} bytes, '
+              f'{len(manifest.get("deltas", {}))} patches, signature verified')
+    elif len(argv) == 3 and argv[0] == 'keygen':
+        if os.path.exists(argv[1]):
+            print(f'{argv[1]} already exists', file=sys.stderr)
+            return 1
+        openssl('ecparam', '-name', 'prime256v1', '-genkey', '-noout', '-out', argv[1])
+        os.chmod(argv[1], 0o600)
+        openssl('pkey', '-in', argv[1], '-pubout', '-out', argv[2])
+        print(f'{argv[1]}: private key (keep it out of the repository), {argv[2]}: public key')
+    else:
+        print(__doc__.split('\n\n')[2], file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
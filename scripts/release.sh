@@ -11,6 +11,9 @@ PROJECT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
 CONFIG_FILE="$PROJECT_DIR/main/app_config.h"
 OTA_REPO_DIR="$PROJECT_DIR/../esp32-ota-firmware"
 ESP_IDF_DIR="$PROJECT_DIR/../esp-idf"
+OTA_DELTA_BASES=3  # Publish patches from this many previous releases
+OTA_SIGNING_KEY="${OTA_SIGNING_KEY:-$PROJECT_DIR/../ota-signing-key.pem}"  # Signs manifest.json; never commit it
+OTA_PUBLIC_KEY="$PROJECT_DIR/main/network/ota_manifest_key.pem"
 
 # Colors for output
 RED='\033[0;31m'
@@ -129,6 +132,60 @@ build_firmware() {
     log_success "Firmware built successfully"
 }
 
+# Build delta patches from the most recent releases to the new firmware
+create_patches() {
+    local new_bin=$1
+    local work_dir
+    work_dir=$(mktemp -d)
+    
+    rm -f "$OTA_REPO_DIR"/firmware-v*.patch
+    
+    local tags
+    tags=$(gh release list --limit "$OTA_DELTA_BASES" --json tagName --jq '.[].tagName')
+    for tag in $tags; do
+        if ! gh release download "$tag" --pattern firmware.bin --dir "$work_dir/$tag" &> /dev/null; then
+            log_warning "No firmware.bin in release $tag, skipping patch"
+            continue
+        fi
+        
+        local patch="$OTA_REPO_DIR/firmware-$tag.patch"
+        python3 "$PROJECT_DIR/scripts/ota_delta.py" create "$work_dir/$tag/firmware.bin" "$new_bin" "$patch" > /dev/null
+        
+        local patch_size=$(stat -c %s "$patch")
+        local full_size=$(stat -c %s "$new_bin")
+        log_info "Patch from $tag: $patch_size bytes ($((patch_size * 100 / full_size))% of $full_size)"
+    done
+    
+    rm -rf "$work_dir"
+}
+
+# The signing key must exist and match the public key built into the firmware
+check_signing_key() {
+    if [ ! -f "$OTA_SIGNING_KEY" ]; then
+        log_error "Manifest signing key not found: $OTA_SIGNING_KEY"
+        log_info "Set OTA_SIGNING_KEY, or create a new pair (devices then need a USB flash):"
+        log_info "  python3 scripts/ota_manifest.py keygen $OTA_SIGNING_KEY $OTA_PUBLIC_KEY"
+        exit 1
+    fi
+    if [ "$(openssl pkey -in "$OTA_SIGNING_KEY" -pubout 2> /dev/null)" != "$(openssl pkey -pubin -in "$OTA_PUBLIC_KEY" 2> /dev/null)" ]; then
+        log_error "$OTA_SIGNING_KEY does not match $OTA_PUBLIC_KEY"
+        exit 1
+    fi
+}
+
+# Signed manifest.json: what the release is, so devices download only when needed
+create_manifest() {
+    local version=$1
+    
+    shopt -s nullglob
+    local patches=("$OTA_REPO_DIR"/firmware-v*.patch)
+    shopt -u nullglob
+    python3 "$PROJECT_DIR/scripts/ota_manifest.py" create "v$version" "$OTA_REPO_DIR/firmware.bin" \
+        "$OTA_SIGNING_KEY" "$OTA_REPO_DIR/manifest.json" "${patches[@]}" > /dev/null
+    python3 "$PROJECT_DIR/scripts/ota_manifest.py" verify "$OTA_REPO_DIR/manifest.json" "$OTA_PUBLIC_KEY" > /dev/null
+    log_info "Manifest: $(stat -c %s "$OTA_REPO_DIR/manifest.json") bytes, ${#patches[@]} patches"
+}
+
 # Create GitHub release
 create_release() {
     local version=$1
@@ -152,12 +209,25 @@ create_release() {
     # Copy firmware binary
     cp "$PROJECT_DIR/build/c6_touch_starter.bin" "$OTA_REPO_DIR/firmware.bin"
     
-    # Create release
+    # Compressed copy for devices with no matching patch
     cd "$OTA_REPO_DIR"
+    python3 "$PROJECT_DIR/scripts/ota_compress.py" compress firmware.bin firmware.bin.hs > /dev/null
+    log_info "Compressed image: $(stat -c %s firmware.bin.hs) of $(stat -c %s firmware.bin) bytes"
+    
+    # Patches from recent releases, for devices still running them
+    create_patches "$OTA_REPO_DIR/firmware.bin"
+    
+    # Manifest describing all of the above, checked by the device first
+    create_manifest "$version"
+    
+    # Create release
+    shopt -s nullglob
+    local assets=(manifest.json firmware.bin firmware.bin.hs firmware-v*.patch)
+    shopt -u nullglob
     gh release create "v$version" \
         --title "v$version - ESP32-C6 Touch Starter" \
         --notes "$release_notes" \
-        firmware.bin
+        "${assets[@]}"
     
     local release_url="https://github.com/slastra/esp32-ota-firmware/releases/tag/v$version"
     log_success "Release created: $release_url"
@@ -242,7 +312,7 @@ main() {
 
 # Check dependencies
 check_dependencies() {
-    local deps=("gh" "git" "sed")
+    local deps=("gh" "git" "sed" "python3" "openssl")
     local missing=()
     
     for dep in "${deps[@]}"; do
@@ -294,4 +364,5 @@ fi
 
 # Run checks and main process
 check_dependencies
+check_signing_key
 main "$@"
\ No newline at end of file
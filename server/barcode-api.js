@@ -0,0 +1,101 @@
+/**
+ * @file barcode-api.js
+ * @brief BarcodeLookup API client
+ *
+ * One HTTP call resolves one or several barcodes (comma-separated `barcode`
+ * parameter). Results come back keyed by the code that was asked for.
+ */
+
+const log = require('./logger');
+
+const TAG = 'barcode-api';
+
+/**
+ * Reduce an API product to what the device needs; this is what gets cached
+ * @param {Object} product - Product from the API response
+ * @param {string} barcode - Code that was looked up
+ * @returns {Object} Essential product fields
+ */
+function essentialProduct(product, barcode) {
+    return {
+        name: product.title || product.product_name || 'Unknown Product',
+        brand: product.brand || 'Unknown Brand',
+        model: product.mpn || product.model || '',
+        price: product.stores && product.stores.length > 0
+            ? `$${product.stores[0].price || 'N/A'}`
+            : 'Price N/A',
+        source_image: Array.isArray(product.images) && typeof product.images[0] === 'string'
+            ? product.images[0] : null,
+        upc: product.barcode_number || barcode
+    };
+}
+
+/**
+ * Match key for a barcode; UPC-A and its EAN-13 form differ only by leading zeros
+ */
+function matchKey(code) {
+    return String(code).replace(/^0+/, '');
+}
+
+/**
+ * Look up one or more barcodes in a single API call
+ * @param {string[]} barcodes - Distinct UPC/EAN codes
+ * @param {Object} options - { http (UpstreamHttp), apiBase, apiKey, timeoutMs }
+ * @returns {Promise<Map<string, Object>>} Requested code -> essential product; codes without a product are absent
+ * @throws On timeouts and API errors, so failures are never cached as "not found"
+ */
+async function fetchProducts(barcodes, options) {
+    const url = `${options.apiBase}?barcode=${barcodes.map(encodeURIComponent).join(',')}&formatted=y&key=${options.apiKey}`;
+
+    log.debug(`[${TAG}] Fetching ${barcodes.length > 1 ? `${barcodes.length} barcodes` : 'barcode'} from API: ${barcodes.join(',')}`);
+
+    const response = await options.http.request(url, {
+        timeoutMs: options.timeoutMs,
+        headers: {
+            'User-Agent': 'ESP32-Barcode-Scanner/1.0'
+        }
+    });
+
+    // BarcodeLookup answers 404 when none of the codes has a product
+    if (response.status === 404) {
+        log.debug(`[${TAG}] No products found for barcode: ${barcodes.join(',')}`);
+        return new Map();
+    }
+
+    if (!response.ok) {
+        throw new Error(`API request failed: ${response.status} ${response.statusText}`);
+    }
+
+    const data = response.json();
+
+    // Log the raw API response for debugging; serializing it is too costly to do unconditionally
+    if (log.debugEnabled) {
+        log.debug(`[${TAG}] Raw API response:`, JSON.stringify(data, null, 2));
+    }
+
+    const products = Array.isArray(data.products) ? data.products : [];
+    const results = new Map();
+
+    if (barcodes.length === 1) {
+        // Single lookups keep the API's first match, whatever barcode format it reports
+        if (products.length > 0) {
+            results.set(barcodes[0], essentialProduct(products[0], barcodes[0]));
+        }
+    } else {
+        const wanted = new Map(barcodes.map(code => [matchKey(code), code]));
+        for (const product of products) {
+            const code = wanted.get(matchKey(product.barcode_number || ''));
+            if (code && !results.has(code)) {
+                results.set(code, essentialProduct(product, code));
+            }
+        }
+    }
+
+    for (const [code, product] of results) {
+        log.debug(`[${TAG}] Found product for ${code}: "${product.name}" by ${product.brand} (Model: ${product.model || 'N/A'})`);
+    }
+
+    return results;
+}
+
+module.exports = { fetchProducts };
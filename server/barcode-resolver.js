@@ -7,43 +7,246 @@
  * - Connects to Mosquitto broker at desk.local:1883
  * - Resolves UPC codes via BarcodeLookup API
  * - Publishes product information back to ESP32 devices
+ * - Embeds a BlurHash image placeholder in each lookup response
+ * - Prewarms product images during lookup so the device's image fetch is served hot
+ * - Optionally streams the RGB565 thumbnail inline over MQTT (no second HTTP round trip)
+ * - Tiered product cache (memory LRU + SQLite) with single-flight upstream calls
+ * - Byte-bounded LRU image cache with content-hash ETags and 304 revalidation
+ * - Native SIMD RGB565 conversion (optional addon, JS fallback)
+ * - Image decode/resize/convert on a bounded worker-thread pool, keeping MQTT responsive
+ * - Optional multi-process mode (resolver-cluster.js)
+ * - Horizontal scaling: instances share requests through an MQTT 5 shared subscription,
+ *   deduplicate retransmitted request IDs and share upstream results
+ * - Prometheus metrics on /metrics; per-request logging only at LOG_LEVEL=debug
  * - Error handling with timeout and retry logic
  */
 
 const mqtt = require('mqtt');
 const fastify = require('fastify')({ logger: false });
-const sharp = require('sharp');
 const crypto = require('crypto');
+const os = require('os');
+const path = require('path');
+const { performance, monitorEventLoopDelay } = require('perf_hooks');
+const log = require('./logger');
+const { MetricsRegistry, labelled, mergeExpositions } = require('./metrics');
+const rgb565 = require('./rgb565');
+const { renderImage } = require('./image-processing');
+const { WorkerPool } = require('./worker-pool');
+const { ProductCache } = require('./product-cache');
+const { ImageCache, contentEtag } = require('./image-cache');
+const { UpstreamBatcher } = require('./upstream-batcher');
+const { UpstreamHttp } = require('./upstream-http');
+const barcodeApi = require('./barcode-api');
+const { createProviders } = require('./product-providers');
+const { HedgedLookup } = require('./hedged-lookup');
+const { RateLimiter } = require('./rate-limiter');
+const { RequestLedger } = require('./request-ledger');
+const { CoapServer, CODE: COAP_CODE, CONTENT_FORMAT: COAP_CONTENT_FORMAT } = require('./coap-server');
 require('dotenv').config();
 
 // Configuration
-const MQTT_BROKER_URI = 'mqtt://desk.local:1883';
-const BARCODE_API_BASE = 'https://api.barcodelookup.com/v3/products';
+const MQTT_BROKER_URI = process.env.MQTT_BROKER_URI || 'mqtt://desk.local:1883';
+const BARCODE_API_BASE = process.env.BARCODE_API_BASE || 'https://api.barcodelookup.com/v3/products';
 const REQUEST_TIMEOUT_MS = 10000;  // 10 second timeout
 const MAX_RETRIES = 3;
-const HTTP_PROXY_PORT = 3000;
+const HTTP_PROXY_PORT = parseInt(process.env.PORT) || 3000;
+const DEVICE_IMAGE_SIZE = 80;         // Product image slot on the ESP32 is 80x80
+const PLACEHOLDER_TIMEOUT_MS = 1500;  // Don't hold the lookup response longer than this
+const PLACEHOLDER_CACHE_MAX = 1000;
+const INLINE_IMAGES_ENABLED = process.env.INLINE_IMAGES !== '0';  // Devices still have to opt in per request
+const INLINE_CHUNK_SIZE = 4096;       // Payload bytes per binary MQTT image chunk
+const INLINE_HEADER_SIZE = 16;        // request_id, total_size, offset (u32) + width, height (u16), big-endian
+const PRODUCT_CACHE_DB = process.env.PRODUCT_CACHE_DB ?? path.join(__dirname, 'product-cache.db');  // Empty = memory only
+const PRODUCT_CACHE_MAX_ENTRIES = 5000;
+const PRODUCT_CACHE_TTL_MS = (parseFloat(process.env.PRODUCT_CACHE_TTL_HOURS) || 24) * 3600000;
+const PRODUCT_NOT_FOUND_TTL_MS = 3600000;           // Unknown codes may get listed later
+const PRODUCT_STALE_MS = 7 * 24 * 3600000;          // Serve expired entries this long while refreshing
+const IMAGE_CACHE_MAX_BYTES = (parseFloat(process.env.IMAGE_CACHE_MB) || 64) * 1024 * 1024;  // ~5000 80x80 images
+const IMAGE_CACHE_MAX_AGE_MS = 3600000;             // Re-fetch source images after an hour
+const IMAGE_SPILL_DIR = process.env.IMAGE_SPILL_DIR || null;  // Unset = evicted images are dropped
+const IMAGE_SPILL_MAX_BYTES = (parseFloat(process.env.IMAGE_SPILL_MB) || 256) * 1024 * 1024;
+const IMAGE_DITHER = process.env.IMAGE_DITHER === '1';  // Ordered dithering softens RGB565 banding
+const IMAGE_PREWARM = process.env.IMAGE_PREWARM !== '0';  // 0 = convert only when the device asks, for comparison
+const IMAGE_WORKERS = process.env.IMAGE_WORKERS !== undefined
+    ? parseInt(process.env.IMAGE_WORKERS) || 0            // 0 = process images on the main thread
+    : Math.max(1, os.cpus().length - 1);
+const IMAGE_QUEUE_MAX = 32;                         // Waiting image jobs before new ones get a 503
+const UPSTREAM_BATCH_MAX = parseInt(process.env.UPSTREAM_BATCH_MAX) || 10;  // Codes per API call; 1 = no batching
+const UPSTREAM_BATCH_WINDOW_MS = parseInt(process.env.UPSTREAM_BATCH_WINDOW_MS ?? '5');  // Wait this long for more codes
+const UPSTREAM_MAX_SOCKETS = 16;                   // Keep-alive connections per image origin
+const UPSTREAM_API_SOCKETS = parseInt(process.env.UPSTREAM_API_SOCKETS) || 4;  // Connection limit to the lookup API
+const UPSTREAM_API_PREWARM = 2;                     // Lookup API connections kept open while idle
+const UPSTREAM_SOCKET_IDLE_MS = 30000;              // Close idle sockets before typical 60s server timeouts
+const UPSTREAM_REWARM_INTERVAL_MS = 10000;          // Reopen lookup API connections after idle periods
+const UPSTREAM_POOL_IDLE_MS = 600000;               // Drop pools for image origins unused this long
+const PRODUCT_PROVIDERS = (process.env.PRODUCT_PROVIDERS || 'barcodelookup').split(',').map(name => name.trim()).filter(Boolean);
+const HEDGE_DELAY_MS = parseInt(process.env.HEDGE_DELAY_MS ?? '400');  // Ask the next provider if no product by then
+const LOCAL_PRODUCTS_FILE = process.env.LOCAL_PRODUCTS_FILE || null;  // JSON product database for the 'local' provider
+const RESOLVER_PROCESS_COUNT = parseInt(process.env.RESOLVER_PROCESS_COUNT) || 1;  // Set by resolver-cluster.js
+const UPSTREAM_RATE_PER_MIN = parseFloat(process.env.UPSTREAM_RATE_PER_MIN ?? '100');  // 0 = unlimited; shared across cluster processes
+const UPSTREAM_BURST = parseInt(process.env.UPSTREAM_BURST) || 20;
+const UPSTREAM_QUEUE_MAX = 200;                     // Lookups waiting for a token, all devices
+const UPSTREAM_QUEUE_PER_DEVICE = 4;                // A scanning loop only queues behind itself
+const UPSTREAM_MAX_WAIT_MS = 5000;                  // Give up before the device's own timeout
+const CLUSTER_CHILD = process.env.RESOLVER_CLUSTER_CHILD === '1';  // Requests arrive from resolver-cluster.js
+const RESOLVER_SLOT = parseInt(process.env.RESOLVER_SLOT) || 0;    // Cluster slot, the process label on /metrics and /stats
+const CLUSTER_COLLECT_TIMEOUT_MS = 2000;            // Wait for sibling processes' reports on a scrape
+const RESOLVER_SHARE_GROUP = process.env.RESOLVER_SHARE_GROUP ?? 'resolvers';  // MQTT 5 shared subscription group; empty = plain subscription
+const RESOLVER_INSTANCES = parseInt(process.env.RESOLVER_INSTANCES) || 1;  // Instances in the group; they split the upstream rate limit
+const REQUEST_TOPIC = 'barcode/lookup/request/+';
+const REQUEST_SUBSCRIPTION = RESOLVER_SHARE_GROUP ? `$share/${RESOLVER_SHARE_GROUP}/${REQUEST_TOPIC}` : REQUEST_TOPIC;
+const CACHE_SYNC_TOPIC = 'barcode/resolver/cache';  // Upstream results broadcast to the other instances
+const RESOLVER_SYNC_SECRET = process.env.RESOLVER_SYNC_SECRET || null;  // HMAC key for that broadcast; unset = no sharing
+const CACHE_SYNC = Boolean(RESOLVER_SHARE_GROUP && RESOLVER_SYNC_SECRET);
+const REQUEST_LEDGER_TTL_MS = 600000;               // Remember request IDs for 10 minutes
+const REQUEST_CLAIM_TIMEOUT_MS = 30000;             // An unfinished claim this old belongs to a dead instance
+const REQUEST_LEDGER_MAX_ENTRIES = 20000;
+const COAP_PORT = parseInt(process.env.COAP_PORT) || 0;   // Direct CoAP/UDP lookups for devices built with the CoAP transport; 0 = off
+const COAP_PIGGYBACK_MS = 500;                      // Slower lookups get an empty ACK first, then a separate response
 
 // Validate API key
-if (!process.env.BARCODELOOKUP_API_KEY) {
+if (PRODUCT_PROVIDERS.includes('barcodelookup') && !process.env.BARCODELOOKUP_API_KEY) {
     console.error('ERROR: BARCODELOOKUP_API_KEY not found in .env file');
     process.exit(1);
 }
 
 const TAG = 'barcode-resolver';
+const MQTT_CLIENT_ID = `barcode-resolver-${Math.random().toString(16).substr(2, 8)}`;
 
-// Image cache for proxy server
-const imageCache = new Map();
+// Image cache for proxy server; starts empty so stale conversions are never served
+const imageCache = new ImageCache({
+    maxBytes: IMAGE_CACHE_MAX_BYTES,
+    maxAgeMs: IMAGE_CACHE_MAX_AGE_MS,
+    spillDir: IMAGE_SPILL_DIR,
+    spillMaxBytes: IMAGE_SPILL_MAX_BYTES
+});
+
+// BlurHash placeholders keyed by source image URL
+const placeholderCache = new Map();
+
+// In-flight image fetch/convert promises keyed by image cache key
+const inflightImages = new Map();
+
+// Prewarm start times, used to measure how far ahead of the device we were
+const prewarmStarted = new Map();
+
+// Prewarm effectiveness counters
+const imageStats = {
+    prewarmed: 0,     // Images fetched ahead of the device's request
+    cacheHits: 0,     // Device requests served from a finished result
+    attached: 0,      // Device requests that joined an in-flight fetch
+    misses: 0,        // Device requests that started their own fetch
+    notModified: 0,   // Revalidations answered with 304 (no pixels sent)
+    peakInflight: 0   // Most concurrent image fetches seen
+};
+
+// Prometheus metrics: latencies are observed inline, everything else is read from stats() on scrape
+const metrics = new MetricsRegistry();
+const lookupDuration = metrics.histogram('barcode_lookup_duration_seconds',
+    'Device lookup time from request to product answer, by result');
+const upstreamDuration = metrics.histogram('barcode_upstream_request_duration_seconds',
+    'Product provider request time, by provider and outcome');
+const imageFetchDuration = metrics.histogram('barcode_image_fetch_duration_seconds',
+    'Source image download time');
+const imageProcessingDuration = metrics.histogram('barcode_image_processing_duration_seconds',
+    'Decode, resize and RGB565 conversion time including worker queueing, by where it ran');
+const mqttPublishDuration = metrics.histogram('barcode_mqtt_publish_duration_seconds',
+    'Time from publish to broker acknowledgement (QoS 1), by message kind');
+const limiterWaitDuration = metrics.histogram('barcode_upstream_limiter_wait_seconds',
+    'Time queued lookups waited for an upstream token, by priority and outcome');
+const EVENT_LOOP_RESOLUTION_MS = 10;
+const eventLoopDelay = monitorEventLoopDelay({ resolution: EVENT_LOOP_RESOLUTION_MS });
+eventLoopDelay.enable();
+let inflightRequests = 0;   // Device requests waiting for their product lookup
+
+// Keep-alive pools per upstream origin; the lookup API stays warm between scans
+const upstreamHttp = new UpstreamHttp({
+    maxSockets: UPSTREAM_MAX_SOCKETS,
+    socketIdleMs: UPSTREAM_SOCKET_IDLE_MS,
+    rewarmIntervalMs: UPSTREAM_REWARM_INTERVAL_MS,
+    origins: PRODUCT_PROVIDERS.includes('barcodelookup') ? {
+        [new URL(BARCODE_API_BASE).origin]: { maxSockets: UPSTREAM_API_SOCKETS, prewarm: UPSTREAM_API_PREWARM }
+    } : {}
+});
+upstreamHttp.prewarm();
+
+// Cache misses from all devices share multi-barcode API calls
+const upstreamBatcher = new UpstreamBatcher({
+    fetchBatch: codes => barcodeApi.fetchProducts(codes, {
+        http: upstreamHttp,
+        apiBase: BARCODE_API_BASE,
+        apiKey: process.env.BARCODELOOKUP_API_KEY,
+        timeoutMs: REQUEST_TIMEOUT_MS
+    }),
+    maxBatch: UPSTREAM_BATCH_MAX,
+    windowMs: UPSTREAM_BATCH_WINDOW_MS
+});
+
+// Product sources in preference order; slow ones get hedged, the first product found wins
+const hedgedLookup = new HedgedLookup({
+    providers: createProviders(PRODUCT_PROVIDERS, {
+        batcher: upstreamBatcher,
+        http: upstreamHttp,
+        timeoutMs: REQUEST_TIMEOUT_MS,
+        localProductsFile: LOCAL_PRODUCTS_FILE,
+        openFoodFactsBase: process.env.OPENFOODFACTS_API_BASE,
+        upcItemDbBase: process.env.UPCITEMDB_API_BASE
+    }),
+    hedgeDelayMs: HEDGE_DELAY_MS,
+    onAttempt: (provider, ms, outcome) => upstreamDuration.observe(ms, { provider, outcome })
+});
+
+// Upstream admission control: interactive scans first, devices take turns
+const upstreamLimiter = UPSTREAM_RATE_PER_MIN > 0
+    ? new RateLimiter({
+        ratePerSec: UPSTREAM_RATE_PER_MIN / 60 / (RESOLVER_PROCESS_COUNT * RESOLVER_INSTANCES),
+        burst: Math.max(1, Math.round(UPSTREAM_BURST / (RESOLVER_PROCESS_COUNT * RESOLVER_INSTANCES))),
+        maxQueue: UPSTREAM_QUEUE_MAX,
+        maxQueuePerDevice: UPSTREAM_QUEUE_PER_DEVICE,
+        maxWaitMs: UPSTREAM_MAX_WAIT_MS,
+        onWait: (ms, outcome, priority) => limiterWaitDuration.observe(ms, { priority, outcome })
+    })
+    : null;
+
+// Product lookups: memory LRU in front of SQLite, one upstream call per barcode at a time
+const productCache = new ProductCache({
+    fetcher: fetchProduct,
+    limiter: upstreamLimiter,
+    dbPath: PRODUCT_CACHE_DB || null,
+    maxEntries: PRODUCT_CACHE_MAX_ENTRIES,
+    ttlMs: PRODUCT_CACHE_TTL_MS,
+    notFoundTtlMs: PRODUCT_NOT_FOUND_TTL_MS,
+    staleMs: PRODUCT_STALE_MS,
+    onStore: CACHE_SYNC ? shareProduct : null
+});
+
+// Request IDs already handled; the SQLite file is shared by every instance on this host
+const requestLedger = new RequestLedger({
+    dbPath: PRODUCT_CACHE_DB || null,
+    owner: MQTT_CLIENT_ID,
+    ttlMs: REQUEST_LEDGER_TTL_MS,
+    claimTimeoutMs: REQUEST_CLAIM_TIMEOUT_MS,
+    maxEntries: REQUEST_LEDGER_MAX_ENTRIES
+});
 
-// Clear cache on startup to prevent serving stale images
-console.log(`[${TAG}] Clearing image cache on startup`);
-imageCache.clear();
+// Decode/resize/convert off the main thread so MQTT handling never waits behind Sharp
+const imagePool = IMAGE_WORKERS > 0
+    ? new WorkerPool({
+        script: path.join(__dirname, 'image-worker.js'),
+        size: IMAGE_WORKERS,
+        maxQueue: IMAGE_QUEUE_MAX
+    })
+    : null;
 
-console.log(`[${TAG}] Starting barcode resolver service...`);
+console.log(`[${TAG}] Starting barcode resolver service${CLUSTER_CHILD ? ` (cluster worker ${process.pid})` : ''}...`);
+console.log(`[${TAG}] RGB565 conversion: ${rgb565.implementation}${IMAGE_DITHER ? ', dithered' : ''}`);
+console.log(`[${TAG}] Log level: ${log.level}${log.debugEnabled ? '' : ' (per-request logging off)'}`);
 console.log(`[${TAG}] Connecting to MQTT broker: ${MQTT_BROKER_URI}`);
 
 // Connect to MQTT broker
 const client = mqtt.connect(MQTT_BROKER_URI, {
-    clientId: `barcode-resolver-${Math.random().toString(16).substr(2, 8)}`,
+    clientId: MQTT_CLIENT_ID,
+    protocolVersion: RESOLVER_SHARE_GROUP ? 5 : 4,   // Shared subscriptions are an MQTT 5 feature
     keepalive: 30,
     reconnectPeriod: 5000,
     connectTimeout: 10000,
@@ -51,106 +254,280 @@ const client = mqtt.connect(MQTT_BROKER_URI, {
 
 // Setup Fastify HTTP proxy server with image processing
 
-// Image proxy endpoint with Sharp resizing
-fastify.get('/image/:imageId', async (request, reply) => {
-    const imageId = request.params.imageId;
-    const imageUrl = request.query.url;
-    const width = parseInt(request.query.w) || 80;  // Default to 80x80 for ESP32
-    const height = parseInt(request.query.h) || 80;
-    const nocache = request.query.nocache === '1';
+/**
+ * Download an original product image
+ * @param {string} imageUrl - Source image URL
+ * @returns {Promise<Buffer>} Image bytes, or null if the server returned an error
+ */
+async function fetchImage(imageUrl) {
+    log.debug(`[${TAG}] Downloading image from: ${imageUrl}`);
+    const started = performance.now();
+    const response = await upstreamHttp.request(imageUrl, {
+        timeoutMs: REQUEST_TIMEOUT_MS,
+        headers: {
+            'User-Agent': 'ESP32-Barcode-Scanner-Proxy/1.0'
+        }
+    });
     
-    console.log(`[${TAG}] Proxying image: ${imageId} (${width}x${height}) from ${imageUrl}${nocache ? ' [NOCACHE]' : ''}`);
+    if (!response.ok) {
+        console.error(`[${TAG}] Image download failed: ${response.status} ${response.statusText}`);
+        return null;
+    }
     
+    const originalBuffer = response.body;
+    imageFetchDuration.observe(performance.now() - started);
+    log.debug(`[${TAG}] Original image: ${originalBuffer.length} bytes`);
+    return originalBuffer;
+}
+
+/**
+ * Build the image cache key for a source URL and output size
+ * @param {string} imageUrl - Source image URL
+ * @param {number} width - Output width
+ * @param {number} height - Output height
+ * @returns {string} Cache key
+ */
+function imageCacheKey(imageUrl, width, height) {
     // Create unique cache key using URL hash to prevent collisions
     const urlHash = crypto.createHash('md5').update(imageUrl || '').digest('hex').substring(0, 8);
-    const cacheKey = `${urlHash}_${width}x${height}`;
+    return `${urlHash}_${width}x${height}`;
+}
+
+/**
+ * Run the CPU-heavy part of image processing on the worker pool
+ * @param {Buffer} originalBuffer - Original image bytes (moved to the worker, unusable afterwards)
+ * @param {number} width - Output width
+ * @param {number} height - Output height
+ * @param {boolean} wantPlaceholder - Also compute the BlurHash
+ * @returns {Promise<Object>} { rgb565: Buffer, placeholder: string|null }
+ * @throws error.code 'POOL_SATURATED' when the queue is full
+ */
+async function render(originalBuffer, width, height, wantPlaceholder) {
+    const options = { placeholder: wantPlaceholder, dither: IMAGE_DITHER };
+    const started = performance.now();
+    if (!imagePool) {
+        const rendered = await renderImage(originalBuffer, width, height, options);
+        imageProcessingDuration.observe(performance.now() - started, { mode: 'main_thread' });
+        return rendered;
+    }
     
-    // Check cache first (unless nocache is requested)
-    if (!nocache && imageCache.has(cacheKey)) {
-        const cachedImage = imageCache.get(cacheKey);
-        console.log(`[${TAG}] Cache HIT: Serving cached image ${cacheKey} for URL: ${imageUrl}`);
-        return reply
-            .type(cachedImage.contentType)
-            .send(cachedImage.buffer);
-    } else if (!nocache) {
-        console.log(`[${TAG}] Cache MISS: Processing new image ${cacheKey} for URL: ${imageUrl}`);
+    // Transfer rather than copy when the buffer owns its whole ArrayBuffer
+    const owned = originalBuffer.byteOffset === 0 && originalBuffer.byteLength === originalBuffer.buffer.byteLength;
+    const original = owned ? originalBuffer.buffer : originalBuffer;
+    const result = await imagePool.run({ original, width, height, options }, owned ? [original] : []);
+    imageProcessingDuration.observe(performance.now() - started, { mode: 'worker' });
+    
+    return {
+        rgb565: Buffer.from(result.rgb565.buffer, result.rgb565.byteOffset, result.rgb565.byteLength),
+        placeholder: result.placeholder
+    };
+}
+
+/**
+ * Download an image once and produce both the RGB565 thumbnail and its placeholder
+ * @param {string} imageUrl - Source image URL
+ * @param {number} width - Output width
+ * @param {number} height - Output height
+ * @param {boolean} nocache - Skip storing the result in the image cache
+ * @returns {Promise<Object>} Processed image entry, or null if the source is missing
+ */
+async function processImage(imageUrl, width, height, nocache) {
+    const startTime = Date.now();
+    
+    const originalBuffer = await fetchImage(imageUrl);
+    if (!originalBuffer) {
+        return null;
+    }
+    
+    const originalSize = originalBuffer.length;
+    const knownPlaceholder = placeholderCache.get(imageUrl);
+    const rendered = await render(originalBuffer, width, height, !knownPlaceholder);
+    const rgb565Buffer = rendered.rgb565;
+    const placeholder = knownPlaceholder || rendered.placeholder;
+    
+    log.debug(`[${TAG}] RGB565 data: ${rgb565Buffer.length} bytes (${Math.round(rgb565Buffer.length * 100 / originalSize)}% of original) in ${Date.now() - startTime}ms`);
+    
+    if (placeholder && !placeholderCache.has(imageUrl)) {
+        // Bounded insertion-order eviction; entries are ~30 bytes each
+        if (placeholderCache.size >= PLACEHOLDER_CACHE_MAX) {
+            placeholderCache.delete(placeholderCache.keys().next().value);
+        }
+        placeholderCache.set(imageUrl, placeholder);
+    }
+    
+    const entry = {
+        buffer: rgb565Buffer,
+        contentType: 'application/octet-stream',
+        width: width,
+        height: height,
+        placeholder: placeholder,
+        etag: contentEtag(rgb565Buffer),
+        timestamp: Date.now(),
+        originalUrl: imageUrl
+    };
+    
+    // Cache the RGB565 data (expires in 1 hour) unless nocache requested
+    if (!nocache) {
+        imageCache.set(imageCacheKey(imageUrl, width, height), entry);
+    }
+    
+    return entry;
+}
+
+/**
+ * Get a processed image, sharing work with any in-flight fetch of the same image
+ *
+ * Prewarmed lookups and later HTTP requests attach to the same promise, so the
+ * upstream fetch and Sharp conversion run once no matter who asks first.
+ *
+ * @param {string} imageUrl - Source image URL
+ * @param {number} width - Output width
+ * @param {number} height - Output height
+ * @param {boolean} nocache - Bypass cache and in-flight sharing
+ * @returns {Promise<Object>} Processed image entry, or null if the source is missing
+ */
+function getImage(imageUrl, width, height, nocache = false) {
+    if (nocache) {
+        return processImage(imageUrl, width, height, true);
+    }
+    
+    const cacheKey = imageCacheKey(imageUrl, width, height);
+    
+    if (imageCache.has(cacheKey)) {
+        return Promise.resolve(imageCache.get(cacheKey));
+    }
+    
+    if (inflightImages.has(cacheKey)) {
+        return inflightImages.get(cacheKey);
+    }
+    
+    // Evicted images may still be on disk; that beats another fetch and convert
+    const promise = imageCache.load(cacheKey)
+        .then(entry => entry || processImage(imageUrl, width, height, false))
+        .finally(() => inflightImages.delete(cacheKey));
+    inflightImages.set(cacheKey, promise);
+    imageStats.peakInflight = Math.max(imageStats.peakInflight, inflightImages.size);
+    
+    return promise;
+}
+
+/**
+ * Start fetching and converting a product image before the device asks for it
+ * @param {string} imageUrl - Source image URL
+ */
+function prewarmImage(imageUrl) {
+    const cacheKey = imageCacheKey(imageUrl, DEVICE_IMAGE_SIZE, DEVICE_IMAGE_SIZE);
+    if (imageCache.has(cacheKey) || inflightImages.has(cacheKey)) {
+        return;
+    }
+    
+    imageStats.prewarmed++;
+    prewarmStarted.set(cacheKey, Date.now());
+    getImage(imageUrl, DEVICE_IMAGE_SIZE, DEVICE_IMAGE_SIZE).catch(error => {
+        console.error(`[${TAG}] Image prewarm failed for ${imageUrl}: ${error.message}`);
+    });
+}
+
+/**
+ * Wait for a prewarmed image's placeholder without delaying the lookup response
+ * past PLACEHOLDER_TIMEOUT_MS
+ * @param {string} imageUrl - Source image URL
+ * @returns {Promise<string>} BlurHash or null on timeout/failure
+ */
+async function placeholderWithTimeout(imageUrl) {
+    if (placeholderCache.has(imageUrl)) {
+        return placeholderCache.get(imageUrl);
+    }
+    
+    let timeoutId;
+    const timeout = new Promise(resolve => {
+        timeoutId = setTimeout(() => resolve(null), PLACEHOLDER_TIMEOUT_MS);
+    });
+    
+    // Without prewarming the placeholder gets a fetch of its own, as it did before
+    const processing = IMAGE_PREWARM
+        ? getImage(imageUrl, DEVICE_IMAGE_SIZE, DEVICE_IMAGE_SIZE)
+        : processImage(imageUrl, DEVICE_IMAGE_SIZE, DEVICE_IMAGE_SIZE, true);
+    try {
+        const hash = await Promise.race([
+            processing
+                .then(image => image ? image.placeholder : null)
+                .catch(() => null),
+            timeout
+        ]);
+        if (hash) {
+            log.debug(`[${TAG}] Placeholder for ${imageUrl}: ${hash}`);
+        }
+        return hash;
+    } finally {
+        clearTimeout(timeoutId);
+    }
+}
+
+/**
+ * Check an If-None-Match header against a strong ETag
+ * @param {string} header - If-None-Match value (may list several tags)
+ * @param {string} etag - Current ETag
+ * @returns {boolean} True if the client's copy is current
+ */
+function etagMatches(header, etag) {
+    if (!header || !etag) {
+        return false;
     }
+    // Weak comparison per RFC 9110: a W/ prefix still matches the same bytes
+    return header.split(',').some(tag => {
+        const value = tag.trim();
+        return value === '*' || value.replace(/^W\//, '') === etag;
+    });
+}
+
+// Image proxy endpoint with Sharp resizing
+fastify.get('/image/:imageId', async (request, reply) => {
+    const imageId = request.params.imageId;
+    const imageUrl = request.query.url;
+    const width = parseInt(request.query.w) || DEVICE_IMAGE_SIZE;  // Default to 80x80 for ESP32
+    const height = parseInt(request.query.h) || DEVICE_IMAGE_SIZE;
+    const nocache = request.query.nocache === '1';
+    
+    log.debug(`[${TAG}] Proxying image: ${imageId} (${width}x${height}) from ${imageUrl}${nocache ? ' [NOCACHE]' : ''}`);
     
     if (!imageUrl) {
         console.error(`[${TAG}] No URL provided for image ${imageId}`);
         return reply.code(400).send('Missing image URL');
     }
     
+    const cacheKey = imageCacheKey(imageUrl, width, height);
+    const requestTime = Date.now();
+    
+    // Classify how this request was served so prewarming can be measured
+    let servedFrom = 'miss';
+    if (!nocache && imageCache.has(cacheKey)) {
+        servedFrom = 'cache';
+        imageStats.cacheHits++;
+    } else if (!nocache && inflightImages.has(cacheKey)) {
+        servedFrom = 'inflight';
+        imageStats.attached++;
+    } else {
+        imageStats.misses++;
+    }
+    
     try {
-        // Download original image
-        console.log(`[${TAG}] Downloading image from: ${imageUrl}`);
-        const controller = new AbortController();
-        const timeoutId = setTimeout(() => controller.abort(), REQUEST_TIMEOUT_MS);
-        
-        const response = await fetch(imageUrl, {
-            method: 'GET',
-            signal: controller.signal,
-            headers: {
-                'User-Agent': 'ESP32-Barcode-Scanner-Proxy/1.0'
-            }
-        });
-        
-        clearTimeout(timeoutId);
-        
-        if (!response.ok) {
-            console.error(`[${TAG}] Image download failed: ${response.status} ${response.statusText}`);
+        const image = await getImage(imageUrl, width, height, nocache);
+        if (!image) {
             return reply.code(404).send('Image not found');
         }
         
-        const originalBuffer = Buffer.from(await response.arrayBuffer());
-        console.log(`[${TAG}] Original image: ${originalBuffer.length} bytes`);
-        
-        // Convert to raw RGB565 format for LVGL
-        const rawBuffer = await sharp(originalBuffer)
-            .resize(width, height, {
-                fit: 'cover',        // Cover the entire area
-                position: 'center'   // Center the image
-            })
-            .raw()                   // Get raw RGB888 data
-            .toBuffer();
-        
-        console.log(`[${TAG}] Raw RGB888 data: ${rawBuffer.length} bytes`);
+        const waitMs = Date.now() - requestTime;
+        const prewarmTime = prewarmStarted.get(cacheKey);
+        prewarmStarted.delete(cacheKey);
+        log.debug(`[${TAG}] Served image ${cacheKey} from ${servedFrom} after ${waitMs}ms` +
+            (prewarmTime ? ` (prewarm started ${requestTime - prewarmTime}ms before request)` : ''));
         
-        // Convert RGB888 to RGB565 with correct byte order for ESP32/LVGL
-        const rgb565Buffer = Buffer.alloc(width * height * 2);
-        for (let i = 0, j = 0; i < rawBuffer.length; i += 3, j += 2) {
-            const r = rawBuffer[i] >> 3;     // 5 bits for red (0-31)
-            const g = rawBuffer[i + 1] >> 2; // 6 bits for green (0-63)  
-            const b = rawBuffer[i + 2] >> 3; // 5 bits for blue (0-31)
-            
-            // RGB565 format: RRRRRGGG GGGBBBBB
-            const rgb565 = (r << 11) | (g << 5) | b;
-            
-            // Try big-endian byte order (high byte first)
-            rgb565Buffer[j] = (rgb565 >> 8) & 0xFF;     // High byte first
-            rgb565Buffer[j + 1] = rgb565 & 0xFF;        // Low byte second
-        }
-        
-        // Log first few pixels for debugging
-        if (rgb565Buffer.length >= 8) {
-            console.log(`[${TAG}] First 4 RGB565 pixels: ${rgb565Buffer.subarray(0, 8).toString('hex')}`);
-        }
-        
-        console.log(`[${TAG}] RGB565 data: ${rgb565Buffer.length} bytes (${Math.round(rgb565Buffer.length * 100 / originalBuffer.length)}% of original)`);
-        
-        // Cache the RGB565 data (expires in 1 hour) unless nocache requested
-        if (!nocache) {
-            imageCache.set(cacheKey, {
-                buffer: rgb565Buffer,
-                contentType: 'application/octet-stream',
-                width: width,
-                height: height,
-                timestamp: Date.now(),
-                originalUrl: imageUrl
-            });
-            console.log(`[${TAG}] Cached image ${cacheKey} for URL: ${imageUrl}`);
-        } else {
-            console.log(`[${TAG}] Skipping cache for ${cacheKey} (nocache requested)`);
+        // The device already has these exact pixels
+        if (etagMatches(request.headers['if-none-match'], image.etag)) {
+            imageStats.notModified++;
+            log.debug(`[${TAG}] Image ${cacheKey} not modified (${image.etag})`);
+            return reply.code(304).header('ETag', image.etag).send();
         }
         
         return reply
@@ -158,9 +535,15 @@ fastify.get('/image/:imageId', async (request, reply) => {
             .header('X-Image-Format', 'RGB565')
             .header('X-Image-Width', width.toString())
             .header('X-Image-Height', height.toString())
-            .send(rgb565Buffer);
+            .header('ETag', image.etag)
+            .send(image.buffer);
         
     } catch (error) {
+        if (error.code === 'POOL_SATURATED') {
+            // Shed load early; the device shows the placeholder and can retry
+            log.debug(`[${TAG}] Image workers saturated, rejecting ${imageId}`);
+            return reply.code(503).header('Retry-After', '1').send('Image workers busy');
+        }
         if (error.name === 'AbortError') {
             console.error(`[${TAG}] Image download timeout: ${imageUrl}`);
         } else {
@@ -170,6 +553,234 @@ fastify.get('/image/:imageId', async (request, reply) => {
     }
 });
 
+/**
+ * Batcher stats plus API calls per device lookup (the cache and the batcher both cut this)
+ */
+function upstreamStats() {
+    const batcher = upstreamBatcher.stats();
+    const lookups = productCache.stats().lookups;
+    return {
+        ...batcher,
+        callsPerDeviceLookup: lookups > 0 ? batcher.upstreamCalls / lookups : 0
+    };
+}
+
+function currentStats() {
+    return {
+        products: productCache.stats(),
+        upstream: upstreamStats(),
+        providers: hedgedLookup.stats(),
+        limiter: upstreamLimiter ? upstreamLimiter.stats() : null,
+        http: upstreamHttp.stats(),
+        images: { ...imageStats, ...imageCache.stats(), inflight: inflightImages.size },
+        workers: imagePool ? imagePool.stats() : null,
+        requests: requestLedger.stats(),
+        coap: coapServer ? coapServer.stats() : null
+    };
+}
+
+/**
+ * Local report for /stats or /metrics; cluster workers label theirs with the slot
+ * @param {string} what - 'stats' or 'metrics'
+ */
+function localReport(what) {
+    if (what === 'stats') {
+        return currentStats();
+    }
+    return metrics.render(CLUSTER_CHILD ? { process: RESOLVER_SLOT } : {});
+}
+
+// Port 3000 is shared in cluster mode, so whichever worker answers asks the
+// primary to gather every worker's report: { slot, body } per live process
+const pendingCollections = new Map();
+let nextCollectionId = 0;
+
+function collectReports(what) {
+    if (!CLUSTER_CHILD || !process.connected) {
+        return Promise.resolve([{ slot: RESOLVER_SLOT, body: localReport(what) }]);
+    }
+    const id = nextCollectionId++;
+    return new Promise((resolve) => {
+        const timer = setTimeout(() => {
+            pendingCollections.delete(id);
+            console.warn(`[${TAG}] No cluster ${what} from the primary, answering with this process only`);
+            resolve([{ slot: RESOLVER_SLOT, body: localReport(what) }]);
+        }, CLUSTER_COLLECT_TIMEOUT_MS);
+        pendingCollections.set(id, (results) => {
+            clearTimeout(timer);
+            resolve(results);
+        });
+        process.send({ type: 'collect', id, what });
+    });
+}
+
+// Cache and upstream metrics; one entry per process in cluster mode
+fastify.get('/stats', async () => {
+    const reports = await collectReports('stats');
+    if (!CLUSTER_CHILD) {
+        return reports[0].body;
+    }
+    return { processes: reports.map(({ slot, body }) => ({ process: slot, ...body })) };
+});
+
+// Counters and gauges for /metrics, read from the same stats() as /stats at scrape time
+metrics.collect(() => {
+    const products = productCache.stats();
+    const images = imageCache.stats();
+    const upstream = upstreamBatcher.stats();
+    const requests = requestLedger.stats();
+    const imageRequests = imageStats.cacheHits + imageStats.attached + imageStats.misses;
+    return [
+        labelled('barcode_product_cache_lookups_total', 'Product cache lookups by outcome', 'counter', 'outcome', {
+            memory_hit: products.memoryHits,
+            disk_hit: products.diskHits,
+            stale_hit: products.staleHits,
+            stale_rate_limited: products.staleRateLimited,
+            coalesced: products.coalesced,
+            miss: products.misses
+        }),
+        { name: 'barcode_product_cache_stale_on_error_total', help: 'Misses answered with an expired entry because the upstream failed', type: 'counter', value: products.staleOnError },
+        { name: 'barcode_product_cache_hit_ratio', help: 'Share of product lookups answered from cache', type: 'gauge', value: products.hitRatio },
+        labelled('barcode_product_cache_entries', 'Product cache entries by tier', 'gauge', 'tier', {
+            memory: products.memoryEntries,
+            disk: products.diskEntries
+        }),
+        labelled('barcode_image_requests_total', 'Device image requests by how they were served', 'counter', 'served_from', {
+            cache: imageStats.cacheHits,
+            inflight: imageStats.attached,
+            miss: imageStats.misses
+        }),
+        { name: 'barcode_image_not_modified_total', help: 'Image revalidations answered with 304', type: 'counter', value: imageStats.notModified },
+        { name: 'barcode_image_prewarms_total', help: 'Images fetched ahead of the device request', type: 'counter', value: imageStats.prewarmed },
+        { name: 'barcode_image_inflight_peak', help: 'Most image fetches in flight at once since start', type: 'gauge', value: imageStats.peakInflight },
+        {
+            name: 'barcode_image_cache_hit_ratio',
+            help: 'Share of device image requests served from a finished or in-flight result',
+            type: 'gauge',
+            value: imageRequests > 0 ? (imageStats.cacheHits + imageStats.attached) / imageRequests : 0
+        },
+        { name: 'barcode_image_cache_bytes', help: 'RGB565 bytes held in the image cache', type: 'gauge', value: images.bytes },
+        labelled('barcode_inflight', 'Work currently in flight', 'gauge', 'kind', {
+            device_requests: inflightRequests,
+            product_lookups: products.inflight,
+            upstream_batches: upstream.inflight,
+            image_fetches: inflightImages.size
+        }),
+        { name: 'barcode_upstream_api_calls_total', help: 'Lookup API calls (batched)', type: 'counter', value: upstream.upstreamCalls },
+        { name: 'barcode_upstream_api_codes_total', help: 'Barcodes sent to the lookup API', type: 'counter', value: upstream.upstreamCodes },
+        { name: 'barcode_upstream_api_errors_total', help: 'Failed lookup API calls', type: 'counter', value: upstream.upstreamErrors },
+        { name: 'barcode_product_peer_fills_total', help: 'Products received from other resolver instances', type: 'counter', value: products.peerFills },
+        { name: 'barcode_product_peer_rejects_total', help: 'Shared products dropped as malformed or from the future', type: 'counter', value: products.peerRejects },
+        labelled('barcode_requests_total', 'Device requests by ledger outcome', 'counter', 'outcome', {
+            processed: requests.claimed,
+            duplicate_resent: requests.resent,
+            duplicate_dropped: requests.dropped,
+            taken_over: requests.takenOver
+        })
+    ];
+});
+
+metrics.collect(() => {
+    const hedging = hedgedLookup.stats();
+    const pools = upstreamHttp.stats();
+    const collected = [
+        { name: 'barcode_hedged_requests_total', help: 'Extra provider requests started by hedging', type: 'counter', value: hedging.hedged },
+        {
+            name: 'barcode_provider_rank',
+            help: 'Order in which providers are asked (1 = first)',
+            type: 'gauge',
+            samples: Object.entries(hedging.providers).map(([provider, p]) => ({ labels: { provider }, value: p.rank }))
+        },
+        {
+            name: 'barcode_upstream_connections_total',
+            help: 'Upstream HTTP requests by origin and whether a keep-alive socket was reused',
+            type: 'counter',
+            samples: Object.entries(pools.origins).flatMap(([origin, p]) => [
+                { labels: { origin, socket: 'reused' }, value: p.reused },
+                { labels: { origin, socket: 'new' }, value: p.connections }
+            ])
+        },
+        {
+            name: 'barcode_upstream_http_errors_total',
+            help: 'Upstream HTTP failures by origin (timeouts included)',
+            type: 'counter',
+            samples: Object.entries(pools.origins).map(([origin, p]) => ({ labels: { origin }, value: p.errors }))
+        }
+    ];
+
+    if (upstreamLimiter) {
+        const limiter = upstreamLimiter.stats();
+        collected.push(
+            labelled('barcode_upstream_limiter_decisions_total', 'Rate limiter decisions', 'counter', 'decision', {
+                admitted: limiter.admitted,
+                granted_after_wait: limiter.granted,
+                rejected_queue_full: limiter.rejectedQueueFull,
+                rejected_device_limit: limiter.rejectedDeviceLimit,
+                rejected_timeout: limiter.rejectedTimeout
+            }),
+            labelled('barcode_upstream_limiter_queued', 'Lookups waiting for an upstream token', 'gauge', 'priority', {
+                interactive: limiter.queuedInteractive,
+                batch: limiter.queuedBatch
+            }),
+            { name: 'barcode_upstream_limiter_tokens', help: 'Upstream tokens available now', type: 'gauge', value: limiter.tokens }
+        );
+    }
+
+    if (imagePool) {
+        const workers = imagePool.stats();
+        collected.push(
+            labelled('barcode_image_workers', 'Image worker threads by state', 'gauge', 'state', {
+                busy: workers.busy,
+                idle: workers.size - workers.busy
+            }),
+            { name: 'barcode_image_worker_queue', help: 'Image jobs waiting for a worker', type: 'gauge', value: workers.queued },
+            { name: 'barcode_image_worker_rejected_total', help: 'Image jobs shed with 503', type: 'counter', value: workers.rejected }
+        );
+    }
+
+    if (coapServer) {
+        const coap = coapServer.stats();
+        collected.push(
+            labelled('barcode_coap_messages_total', 'CoAP messages by kind', 'counter', 'kind', {
+                request: coap.requests,
+                duplicate: coap.duplicates,
+                separate_response: coap.separate,
+                retransmit: coap.retransmits,
+                undelivered: coap.undelivered,
+                block: coap.blocks
+            }),
+            labelled('barcode_coap_datagrams_total', 'CoAP datagrams by direction', 'counter', 'direction', {
+                in: coap.datagramsIn,
+                out: coap.datagramsOut
+            })
+        );
+    }
+    return collected;
+});
+
+metrics.collect(() => {
+    const memory = process.memoryUsage();
+    return [
+        {
+            name: 'nodejs_eventloop_delay_seconds',
+            help: 'Event loop delay since start',
+            type: 'gauge',
+            // The sampler's own timer interval is included in every reading
+            samples: [0.5, 0.9, 0.99].map(q => ({
+                labels: { quantile: q },
+                value: Math.max(0, eventLoopDelay.percentile(q * 100) / 1e6 - EVENT_LOOP_RESOLUTION_MS) / 1000
+            }))
+        },
+        { name: 'process_resident_memory_bytes', help: 'Resident set size', type: 'gauge', value: memory.rss },
+        { name: 'nodejs_heap_used_bytes', help: 'V8 heap in use', type: 'gauge', value: memory.heapUsed }
+    ];
+});
+
+fastify.get('/metrics', async (request, reply) => {
+    const reports = await collectReports('metrics');
+    return reply.type('text/plain; version=0.0.4').send(mergeExpositions(reports.map(({ body }) => body)));
+});
+
 // Start Fastify server
 const startServer = async () => {
     try {
@@ -185,89 +796,294 @@ startServer();
 // Clean cache every 30 minutes
 setInterval(() => {
     const now = Date.now();
-    let cleanedCount = 0;
-    for (const [key, value] of imageCache.entries()) {
-        if (now - value.timestamp > 3600000) { // 1 hour
-            imageCache.delete(key);
-            cleanedCount++;
+    const cleanedCount = imageCache.prune();
+    for (const [key, startedAt] of prewarmStarted.entries()) {
+        if (now - startedAt > 3600000) { // Prewarmed but never requested
+            prewarmStarted.delete(key);
         }
     }
     if (cleanedCount > 0) {
         console.log(`[${TAG}] Cleaned ${cleanedCount} expired images from cache`);
     }
+    const prunedProducts = productCache.prune();
+    if (prunedProducts > 0) {
+        console.log(`[${TAG}] Pruned ${prunedProducts} expired products from disk cache`);
+    }
+    requestLedger.prune();
+    const products = productCache.stats();
+    console.log(`[${TAG}] Product cache: lookups=${products.lookups} hit_ratio=${products.hitRatio.toFixed(2)} ` +
+        `upstream=${products.upstreamCalls} (${products.upstreamCallsPerMinute.toFixed(2)}/min) ` +
+        `coalesced=${products.coalesced} errors=${products.upstreamErrors} peer_fills=${products.peerFills} peer_rejects=${products.peerRejects}`);
+    const requests = requestLedger.stats();
+    console.log(`[${TAG}] Requests: processed=${requests.claimed} duplicates_resent=${requests.resent} ` +
+        `duplicates_dropped=${requests.dropped} taken_over=${requests.takenOver}`);
+    const upstream = upstreamStats();
+    console.log(`[${TAG}] Upstream: calls=${upstream.upstreamCalls} batches=${upstream.batches} ` +
+        `avg_batch=${upstream.avgBatchSize.toFixed(2)} retries=${upstream.singleRetries} ` +
+        `calls_per_lookup=${upstream.callsPerDeviceLookup.toFixed(3)}`);
+    const hedging = hedgedLookup.stats();
+    for (const [name, provider] of Object.entries(hedging.providers)) {
+        console.log(`[${TAG}] Provider ${name}: rank=${provider.rank} requests=${provider.requests} wins=${provider.wins} ` +
+            `not_found=${provider.notFound} errors=${provider.errors} cancelled=${provider.cancelled} ` +
+            `p50=${provider.p50Ms.toFixed(0)}ms p90=${provider.p90Ms.toFixed(0)}ms`);
+    }
+    if (upstreamLimiter) {
+        const limiter = upstreamLimiter.stats();
+        console.log(`[${TAG}] Upstream limiter: admitted=${limiter.admitted} queued=${limiter.queuedTotal} ` +
+            `rejected=${limiter.rejected} peak_queue=${limiter.peakQueue} wait_p99=${limiter.waitP99Ms.toFixed(0)}ms ` +
+            `stale_served=${products.staleRateLimited} refreshes_skipped=${products.refreshesSkipped}`);
+    }
+    const closedPools = upstreamHttp.prune(UPSTREAM_POOL_IDLE_MS);
+    const pools = upstreamHttp.stats();
+    console.log(`[${TAG}] Upstream connections: requests=${pools.requests} reused=${pools.reused} ` +
+        `new=${pools.connections} prewarmed=${pools.prewarmedSockets} reuse_rate=${pools.reuseRate.toFixed(2)} ` +
+        `pools=${pools.pools} closed=${closedPools}`);
+    const images = imageCache.stats();
+    console.log(`[${TAG}] Image stats: prewarmed=${imageStats.prewarmed} cache=${imageStats.cacheHits} ` +
+        `attached=${imageStats.attached} miss=${imageStats.misses} not_modified=${imageStats.notModified} ` +
+        `peak_inflight=${imageStats.peakInflight} cached=${images.entries} (${Math.round(images.bytes / 1024)} KB) ` +
+        `evicted=${images.evictions} spilled=${images.spilledEntries}`);
 }, 1800000); // 30 minutes
 
 /**
- * Lookup barcode using BarcodeLookup API
+ * Fetch a product from the configured providers (BarcodeLookup calls share the batch window)
+ * @param {string} barcode - UPC/EAN barcode to lookup
+ * @returns {Promise<Object>} Essential product fields, or null if no provider has the product
+ * @throws On timeouts and provider errors, so failures are never cached as "not found"
+ */
+function fetchProduct(barcode) {
+    return hedgedLookup.lookup(barcode);
+}
+
+function syncSignature(body) {
+    return crypto.createHmac('sha256', RESOLVER_SYNC_SECRET).update(body).digest();
+}
+
+/**
+ * Broadcast an upstream result so the other instances don't pay for the same lookup.
+ * Signed with RESOLVER_SYNC_SECRET: any broker client can publish on the topic.
+ * @param {string} barcode - UPC/EAN barcode
+ * @param {Object} entry - Product cache entry
+ */
+function shareProduct(barcode, entry) {
+    const body = JSON.stringify({
+        from: MQTT_CLIENT_ID,
+        barcode,
+        product: entry.product,
+        fetchedAt: entry.fetchedAt,
+        expiresAt: entry.expiresAt
+    });
+    client.publish(`${CACHE_SYNC_TOPIC}/${barcode}`, JSON.stringify({
+        body,
+        hmac: syncSignature(body).toString('hex')
+    }), { qos: 0 });
+}
+
+/**
+ * Merge a product another instance fetched into the local cache; the
+ * product cache checks the entry itself
+ * @param {string} topic - barcode/resolver/cache/{barcode}
+ * @param {Buffer} message - Entry published by shareProduct
+ */
+function acceptSharedProduct(topic, message) {
+    const barcode = topic.slice(CACHE_SYNC_TOPIC.length + 1);
+    try {
+        const { body, hmac } = JSON.parse(message.toString());
+        const expected = syncSignature(String(body));
+        const received = Buffer.from(String(hmac), 'hex');
+        if (received.length !== expected.length || !crypto.timingSafeEqual(received, expected)) {
+            console.warn(`[${TAG}] Ignoring unsigned shared product on ${topic}`);
+            return;
+        }
+        const shared = JSON.parse(body);
+        if (shared.from === MQTT_CLIENT_ID) {
+            return;
+        }
+        if (shared.barcode !== barcode) {
+            console.warn(`[${TAG}] Ignoring shared product for ${shared.barcode} on ${topic}`);
+            return;
+        }
+        productCache.accept(barcode, {
+            product: shared.product,
+            fetchedAt: shared.fetchedAt,
+            expiresAt: shared.expiresAt
+        });
+    } catch (error) {
+        console.error(`[${TAG}] Ignoring malformed shared product on ${topic}: ${error.message}`);
+    }
+}
+
+/**
+ * Lookup barcode through the product cache
  * @param {string} barcode - UPC/EAN barcode to lookup
+ * @param {Object} context - { deviceId, priority } for upstream rate limiting
  * @returns {Promise<Object>} Product information or null if not found
  */
-async function lookupBarcode(barcode) {
-    const url = `${BARCODE_API_BASE}?barcode=${barcode}&formatted=y&key=${process.env.BARCODELOOKUP_API_KEY}`;
-    
-    console.log(`[${TAG}] Looking up barcode: ${barcode}`);
+async function lookupBarcode(barcode, context = {}) {
+    log.debug(`[${TAG}] Looking up barcode: ${barcode}`);
     
+    let cached;
     try {
-        const controller = new AbortController();
-        const timeoutId = setTimeout(() => controller.abort(), REQUEST_TIMEOUT_MS);
-        
-        const response = await fetch(url, {
-            method: 'GET',
-            signal: controller.signal,
-            headers: {
-                'User-Agent': 'ESP32-Barcode-Scanner/1.0'
+        cached = await productCache.get(barcode, context);
+    } catch (error) {
+        if (error.code === 'RATE_LIMITED') {
+            console.error(`[${TAG}] Rate limited lookup of ${barcode} for ${context.deviceId}: ${error.message}`);
+        } else if (error.name === 'AbortError') {
+            console.error(`[${TAG}] API request timeout for barcode: ${barcode}`);
+        } else {
+            console.error(`[${TAG}] API error for barcode ${barcode}:`, error.message);
+        }
+        return null;
+    }
+    
+    if (!cached) {
+        return null;
+    }
+    
+    const sourceImage = cached.source_image;
+    
+    // Start fetching the image now; the device will ask for it right after this response
+    if (sourceImage && IMAGE_PREWARM) {
+        prewarmImage(sourceImage);
+    }
+    
+    // Return only essential data to prevent ESP32 memory issues
+    return {
+        name: cached.name,
+        brand: cached.brand,
+        model: cached.model,
+        price: cached.price,
+        image_url: sourceImage
+            ? `http://desk.local:${HTTP_PROXY_PORT}/image/${crypto.createHash('md5').update(sourceImage).digest('hex').substring(0, 16)}?url=${encodeURIComponent(sourceImage)}&w=${DEVICE_IMAGE_SIZE}&h=${DEVICE_IMAGE_SIZE}`
+            : null,
+        placeholder: sourceImage ? await placeholderWithTimeout(sourceImage) : null,
+        upc: cached.upc
+    };
+}
+
+/**
+ * Recover the original image URL from a product's proxy image_url
+ * @param {Object} product - Product returned by lookupBarcode
+ * @returns {string} Source image URL or null
+ */
+function sourceImageUrl(product) {
+    if (!product || !product.image_url) {
+        return null;
+    }
+    return new URL(product.image_url).searchParams.get('url');
+}
+
+/**
+ * Publish one binary image chunk to a device
+ * @returns {Promise<void>} Resolves once the broker has acknowledged the chunk
+ */
+function publishImageChunk(imageTopic, requestId, totalSize, offset, width, height, payload) {
+    const header = Buffer.alloc(INLINE_HEADER_SIZE);
+    header.writeUInt32BE(requestId >>> 0, 0);
+    header.writeUInt32BE(totalSize, 4);
+    header.writeUInt32BE(offset, 8);
+    header.writeUInt16BE(width, 12);
+    header.writeUInt16BE(height, 14);
+    
+    const started = performance.now();
+    return new Promise((resolve, reject) => {
+        client.publish(imageTopic, Buffer.concat([header, payload]), { qos: 1 }, error => {
+            mqttPublishDuration.observe(performance.now() - started, { kind: 'image_chunk' });
+            if (error) {
+                reject(error);
+            } else {
+                resolve();
             }
         });
-        
-        clearTimeout(timeoutId);
-        
-        if (!response.ok) {
-            console.error(`[${TAG}] API request failed: ${response.status} ${response.statusText}`);
-            return null;
+    });
+}
+
+/**
+ * Deliver the product thumbnail as binary MQTT chunks on {responseTopic}/image
+ *
+ * The device reassembles chunks straight into its image buffer. A chunk with
+ * total_size 0 tells the device there is no image so it can stop waiting.
+ *
+ * @param {string} responseTopic - Device response topic
+ * @param {number} requestId - Device request ID (echoed in every chunk header)
+ * @param {string} imageUrl - Source image URL
+ * @param {number} lookupStart - Request start time for time-to-image logging
+ */
+async function publishInlineImage(responseTopic, requestId, imageUrl, lookupStart) {
+    const imageTopic = `${responseTopic}/image`;
+    
+    let image = null;
+    try {
+        // Usually already finished or in flight thanks to the lookup prewarm
+        image = await getImage(imageUrl, DEVICE_IMAGE_SIZE, DEVICE_IMAGE_SIZE);
+    } catch (error) {
+        console.error(`[${TAG}] Inline image processing failed: ${error.message}`);
+    }
+    
+    try {
+        if (!image) {
+            await publishImageChunk(imageTopic, requestId, 0, 0, 0, 0, Buffer.alloc(0));
+            return;
         }
         
-        const data = await response.json();
-        
-        // Log the raw API response for debugging
-        console.log(`[${TAG}] Raw API response:`, JSON.stringify(data, null, 2));
-        
-        if (data.products && data.products.length > 0) {
-            const product = data.products[0];
-            
-            // Log detailed product information
-            console.log(`[${TAG}] Product details:`, JSON.stringify(product, null, 2));
-            console.log(`[${TAG}] Images array:`, product.images);
-            console.log(`[${TAG}] Selected image URL:`, product.images?.[0]);
-            
-            console.log(`[${TAG}] Found product: "${product.title || product.product_name || 'Unknown'}" by ${product.brand || 'Unknown Brand'} (Model: ${product.mpn || product.model || 'N/A'})`);
-            
-            // Return only essential data to prevent ESP32 memory issues
-            return {
-                name: product.title || product.product_name || 'Unknown Product',
-                brand: product.brand || 'Unknown Brand', 
-                model: product.mpn || product.model || '',
-                price: product.stores && product.stores.length > 0 
-                    ? `$${product.stores[0].price || 'N/A'}` 
-                    : 'Price N/A',
-                image_url: product.images && Array.isArray(product.images) && product.images.length > 0 
-                    ? (typeof product.images[0] === 'string' ? 
-                        `http://desk.local:${HTTP_PROXY_PORT}/image/${crypto.createHash('md5').update(product.images[0]).digest('hex').substring(0, 16)}?url=${encodeURIComponent(product.images[0])}&w=80&h=80` 
-                        : null) : null,
-                upc: product.barcode_number || barcode
-            };
-        } else {
-            console.log(`[${TAG}] No products found for barcode: ${barcode}`);
-            return null;
+        const buffer = image.buffer;
+        for (let offset = 0; offset < buffer.length; offset += INLINE_CHUNK_SIZE) {
+            const payload = buffer.subarray(offset, Math.min(offset + INLINE_CHUNK_SIZE, buffer.length));
+            await publishImageChunk(imageTopic, requestId, buffer.length, offset, image.width, image.height, payload);
         }
         
+        log.debug(`[${TAG}] Published inline image to ${imageTopic}: ${buffer.length} bytes in ` +
+            `${Math.ceil(buffer.length / INLINE_CHUNK_SIZE)} chunks (${Date.now() - lookupStart}ms after request)`);
     } catch (error) {
-        if (error.name === 'AbortError') {
-            console.error(`[${TAG}] API request timeout for barcode: ${barcode}`);
-        } else {
-            console.error(`[${TAG}] API error for barcode ${barcode}:`, error.message);
-        }
-        return null;
+        console.error(`[${TAG}] Failed to publish inline image:`, error);
+    }
+}
+
+/**
+ * Look up a device request and build the response it expects (shared by the MQTT and CoAP transports)
+ * @param {string} deviceId - Device client ID, for per-device fairness in the upstream limiter
+ * @param {Object} request - { barcode, request_id, image_transport, priority }
+ * @param {string} transport - 'mqtt' or 'coap'; the image follows inline if the device asked for that transport
+ * @returns {Promise<Object>} { response, imageUrl } - imageUrl is set when the image follows over the device's transport
+ */
+async function resolveRequest(deviceId, request, transport) {
+    const { barcode, request_id, image_transport, priority } = request;
+    const startTime = Date.now();
+    const started = performance.now();
+    
+    // Lookup product information
+    // Inventory/batch scans declare themselves; everything else is someone waiting at the screen
+    let product;
+    inflightRequests++;
+    try {
+        product = await lookupBarcode(barcode, {
+            deviceId,
+            priority: priority === 'batch' || priority === 'inventory' ? 'batch' : 'interactive'
+        });
+    } finally {
+        inflightRequests--;
     }
+    
+    const lookupTime = Date.now() - startTime;
+    lookupDuration.observe(performance.now() - started, { result: product ? 'found' : 'not_found' });
+    
+    // Inline delivery needs a numeric request ID to tag the chunks with
+    const imageUrl = sourceImageUrl(product);
+    const inlineImage = INLINE_IMAGES_ENABLED && image_transport === transport &&
+        !!imageUrl && Number.isInteger(request_id);
+    
+    return {
+        response: {
+            request_id: request_id || 'unknown',
+            success: !!product,
+            barcode: barcode,
+            product: product,
+            image_inline: inlineImage,
+            lookup_time_ms: lookupTime,
+            timestamp: Math.floor(Date.now() / 1000)
+        },
+        imageUrl: inlineImage ? imageUrl : null
+    };
 }
 
 /**
@@ -276,6 +1092,7 @@ async function lookupBarcode(barcode) {
  * @param {Buffer} message - Message buffer
  */
 async function handleBarcodeRequest(topic, message) {
+    let ledgerKey = null;
     try {
         // Extract device ID from topic: barcode/lookup/request/{device_id}
         const deviceId = topic.split('/').pop();
@@ -283,56 +1100,166 @@ async function handleBarcodeRequest(topic, message) {
         
         // Parse JSON request
         const request = JSON.parse(message.toString());
-        const { barcode, request_id, timestamp } = request;
+        const { barcode, request_id } = request;
         
         if (!barcode) {
             console.error(`[${TAG}] Missing barcode in request from ${deviceId}`);
             return;
         }
         
-        console.log(`[${TAG}] Processing request ${request_id} from ${deviceId}: ${barcode}`);
-        
-        const startTime = Date.now();
+        // Delivery is at-least-once: a repeated request ID is answered without a second lookup
+        if (request_id !== undefined) {
+            ledgerKey = `${deviceId}:${request_id}`;
+            const claim = requestLedger.claim(ledgerKey);
+            if (claim.state === 'inflight') {
+                log.debug(`[${TAG}] Duplicate request ${request_id} from ${deviceId} already in progress, dropped`);
+                return;
+            }
+            if (claim.state === 'done') {
+                log.debug(`[${TAG}] Duplicate request ${request_id} from ${deviceId}, resending response`);
+                resendResponse(responseTopic, claim.response);
+                return;
+            }
+        }
         
-        // Lookup product information
-        const product = await lookupBarcode(barcode);
+        log.debug(`[${TAG}] Processing request ${request_id} from ${deviceId}: ${barcode}`);
         
-        const lookupTime = Date.now() - startTime;
+        const startTime = Date.now();
+        const { response, imageUrl } = await resolveRequest(deviceId, request, 'mqtt');
+        const { product, lookup_time_ms: lookupTime } = response;
         
-        // Prepare response
-        const response = {
-            request_id: request_id || 'unknown',
-            success: !!product,
-            barcode: barcode,
-            product: product,
-            lookup_time_ms: lookupTime,
-            timestamp: Math.floor(Date.now() / 1000)
-        };
+        const payload = JSON.stringify(response);
+        if (ledgerKey) {
+            requestLedger.complete(ledgerKey, payload);
+        }
         
         // Publish response
-        client.publish(responseTopic, JSON.stringify(response), { qos: 1 }, (error) => {
+        const publishStarted = performance.now();
+        client.publish(responseTopic, payload, { qos: 1 }, (error) => {
+            mqttPublishDuration.observe(performance.now() - publishStarted, { kind: 'response' });
             if (error) {
                 console.error(`[${TAG}] Failed to publish response:`, error);
             } else {
-                console.log(`[${TAG}] Published response to ${deviceId}: ${product ? 'SUCCESS' : 'NOT_FOUND'} (${lookupTime}ms)`);
+                log.debug(`[${TAG}] Published response to ${deviceId}: ${product ? 'SUCCESS' : 'NOT_FOUND'} (${lookupTime}ms)`);
             }
         });
         
+        // Chunks follow the JSON response on the same connection, so they arrive after it
+        if (imageUrl) {
+            publishInlineImage(responseTopic, request_id, imageUrl, startTime);
+        }
+        
     } catch (error) {
         console.error(`[${TAG}] Error processing barcode request:`, error);
+        if (ledgerKey) {
+            requestLedger.release(ledgerKey);
+        }
+    }
+}
+
+/**
+ * Answer a repeated request with the response recorded for it, image chunks included
+ * @param {string} responseTopic - Device response topic
+ * @param {string} payload - Response recorded in the request ledger
+ */
+function resendResponse(responseTopic, payload) {
+    client.publish(responseTopic, payload, { qos: 1 }, (error) => {
+        if (error) {
+            console.error(`[${TAG}] Failed to resend response:`, error);
+        }
+    });
+    
+    const response = JSON.parse(payload);
+    if (response.image_inline) {
+        publishInlineImage(responseTopic, response.request_id, sourceImageUrl(response.product), Date.now());
+    }
+}
+
+/**
+ * Answer a device over CoAP: GET /lookup/{barcode}?d={deviceId} and GET /image/{id}?url=&w=&h=
+ *
+ * The 4-byte token carries the device's request ID. The CoAP layer's
+ * message ID deduplication stands in for the request ledger, and the image
+ * is pulled block by block from /image, which the lookup has already prewarmed.
+ *
+ * @param {Object} request - { method, path, query, token, remote } from CoapServer
+ * @returns {Promise<Object>} { code, payload, contentFormat }
+ */
+async function handleCoapRequest({ method, path, query, token, remote }) {
+    if (method !== COAP_CODE.GET) {
+        return { code: COAP_CODE.METHOD_NOT_ALLOWED };
+    }
+    const [resource, id] = path;
+    
+    // The barcode is one Uri-Path option, '/' and all; more segments mean an older client split it
+    if (resource === 'lookup' && id && path.length === 2) {
+        const deviceId = query.d || remote.address;
+        const request = {
+            barcode: id,
+            request_id: token.length === 4 ? token.readUInt32BE(0) : undefined,
+            image_transport: 'coap',
+            priority: query.p
+        };
+        log.debug(`[${TAG}] CoAP request ${request.request_id} from ${deviceId}: ${id}`);
+        const { response } = await resolveRequest(deviceId, request, 'coap');
+        return { code: COAP_CODE.CONTENT, payload: Buffer.from(JSON.stringify(response)), contentFormat: COAP_CONTENT_FORMAT.JSON };
+    }
+    
+    if (resource === 'image' && query.url) {
+        const width = parseInt(query.w) || DEVICE_IMAGE_SIZE;
+        const height = parseInt(query.h) || DEVICE_IMAGE_SIZE;
+        try {
+            const image = await getImage(decodeURIComponent(query.url), width, height);
+            if (!image) {
+                return { code: COAP_CODE.NOT_FOUND };
+            }
+            return { code: COAP_CODE.CONTENT, payload: image.buffer, contentFormat: COAP_CONTENT_FORMAT.OCTET_STREAM };
+        } catch (error) {
+            if (error.code === 'POOL_SATURATED') {
+                return { code: COAP_CODE.SERVICE_UNAVAILABLE };
+            }
+            console.error(`[${TAG}] CoAP image processing error: ${error.message}`);
+            return { code: COAP_CODE.INTERNAL_ERROR };
+        }
     }
+    
+    return { code: COAP_CODE.NOT_FOUND };
+}
+
+const coapServer = COAP_PORT > 0
+    ? new CoapServer({ port: COAP_PORT, handler: handleCoapRequest, piggybackMs: COAP_PIGGYBACK_MS })
+    : null;
+if (coapServer) {
+    coapServer.listen()
+        .then(() => console.log(`[${TAG}] CoAP lookup endpoint listening on udp/${COAP_PORT}`))
+        .catch(error => console.error(`[${TAG}] Failed to start CoAP endpoint on udp/${COAP_PORT}: ${error.message}`));
 }
 
 // MQTT event handlers
 client.on('connect', () => {
     console.log(`[${TAG}] Connected to MQTT broker`);
     
-    // Subscribe to barcode lookup requests from all devices
-    client.subscribe('barcode/lookup/request/+', { qos: 1 }, (error) => {
+    // Upstream results fetched by the other instances in the group
+    if (CACHE_SYNC) {
+        client.subscribe(`${CACHE_SYNC_TOPIC}/+`, { qos: 0 }, (error) => {
+            if (error) {
+                console.error(`[${TAG}] Failed to subscribe to shared products:`, error);
+            }
+        });
+    }
+    
+    // Cluster workers only publish; the primary owns the subscription and routes requests here
+    if (CLUSTER_CHILD) {
+        console.log(`[${TAG}] Barcode resolver worker ${process.pid} ready!`);
+        return;
+    }
+    
+    // Subscribe to barcode lookup requests from all devices; in a share group each request goes to one instance
+    client.subscribe(REQUEST_SUBSCRIPTION, { qos: 1 }, (error) => {
         if (error) {
             console.error(`[${TAG}] Failed to subscribe:`, error);
         } else {
-            console.log(`[${TAG}] Subscribed to barcode/lookup/request/+`);
+            console.log(`[${TAG}] Subscribed to ${REQUEST_SUBSCRIPTION}`);
             console.log(`[${TAG}] Barcode resolver service ready!`);
         }
     });
@@ -341,9 +1268,27 @@ client.on('connect', () => {
 client.on('message', (topic, message) => {
     if (topic.startsWith('barcode/lookup/request/')) {
         handleBarcodeRequest(topic, message);
+    } else if (topic.startsWith(`${CACHE_SYNC_TOPIC}/`)) {
+        acceptSharedProduct(topic, message);
     }
 });
 
+if (CLUSTER_CHILD) {
+    process.on('message', (message) => {
+        if (message.type === 'report') {
+            process.send({ type: 'report', id: message.id, body: localReport(message.what) });
+        } else if (message.type === 'collected') {
+            const resolve = pendingCollections.get(message.id);
+            if (resolve) {
+                pendingCollections.delete(message.id);
+                resolve(message.results);
+            }
+        } else {
+            handleBarcodeRequest(message.topic, Buffer.from(message.message, 'base64'));
+        }
+    });
+}
+
 client.on('error', (error) => {
     console.error(`[${TAG}] MQTT Error:`, error);
 });
@@ -359,6 +1304,15 @@ client.on('reconnect', () => {
 // Graceful shutdown
 process.on('SIGINT', () => {
     console.log(`\n[${TAG}] Shutting down barcode resolver...`);
+    productCache.close();
+    requestLedger.close();
+    upstreamHttp.close();
+    if (coapServer) {
+        coapServer.close();
+    }
+    if (imagePool) {
+        imagePool.close();
+    }
     client.end(() => {
         console.log(`[${TAG}] Disconnected from MQTT broker`);
         process.exit(0);
@@ -367,6 +1321,15 @@ process.on('SIGINT', () => {
 
 process.on('SIGTERM', () => {
     console.log(`[${TAG}] Received SIGTERM, shutting down...`);
+    productCache.close();
+    requestLedger.close();
+    upstreamHttp.close();
+    if (coapServer) {
+        coapServer.close();
+    }
+    if (imagePool) {
+        imagePool.close();
+    }
     client.end(() => {
         process.exit(0);
     });
@@ -0,0 +1,101 @@
+/**
+ * @file blurhash.js
+ * @brief Minimal BlurHash encoder for lookup-response image placeholders
+ *
+ * Produces the standard BlurHash string (https://blurha.sh) so the ESP32 can
+ * expand it into a low-resolution RGB565 preview while the real image loads.
+ * A 4x3 component hash is 28 characters.
+ */
+
+const BASE83_CHARS = '0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~';
+
+function encode83(value, length) {
+    let result = '';
+    for (let i = 1; i <= length; i++) {
+        const digit = Math.floor(value / Math.pow(83, length - i)) % 83;
+        result += BASE83_CHARS[digit];
+    }
+    return result;
+}
+
+function sRGBToLinear(value) {
+    const v = value / 255;
+    return v <= 0.04045 ? v / 12.92 : Math.pow((v + 0.055) / 1.055, 2.4);
+}
+
+function linearTosRGB(value) {
+    const v = Math.max(0, Math.min(1, value));
+    return v <= 0.0031308
+        ? Math.round(v * 12.92 * 255)
+        : Math.round((1.055 * Math.pow(v, 1 / 2.4) - 0.055) * 255);
+}
+
+function signPow(value, exp) {
+    return Math.sign(value) * Math.pow(Math.abs(value), exp);
+}
+
+/**
+ * Encode raw pixels as a BlurHash string
+ * @param {Buffer} pixels - Raw interleaved pixel data (RGB or RGBA)
+ * @param {number} width - Image width
+ * @param {number} height - Image height
+ * @param {number} componentsX - Horizontal components (1-9)
+ * @param {number} componentsY - Vertical components (1-9)
+ * @param {number} channels - Bytes per pixel (3 or 4)
+ * @returns {string} BlurHash string
+ */
+function encode(pixels, width, height, componentsX = 4, componentsY = 3, channels = 3) {
+    // Linearize once; the basis loop below touches every pixel per component
+    const linear = new Float32Array(width * height * 3);
+    for (let i = 0, p = 0; i < width * height; i++, p += channels) {
+        linear[i * 3] = sRGBToLinear(pixels[p]);
+        linear[i * 3 + 1] = sRGBToLinear(pixels[p + 1]);
+        linear[i * 3 + 2] = sRGBToLinear(pixels[p + 2]);
+    }
+
+    const factors = [];
+    for (let cy = 0; cy < componentsY; cy++) {
+        for (let cx = 0; cx < componentsX; cx++) {
+            const normalisation = (cx === 0 && cy === 0) ? 1 : 2;
+            let r = 0, g = 0, b = 0;
+            for (let y = 0; y < height; y++) {
+                const basisY = Math.cos(Math.PI * cy * y / height);
+                for (let x = 0; x < width; x++) {
+                    const basis = normalisation * Math.cos(Math.PI * cx * x / width) * basisY;
+                    const i = (y * width + x) * 3;
+                    r += basis * linear[i];
+                    g += basis * linear[i + 1];
+                    b += basis * linear[i + 2];
+                }
+            }
+            const scale = 1 / (width * height);
+            factors.push([r * scale, g * scale, b * scale]);
+        }
+    }
+
+    const dc = factors[0];
+    const ac = factors.slice(1);
+
+    let hash = encode83((componentsX - 1) + (componentsY - 1) * 9, 1);
+
+    let maximumValue = 1;
+    if (ac.length > 0) {
+        const actualMaximum = Math.max(...ac.map(f => Math.max(...f.map(Math.abs))));
+        const quantisedMaximum = Math.max(0, Math.min(82, Math.floor(actualMaximum * 166 - 0.5)));
+        maximumValue = (quantisedMaximum + 1) / 166;
+        hash += encode83(quantisedMaximum, 1);
+    } else {
+        hash += encode83(0, 1);
+    }
+
+    hash += encode83((linearTosRGB(dc[0]) << 16) + (linearTosRGB(dc[1]) << 8) + linearTosRGB(dc[2]), 4);
+
+    const quantise = v => Math.max(0, Math.min(18, Math.floor(signPow(v / maximumValue, 0.5) * 9 + 9.5)));
+    for (const f of ac) {
+        hash += encode83(quantise(f[0]) * 19 * 19 + quantise(f[1]) * 19 + quantise(f[2]), 2);
+    }
+
+    return hash;
+}
+
+module.exports = { encode };
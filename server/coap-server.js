@@ -0,0 +1,441 @@
+/**
+ * @file coap-server.js
+ * @brief Minimal CoAP server (RFC 7252) with block-wise responses (RFC 7959)
+ *
+ * Just enough CoAP for the device's direct lookup transport: confirmable GET
+ * requests, a piggybacked response when the handler answers quickly and an
+ * empty ACK followed by a confirmable separate response when it does not,
+ * duplicate detection by message ID, and Block2 slicing of representations
+ * larger than one block, with Size2 on the first block. No observe, no
+ * proxying, no DTLS.
+ *
+ * The message codec is exported so tools can speak the same protocol.
+ */
+
+const dgram = require('dgram');
+
+const TAG = 'coap-server';
+
+const TYPE = { CON: 0, NON: 1, ACK: 2, RST: 3 };
+const CODE = {
+    EMPTY: 0x00,
+    GET: 0x01,
+    CONTENT: 0x45,              // 2.05
+    BAD_REQUEST: 0x80,          // 4.00
+    NOT_FOUND: 0x84,            // 4.04
+    METHOD_NOT_ALLOWED: 0x85,   // 4.05
+    INTERNAL_ERROR: 0xa0,       // 5.00
+    SERVICE_UNAVAILABLE: 0xa3   // 5.03
+};
+const OPTION = { URI_PATH: 11, CONTENT_FORMAT: 12, URI_QUERY: 15, BLOCK2: 23, SIZE2: 28 };
+const CONTENT_FORMAT = { OCTET_STREAM: 42, JSON: 50 };
+const PAYLOAD_MARKER = 0xff;
+
+const ACK_TIMEOUT_MS = 2000;            // RFC 7252 transmission parameters
+const ACK_RANDOM_FACTOR = 1.5;
+const MAX_RETRANSMIT = 4;
+const EXCHANGE_LIFETIME_MS = 247000;    // How long a message ID counts as a duplicate
+const MAX_BLOCK_SZX = 6;                // 1024-byte blocks, the largest RFC 7959 allows
+
+/**
+ * Encode an unsigned option value in the fewest bytes (0 is the empty value)
+ */
+function encodeUint(value) {
+    const bytes = [];
+    for (let v = value; v > 0; v = Math.floor(v / 256)) {
+        bytes.unshift(v & 0xff);
+    }
+    return Buffer.from(bytes);
+}
+
+function decodeUint(buffer) {
+    let value = 0;
+    for (const byte of buffer) {
+        value = value * 256 + byte;
+    }
+    return value;
+}
+
+/**
+ * Option delta or length nibble with its extended bytes
+ */
+function optionNibble(value) {
+    if (value < 13) {
+        return { nibble: value, extended: Buffer.alloc(0) };
+    }
+    if (value < 269) {
+        return { nibble: 13, extended: Buffer.from([value - 13]) };
+    }
+    const extended = Buffer.alloc(2);
+    extended.writeUInt16BE(value - 269);
+    return { nibble: 14, extended };
+}
+
+/**
+ * @param {Object} message - { type, code, messageId, token, options: [{ number, value }], payload }
+ * @returns {Buffer} Datagram
+ */
+function encode(message) {
+    const token = message.token || Buffer.alloc(0);
+    const parts = [Buffer.from([
+        0x40 | (message.type << 4) | token.length,
+        message.code,
+        (message.messageId >> 8) & 0xff,
+        message.messageId & 0xff
+    ]), token];
+
+    const options = [...(message.options || [])].sort((a, b) => a.number - b.number);
+    let previous = 0;
+    for (const { number, value } of options) {
+        const delta = optionNibble(number - previous);
+        const length = optionNibble(value.length);
+        parts.push(Buffer.from([(delta.nibble << 4) | length.nibble]), delta.extended, length.extended, value);
+        previous = number;
+    }
+
+    if (message.payload && message.payload.length > 0) {
+        parts.push(Buffer.from([PAYLOAD_MARKER]), message.payload);
+    }
+    return Buffer.concat(parts);
+}
+
+/**
+ * @param {Buffer} buffer - Datagram
+ * @returns {Object} { type, code, messageId, token, options, payload }
+ * @throws On malformed messages
+ */
+function decode(buffer) {
+    if (buffer.length < 4 || (buffer[0] >> 6) !== 1) {
+        throw new Error('not a CoAP message');
+    }
+    const tokenLength = buffer[0] & 0x0f;
+    if (tokenLength > 8 || buffer.length < 4 + tokenLength) {
+        throw new Error('bad token length');
+    }
+    const message = {
+        type: (buffer[0] >> 4) & 0x03,
+        code: buffer[1],
+        messageId: buffer.readUInt16BE(2),
+        token: buffer.subarray(4, 4 + tokenLength),
+        options: [],
+        payload: Buffer.alloc(0)
+    };
+
+    let position = 4 + tokenLength;
+    let number = 0;
+    const extended = nibble => {
+        if (nibble < 13) {
+            return nibble;
+        }
+        if (nibble === 13) {
+            return buffer[position++] + 13;
+        }
+        if (nibble === 14) {
+            const value = buffer.readUInt16BE(position) + 269;
+            position += 2;
+            return value;
+        }
+        throw new Error('reserved option nibble');
+    };
+    while (position < buffer.length) {
+        if (buffer[position] === PAYLOAD_MARKER) {
+            message.payload = buffer.subarray(position + 1);
+            break;
+        }
+        const header = buffer[position++];
+        number += extended(header >> 4);
+        const length = extended(header & 0x0f);
+        if (position + length > buffer.length) {
+            throw new Error('option overruns message');
+        }
+        message.options.push({ number, value: buffer.subarray(position, position + length) });
+        position += length;
+    }
+    return message;
+}
+
+function optionValues(message, number) {
+    return message.options.filter(option => option.number === number).map(option => option.value);
+}
+
+/**
+ * Block option value: block number, more flag and size exponent (block size = 2^(szx + 4))
+ */
+function encodeBlock(num, more, szx) {
+    return encodeUint(num * 16 + (more ? 8 : 0) + szx);
+}
+
+function decodeBlock(value) {
+    const raw = decodeUint(value);
+    return { num: Math.floor(raw / 16), more: (raw & 0x08) !== 0, szx: raw & 0x07 };
+}
+
+class CoapServer {
+    /**
+     * @param {Object} options
+     * @param {number} options.port - UDP port (5683 is the CoAP default)
+     * @param {Function} options.handler - async ({ method, path, query, token, remote }) => { code, payload, contentFormat }
+     * @param {number} options.piggybackMs - Answer in the ACK if the handler finishes within this, else ACK first
+     * @param {number} options.representationTtlMs - How long a sliced response is kept for its remaining blocks
+     * @param {number} options.maxRepresentations - Sliced responses kept at once
+     */
+    constructor(options) {
+        this.port = options.port;
+        this.handler = options.handler;
+        this.piggybackMs = options.piggybackMs ?? 500;
+        this.representationTtlMs = options.representationTtlMs ?? 30000;
+        this.maxRepresentations = options.maxRepresentations ?? 256;
+
+        this.socket = null;
+        this.nextMessageId = Math.floor(Math.random() * 0x10000);
+        this.exchanges = new Map();        // "address:port:mid" -> { at, reply }; insertion order is age order
+        this.representations = new Map();  // "address:port|uri" -> { payload, contentFormat, at }
+        this.separate = new Map();         // message ID of an unacknowledged separate response -> { timer }
+
+        this.counters = {
+            requests: 0,        // Requests handled (each block counts)
+            duplicates: 0,      // Retransmissions answered from the exchange record
+            separate: 0,        // Responses sent after an empty ACK
+            retransmits: 0,     // Separate responses sent again for lack of an ACK
+            undelivered: 0,     // Separate responses never acknowledged
+            blocks: 0,          // Block2 slices sent
+            malformed: 0,
+            datagramsIn: 0,
+            datagramsOut: 0,
+            bytesOut: 0
+        };
+    }
+
+    listen() {
+        return new Promise((resolve, reject) => {
+            this.socket = dgram.createSocket('udp4');
+            this.socket.on('message', (buffer, remote) => this.onDatagram(buffer, remote));
+            this.socket.once('error', reject);
+            this.socket.bind(this.port, () => {
+                this.socket.removeListener('error', reject);
+                this.socket.on('error', error => console.error(`[${TAG}] Socket error: ${error.message}`));
+                resolve();
+            });
+        });
+    }
+
+    send(datagram, remote) {
+        this.counters.datagramsOut++;
+        this.counters.bytesOut += datagram.length;
+        this.socket.send(datagram, remote.port, remote.address);
+    }
+
+    allocateMessageId() {
+        this.nextMessageId = (this.nextMessageId + 1) & 0xffff;
+        return this.nextMessageId;
+    }
+
+    onDatagram(buffer, remote) {
+        this.counters.datagramsIn++;
+        let message;
+        try {
+            message = decode(buffer);
+        } catch (error) {
+            this.counters.malformed++;
+            return;
+        }
+
+        if (message.type === TYPE.ACK || message.type === TYPE.RST) {
+            const pending = this.separate.get(message.messageId);
+            if (pending) {
+                clearTimeout(pending.timer);
+                this.separate.delete(message.messageId);
+            }
+            return;
+        }
+        if (message.code === CODE.EMPTY) {
+            // CoAP ping: an empty CON is answered with RST
+            if (message.type === TYPE.CON) {
+                this.send(encode({ type: TYPE.RST, code: CODE.EMPTY, messageId: message.messageId }), remote);
+            }
+            return;
+        }
+
+        const key = `${remote.address}:${remote.port}:${message.messageId}`;
+        const seen = this.exchanges.get(key);
+        if (seen) {
+            this.counters.duplicates++;
+            if (seen.reply) {
+                this.send(seen.reply, remote);
+            }
+            return;
+        }
+        const exchange = { at: Date.now(), reply: null };
+        this.exchanges.set(key, exchange);
+        this.pruneExchanges(exchange.at);
+
+        this.respond(message, remote, exchange).catch(error => {
+            console.error(`[${TAG}] Failed to answer ${remote.address}:${remote.port}: ${error.message}`);
+        });
+    }
+
+    /**
+     * Run the handler and answer piggybacked, or with an empty ACK first if it is slow
+     */
+    async respond(message, remote, exchange) {
+        this.counters.requests++;
+        let acknowledged = false;
+        const ackTimer = message.type === TYPE.CON
+            ? setTimeout(() => {
+                acknowledged = true;
+                exchange.reply = encode({ type: TYPE.ACK, code: CODE.EMPTY, messageId: message.messageId });
+                this.send(exchange.reply, remote);
+            }, this.piggybackMs)
+            : null;
+
+        const response = await this.produce(message, remote);
+        clearTimeout(ackTimer);
+
+        if (message.type === TYPE.CON && !acknowledged) {
+            exchange.reply = encode({ ...response, type: TYPE.ACK, messageId: message.messageId, token: message.token });
+            this.send(exchange.reply, remote);
+            return;
+        }
+        if (message.type === TYPE.NON) {
+            this.send(encode({ ...response, type: TYPE.NON, messageId: this.allocateMessageId(), token: message.token }), remote);
+            return;
+        }
+
+        // Separate response: confirmable, retransmitted with exponential backoff until the device ACKs
+        this.counters.separate++;
+        const messageId = this.allocateMessageId();
+        const datagram = encode({ ...response, type: TYPE.CON, messageId, token: message.token });
+        let timeout = ACK_TIMEOUT_MS * (1 + Math.random() * (ACK_RANDOM_FACTOR - 1));
+        let attempts = 0;
+        const transmit = () => {
+            this.send(datagram, remote);
+            const pending = {
+                timer: setTimeout(() => {
+                    if (attempts++ >= MAX_RETRANSMIT) {
+                        this.separate.delete(messageId);
+                        this.counters.undelivered++;
+                        return;
+                    }
+                    this.counters.retransmits++;
+                    timeout *= 2;
+                    transmit();
+                }, timeout)
+            };
+            this.separate.set(messageId, pending);
+        };
+        transmit();
+    }
+
+    /**
+     * Build the response for one request, slicing it into the requested block
+     * @returns {Object} { code, options, payload }
+     */
+    async produce(message, remote) {
+        const path = optionValues(message, OPTION.URI_PATH).map(value => value.toString());
+        const queryPairs = optionValues(message, OPTION.URI_QUERY).map(value => value.toString());
+        const blockOption = optionValues(message, OPTION.BLOCK2)[0];
+        const requested = blockOption ? decodeBlock(blockOption) : { num: 0, szx: MAX_BLOCK_SZX };
+        const szx = Math.min(requested.szx, MAX_BLOCK_SZX);
+        const blockSize = 1 << (szx + 4);
+
+        // Later blocks come from the representation sliced for block 0, so a lookup runs once
+        const representationKey = `${remote.address}:${remote.port}|${path.join('/')}?${queryPairs.join('&')}`;
+        let representation = requested.num > 0 ? this.representations.get(representationKey) : null;
+        if (representation && Date.now() - representation.at > this.representationTtlMs) {
+            representation = null;
+        }
+
+        if (!representation) {
+            const query = {};
+            for (const pair of queryPairs) {
+                const split = pair.indexOf('=');
+                query[split < 0 ? pair : pair.slice(0, split)] = split < 0 ? '' : pair.slice(split + 1);
+            }
+            let result;
+            try {
+                result = await this.handler({ method: message.code, path, query, token: message.token, remote });
+            } catch (error) {
+                console.error(`[${TAG}] Handler failed for /${path.join('/')}: ${error.message}`);
+                result = { code: CODE.INTERNAL_ERROR };
+            }
+            if (result.code !== CODE.CONTENT) {
+                return { code: result.code, options: [], payload: result.payload || Buffer.alloc(0) };
+            }
+            representation = { payload: result.payload, contentFormat: result.contentFormat, at: Date.now() };
+        }
+
+        const options = [{ number: OPTION.CONTENT_FORMAT, value: encodeUint(representation.contentFormat) }];
+        const { payload } = representation;
+        if (payload.length <= blockSize && requested.num === 0) {
+            return { code: CODE.CONTENT, options, payload };
+        }
+
+        const start = requested.num * blockSize;
+        if (start >= payload.length) {
+            return { code: CODE.BAD_REQUEST, options: [], payload: Buffer.alloc(0) };
+        }
+        const end = Math.min(start + blockSize, payload.length);
+        const more = end < payload.length;
+        options.push({ number: OPTION.BLOCK2, value: encodeBlock(requested.num, more, szx) });
+        if (requested.num === 0) {
+            options.push({ number: OPTION.SIZE2, value: encodeUint(payload.length) });
+        }
+
+        if (more) {
+            this.representations.delete(representationKey);
+            this.representations.set(representationKey, representation);
+            while (this.representations.size > this.maxRepresentations) {
+                this.representations.delete(this.representations.keys().next().value);
+            }
+        } else {
+            this.representations.delete(representationKey);
+        }
+        this.counters.blocks++;
+        return { code: CODE.CONTENT, options, payload: payload.subarray(start, end) };
+    }
+
+    pruneExchanges(now) {
+        for (const [key, exchange] of this.exchanges) {
+            if (now - exchange.at < EXCHANGE_LIFETIME_MS) {
+                break;
+            }
+            this.exchanges.delete(key);
+        }
+    }
+
+    stats() {
+        return {
+            ...this.counters,
+            port: this.port,
+            exchanges: this.exchanges.size,
+            pendingSeparate: this.separate.size,
+            representations: this.representations.size
+        };
+    }
+
+    close() {
+        for (const pending of this.separate.values()) {
+            clearTimeout(pending.timer);
+        }
+        this.separate.clear();
+        if (this.socket) {
+            this.socket.close();
+            this.socket = null;
+        }
+    }
+}
+
+module.exports = {
+    CoapServer,
+    TYPE,
+    CODE,
+    OPTION,
+    CONTENT_FORMAT,
+    encode,
+    decode,
+    encodeUint,
+    decodeUint,
+    encodeBlock,
+    decodeBlock,
+    optionValues
+};
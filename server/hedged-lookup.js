@@ -0,0 +1,233 @@
+/**
+ * @file hedged-lookup.js
+ * @brief First-answer-wins lookup across several product providers
+ *
+ * The fastest-looking provider is asked first. If it hasn't found the
+ * product within the hedge delay, the next one is asked as well, and so on;
+ * a provider that fails or has no product hands over immediately. The first
+ * provider to return a product wins and the others are cancelled.
+ *
+ * The result is null only when every provider answered "no product"; if any
+ * of them failed the lookup rejects, so a flaky provider never gets a
+ * product cached as unknown.
+ *
+ * Providers are ranked by their recent p90 answer latency (a cancelled
+ * request counts as at least as slow as it got), inflated by their error
+ * rate, once each has enough samples; until then the configured order holds.
+ */
+
+const { RollingHistogram } = require('./latency-histogram');
+
+const TAG = 'hedged-lookup';
+const MIN_SAMPLES = 20;                  // Answers needed before a provider's latency counts
+const HISTOGRAM_WINDOW_MS = 300000;      // Rankings follow the last 5-10 minutes
+const MAX_ERROR_RATE = 0.9;              // Keeps the error penalty finite
+
+class HedgedLookup {
+    /**
+     * @param {Object} options
+     * @param {Object[]} options.providers - { name, lookup(barcode, signal) } in preference order
+     * @param {number} options.hedgeDelayMs - Wait this long for a provider before also asking the next
+     * @param {Function} options.onAttempt - Optional (providerName, ms, outcome) per provider request,
+     *                                       outcome 'found' | 'not_found' | 'error' | 'cancelled'
+     */
+    constructor(options) {
+        this.hedgeDelayMs = options.hedgeDelayMs;
+        this.onAttempt = options.onAttempt || null;
+        this.providers = options.providers.map((provider, index) => ({
+            provider,
+            index,
+            latency: new RollingHistogram(HISTOGRAM_WINDOW_MS),
+            errorsWindow: { errors: 0, total: 0 },
+            counters: {
+                requests: 0,
+                wins: 0,
+                found: 0,
+                notFound: 0,
+                errors: 0,
+                cancelled: 0
+            }
+        }));
+        this.counters = {
+            lookups: 0,
+            hedged: 0,
+            notFound: 0,
+            failed: 0
+        };
+
+        console.log(`[${TAG}] Providers: ${this.providers.map(p => p.provider.name).join(', ')} ` +
+            `(hedge after ${this.hedgeDelayMs}ms)`);
+    }
+
+    /**
+     * Ranking score: expected slow-case latency, worse for providers that fail often
+     */
+    score(entry) {
+        const window = entry.errorsWindow;
+        const errorRate = window.total > 0 ? Math.min(MAX_ERROR_RATE, window.errors / window.total) : 0;
+        return entry.latency.quantile(0.9) / (1 - errorRate);
+    }
+
+    /**
+     * Providers in the order they should be asked
+     */
+    order() {
+        if (this.providers.some(entry => entry.latency.count < MIN_SAMPLES)) {
+            return this.providers;
+        }
+        return [...this.providers].sort((a, b) => this.score(a) - this.score(b) || a.index - b.index);
+    }
+
+    /**
+     * Latency sample for ranking (errors excluded) and for the onAttempt hook
+     */
+    observe(entry, ms, outcome) {
+        if (outcome !== 'error') {
+            entry.latency.observe(ms);
+        }
+        if (this.onAttempt) {
+            this.onAttempt(entry.provider.name, ms, outcome);
+        }
+    }
+
+    record(entry, error) {
+        const window = entry.errorsWindow;
+        // Halve the error window now and then so old failures fade
+        if (window.total >= 200) {
+            window.errors /= 2;
+            window.total /= 2;
+        }
+        window.total++;
+        if (error) {
+            window.errors++;
+        }
+    }
+
+    /**
+     * Look a barcode up across the providers
+     * @param {string} barcode - UPC/EAN code
+     * @returns {Promise<Object|null>} First product found, or null if every provider has none
+     * @throws When no provider found it and at least one failed
+     */
+    lookup(barcode) {
+        this.counters.lookups++;
+        const order = this.order();
+
+        return new Promise((resolve, reject) => {
+            const running = new Map();   // entry -> { controller, started }
+            const errors = [];
+            let next = 0;
+            let done = false;
+            let hedgeTimer = null;
+
+            const settle = () => {
+                if (done || next < order.length || running.size > 0) {
+                    return;
+                }
+                done = true;
+                if (errors.length > 0) {
+                    this.counters.failed++;
+                    reject(errors[0]);
+                } else {
+                    this.counters.notFound++;
+                    resolve(null);
+                }
+            };
+
+            // A miss or failure starts the next provider now, unless a hedge is already running
+            const handOver = () => {
+                if (running.size === 0) {
+                    launch();
+                } else {
+                    settle();
+                }
+            };
+
+            const launch = () => {
+                clearTimeout(hedgeTimer);
+                hedgeTimer = null;
+                if (done || next >= order.length) {
+                    settle();
+                    return;
+                }
+
+                const entry = order[next++];
+                const controller = new AbortController();
+                const started = process.hrtime.bigint();
+                running.set(entry, { controller, started });
+                entry.counters.requests++;
+                if (next > 1) {
+                    this.counters.hedged++;
+                }
+
+                entry.provider.lookup(barcode, controller.signal).then(product => {
+                    running.delete(entry);
+                    this.observe(entry, Number(process.hrtime.bigint() - started) / 1e6, product ? 'found' : 'not_found');
+                    this.record(entry, false);
+                    if (done) {
+                        return;
+                    }
+                    if (product) {
+                        entry.counters.found++;
+                        entry.counters.wins++;
+                        done = true;
+                        clearTimeout(hedgeTimer);
+                        const now = process.hrtime.bigint();
+                        for (const [loser, attempt] of running) {
+                            // It took at least this long; leaving it out would hide a provider that got slow
+                            this.observe(loser, Number(now - attempt.started) / 1e6, 'cancelled');
+                            loser.counters.cancelled++;
+                            attempt.controller.abort();
+                        }
+                        running.clear();
+                        resolve(product);
+                    } else {
+                        entry.counters.notFound++;
+                        handOver();
+                    }
+                }, error => {
+                    running.delete(entry);
+                    if (controller.signal.aborted) {
+                        return;
+                    }
+                    entry.counters.errors++;
+                    this.observe(entry, Number(process.hrtime.bigint() - started) / 1e6, 'error');
+                    this.record(entry, true);
+                    console.error(`[${TAG}] ${entry.provider.name} failed for ${barcode}: ${error.message}`);
+                    if (!done) {
+                        errors.push(error);
+                        handOver();
+                    }
+                });
+
+                if (next < order.length) {
+                    hedgeTimer = setTimeout(launch, this.hedgeDelayMs);
+                }
+            };
+
+            launch();
+        });
+    }
+
+    stats() {
+        const ranked = this.order();
+        const providers = {};
+        for (const entry of this.providers) {
+            providers[entry.provider.name] = {
+                ...entry.counters,
+                rank: ranked.indexOf(entry) + 1,
+                samples: entry.latency.count,
+                p50Ms: entry.latency.quantile(0.5),
+                p90Ms: entry.latency.quantile(0.9),
+                p99Ms: entry.latency.quantile(0.99)
+            };
+        }
+        return {
+            ...this.counters,
+            hedgeDelayMs: this.hedgeDelayMs,
+            providers
+        };
+    }
+}
+
+module.exports = { HedgedLookup };
@@ -0,0 +1,263 @@
+/**
+ * @file image-cache.js
+ * @brief Byte-bounded LRU cache for converted RGB565 images
+ *
+ * Entries are evicted least-recently-used first once the total pixel bytes
+ * exceed the memory budget. With a spill directory configured, evicted
+ * entries move to disk (under their own byte budget) and are promoted back
+ * on the next request instead of being fetched and converted again.
+ */
+
+const crypto = require('crypto');
+const fs = require('fs');
+const path = require('path');
+
+const TAG = 'image-cache';
+
+// Created inside the configured spill directory; the cache touches nothing outside it
+const SPILL_SUBDIR = 'barcode-image-spill';
+const SPILL_FILE = /\.(bin|json)$/;
+
+/**
+ * Strong ETag for image bytes; identical pixels give identical tags across restarts
+ * @param {Buffer} buffer - Image data
+ * @returns {string} Quoted ETag
+ */
+function contentEtag(buffer) {
+    return `"${crypto.createHash('sha256').update(buffer).digest('hex').substring(0, 32)}"`;
+}
+
+class ImageCache {
+    /**
+     * @param {Object} options
+     * @param {number} options.maxBytes - Memory budget for image data
+     * @param {number} options.maxAgeMs - Entries older than this are treated as misses
+     * @param {string} options.spillDir - Directory to keep evicted entries under, in a
+     *        barcode-image-spill subdirectory (null disables spilling)
+     * @param {number} options.spillMaxBytes - Disk budget for spilled entries
+     */
+    constructor(options) {
+        this.maxBytes = options.maxBytes;
+        this.maxAgeMs = options.maxAgeMs;
+        this.spillDir = options.spillDir ? path.join(options.spillDir, SPILL_SUBDIR) : null;
+        this.spillMaxBytes = options.spillMaxBytes || 0;
+
+        // Map iteration order doubles as LRU order: oldest first
+        this.entries = new Map();
+        this.bytes = 0;
+
+        // Spilled entries: key -> { bytes, timestamp, files, written }, also oldest first
+        this.spilled = new Map();
+        this.spilledBytes = 0;
+        this.spillGeneration = 0;
+
+        this.counters = {
+            evictions: 0,
+            spills: 0,
+            spillHits: 0
+        };
+
+        if (this.spillDir) {
+            // Like the memory tier, start empty so old conversions are never served.
+            // Only files this cache writes are removed, even in its own subdirectory.
+            fs.mkdirSync(this.spillDir, { recursive: true });
+            for (const name of fs.readdirSync(this.spillDir)) {
+                if (SPILL_FILE.test(name)) {
+                    fs.rmSync(path.join(this.spillDir, name), { force: true });
+                }
+            }
+            console.log(`[${TAG}] Spilling evicted images to ${this.spillDir} (max ${Math.round(this.spillMaxBytes / 1024)} KB)`);
+        }
+    }
+
+    get size() {
+        return this.entries.size;
+    }
+
+    isFresh(entry) {
+        return Date.now() - entry.timestamp <= this.maxAgeMs;
+    }
+
+    /**
+     * Check the memory tier without touching LRU order
+     * @param {string} key - Image cache key
+     * @returns {boolean} True if a fresh entry is in memory
+     */
+    has(key) {
+        const entry = this.entries.get(key);
+        return !!entry && this.isFresh(entry);
+    }
+
+    /**
+     * Get an entry from the memory tier and mark it most recently used
+     * @param {string} key - Image cache key
+     * @returns {Object} Entry or undefined
+     */
+    get(key) {
+        const entry = this.entries.get(key);
+        if (!entry) {
+            return undefined;
+        }
+        this.entries.delete(key);
+        if (!this.isFresh(entry)) {
+            this.bytes -= entry.buffer.length;
+            return undefined;
+        }
+        this.entries.set(key, entry);
+        return entry;
+    }
+
+    /**
+     * Store an entry, evicting (and optionally spilling) the least recently used ones
+     * @param {string} key - Image cache key
+     * @param {Object} entry - Entry with buffer, width, height, etag and timestamp
+     */
+    set(key, entry) {
+        const previous = this.entries.get(key);
+        if (previous) {
+            this.entries.delete(key);
+            this.bytes -= previous.buffer.length;
+        }
+        this.entries.set(key, entry);
+        this.bytes += entry.buffer.length;
+
+        while (this.bytes > this.maxBytes && this.entries.size > 1) {
+            const [oldestKey, oldest] = this.entries.entries().next().value;
+            this.entries.delete(oldestKey);
+            this.bytes -= oldest.buffer.length;
+            this.counters.evictions++;
+            if (this.spillDir && this.isFresh(oldest)) {
+                this.spill(oldestKey, oldest);
+            }
+        }
+    }
+
+    spillPaths(key, generation) {
+        return {
+            data: path.join(this.spillDir, `${key}-${generation}.bin`),
+            meta: path.join(this.spillDir, `${key}-${generation}.json`)
+        };
+    }
+
+    /**
+     * Write an evicted entry to disk; failures just drop the entry
+     */
+    spill(key, entry) {
+        const { buffer, ...meta } = entry;
+
+        this.dropSpilled(key);
+        if (buffer.length > this.spillMaxBytes) {
+            return;
+        }
+
+        // Each spill gets its own files, so the deferred removal of an earlier
+        // copy of this key can't delete the one written now
+        const spilled = {
+            bytes: buffer.length,
+            timestamp: entry.timestamp,
+            files: this.spillPaths(key, ++this.spillGeneration)
+        };
+        spilled.written = Promise.all([
+            fs.promises.writeFile(spilled.files.data, buffer),
+            fs.promises.writeFile(spilled.files.meta, JSON.stringify(meta))
+        ]).catch(error => {
+            console.error(`[${TAG}] Failed to spill ${key}: ${error.message}`);
+            this.dropSpilled(key, spilled);
+        });
+
+        this.spilled.set(key, spilled);
+        this.spilledBytes += buffer.length;
+        this.counters.spills++;
+
+        while (this.spilledBytes > this.spillMaxBytes) {
+            this.dropSpilled(this.spilled.keys().next().value);
+        }
+    }
+
+    /**
+     * Forget a spilled entry and remove its files
+     * @param {string} key - Image cache key
+     * @param {Object} only - Drop only if this is still the entry spilled under key
+     */
+    dropSpilled(key, only) {
+        const spilled = this.spilled.get(key);
+        if (!spilled || (only && spilled !== only)) {
+            return;
+        }
+        this.spilled.delete(key);
+        this.spilledBytes -= spilled.bytes;
+        // Remove only after the write settles so a late write can't leave an orphan
+        spilled.written.finally(() => Promise.all([
+            fs.promises.rm(spilled.files.data, { force: true }),
+            fs.promises.rm(spilled.files.meta, { force: true })
+        ])).catch(() => {});
+    }
+
+    /**
+     * Load a spilled entry back into memory
+     * @param {string} key - Image cache key
+     * @returns {Promise<Object>} Entry or null if not on disk
+     */
+    async load(key) {
+        const spilled = this.spilled.get(key);
+        if (!spilled) {
+            return null;
+        }
+        if (Date.now() - spilled.timestamp > this.maxAgeMs) {
+            this.dropSpilled(key);
+            return null;
+        }
+
+        try {
+            await spilled.written;
+            const [buffer, meta] = await Promise.all([
+                fs.promises.readFile(spilled.files.data),
+                fs.promises.readFile(spilled.files.meta, 'utf8')
+            ]);
+            const entry = { ...JSON.parse(meta), buffer: buffer };
+            this.dropSpilled(key, spilled);
+            this.counters.spillHits++;
+            this.set(key, entry);
+            return entry;
+        } catch (error) {
+            console.error(`[${TAG}] Failed to load spilled ${key}: ${error.message}`);
+            this.dropSpilled(key, spilled);
+            return null;
+        }
+    }
+
+    /**
+     * Remove expired entries from both tiers
+     * @returns {number} Number of entries removed
+     */
+    prune() {
+        let removed = 0;
+        for (const [key, entry] of this.entries.entries()) {
+            if (!this.isFresh(entry)) {
+                this.entries.delete(key);
+                this.bytes -= entry.buffer.length;
+                removed++;
+            }
+        }
+        for (const [key, spilled] of this.spilled.entries()) {
+            if (Date.now() - spilled.timestamp > this.maxAgeMs) {
+                this.dropSpilled(key);
+                removed++;
+            }
+        }
+        return removed;
+    }
+
+    stats() {
+        return {
+            ...this.counters,
+            entries: this.entries.size,
+            bytes: this.bytes,
+            maxBytes: this.maxBytes,
+            spilledEntries: this.spilled.size,
+            spilledBytes: this.spilledBytes
+        };
+    }
+}
+
+module.exports = { ImageCache, contentEtag };
@@ -0,0 +1,77 @@
+/**
+ * @file image-processing.js
+ * @brief CPU-heavy image work: decode, resize, RGB565 conversion and BlurHash
+ *
+ * Runs inside the image worker threads (image-worker.js), or on the main
+ * thread when the pool is disabled.
+ */
+
+const sharp = require('sharp');
+const blurhash = require('./blurhash');
+const rgb565 = require('./rgb565');
+
+const TAG = 'image-processing';
+const PLACEHOLDER_SAMPLE_SIZE = 32;   // Downscale before encoding; BlurHash only needs low frequencies
+
+/**
+ * Convert an original image to big-endian RGB565 for LVGL
+ * @param {Buffer} originalBuffer - Original image bytes
+ * @param {number} width - Output width
+ * @param {number} height - Output height
+ * @param {boolean} dither - Apply ordered dithering
+ * @returns {Promise<Buffer>} RGB565 pixel data
+ */
+async function convertToRgb565(originalBuffer, width, height, dither) {
+    // Convert to raw RGB565 format for LVGL
+    const rawBuffer = await sharp(originalBuffer)
+        .resize(width, height, {
+            fit: 'cover',        // Cover the entire area
+            position: 'center'   // Center the image
+        })
+        .removeAlpha()
+        .raw()                   // Get raw RGB888 data
+        .toBuffer();
+
+    // Convert RGB888 to RGB565 with correct byte order for ESP32/LVGL
+    return rgb565.convert(rawBuffer, width, height, dither);
+}
+
+/**
+ * Compute a BlurHash placeholder from an original image
+ * @param {Buffer} originalBuffer - Original image bytes
+ * @returns {Promise<string>} ~28 character BlurHash
+ */
+async function encodePlaceholder(originalBuffer) {
+    // Same crop as the device image so the preview lines up with the real one
+    const pixels = await sharp(originalBuffer)
+        .resize(PLACEHOLDER_SAMPLE_SIZE, PLACEHOLDER_SAMPLE_SIZE, { fit: 'cover', position: 'center' })
+        .removeAlpha()
+        .raw()
+        .toBuffer();
+
+    return blurhash.encode(pixels, PLACEHOLDER_SAMPLE_SIZE, PLACEHOLDER_SAMPLE_SIZE, 4, 3, 3);
+}
+
+/**
+ * Produce the device thumbnail and (optionally) its placeholder from one download
+ * @param {Buffer} originalBuffer - Original image bytes
+ * @param {number} width - Output width
+ * @param {number} height - Output height
+ * @param {Object} options - { placeholder: boolean, dither: boolean }
+ * @returns {Promise<Object>} { rgb565: Buffer, placeholder: string|null }
+ */
+async function renderImage(originalBuffer, width, height, options) {
+    const [rgb565Buffer, placeholder] = await Promise.all([
+        convertToRgb565(originalBuffer, width, height, options.dither),
+        options.placeholder
+            ? encodePlaceholder(originalBuffer).catch(error => {
+                console.error(`[${TAG}] Placeholder generation failed: ${error.message}`);
+                return null;
+            })
+            : null
+    ]);
+
+    return { rgb565: rgb565Buffer, placeholder: placeholder };
+}
+
+module.exports = { renderImage };
@@ -0,0 +1,21 @@
+/**
+ * @file image-worker.js
+ * @brief Worker thread entry point for the image pool (see worker-pool.js)
+ */
+
+const { parentPort } = require('worker_threads');
+const sharp = require('sharp');
+const { renderImage } = require('./image-processing');
+
+// Parallelism comes from the pool; one libvips thread per worker avoids oversubscribing cores
+sharp.concurrency(1);
+
+parentPort.on('message', async ({ id, payload }) => {
+    try {
+        const { original, width, height, options } = payload;
+        const result = await renderImage(Buffer.from(original), width, height, options);
+        parentPort.postMessage({ id, result });
+    } catch (error) {
+        parentPort.postMessage({ id, error: error.message });
+    }
+});
@@ -0,0 +1,106 @@
+/**
+ * @file latency-histogram.js
+ * @brief Fixed-bucket latency histograms
+ *
+ * Cheap enough to observe on every request: one bucket increment, no
+ * allocation. Quantiles are interpolated within a bucket, which is plenty
+ * for ranking providers and spotting tail regressions.
+ */
+
+const DEFAULT_BUCKETS_MS = [5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000];
+
+class LatencyHistogram {
+    /**
+     * @param {number[]} buckets - Ascending bucket upper bounds in milliseconds
+     */
+    constructor(buckets = DEFAULT_BUCKETS_MS) {
+        this.buckets = buckets;
+        this.counts = new Array(buckets.length + 1).fill(0);   // Last slot is +Inf
+        this.count = 0;
+        this.sum = 0;
+    }
+
+    observe(ms) {
+        let i = 0;
+        while (i < this.buckets.length && ms > this.buckets[i]) {
+            i++;
+        }
+        this.counts[i]++;
+        this.count++;
+        this.sum += ms;
+    }
+
+    /**
+     * Estimate a quantile
+     * @param {number} q - 0..1
+     * @param {LatencyHistogram} other - Optional histogram with the same buckets to include
+     * @returns {number} Milliseconds, or NaN when empty
+     */
+    quantile(q, other = null) {
+        const total = this.count + (other ? other.count : 0);
+        if (total === 0) {
+            return NaN;
+        }
+        const rank = q * total;
+        let seen = 0;
+        for (let i = 0; i < this.counts.length; i++) {
+            const inBucket = this.counts[i] + (other ? other.counts[i] : 0);
+            if (inBucket > 0 && seen + inBucket >= rank) {
+                const lower = i === 0 ? 0 : this.buckets[i - 1];
+                const upper = i < this.buckets.length ? this.buckets[i] : lower * 2;
+                return lower + (upper - lower) * ((rank - seen) / inBucket);
+            }
+            seen += inBucket;
+        }
+        return this.buckets[this.buckets.length - 1] * 2;
+    }
+
+    reset() {
+        this.counts.fill(0);
+        this.count = 0;
+        this.sum = 0;
+    }
+}
+
+/**
+ * Histogram over roughly the last one to two windows, so rankings follow
+ * a provider that recovers or degrades instead of averaging over all time
+ */
+class RollingHistogram {
+    constructor(windowMs, buckets = DEFAULT_BUCKETS_MS) {
+        this.windowMs = windowMs;
+        this.current = new LatencyHistogram(buckets);
+        this.previous = new LatencyHistogram(buckets);
+        this.rotatedAt = Date.now();
+    }
+
+    rotate() {
+        const now = Date.now();
+        if (now - this.rotatedAt < this.windowMs) {
+            return;
+        }
+        [this.previous, this.current] = [this.current, this.previous];
+        this.current.reset();
+        if (now - this.rotatedAt >= 2 * this.windowMs) {
+            this.previous.reset();
+        }
+        this.rotatedAt = now;
+    }
+
+    observe(ms) {
+        this.rotate();
+        this.current.observe(ms);
+    }
+
+    quantile(q) {
+        this.rotate();
+        return this.current.quantile(q, this.previous);
+    }
+
+    get count() {
+        this.rotate();
+        return this.current.count + this.previous.count;
+    }
+}
+
+module.exports = { LatencyHistogram, RollingHistogram, DEFAULT_BUCKETS_MS };
@@ -0,0 +1,31 @@
+/**
+ * @file logger.js
+ * @brief Log level gate for per-request logging
+ *
+ * Startup messages, periodic summaries and errors always print. Per-request
+ * detail (each lookup, raw API responses, every image conversion) only
+ * prints at debug level, so under load it costs a branch instead of string
+ * building and synchronous console writes.
+ *
+ * Level: --log-level=<info|debug> on the command line, else LOG_LEVEL (default info).
+ */
+
+const LEVELS = { info: 1, debug: 2 };
+
+const argument = process.argv.find(arg => arg.startsWith('--log-level='));
+const name = (argument ? argument.split('=')[1] : process.env.LOG_LEVEL || 'info').toLowerCase();
+const level = LEVELS[name] || LEVELS.info;
+
+module.exports = {
+    level: level === LEVELS.debug ? 'debug' : 'info',
+    debugEnabled: level >= LEVELS.debug,
+
+    /**
+     * console.log at debug level; guard with debugEnabled when building the message is itself costly
+     */
+    debug(...args) {
+        if (level >= LEVELS.debug) {
+            console.log(...args);
+        }
+    }
+};
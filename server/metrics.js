@@ -0,0 +1,181 @@
+/**
+ * @file metrics.js
+ * @brief Prometheus text-format metrics
+ *
+ * Histograms are observed inline (one bucket increment per sample).
+ * Everything else is read at scrape time from the stats() the components
+ * already keep, through collectors, so there is a single source of truth.
+ * In cluster mode each process renders its own samples with a process label
+ * and mergeExpositions() joins them into one scrape.
+ */
+
+const { LatencyHistogram } = require('./latency-histogram');
+
+const DEFAULT_BUCKETS_MS = [1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000];
+
+function escapeLabel(value) {
+    return String(value).replace(/\\/g, '\\\\').replace(/"/g, '\\"').replace(/\n/g, '\\n');
+}
+
+function formatLabels(labels) {
+    const entries = Object.entries(labels);
+    if (entries.length === 0) {
+        return '';
+    }
+    return `{${entries.map(([key, value]) => `${key}="${escapeLabel(value)}"`).join(',')}}`;
+}
+
+function formatValue(value) {
+    if (typeof value === 'boolean') {
+        return value ? '1' : '0';
+    }
+    if (Number.isNaN(value)) {
+        return 'NaN';
+    }
+    if (value === Infinity) {
+        return '+Inf';
+    }
+    return String(value);
+}
+
+/**
+ * Latency histogram in milliseconds, exposed in seconds as Prometheus expects
+ */
+class Histogram {
+    constructor(name, help, buckets = DEFAULT_BUCKETS_MS) {
+        this.name = name;
+        this.help = help;
+        this.buckets = buckets;
+        this.series = new Map();   // label key -> { labels, histogram }
+    }
+
+    /**
+     * @param {number} ms - Duration in milliseconds
+     * @param {Object} labels - Label values, e.g. { result: 'found' }
+     */
+    observe(ms, labels = {}) {
+        const key = formatLabels(labels);
+        let series = this.series.get(key);
+        if (!series) {
+            series = { labels, histogram: new LatencyHistogram(this.buckets) };
+            this.series.set(key, series);
+        }
+        series.histogram.observe(ms);
+    }
+
+    render(lines, extraLabels = {}) {
+        lines.push(`# HELP ${this.name} ${this.help}`);
+        lines.push(`# TYPE ${this.name} histogram`);
+        for (const series of this.series.values()) {
+            const labels = { ...extraLabels, ...series.labels };
+            const histogram = series.histogram;
+            let cumulative = 0;
+            for (let i = 0; i < this.buckets.length; i++) {
+                cumulative += histogram.counts[i];
+                lines.push(`${this.name}_bucket${formatLabels({ ...labels, le: this.buckets[i] / 1000 })} ${cumulative}`);
+            }
+            lines.push(`${this.name}_bucket${formatLabels({ ...labels, le: '+Inf' })} ${histogram.count}`);
+            lines.push(`${this.name}_sum${formatLabels(labels)} ${histogram.sum / 1000}`);
+            lines.push(`${this.name}_count${formatLabels(labels)} ${histogram.count}`);
+        }
+    }
+}
+
+class MetricsRegistry {
+    constructor() {
+        this.histograms = [];
+        this.collectors = [];
+    }
+
+    histogram(name, help, buckets) {
+        const histogram = new Histogram(name, help, buckets);
+        this.histograms.push(histogram);
+        return histogram;
+    }
+
+    /**
+     * Register a scrape-time collector
+     * @param {Function} collector - () => [{ name, help, type: 'counter'|'gauge', value } or { ..., samples: [{ labels, value }] }]
+     */
+    collect(collector) {
+        this.collectors.push(collector);
+    }
+
+    /**
+     * @param {Object} extraLabels - Added to every sample, e.g. { process: 2 }
+     * @returns {string} Prometheus text exposition format 0.0.4
+     */
+    render(extraLabels = {}) {
+        const lines = [];
+        for (const histogram of this.histograms) {
+            histogram.render(lines, extraLabels);
+        }
+        for (const collector of this.collectors) {
+            for (const metric of collector()) {
+                lines.push(`# HELP ${metric.name} ${metric.help}`);
+                lines.push(`# TYPE ${metric.name} ${metric.type}`);
+                const samples = metric.samples || [{ labels: {}, value: metric.value }];
+                for (const sample of samples) {
+                    lines.push(`${metric.name}${formatLabels({ ...extraLabels, ...sample.labels })} ${formatValue(sample.value)}`);
+                }
+            }
+        }
+        return lines.join('\n') + '\n';
+    }
+}
+
+/**
+ * Shorthand for a labelled counter or gauge built from a stats object
+ * @param {string} name - Metric name
+ * @param {string} help - Help text
+ * @param {string} type - 'counter' or 'gauge'
+ * @param {string} label - Label name
+ * @param {Object} values - { labelValue: number }
+ */
+function labelled(name, help, type, label, values) {
+    return {
+        name,
+        help,
+        type,
+        samples: Object.entries(values).map(([value, count]) => ({ labels: { [label]: value }, value: count }))
+    };
+}
+
+/**
+ * Join expositions from several processes into one
+ *
+ * The format allows each metric family once, so samples are grouped under
+ * the first HELP/TYPE seen for their family. Every input must label its
+ * samples apart (render({ process })), or the merged series would collide.
+ * @param {string[]} texts - Output of render() from each process
+ * @returns {string} Prometheus text exposition format 0.0.4
+ */
+function mergeExpositions(texts) {
+    const families = new Map();   // name -> { header: [HELP, TYPE], samples: [] }
+    for (const text of texts) {
+        let family = null;
+        for (const line of text.split('\n')) {
+            const help = line.match(/^# HELP (\S+)/);
+            if (help) {
+                family = families.get(help[1]);
+                if (!family) {
+                    family = { header: [line], samples: [] };
+                    families.set(help[1], family);
+                }
+            } else if (line.startsWith('# TYPE ')) {
+                if (family && family.header.length === 1) {
+                    family.header.push(line);
+                }
+            } else if (line && family) {
+                family.samples.push(line);
+            }
+        }
+    }
+    const lines = [];
+    for (const family of families.values()) {
+        lines.push(...family.header, ...family.samples);
+    }
+    return lines.join('\n') + '\n';
+}
+
+module.exports = { MetricsRegistry, labelled, mergeExpositions };
@@ -0,0 +1,78 @@
+#!/usr/bin/env node
+/**
+ * @file bench.js
+ * @brief Microbenchmark: JS loop vs native scalar vs native SIMD RGB565 conversion
+ *
+ * Checks every kernel against the JS reference (dithering off and on) before
+ * timing, then reports throughput per image size.
+ *
+ * Usage: npm run bench [-- --dither]
+ */
+
+const native = require('./index');
+const { convertJs } = require('../../rgb565');
+
+const SIZES = [[80, 80], [83, 61], [240, 240], [640, 480], [1920, 1080]];  // 83x61 exercises the tails
+const MIN_RUN_MS = 300;
+const dither = process.argv.includes('--dither');
+
+function randomImage(width, height) {
+    const buffer = Buffer.alloc(width * height * 3);
+    for (let i = 0; i < buffer.length; i++) {
+        buffer[i] = (Math.random() * 256) | 0;
+    }
+    // Saturated corners exercise the dither clamp
+    buffer.fill(255, 0, Math.min(buffer.length, 48));
+    return buffer;
+}
+
+function measure(fn) {
+    // Warm up (JIT, page faults) before timing
+    for (let i = 0; i < 3; i++) {
+        fn();
+    }
+    let iterations = 0;
+    const start = process.hrtime.bigint();
+    let elapsedMs = 0;
+    while (elapsedMs < MIN_RUN_MS) {
+        fn();
+        iterations++;
+        elapsedMs = Number(process.hrtime.bigint() - start) / 1e6;
+    }
+    return elapsedMs / iterations;
+}
+
+const implementations = [['js', (rgb, w, h) => convertJs(rgb, w, h, dither)]];
+for (const kernel of native.kernels) {
+    implementations.push([kernel, (rgb, w, h) => native.convert(rgb, w, h, dither, kernel)]);
+}
+
+console.log(`RGB888 -> RGB565 (dither ${dither ? 'on' : 'off'}), kernels: ${native.kernels.join(', ')}, default: ${native.kernel}\n`);
+
+for (const [width, height] of SIZES) {
+    const rgb = randomImage(width, height);
+
+    // Bit-exactness against the JS reference, both modes
+    for (const mode of [false, true]) {
+        const expected = convertJs(rgb, width, height, mode);
+        for (const kernel of native.kernels) {
+            const actual = native.convert(rgb, width, height, mode, kernel);
+            if (!actual.equals(expected)) {
+                console.error(`MISMATCH: ${kernel} at ${width}x${height} (dither ${mode})`);
+                process.exit(1);
+            }
+        }
+    }
+
+    const pixels = width * height;
+    let baseline = 0;
+    const rows = [];
+    for (const [name, fn] of implementations) {
+        const ms = measure(() => fn(rgb, width, height));
+        baseline = baseline || ms;
+        rows.push(`  ${name.padEnd(7)} ${(ms * 1000).toFixed(1).padStart(9)} us  ` +
+            `${(pixels / ms / 1000).toFixed(1).padStart(8)} MPix/s  ${(baseline / ms).toFixed(1).padStart(5)}x`);
+    }
+    console.log(`${width}x${height} (bit-exact)`);
+    console.log(rows.join('\n'));
+}
@@ -0,0 +1,12 @@
+{
+  "targets": [
+    {
+      "target_name": "rgb565",
+      "sources": ["src/rgb565.c", "src/addon.c"],
+      "cflags": ["-O3", "-std=c11"],
+      "xcode_settings": {
+        "OTHER_CFLAGS": ["-O3", "-std=c11"]
+      }
+    }
+  ]
+}
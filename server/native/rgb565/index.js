@@ -0,0 +1 @@
+module.exports = require('./build/Release/rgb565.node');
@@ -0,0 +1,103 @@
+/**
+ * @file addon.c
+ * @brief Node-API bindings for the RGB565 conversion kernels
+ *
+ * convert(rgb, width, height[, dither[, kernel]]) -> Buffer
+ *   rgb     Buffer of packed RGB888 pixels (width * height * 3 bytes)
+ *   dither  Apply 4x4 ordered dithering (default false)
+ *   kernel  "scalar", "sse2", "avx2" or "neon" (default: fastest available)
+ *
+ * kernel   Name of the default kernel
+ * kernels  Names of every kernel usable on this CPU
+ */
+
+#include <node_api.h>
+#include <stdio.h>
+
+#include "rgb565.h"
+
+#define THROW(env, msg) do { napi_throw_error((env), NULL, (msg)); return NULL; } while (0)
+#define CHECK(env, call) do { if ((call) != napi_ok) THROW((env), "N-API call failed: " #call); } while (0)
+
+static const char *const kernel_names[] = { "scalar", "sse2", "avx2", "neon" };
+
+static napi_value convert(napi_env env, napi_callback_info info)
+{
+    size_t argc = 5;
+    napi_value argv[5];
+    CHECK(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    if (argc < 3) {
+        THROW(env, "convert(rgb, width, height[, dither[, kernel]])");
+    }
+
+    bool is_buffer = false;
+    CHECK(env, napi_is_buffer(env, argv[0], &is_buffer));
+    if (!is_buffer) {
+        THROW(env, "rgb must be a Buffer");
+    }
+
+    void *src = NULL;
+    size_t src_len = 0;
+    uint32_t width = 0, height = 0;
+    CHECK(env, napi_get_buffer_info(env, argv[0], &src, &src_len));
+    CHECK(env, napi_get_value_uint32(env, argv[1], &width));
+    CHECK(env, napi_get_value_uint32(env, argv[2], &height));
+
+    if (width == 0 || height == 0 || (uint64_t)width * height * 3 > src_len) {
+        THROW(env, "rgb is smaller than width * height * 3");
+    }
+
+    bool dither = false;
+    if (argc > 3) {
+        napi_valuetype type;
+        CHECK(env, napi_typeof(env, argv[3], &type));
+        if (type == napi_boolean) {
+            CHECK(env, napi_get_value_bool(env, argv[3], &dither));
+        }
+    }
+
+    char kernel_name[16] = {0};
+    if (argc > 4) {
+        size_t len = 0;
+        CHECK(env, napi_get_value_string_utf8(env, argv[4], kernel_name, sizeof(kernel_name), &len));
+    } else {
+        snprintf(kernel_name, sizeof(kernel_name), "%s", rgb565_best());
+    }
+
+    rgb565_convert_fn fn = rgb565_find(kernel_name);
+    if (!fn) {
+        THROW(env, "kernel not available on this CPU");
+    }
+
+    void *dst = NULL;
+    napi_value result;
+    CHECK(env, napi_create_buffer(env, (size_t)width * height * 2, &dst, &result));
+
+    fn(src, dst, width, height, dither);
+    return result;
+}
+
+static napi_value init(napi_env env, napi_value exports)
+{
+    napi_value fn, name, list;
+
+    CHECK(env, napi_create_function(env, "convert", NAPI_AUTO_LENGTH, convert, NULL, &fn));
+    CHECK(env, napi_set_named_property(env, exports, "convert", fn));
+
+    CHECK(env, napi_create_string_utf8(env, rgb565_best(), NAPI_AUTO_LENGTH, &name));
+    CHECK(env, napi_set_named_property(env, exports, "kernel", name));
+
+    CHECK(env, napi_create_array(env, &list));
+    uint32_t count = 0;
+    for (size_t i = 0; i < sizeof(kernel_names) / sizeof(kernel_names[0]); i++) {
+        if (rgb565_find(kernel_names[i])) {
+            CHECK(env, napi_create_string_utf8(env, kernel_names[i], NAPI_AUTO_LENGTH, &name));
+            CHECK(env, napi_set_element(env, list, count++, name));
+        }
+    }
+    CHECK(env, napi_set_named_property(env, exports, "kernels", list));
+
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,267 @@
+/**
+ * @file rgb565.c
+ * @brief RGB888 -> big-endian RGB565 conversion kernels
+ *
+ * Output byte order matches the resolver's JavaScript loop and the ESP32's
+ * LV_COLOR_16_SWAP layout: high byte (RRRRRGGG) first, then GGGBBBBB.
+ * All kernels truncate exactly like the JS path; dithering adds a 4x4 Bayer
+ * offset (saturating at 255) before truncation, identically in every kernel.
+ */
+
+#include "rgb565.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RGB565_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define RGB565_NEON 1
+#include <arm_neon.h>
+#endif
+
+// 4x4 Bayer thresholds (0-15); scaled to the 8-step (5-bit) and 4-step (6-bit) quantizers
+static const uint8_t bayer4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 },
+};
+
+static inline uint8_t dither_rb(uint32_t x, uint32_t y) { return bayer4[y & 3][x & 3] >> 1; }
+static inline uint8_t dither_g(uint32_t x, uint32_t y)  { return bayer4[y & 3][x & 3] >> 2; }
+
+static inline uint32_t add_sat(uint32_t value, uint32_t offset)
+{
+    value += offset;
+    return value > 255 ? 255 : value;
+}
+
+/**
+ * Convert pixels [x0, x1) of row y; also used for the tails of the SIMD kernels
+ */
+static inline void convert_span(const uint8_t *src_row, uint8_t *dst_row,
+                                uint32_t x0, uint32_t x1, uint32_t y, int dither)
+{
+    for (uint32_t x = x0; x < x1; x++) {
+        uint32_t r = src_row[x * 3];
+        uint32_t g = src_row[x * 3 + 1];
+        uint32_t b = src_row[x * 3 + 2];
+
+        if (dither) {
+            r = add_sat(r, dither_rb(x, y));
+            g = add_sat(g, dither_g(x, y));
+            b = add_sat(b, dither_rb(x, y));
+        }
+
+        dst_row[x * 2] = (uint8_t)((r & 0xF8) | (g >> 5));
+        dst_row[x * 2 + 1] = (uint8_t)(((g << 3) & 0xE0) | (b >> 3));
+    }
+}
+
+void rgb565_convert_scalar(const uint8_t *src, uint8_t *dst,
+                           uint32_t width, uint32_t height, int dither)
+{
+    for (uint32_t y = 0; y < height; y++) {
+        convert_span(src + (size_t)y * width * 3, dst + (size_t)y * width * 2, 0, width, y, dither);
+    }
+}
+
+#if RGB565_X86
+
+/**
+ * Dither offsets for pixel x of row y as one 32-bit lane: R | G << 8 | B << 16
+ */
+static inline int dither_lane(uint32_t x, uint32_t y)
+{
+    return (int)(dither_rb(x, y) | (dither_g(x, y) << 8) | (dither_rb(x, y) << 16));
+}
+
+static inline int load_u32(const uint8_t *p)
+{
+    int32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Four pixels, one per 32-bit lane as R | G << 8 | B << 16 (top byte ignored),
+ * to big-endian RGB565 in the low 16 bits of each lane
+ */
+static inline __m128i sse2_pack_lanes(__m128i v)
+{
+    __m128i hi = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0xF8)),
+                              _mm_and_si128(_mm_srli_epi32(v, 13), _mm_set1_epi32(0x07)));
+    __m128i lo = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 3), _mm_set1_epi32(0xE000)),
+                              _mm_and_si128(_mm_srli_epi32(v, 11), _mm_set1_epi32(0x1F00)));
+    __m128i out = _mm_or_si128(hi, lo);
+
+    // Sign-extend so the signed 32->16 pack below is exact
+    return _mm_srai_epi32(_mm_slli_epi32(out, 16), 16);
+}
+
+/**
+ * SSE2 (x86-64 baseline): scalar-gathered pixel lanes, 8 pixels per step
+ */
+static void rgb565_convert_sse2(const uint8_t *src, uint8_t *dst,
+                                uint32_t width, uint32_t height, int dither)
+{
+    const size_t total = (size_t)width * height * 3;
+
+    for (uint32_t y = 0; y < height; y++) {
+        const size_t row = (size_t)y * width;
+        const uint8_t *s = src + row * 3;
+        uint8_t *d = dst + row * 2;
+        const __m128i offsets = dither
+            ? _mm_setr_epi32(dither_lane(0, y), dither_lane(1, y), dither_lane(2, y), dither_lane(3, y))
+            : _mm_setzero_si128();
+
+        uint32_t x = 0;
+        // Each step reads one byte past its last pixel; leave the final pixels to the tail
+        for (; x + 8 <= width && (row + x + 8) * 3 + 1 <= total; x += 8) {
+            const uint8_t *p = s + x * 3;
+            __m128i a = _mm_setr_epi32(load_u32(p), load_u32(p + 3), load_u32(p + 6), load_u32(p + 9));
+            __m128i b = _mm_setr_epi32(load_u32(p + 12), load_u32(p + 15), load_u32(p + 18), load_u32(p + 21));
+
+            a = sse2_pack_lanes(_mm_adds_epu8(a, offsets));
+            b = sse2_pack_lanes(_mm_adds_epu8(b, offsets));
+            _mm_storeu_si128((__m128i *)(d + x * 2), _mm_packs_epi32(a, b));
+        }
+        convert_span(s, d, x, width, y, dither);
+    }
+}
+
+#if defined(__GNUC__)
+#define RGB565_AVX2 1
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_pack_lanes(__m256i v)
+{
+    __m256i hi = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi32(0xF8)),
+                                 _mm256_and_si256(_mm256_srli_epi32(v, 13), _mm256_set1_epi32(0x07)));
+    __m256i lo = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(v, 3), _mm256_set1_epi32(0xE000)),
+                                 _mm256_and_si256(_mm256_srli_epi32(v, 11), _mm256_set1_epi32(0x1F00)));
+    return _mm256_or_si256(hi, lo);
+}
+
+/**
+ * AVX2: byte-shuffle 4 pixels per 128-bit lane into 32-bit lanes, 16 pixels per step
+ */
+__attribute__((target("avx2")))
+static void rgb565_convert_avx2(const uint8_t *src, uint8_t *dst,
+                                uint32_t width, uint32_t height, int dither)
+{
+    const size_t total = (size_t)width * height * 3;
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const size_t row = (size_t)y * width;
+        const uint8_t *s = src + row * 3;
+        uint8_t *d = dst + row * 2;
+        const __m256i offsets = dither
+            ? _mm256_setr_epi32(dither_lane(0, y), dither_lane(1, y), dither_lane(2, y), dither_lane(3, y),
+                                dither_lane(0, y), dither_lane(1, y), dither_lane(2, y), dither_lane(3, y))
+            : _mm256_setzero_si256();
+
+        uint32_t x = 0;
+        // The last 16-byte load reaches 4 bytes past the step; leave the final pixels to the tail
+        for (; x + 16 <= width && (row + x + 16) * 3 + 4 <= total; x += 16) {
+            const uint8_t *p = s + x * 3;
+            __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                                _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+            __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(p + 24))),
+                                                _mm_loadu_si128((const __m128i *)(p + 36)), 1);
+
+            a = avx2_pack_lanes(_mm256_adds_epu8(_mm256_shuffle_epi8(a, spread), offsets));
+            b = avx2_pack_lanes(_mm256_adds_epu8(_mm256_shuffle_epi8(b, spread), offsets));
+
+            // packus works per 128-bit lane: a0-3 b0-3 | a4-7 b4-7 -> a0-7 b0-7
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+            _mm256_storeu_si256((__m256i *)(d + x * 2), packed);
+        }
+        convert_span(s, d, x, width, y, dither);
+    }
+}
+#endif /* __GNUC__ */
+
+#endif /* RGB565_X86 */
+
+#if RGB565_NEON
+
+/**
+ * NEON: vld3 de-interleaves 16 pixels, vst2 writes the two output bytes interleaved
+ */
+static void rgb565_convert_neon(const uint8_t *src, uint8_t *dst,
+                                uint32_t width, uint32_t height, int dither)
+{
+    const uint8x16_t mask_hi = vdupq_n_u8(0xF8);
+    const uint8x16_t mask_lo = vdupq_n_u8(0xE0);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const size_t row = (size_t)y * width;
+        const uint8_t *s = src + row * 3;
+        uint8_t *d = dst + row * 2;
+
+        uint8_t rb_offsets[16] = {0};
+        uint8_t g_offsets[16] = {0};
+        if (dither) {
+            for (uint32_t i = 0; i < 16; i++) {
+                rb_offsets[i] = dither_rb(i, y);
+                g_offsets[i] = dither_g(i, y);
+            }
+        }
+        const uint8x16_t rb_offset = vld1q_u8(rb_offsets);
+        const uint8x16_t g_offset = vld1q_u8(g_offsets);
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x3_t px = vld3q_u8(s + x * 3);
+            uint8x16_t r = vqaddq_u8(px.val[0], rb_offset);
+            uint8x16_t g = vqaddq_u8(px.val[1], g_offset);
+            uint8x16_t b = vqaddq_u8(px.val[2], rb_offset);
+
+            uint8x16x2_t out;
+            out.val[0] = vorrq_u8(vandq_u8(r, mask_hi), vshrq_n_u8(g, 5));
+            out.val[1] = vorrq_u8(vandq_u8(vshlq_n_u8(g, 3), mask_lo), vshrq_n_u8(b, 3));
+            vst2q_u8(d + x * 2, out);
+        }
+        convert_span(s, d, x, width, y, dither);
+    }
+}
+
+#endif /* RGB565_NEON */
+
+rgb565_convert_fn rgb565_find(const char *name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        return rgb565_convert_scalar;
+    }
+#if RGB565_X86
+    if (strcmp(name, "sse2") == 0) {
+        return rgb565_convert_sse2;
+    }
+#endif
+#if RGB565_AVX2
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return rgb565_convert_avx2;
+    }
+#endif
+#if RGB565_NEON
+    if (strcmp(name, "neon") == 0) {
+        return rgb565_convert_neon;
+    }
+#endif
+    return NULL;
+}
+
+const char *rgb565_best(void)
+{
+    static const char *const preference[] = { "avx2", "sse2", "neon" };
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        if (rgb565_find(preference[i])) {
+            return preference[i];
+        }
+    }
+    return "scalar";
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Conversion kernel: packed RGB888 rows in, big-endian RGB565 rows out
+ * @param src RGB888 pixels, width * height * 3 bytes
+ * @param dst Output, width * height * 2 bytes (high byte first, as the ESP32 expects)
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param dither Apply 4x4 ordered (Bayer) dithering before truncation
+ */
+typedef void (*rgb565_convert_fn)(const uint8_t *src, uint8_t *dst,
+                                  uint32_t width, uint32_t height, int dither);
+
+/**
+ * @brief Portable reference implementation; every SIMD path matches it bit for bit
+ */
+void rgb565_convert_scalar(const uint8_t *src, uint8_t *dst,
+                           uint32_t width, uint32_t height, int dither);
+
+/**
+ * @brief Look up a kernel by name
+ * @param name "scalar", "sse2", "avx2" or "neon"
+ * @return Conversion function, or NULL if not built for this target or the CPU lacks it
+ */
+rgb565_convert_fn rgb565_find(const char *name);
+
+/**
+ * @brief Name of the fastest kernel the running CPU supports
+ */
+const char *rgb565_best(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,363 @@
+/**
+ * @file product-cache.js
+ * @brief Tiered product cache for barcode lookups
+ *
+ * Tier 1 is an in-memory LRU bounded by entry count. Tier 2 is a SQLite file
+ * that survives restarts. Entries are fresh for their TTL, then served stale
+ * for a grace window while a background refresh runs. Concurrent lookups of
+ * the same barcode share a single upstream call.
+ *
+ * Results fetched by peer resolver instances can be merged in with accept(),
+ * and onStore reports this instance's own upstream results for sharing.
+ *
+ * With a rate limiter, an upstream call needs a token. When the bucket is
+ * empty, any expired entry still on hand is served rather than queueing,
+ * and background refreshes are skipped until tokens are available.
+ */
+
+const Database = require('better-sqlite3');
+
+const TAG = 'product-cache';
+const PEER_CLOCK_SKEW_MS = 5000;    // Peer entries fetched further in the future than this are dropped
+
+class ProductCache {
+    /**
+     * @param {Object} options
+     * @param {Function} options.fetcher - async (barcode) => product, or null if not found; throws on upstream errors
+     * @param {string} options.dbPath - SQLite file path (null for memory only)
+     * @param {number} options.maxEntries - In-memory LRU capacity
+     * @param {number} options.ttlMs - How long a found product is fresh
+     * @param {number} options.notFoundTtlMs - How long a "not found" result is fresh
+     * @param {number} options.staleMs - Grace window after expiry where the old entry is served while refreshing
+     * @param {RateLimiter} options.limiter - Optional admission control for upstream calls
+     * @param {Function} options.onStore - Optional (barcode, entry) after each upstream result is stored
+     */
+    constructor(options) {
+        this.fetcher = options.fetcher;
+        this.maxEntries = options.maxEntries;
+        this.ttlMs = options.ttlMs;
+        this.notFoundTtlMs = options.notFoundTtlMs;
+        this.staleMs = options.staleMs;
+        this.limiter = options.limiter || null;
+        this.onStore = options.onStore || null;
+
+        // Map iteration order doubles as LRU order: oldest first
+        this.memory = new Map();
+        this.inflight = new Map();
+        this.db = null;
+
+        this.counters = {
+            memoryHits: 0,      // Fresh entry found in memory
+            diskHits: 0,        // Fresh entry found on disk (promoted to memory)
+            staleHits: 0,       // Expired entry served while a refresh runs
+            staleOnError: 0,    // Expired entry served because the upstream call failed (already a miss or coalesced)
+            staleRateLimited: 0, // Expired entry served because the upstream bucket was empty
+            refreshesSkipped: 0, // Background refreshes dropped for lack of tokens
+            rateLimited: 0,     // Upstream calls rejected by the limiter
+            coalesced: 0,       // Misses that joined an in-flight upstream call
+            misses: 0,          // Misses that started an upstream call
+            upstreamCalls: 0,
+            upstreamErrors: 0,
+            peerFills: 0,       // Entries received from other instances
+            peerRejects: 0,     // Peer entries dropped as malformed or from the future
+            evictions: 0
+        };
+        this.startedAt = Date.now();
+
+        if (options.dbPath) {
+            this.openDisk(options.dbPath);
+        }
+    }
+
+    /**
+     * Open (or create) the on-disk tier; the cache keeps working in memory if this fails
+     * @param {string} dbPath - SQLite file path
+     */
+    openDisk(dbPath) {
+        try {
+            this.db = new Database(dbPath);
+            this.db.pragma('journal_mode = WAL');
+            this.db.exec(`CREATE TABLE IF NOT EXISTS products (
+                barcode TEXT PRIMARY KEY,
+                product TEXT,
+                fetched_at INTEGER NOT NULL,
+                expires_at INTEGER NOT NULL
+            )`);
+            this.selectStmt = this.db.prepare('SELECT product, fetched_at, expires_at FROM products WHERE barcode = ?');
+            this.upsertStmt = this.db.prepare(`INSERT INTO products (barcode, product, fetched_at, expires_at)
+                VALUES (?, ?, ?, ?)
+                ON CONFLICT(barcode) DO UPDATE SET product = excluded.product,
+                    fetched_at = excluded.fetched_at, expires_at = excluded.expires_at`);
+            this.pruneStmt = this.db.prepare('DELETE FROM products WHERE expires_at < ?');
+            this.countStmt = this.db.prepare('SELECT COUNT(*) AS count FROM products');
+            console.log(`[${TAG}] On-disk cache at ${dbPath} (${this.countStmt.get().count} entries)`);
+        } catch (error) {
+            console.error(`[${TAG}] Failed to open ${dbPath}, using memory only: ${error.message}`);
+            this.db = null;
+        }
+    }
+
+    /**
+     * Look up a barcode, calling the upstream fetcher only when needed
+     * @param {string} barcode - UPC/EAN barcode
+     * @param {Object} context - { deviceId, priority } for the rate limiter
+     * @returns {Promise<Object>} Product, or null if the upstream has no product for this code
+     * @throws On upstream errors, or error.code 'RATE_LIMITED', when there is nothing cached to fall back on
+     */
+    async get(barcode, context = {}) {
+        const now = Date.now();
+
+        let entry = this.memory.get(barcode);
+        let tier = 'memory';
+        if (entry) {
+            // Refresh LRU position
+            this.memory.delete(barcode);
+            this.memory.set(barcode, entry);
+        } else {
+            entry = this.readDisk(barcode);
+            tier = 'disk';
+            if (entry) {
+                this.remember(barcode, entry);
+            }
+        }
+
+        if (entry && now < entry.expiresAt) {
+            if (tier === 'memory') {
+                this.counters.memoryHits++;
+            } else {
+                this.counters.diskHits++;
+            }
+            return entry.product;
+        }
+
+        if (entry && now < entry.expiresAt + this.staleMs) {
+            // Stale-while-revalidate: answer now, refresh in the background if a token is free
+            this.counters.staleHits++;
+            if (this.inflight.has(barcode) || !this.limiter || this.limiter.tryAcquire()) {
+                this.refresh(barcode, { ...context, admitted: true }).catch(error => {
+                    console.error(`[${TAG}] Background refresh failed for ${barcode}: ${error.message}`);
+                });
+            } else {
+                this.counters.refreshesSkipped++;
+            }
+            return entry.product;
+        }
+
+        let admitted = !this.limiter;
+        if (this.inflight.has(barcode)) {
+            this.counters.coalesced++;
+            admitted = true;
+        } else {
+            if (!admitted) {
+                admitted = this.limiter.tryAcquire();
+                if (!admitted && entry) {
+                    this.counters.staleRateLimited++;
+                    return entry.product;
+                }
+            }
+            this.counters.misses++;
+        }
+
+        try {
+            return await this.refresh(barcode, { ...context, admitted });
+        } catch (error) {
+            if (entry) {
+                // Old data beats no data while the upstream is down
+                this.counters.staleOnError++;
+                console.log(`[${TAG}] Upstream failed for ${barcode}, serving expired entry: ${error.message}`);
+                return entry.product;
+            }
+            throw error;
+        }
+    }
+
+    /**
+     * Fetch a barcode from upstream and store the result, sharing any call already in flight
+     * @param {string} barcode - UPC/EAN barcode
+     * @param {Object} context - { deviceId, priority, admitted }; admitted = token already taken
+     * @returns {Promise<Object>} Product or null if not found
+     */
+    refresh(barcode, context = {}) {
+        if (this.inflight.has(barcode)) {
+            return this.inflight.get(barcode);
+        }
+
+        const admission = context.admitted || !this.limiter
+            ? Promise.resolve()
+            : this.limiter.acquire(context);
+        const promise = admission
+            .then(() => {
+                this.counters.upstreamCalls++;
+                return this.fetcher(barcode);
+            }, error => {
+                this.counters.rateLimited++;
+                throw error;
+            })
+            .then(product => {
+                this.store(barcode, product);
+                return product;
+            }, error => {
+                if (error.code !== 'RATE_LIMITED') {
+                    this.counters.upstreamErrors++;
+                }
+                throw error;
+            })
+            .finally(() => this.inflight.delete(barcode));
+        this.inflight.set(barcode, promise);
+
+        return promise;
+    }
+
+    /**
+     * Store an upstream result in both tiers
+     * @param {string} barcode - UPC/EAN barcode
+     * @param {Object} product - Product or null for "not found"
+     */
+    store(barcode, product) {
+        const now = Date.now();
+        const entry = {
+            product: product,
+            fetchedAt: now,
+            expiresAt: now + (product ? this.ttlMs : this.notFoundTtlMs)
+        };
+
+        this.remember(barcode, entry);
+        this.persist(barcode, entry);
+        if (this.onStore) {
+            this.onStore(barcode, entry);
+        }
+    }
+
+    /**
+     * Take an entry another instance fetched, unless ours is at least as recent.
+     * The entry comes off the broker, so it must have a numeric fetchedAt that
+     * isn't in the future and an object (or null) product, and it never lives
+     * longer than store() would have kept the same result.
+     * @param {string} barcode - UPC/EAN barcode
+     * @param {Object} entry - { product, fetchedAt, expiresAt }
+     * @returns {boolean} True if the entry was stored
+     */
+    accept(barcode, entry) {
+        const { product, fetchedAt, expiresAt } = entry;
+        if (!Number.isFinite(fetchedAt) || fetchedAt > Date.now() + PEER_CLOCK_SKEW_MS ||
+            !Number.isFinite(expiresAt) || typeof product !== 'object' || Array.isArray(product)) {
+            this.counters.peerRejects++;
+            return false;
+        }
+
+        const current = this.memory.get(barcode);
+        if (current && current.fetchedAt >= fetchedAt) {
+            return false;
+        }
+
+        const ttlMs = product ? this.ttlMs : this.notFoundTtlMs;
+        const accepted = { product, fetchedAt, expiresAt: Math.min(expiresAt, fetchedAt + ttlMs) };
+        this.counters.peerFills++;
+        this.remember(barcode, accepted);
+        this.persist(barcode, accepted);
+        return true;
+    }
+
+    persist(barcode, entry) {
+        if (!this.db) {
+            return;
+        }
+        try {
+            this.upsertStmt.run(barcode, JSON.stringify(entry.product), entry.fetchedAt, entry.expiresAt);
+        } catch (error) {
+            console.error(`[${TAG}] Failed to persist ${barcode}: ${error.message}`);
+        }
+    }
+
+    /**
+     * Insert into the memory tier, evicting the least recently used entries
+     */
+    remember(barcode, entry) {
+        this.memory.delete(barcode);
+        this.memory.set(barcode, entry);
+        while (this.memory.size > this.maxEntries) {
+            this.memory.delete(this.memory.keys().next().value);
+            this.counters.evictions++;
+        }
+    }
+
+    /**
+     * Read an entry from the disk tier
+     * @returns {Object} Entry or null if absent or unreadable
+     */
+    readDisk(barcode) {
+        if (!this.db) {
+            return null;
+        }
+
+        try {
+            const row = this.selectStmt.get(barcode);
+            if (!row) {
+                return null;
+            }
+            return {
+                product: JSON.parse(row.product),
+                fetchedAt: row.fetched_at,
+                expiresAt: row.expires_at
+            };
+        } catch (error) {
+            console.error(`[${TAG}] Failed to read ${barcode}: ${error.message}`);
+            return null;
+        }
+    }
+
+    /**
+     * Drop entries that are past their stale window from both tiers
+     * @returns {number} Number of disk rows removed
+     */
+    prune() {
+        const cutoff = Date.now() - this.staleMs;
+        for (const [barcode, entry] of this.memory.entries()) {
+            if (entry.expiresAt < cutoff) {
+                this.memory.delete(barcode);
+            }
+        }
+
+        if (!this.db) {
+            return 0;
+        }
+        try {
+            return this.pruneStmt.run(cutoff).changes;
+        } catch (error) {
+            console.error(`[${TAG}] Prune failed: ${error.message}`);
+            return 0;
+        }
+    }
+
+    /**
+     * Snapshot of cache counters plus derived hit ratio and upstream call rate
+     * @returns {Object} Metrics
+     */
+    stats() {
+        const c = this.counters;
+        const hits = c.memoryHits + c.diskHits + c.staleHits + c.staleRateLimited;
+        // staleOnError lookups were already counted as misses or coalesced waits
+        const lookups = hits + c.coalesced + c.misses;
+        const minutes = Math.max((Date.now() - this.startedAt) / 60000, 1 / 60);
+
+        return {
+            ...c,
+            lookups: lookups,
+            inflight: this.inflight.size,
+            memoryEntries: this.memory.size,
+            diskEntries: this.db ? this.countStmt.get().count : 0,
+            hitRatio: lookups > 0 ? hits / lookups : 0,
+            upstreamCallsPerLookup: lookups > 0 ? c.upstreamCalls / lookups : 0,
+            upstreamCallsPerMinute: c.upstreamCalls / minutes
+        };
+    }
+
+    close() {
+        if (this.db) {
+            this.db.close();
+            this.db = null;
+        }
+    }
+}
+
+module.exports = { ProductCache };
@@ -0,0 +1,168 @@
+/**
+ * @file product-providers.js
+ * @brief Product data sources for the hedged lookup
+ *
+ * Every provider has the same shape: { name, lookup(barcode, signal) },
+ * resolving to an essential product ({ name, brand, model, price,
+ * source_image, upc }) or null when it has no product, and rejecting on
+ * timeouts and errors. Aborting `signal` cancels the request.
+ */
+
+const fs = require('fs');
+
+const TAG = 'product-providers';
+const USER_AGENT = 'ESP32-Barcode-Scanner/1.0';
+
+function abortError(message) {
+    const error = new Error(message);
+    error.name = 'AbortError';
+    return error;
+}
+
+/**
+ * BarcodeLookup through the micro-batcher. The call is shared with other
+ * codes, so cancelling only stops this lookup from waiting for it.
+ */
+function barcodeLookupProvider(context) {
+    return {
+        name: 'barcodelookup',
+        lookup(barcode, signal) {
+            const result = context.batcher.fetch(barcode);
+            if (!signal) {
+                return result;
+            }
+            return new Promise((resolve, reject) => {
+                const onAbort = () => reject(abortError('BarcodeLookup lookup cancelled'));
+                signal.addEventListener('abort', onAbort, { once: true });
+                result.then(resolve, reject).finally(() => signal.removeEventListener('abort', onAbort));
+            });
+        }
+    };
+}
+
+/**
+ * Open Food Facts: free, no key, strong on groceries
+ */
+function openFoodFactsProvider(context) {
+    const apiBase = context.openFoodFactsBase || 'https://world.openfoodfacts.org/api/v2/product';
+    return {
+        name: 'openfoodfacts',
+        async lookup(barcode, signal) {
+            const response = await context.http.request(
+                `${apiBase}/${encodeURIComponent(barcode)}.json?fields=code,product_name,brands,image_front_url`,
+                { timeoutMs: context.timeoutMs, signal, headers: { 'User-Agent': USER_AGENT } });
+            if (response.status === 404) {
+                return null;
+            }
+            if (!response.ok) {
+                throw new Error(`Open Food Facts request failed: ${response.status} ${response.statusText}`);
+            }
+            const data = response.json();
+            const product = data.product;
+            if (data.status === 0 || !product || !product.product_name) {
+                return null;
+            }
+            return {
+                name: product.product_name,
+                brand: (product.brands || '').split(',')[0].trim() || 'Unknown Brand',
+                model: '',
+                price: 'Price N/A',
+                source_image: product.image_front_url || null,
+                upc: product.code || barcode
+            };
+        }
+    };
+}
+
+/**
+ * UPCitemdb: general merchandise; the trial endpoint needs no key but is rate limited
+ */
+function upcItemDbProvider(context) {
+    const apiBase = context.upcItemDbBase || 'https://api.upcitemdb.com/prod/trial/lookup';
+    return {
+        name: 'upcitemdb',
+        async lookup(barcode, signal) {
+            const response = await context.http.request(`${apiBase}?upc=${encodeURIComponent(barcode)}`,
+                { timeoutMs: context.timeoutMs, signal, headers: { 'User-Agent': USER_AGENT } });
+            if (response.status === 404) {
+                return null;
+            }
+            if (!response.ok) {
+                throw new Error(`UPCitemdb request failed: ${response.status} ${response.statusText}`);
+            }
+            const item = (response.json().items || [])[0];
+            if (!item) {
+                return null;
+            }
+            const price = Array.isArray(item.offers) && item.offers.length > 0
+                ? item.offers[0].price : item.lowest_recorded_price;
+            return {
+                name: item.title || 'Unknown Product',
+                brand: item.brand || 'Unknown Brand',
+                model: item.model || '',
+                price: price ? `$${price}` : 'Price N/A',
+                source_image: Array.isArray(item.images) && typeof item.images[0] === 'string' ? item.images[0] : null,
+                upc: item.upc || item.ean || barcode
+            };
+        }
+    };
+}
+
+/**
+ * Local product database: a JSON file of { "<barcode>": { name, brand, model, price, image } },
+ * e.g. a store's own inventory. Answers instantly, so it is normally tried first.
+ */
+function localProvider(context) {
+    let products = {};
+    if (context.localProductsFile) {
+        try {
+            products = JSON.parse(fs.readFileSync(context.localProductsFile, 'utf8'));
+            console.log(`[${TAG}] Loaded ${Object.keys(products).length} local products from ${context.localProductsFile}`);
+        } catch (error) {
+            console.error(`[${TAG}] Failed to load local products from ${context.localProductsFile}: ${error.message}`);
+        }
+    }
+    return {
+        name: 'local',
+        async lookup(barcode) {
+            const product = products[barcode];
+            if (!product) {
+                return null;
+            }
+            return {
+                name: product.name || 'Unknown Product',
+                brand: product.brand || 'Unknown Brand',
+                model: product.model || '',
+                price: product.price ? `$${product.price}` : 'Price N/A',
+                source_image: product.image || null,
+                upc: barcode
+            };
+        }
+    };
+}
+
+const FACTORIES = {
+    barcodelookup: barcodeLookupProvider,
+    openfoodfacts: openFoodFactsProvider,
+    upcitemdb: upcItemDbProvider,
+    local: localProvider
+};
+
+/**
+ * Build providers by name, in preference order
+ * @param {string[]} names - Provider names (barcodelookup, openfoodfacts, upcitemdb, local)
+ * @param {Object} context - { batcher, http, timeoutMs, localProductsFile, openFoodFactsBase, upcItemDbBase }
+ * @returns {Object[]} Providers
+ * @throws On unknown provider names, so a typo fails at startup
+ */
+function createProviders(names, context) {
+    return names.map(name => {
+        const factory = FACTORIES[name];
+        if (!factory) {
+            throw new Error(`Unknown product provider "${name}" (expected one of ${Object.keys(FACTORIES).join(', ')})`);
+        }
+        return factory(context);
+    });
+}
+
+module.exports = { createProviders };
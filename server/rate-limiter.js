@@ -0,0 +1,218 @@
+/**
+ * @file rate-limiter.js
+ * @brief Token-bucket admission control for upstream lookups
+ *
+ * Tokens refill continuously up to a burst size. When none are left,
+ * lookups queue: interactive scans are always served before batch work
+ * (inventory runs, background refreshes), and within a class devices take
+ * turns, so one device stuck in a scanning loop only delays itself. Each
+ * device may only have a few lookups queued, and nobody waits forever;
+ * both limits reject with error.code 'RATE_LIMITED'.
+ */
+
+const { LatencyHistogram } = require('./latency-histogram');
+
+const TAG = 'rate-limiter';
+const PRIORITIES = ['interactive', 'batch'];
+
+function rateLimited(message, reason) {
+    const error = new Error(message);
+    error.code = 'RATE_LIMITED';
+    error.reason = reason;
+    return error;
+}
+
+class RateLimiter {
+    /**
+     * @param {Object} options
+     * @param {number} options.ratePerSec - Sustained upstream lookups per second
+     * @param {number} options.burst - Bucket size
+     * @param {number} options.maxQueue - Lookups allowed to wait, across all devices
+     * @param {number} options.maxQueuePerDevice - Lookups one device may have waiting
+     * @param {number} options.maxWaitMs - Waiting lookups are rejected after this
+     * @param {Function} options.onWait - Optional (ms, outcome, priority) for each lookup that queued; outcome is 'granted' or 'timeout'
+     */
+    constructor(options) {
+        this.ratePerSec = options.ratePerSec;
+        this.burst = options.burst;
+        this.maxQueue = options.maxQueue;
+        this.maxQueuePerDevice = options.maxQueuePerDevice;
+        this.maxWaitMs = options.maxWaitMs;
+        this.onWait = options.onWait || null;
+
+        this.tokens = this.burst;
+        this.refilledAt = Date.now();
+        this.timer = null;
+
+        // priority -> Map(deviceId -> waiters[]); Map order is the round-robin order
+        this.queues = new Map(PRIORITIES.map(priority => [priority, new Map()]));
+        this.queued = 0;
+
+        this.waitHistogram = new LatencyHistogram();
+        this.counters = {
+            admitted: 0,          // Granted a token without waiting
+            queuedTotal: 0,       // Had to wait for a token
+            granted: 0,           // Waited and got one
+            rejectedQueueFull: 0,
+            rejectedDeviceLimit: 0,
+            rejectedTimeout: 0,
+            peakQueue: 0
+        };
+
+        console.log(`[${TAG}] ${(this.ratePerSec * 60).toFixed(1)} upstream lookups/min, burst ${this.burst}, ` +
+            `queue ${this.maxQueue} (${this.maxQueuePerDevice} per device), max wait ${this.maxWaitMs}ms`);
+    }
+
+    refill() {
+        const now = Date.now();
+        this.tokens = Math.min(this.burst, this.tokens + (now - this.refilledAt) * this.ratePerSec / 1000);
+        this.refilledAt = now;
+    }
+
+    /**
+     * Take a token only if one is free right now and nobody is waiting for it
+     * @returns {boolean} true if admitted
+     */
+    tryAcquire() {
+        this.refill();
+        if (this.queued === 0 && this.tokens >= 1) {
+            this.tokens--;
+            this.counters.admitted++;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Wait for a token
+     * @param {Object} context - { deviceId, priority: 'interactive' | 'batch' }
+     * @returns {Promise<void>} Resolves when admitted
+     * @throws error.code 'RATE_LIMITED' when the queue is full or the wait times out
+     */
+    acquire(context = {}) {
+        if (this.tryAcquire()) {
+            return Promise.resolve();
+        }
+
+        const priority = context.priority === 'batch' ? 'batch' : 'interactive';
+        const deviceId = context.deviceId || 'unknown';
+        const devices = this.queues.get(priority);
+        const waiters = devices.get(deviceId) || [];
+
+        if (waiters.length >= this.maxQueuePerDevice) {
+            this.counters.rejectedDeviceLimit++;
+            return Promise.reject(rateLimited(`Device ${deviceId} has ${waiters.length} lookups waiting`, 'device_limit'));
+        }
+        if (this.queued >= this.maxQueue) {
+            this.counters.rejectedQueueFull++;
+            return Promise.reject(rateLimited('Upstream queue full', 'queue_full'));
+        }
+
+        return new Promise((resolve, reject) => {
+            const waiter = { resolve, reject, priority, queuedAt: Date.now(), timer: null };
+            waiter.timer = setTimeout(() => this.expire(priority, deviceId, waiter), this.maxWaitMs);
+            waiters.push(waiter);
+            devices.set(deviceId, waiters);
+            this.queued++;
+            this.counters.queuedTotal++;
+            this.counters.peakQueue = Math.max(this.counters.peakQueue, this.queued);
+            this.schedule();
+        });
+    }
+
+    expire(priority, deviceId, waiter) {
+        const devices = this.queues.get(priority);
+        const waiters = devices.get(deviceId);
+        const index = waiters ? waiters.indexOf(waiter) : -1;
+        if (index < 0) {
+            return;
+        }
+        waiters.splice(index, 1);
+        if (waiters.length === 0) {
+            devices.delete(deviceId);
+        }
+        this.queued--;
+        this.counters.rejectedTimeout++;
+        this.recordWait(waiter, 'timeout');
+        waiter.reject(rateLimited(`Waited ${this.maxWaitMs}ms for an upstream slot`, 'timeout'));
+    }
+
+    recordWait(waiter, outcome) {
+        const ms = Date.now() - waiter.queuedAt;
+        this.waitHistogram.observe(ms);
+        if (this.onWait) {
+            this.onWait(ms, outcome, waiter.priority);
+        }
+    }
+
+    /**
+     * Next waiter: highest priority class first, devices in turn within a class
+     */
+    next() {
+        for (const priority of PRIORITIES) {
+            const devices = this.queues.get(priority);
+            for (const [deviceId, waiters] of devices) {
+                const waiter = waiters.shift();
+                // Move the device to the back of the rotation (or drop it once drained)
+                devices.delete(deviceId);
+                if (waiters.length > 0) {
+                    devices.set(deviceId, waiters);
+                }
+                return waiter;
+            }
+        }
+        return null;
+    }
+
+    /**
+     * Hand out the tokens that have accrued, then sleep until the next one
+     */
+    drain() {
+        this.timer = null;
+        this.refill();
+        while (this.queued > 0 && this.tokens >= 1) {
+            const waiter = this.next();
+            this.tokens--;
+            this.queued--;
+            clearTimeout(waiter.timer);
+            this.counters.granted++;
+            this.recordWait(waiter, 'granted');
+            waiter.resolve();
+        }
+        this.schedule();
+    }
+
+    schedule() {
+        if (this.timer || this.queued === 0) {
+            return;
+        }
+        const wait = Math.max(1, Math.ceil((1 - this.tokens) * 1000 / this.ratePerSec));
+        this.timer = setTimeout(() => this.drain(), wait);
+    }
+
+    stats() {
+        this.refill();
+        const queuedBy = {};
+        for (const [priority, devices] of this.queues) {
+            let count = 0;
+            for (const waiters of devices.values()) {
+                count += waiters.length;
+            }
+            queuedBy[priority] = count;
+        }
+        return {
+            ...this.counters,
+            rejected: this.counters.rejectedQueueFull + this.counters.rejectedDeviceLimit + this.counters.rejectedTimeout,
+            tokens: Math.floor(this.tokens),
+            queued: this.queued,
+            queuedInteractive: queuedBy.interactive,
+            queuedBatch: queuedBy.batch,
+            queuedDevices: this.queues.get('interactive').size + this.queues.get('batch').size,
+            waitP50Ms: this.waitHistogram.quantile(0.5),
+            waitP99Ms: this.waitHistogram.quantile(0.99),
+            avgWaitMs: this.waitHistogram.count > 0 ? this.waitHistogram.sum / this.waitHistogram.count : 0
+        };
+    }
+}
+
+module.exports = { RateLimiter };
@@ -0,0 +1,223 @@
+/**
+ * @file request-ledger.js
+ * @brief Idempotent handling of device requests, keyed by request ID
+ *
+ * MQTT QoS 1 is at-least-once: when a PUBACK is lost the device retransmits,
+ * and with a shared subscription the copy may be handed to a different
+ * resolver instance. The ledger records each request ID the first time it is
+ * claimed. A repeat of a finished request gets the stored response again
+ * instead of a second lookup; a repeat of one still being worked on is
+ * dropped, since the original will answer.
+ *
+ * Claims live in memory and, given a dbPath, in a SQLite table that every
+ * instance using the same file sees, so the claim is atomic across
+ * processes. A claim whose owner never finished (crashed) is taken over
+ * after claimTimeoutMs.
+ */
+
+const Database = require('better-sqlite3');
+
+const TAG = 'request-ledger';
+
+class RequestLedger {
+    /**
+     * @param {Object} options
+     * @param {string} options.dbPath - SQLite file shared with other instances (null for this process only)
+     * @param {string} options.owner - Unique name of this instance (e.g. its MQTT client ID)
+     * @param {number} options.ttlMs - How long a request ID is remembered
+     * @param {number} options.claimTimeoutMs - Unfinished claims older than this are taken over
+     * @param {number} options.maxEntries - In-memory entries kept before the oldest are dropped
+     */
+    constructor(options) {
+        this.owner = options.owner;
+        this.ttlMs = options.ttlMs;
+        this.claimTimeoutMs = options.claimTimeoutMs;
+        this.maxEntries = options.maxEntries;
+
+        // key -> { response, claimedAt }; insertion order is age order
+        this.memory = new Map();
+        this.db = null;
+
+        this.counters = {
+            claimed: 0,         // First sighting, processed here
+            resent: 0,          // Repeat of a finished request, answered from the ledger
+            dropped: 0,         // Repeat of a request still in progress
+            takenOver: 0        // Expired or abandoned claims reused
+        };
+
+        if (options.dbPath) {
+            this.openDisk(options.dbPath);
+        }
+    }
+
+    /**
+     * Open (or create) the shared table; the ledger keeps working per process if this fails
+     * @param {string} dbPath - SQLite file path
+     */
+    openDisk(dbPath) {
+        try {
+            this.db = new Database(dbPath);
+            this.db.pragma('journal_mode = WAL');
+            this.db.exec(`CREATE TABLE IF NOT EXISTS request_ledger (
+                key TEXT PRIMARY KEY,
+                response TEXT,
+                claimed_at INTEGER NOT NULL,
+                owner TEXT NOT NULL
+            )`);
+            this.claimStmt = this.db.prepare('INSERT OR IGNORE INTO request_ledger (key, response, claimed_at, owner) VALUES (?, NULL, ?, ?)');
+            this.selectStmt = this.db.prepare('SELECT response, claimed_at FROM request_ledger WHERE key = ?');
+            this.takeOverStmt = this.db.prepare(`UPDATE request_ledger SET response = NULL, claimed_at = ?, owner = ?
+                WHERE key = ? AND claimed_at = ?`);
+            this.completeStmt = this.db.prepare('UPDATE request_ledger SET response = ? WHERE key = ? AND owner = ?');
+            this.releaseStmt = this.db.prepare('DELETE FROM request_ledger WHERE key = ? AND owner = ? AND response IS NULL');
+            this.pruneStmt = this.db.prepare('DELETE FROM request_ledger WHERE claimed_at < ?');
+        } catch (error) {
+            console.error(`[${TAG}] Failed to open ${dbPath}, deduplicating per process only: ${error.message}`);
+            this.db = null;
+        }
+    }
+
+    /**
+     * Classify an existing record
+     * @returns {Object} null if the record no longer counts, else { state: 'done', response } or { state: 'inflight' }
+     */
+    existing(response, claimedAt, now) {
+        const age = now - claimedAt;
+        if (age >= this.ttlMs) {
+            return null;
+        }
+        if (response !== null) {
+            return { state: 'done', response };
+        }
+        return age < this.claimTimeoutMs ? { state: 'inflight' } : null;
+    }
+
+    /**
+     * Claim a request ID for processing
+     * @param {string} key - Device ID and request ID
+     * @returns {Object} { state: 'new' } to process it, { state: 'done', response } to resend
+     *                   the stored response, or { state: 'inflight' } to drop it
+     */
+    claim(key) {
+        const now = Date.now();
+
+        const local = this.memory.get(key);
+        const known = local ? this.existing(local.response, local.claimedAt, now) : null;
+        if (known) {
+            this.count(known);
+            return known;
+        }
+
+        if (this.db) {
+            try {
+                if (this.claimStmt.run(key, now, this.owner).changes === 0) {
+                    const row = this.selectStmt.get(key);
+                    const shared = row ? this.existing(row.response, row.claimed_at, now) : null;
+                    if (shared) {
+                        this.count(shared);
+                        return shared;
+                    }
+                    // Expired, or the owner never finished; the conditional update makes the takeover race-free
+                    if (row && this.takeOverStmt.run(now, this.owner, key, row.claimed_at).changes === 0) {
+                        this.counters.dropped++;
+                        return { state: 'inflight' };
+                    }
+                    this.counters.takenOver++;
+                }
+            } catch (error) {
+                console.error(`[${TAG}] Claim of ${key} failed, processing without shared check: ${error.message}`);
+            }
+        }
+
+        this.memory.delete(key);
+        this.memory.set(key, { response: null, claimedAt: now });
+        while (this.memory.size > this.maxEntries) {
+            this.memory.delete(this.memory.keys().next().value);
+        }
+        this.counters.claimed++;
+        return { state: 'new' };
+    }
+
+    count(result) {
+        if (result.state === 'done') {
+            this.counters.resent++;
+        } else {
+            this.counters.dropped++;
+        }
+    }
+
+    /**
+     * Record the response of a claimed request so repeats can be answered from it
+     * @param {string} key - Key passed to claim()
+     * @param {string} response - Serialized response payload
+     */
+    complete(key, response) {
+        const local = this.memory.get(key);
+        if (local) {
+            local.response = response;
+        }
+        if (this.db) {
+            try {
+                this.completeStmt.run(response, key, this.owner);
+            } catch (error) {
+                console.error(`[${TAG}] Failed to record response for ${key}: ${error.message}`);
+            }
+        }
+    }
+
+    /**
+     * Give up a claim without a response, so a retransmission is processed again
+     * @param {string} key - Key passed to claim()
+     */
+    release(key) {
+        this.memory.delete(key);
+        if (this.db) {
+            try {
+                this.releaseStmt.run(key, this.owner);
+            } catch (error) {
+                console.error(`[${TAG}] Failed to release ${key}: ${error.message}`);
+            }
+        }
+    }
+
+    /**
+     * Forget request IDs older than the TTL
+     * @returns {number} Number of shared rows removed
+     */
+    prune() {
+        const cutoff = Date.now() - this.ttlMs;
+        for (const [key, entry] of this.memory) {
+            if (entry.claimedAt >= cutoff) {
+                break;
+            }
+            this.memory.delete(key);
+        }
+
+        if (!this.db) {
+            return 0;
+        }
+        try {
+            return this.pruneStmt.run(cutoff).changes;
+        } catch (error) {
+            console.error(`[${TAG}] Prune failed: ${error.message}`);
+            return 0;
+        }
+    }
+
+    stats() {
+        return {
+            ...this.counters,
+            entries: this.memory.size,
+            shared: !!this.db
+        };
+    }
+
+    close() {
+        if (this.db) {
+            this.db.close();
+            this.db = null;
+        }
+    }
+}
+
+module.exports = { RequestLedger };
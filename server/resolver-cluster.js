@@ -0,0 +1,201 @@
+#!/usr/bin/env node
+/**
+ * @file resolver-cluster.js
+ * @brief Multi-process barcode resolver
+ *
+ * Forks RESOLVER_PROCESSES copies of barcode-resolver.js. This process owns
+ * the MQTT subscription and routes each request to a worker by barcode, so
+ * repeat scans of a code land on the process that already has it cached and
+ * concurrent scans still share one upstream call. Workers publish their own
+ * responses, share port 3000 through the cluster module, and share the
+ * SQLite product cache on disk. Each spills evicted images to its own
+ * process-<slot> directory under IMAGE_SPILL_DIR.
+ *
+ * Whichever worker takes a /metrics or /stats request asks this process to
+ * gather every worker's report, so a scrape covers the whole cluster with a
+ * process="<slot>" label per worker rather than one random process.
+ *
+ * Several clusters (or single resolvers) can consume the same request
+ * stream: the subscription joins the RESOLVER_SHARE_GROUP MQTT 5 shared
+ * subscription, so the broker hands each request to one of them.
+ *
+ * Usage: RESOLVER_PROCESSES=4 npm run start:cluster
+ */
+
+const cluster = require('cluster');
+const crypto = require('crypto');
+const mqtt = require('mqtt');
+const os = require('os');
+const path = require('path');
+require('dotenv').config();
+
+const MQTT_BROKER_URI = process.env.MQTT_BROKER_URI || 'mqtt://desk.local:1883';
+const RESOLVER_PROCESSES = parseInt(process.env.RESOLVER_PROCESSES) || Math.max(2, Math.floor(os.cpus().length / 2));
+const RESTART_DELAY_MS = 1000;
+const COLLECT_TIMEOUT_MS = 1500;    // Below the workers' own fallback, so late workers are left out, not the whole scrape
+const RESOLVER_SHARE_GROUP = process.env.RESOLVER_SHARE_GROUP ?? 'resolvers';  // Empty = plain subscription
+const REQUEST_TOPIC = 'barcode/lookup/request/+';
+const REQUEST_SUBSCRIPTION = RESOLVER_SHARE_GROUP ? `$share/${RESOLVER_SHARE_GROUP}/${REQUEST_TOPIC}` : REQUEST_TOPIC;
+
+const TAG = 'resolver-cluster';
+
+// Split the cores between processes instead of giving every process a full image pool
+const imageWorkersPerProcess = process.env.IMAGE_WORKERS ??
+    String(Math.max(1, Math.floor(os.cpus().length / RESOLVER_PROCESSES) - 1));
+
+const workers = new Array(RESOLVER_PROCESSES).fill(null);
+const routed = new Array(RESOLVER_PROCESSES).fill(0);
+let shuttingDown = false;
+
+cluster.setupPrimary({ exec: path.join(__dirname, 'barcode-resolver.js') });
+
+function fork(slot) {
+    const env = {
+        RESOLVER_CLUSTER_CHILD: '1',
+        RESOLVER_SLOT: String(slot),
+        RESOLVER_PROCESS_COUNT: String(RESOLVER_PROCESSES),   // Each process takes its share of the upstream rate limit
+        IMAGE_WORKERS: imageWorkersPerProcess
+    };
+    if (process.env.IMAGE_SPILL_DIR) {
+        // One spill directory per slot: a process empties its own at startup, and
+        // siblings writing the same keys would truncate each other's files
+        env.IMAGE_SPILL_DIR = path.join(process.env.IMAGE_SPILL_DIR, `process-${slot}`);
+    }
+    const worker = cluster.fork(env);
+    workers[slot] = worker;
+
+    worker.on('message', (message) => {
+        if (message.type === 'collect') {
+            collect(worker, message);
+        } else if (message.type === 'report') {
+            const collection = collections.get(message.id);
+            if (collection) {
+                collection.results.push({ slot, body: message.body });
+                collection.waiting.delete(slot);
+                if (collection.waiting.size === 0) {
+                    finishCollection(message.id);
+                }
+            }
+        }
+    });
+
+    worker.on('exit', (code, signal) => {
+        workers[slot] = null;
+        if (shuttingDown) {
+            return;
+        }
+        console.error(`[${TAG}] Worker ${worker.process.pid} (slot ${slot}) exited (${signal || code}), restarting`);
+        setTimeout(() => fork(slot), RESTART_DELAY_MS);
+    });
+}
+
+// Cluster-wide /metrics and /stats: ask every live worker for its report
+const collections = new Map();
+let nextCollectionId = 0;
+
+function collect(requester, { id, what }) {
+    const collectionId = nextCollectionId++;
+    const collection = { requester, requestId: id, results: [], waiting: new Set() };
+    collections.set(collectionId, collection);
+    workers.forEach((worker, slot) => {
+        if (worker && worker.isConnected()) {
+            collection.waiting.add(slot);
+            worker.send({ type: 'report', id: collectionId, what });
+        }
+    });
+    collection.timer = setTimeout(() => finishCollection(collectionId), COLLECT_TIMEOUT_MS);
+}
+
+function finishCollection(collectionId) {
+    const collection = collections.get(collectionId);
+    collections.delete(collectionId);
+    clearTimeout(collection.timer);
+    if (collection.requester.isConnected()) {
+        collection.results.sort((a, b) => a.slot - b.slot);
+        collection.requester.send({ type: 'collected', id: collection.requestId, results: collection.results });
+    }
+}
+
+/**
+ * Pick the worker for a barcode; falls through to the next live slot while one restarts
+ * @param {string} barcode - Barcode from the request (may be undefined)
+ * @returns {number} Worker slot, or -1 if none are running
+ */
+function slotFor(barcode) {
+    const hash = crypto.createHash('md5').update(String(barcode)).digest().readUInt32BE(0);
+    for (let i = 0; i < RESOLVER_PROCESSES; i++) {
+        const slot = (hash + i) % RESOLVER_PROCESSES;
+        if (workers[slot] && workers[slot].isConnected()) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+console.log(`[${TAG}] Starting ${RESOLVER_PROCESSES} resolver processes (${imageWorkersPerProcess} image workers each)`);
+for (let slot = 0; slot < RESOLVER_PROCESSES; slot++) {
+    fork(slot);
+}
+
+const client = mqtt.connect(MQTT_BROKER_URI, {
+    clientId: `barcode-resolver-cluster-${Math.random().toString(16).substr(2, 8)}`,
+    protocolVersion: RESOLVER_SHARE_GROUP ? 5 : 4,
+    keepalive: 30,
+    reconnectPeriod: 5000,
+    connectTimeout: 10000,
+});
+
+client.on('connect', () => {
+    console.log(`[${TAG}] Connected to MQTT broker`);
+    client.subscribe(REQUEST_SUBSCRIPTION, { qos: 1 }, (error) => {
+        if (error) {
+            console.error(`[${TAG}] Failed to subscribe:`, error);
+        } else {
+            console.log(`[${TAG}] Subscribed to ${REQUEST_SUBSCRIPTION}`);
+        }
+    });
+});
+
+client.on('message', (topic, message) => {
+    if (!topic.startsWith('barcode/lookup/request/')) {
+        return;
+    }
+
+    let barcode;
+    try {
+        barcode = JSON.parse(message.toString()).barcode;
+    } catch (error) {
+        // Let a worker log the malformed request like the single-process resolver does
+    }
+
+    const slot = slotFor(barcode);
+    if (slot < 0) {
+        console.error(`[${TAG}] No resolver workers available, dropping request on ${topic}`);
+        return;
+    }
+    routed[slot]++;
+    workers[slot].send({ topic, message: message.toString('base64') });
+});
+
+client.on('error', (error) => {
+    console.error(`[${TAG}] MQTT Error:`, error);
+});
+
+// Routing balance, for spotting hot barcodes pinned to one process
+setInterval(() => {
+    console.log(`[${TAG}] Requests per process: ${routed.join(' / ')}`);
+}, 1800000); // 30 minutes
+
+function shutdown() {
+    shuttingDown = true;
+    console.log(`[${TAG}] Shutting down resolver cluster...`);
+    for (const worker of workers) {
+        if (worker) {
+            worker.process.kill('SIGTERM');
+        }
+    }
+    client.end(() => process.exit(0));
+}
+
+process.on('SIGINT', shutdown);
+process.on('SIGTERM', shutdown);
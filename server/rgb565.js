@@ -0,0 +1,82 @@
+/**
+ * @file rgb565.js
+ * @brief RGB888 -> big-endian RGB565 conversion for the ESP32 image pipeline
+ *
+ * Uses the optional native addon (native/rgb565, SSE2/AVX2/NEON) when it
+ * built, and falls back to the JavaScript loop otherwise. Both produce
+ * identical bytes, with or without dithering.
+ */
+
+let native = null;
+try {
+    native = require('rgb565-native');
+} catch (error) {
+    // Addon not built (no compiler at install time); the JS loop is the fallback
+}
+
+// 4x4 Bayer thresholds; same table and scaling as native/rgb565/src/rgb565.c
+const BAYER4 = [
+    [0, 8, 2, 10],
+    [12, 4, 14, 6],
+    [3, 11, 1, 9],
+    [15, 7, 13, 5]
+];
+
+/**
+ * Reference JavaScript conversion
+ * @param {Buffer} rawBuffer - Packed RGB888 pixels
+ * @param {number} width - Image width
+ * @param {number} height - Image height
+ * @param {boolean} dither - Apply 4x4 ordered dithering before truncation
+ * @returns {Buffer} Big-endian RGB565 pixels
+ */
+function convertJs(rawBuffer, width, height, dither = false) {
+    const rgb565Buffer = Buffer.alloc(width * height * 2);
+    for (let i = 0, j = 0, p = 0; p < width * height; i += 3, j += 2, p++) {
+        let r8 = rawBuffer[i];
+        let g8 = rawBuffer[i + 1];
+        let b8 = rawBuffer[i + 2];
+
+        if (dither) {
+            const threshold = BAYER4[Math.floor(p / width) & 3][(p % width) & 3];
+            r8 = Math.min(255, r8 + (threshold >> 1));
+            g8 = Math.min(255, g8 + (threshold >> 2));
+            b8 = Math.min(255, b8 + (threshold >> 1));
+        }
+
+        const r = r8 >> 3;     // 5 bits for red (0-31)
+        const g = g8 >> 2;     // 6 bits for green (0-63)
+        const b = b8 >> 3;     // 5 bits for blue (0-31)
+
+        // RGB565 format: RRRRRGGG GGGBBBBB
+        const rgb565 = (r << 11) | (g << 5) | b;
+
+        // Big-endian byte order (high byte first)
+        rgb565Buffer[j] = (rgb565 >> 8) & 0xFF;     // High byte first
+        rgb565Buffer[j + 1] = rgb565 & 0xFF;        // Low byte second
+    }
+
+    return rgb565Buffer;
+}
+
+/**
+ * Convert with the fastest available implementation
+ * @param {Buffer} rawBuffer - Packed RGB888 pixels
+ * @param {number} width - Image width
+ * @param {number} height - Image height
+ * @param {boolean} dither - Apply 4x4 ordered dithering before truncation
+ * @returns {Buffer} Big-endian RGB565 pixels
+ */
+function convert(rawBuffer, width, height, dither = false) {
+    if (native) {
+        return native.convert(rawBuffer, width, height, dither);
+    }
+    return convertJs(rawBuffer, width, height, dither);
+}
+
+module.exports = {
+    convert,
+    convertJs,
+    native,
+    implementation: native ? `native (${native.kernel})` : 'javascript'
+};
@@ -0,0 +1,110 @@
+#!/usr/bin/env node
+/**
+ * @file batch-bench.js
+ * @brief Upstream calls per lookup with and without micro-batching
+ *
+ * Drives UpstreamBatcher directly (no product cache, so every lookup is a
+ * miss) with Poisson-distributed scans and reports, per configuration, how
+ * many API calls the stub provider was billed for and what the batching
+ * window added to lookup latency.
+ *
+ * Run against tools/stub-upstream.js:
+ *   node tools/stub-upstream.js &
+ *   node tools/batch-bench.js
+ *
+ * Environment:
+ *   STUB_URL          Stub provider base (default http://localhost:4000)
+ *   BENCH_LOOKUPS     Lookups per configuration (default 1000)
+ *   BENCH_RATE        Mean lookups per second (default 200)
+ *   BENCH_CONFIGS     Batch size/window pairs (default "1/0,10/5,10/20")
+ */
+
+const { UpstreamBatcher } = require('../upstream-batcher');
+const barcodeApi = require('../barcode-api');
+const { percentile } = require('./bench-util');
+
+const STUB_URL = process.env.STUB_URL || 'http://localhost:4000';
+const LOOKUPS = parseInt(process.env.BENCH_LOOKUPS) || 1000;
+const RATE = parseFloat(process.env.BENCH_RATE) || 200;
+const CONFIGS = (process.env.BENCH_CONFIGS || '1/0,10/5,10/20').split(',').map(pair => {
+    const [maxBatch, windowMs] = pair.split('/').map(Number);
+    return { maxBatch, windowMs };
+});
+
+const TAG = 'batch-bench';
+
+async function stubStats() {
+    const response = await fetch(`${STUB_URL}/stats`);
+    return response.json();
+}
+
+async function runConfig(config, round) {
+    const batcher = new UpstreamBatcher({
+        fetchBatch: codes => barcodeApi.fetchProducts(codes, {
+            apiBase: `${STUB_URL}/v3/products`,
+            apiKey: 'bench',
+            timeoutMs: 10000
+        }),
+        maxBatch: config.maxBatch,
+        windowMs: config.windowMs
+    });
+
+    const before = await stubStats();
+    const latencies = [];
+    let found = 0;
+    let failed = 0;
+    const lookups = [];
+
+    for (let i = 0; i < LOOKUPS; i++) {
+        // Distinct codes per round so nothing is shared between configurations
+        const barcode = String(800000000000 + round * 1000000 + i);
+        const start = process.hrtime.bigint();
+        lookups.push(batcher.fetch(barcode).then(product => {
+            latencies.push(Number(process.hrtime.bigint() - start) / 1e6);
+            if (product) {
+                found++;
+            }
+        }, () => failed++));
+        await new Promise(resolve => setTimeout(resolve, -Math.log(1 - Math.random()) * 1000 / RATE));
+    }
+    await Promise.all(lookups);
+
+    const after = await stubStats();
+    const stats = batcher.stats();
+    const calls = after.apiCalls - before.apiCalls;
+    latencies.sort((a, b) => a - b);
+
+    console.log(`[${TAG}] batch ${String(config.maxBatch).padStart(2)} / ${String(config.windowMs).padStart(2)}ms: ` +
+        `${calls} calls for ${LOOKUPS} lookups (${(calls / LOOKUPS).toFixed(3)}/lookup, ` +
+        `avg batch ${stats.avgBatchSize.toFixed(2)}, ${stats.singleRetries} retries), ` +
+        `cost ${(after.cost - before.cost).toFixed(2)}, found ${found}, failed ${failed}, ` +
+        `p50 ${percentile(latencies, 0.5).toFixed(1)} p99 ${percentile(latencies, 0.99).toFixed(1)} ms`);
+    return calls / LOOKUPS;
+}
+
+async function main() {
+    // Keep the client's verbose per-call logging out of the report
+    const log = console.log;
+    console.log = (...args) => {
+        if (typeof args[0] === 'string' && args[0].startsWith(`[${TAG}]`)) {
+            log(...args);
+        }
+    };
+
+    log(`[${TAG}] ${LOOKUPS} lookups per configuration at ~${RATE}/s against ${STUB_URL}`);
+    const results = [];
+    for (let round = 0; round < CONFIGS.length; round++) {
+        results.push(await runConfig(CONFIGS[round], round));
+    }
+
+    const baseline = results[0];
+    for (let i = 1; i < results.length; i++) {
+        log(`[${TAG}] ${CONFIGS[i].maxBatch}/${CONFIGS[i].windowMs}ms: ` +
+            `${(baseline / results[i]).toFixed(1)}x fewer upstream calls than ${CONFIGS[0].maxBatch}/${CONFIGS[0].windowMs}ms`);
+    }
+}
+
+main().catch(error => {
+    console.error(`[${TAG}] ${error.message}`);
+    process.exit(1);
+});
@@ -0,0 +1,23 @@
+/**
+ * @file bench-util.js
+ * @brief Helpers shared by the benchmark and load tools
+ */
+
+function delay(ms) {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+/**
+ * Nearest-rank percentile of an ascending array
+ * @param {number[]} sorted - Samples, sorted ascending
+ * @param {number} p - Fraction, 0..1
+ * @returns {number} The sample, or NaN if there are none (prints as "NaN" rather than throwing)
+ */
+function percentile(sorted, p) {
+    if (sorted.length === 0) {
+        return NaN;
+    }
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+module.exports = { delay, percentile };
@@ -0,0 +1,572 @@
+#!/usr/bin/env node
+/**
+ * @file coap-bench.js
+ * @brief Scan round trip over CoAP versus MQTT + HTTP on a simulated LAN
+ *
+ * Starts tools/stub-upstream.js and a resolver with its CoAP endpoint, then
+ * plays one device scanning through three transports:
+ *
+ *   mqtt+http    request/response through the broker, image over a new HTTP connection
+ *   mqtt-inline  request/response through the broker, image as MQTT chunks
+ *   coap         confirmable GET straight to the resolver, image block-wise (1 KB blocks, 4 in flight)
+ *
+ * All device traffic passes through in-process proxies that add half of
+ * BENCH_RTT_MS in each direction; a new TCP connection also waits one RTT
+ * for its handshake before data can flow. Product and image caches are warmed
+ * first so the numbers compare transports, not upstream latency. With
+ * BENCH_MDNS=1 each HTTP image fetch first resolves desk.local over mDNS
+ * (a query and an answer, one RTT), as a device does once its lwIP DNS
+ * cache entry has expired.
+ *
+ * Per scan it reports lookup and scan-to-image latency, device packets and
+ * bytes, and estimated radio-on time. CoAP datagrams are counted exactly.
+ * TCP packets are estimated from the bytes each side writes: one segment
+ * per 1460 bytes per write, a delayed ACK for every two segments received,
+ * 3 packets to open a connection and 4 to close it. Radio-on time is the
+ * union of [packet, packet + BENCH_RADIO_TAIL_MS] over the scan's packets;
+ * the tail stands in for the time modem sleep keeps the radio awake after
+ * traffic.
+ *
+ * Needs a local broker:
+ *   mosquitto -p 1883 &
+ *   node tools/coap-bench.js
+ *
+ * Environment:
+ *   MQTT_BROKER_URI      Broker (default mqtt://localhost:1883)
+ *   BENCH_RTT_MS         Simulated device <-> LAN round trip (default 10)
+ *   BENCH_SCANS          Scans per transport (default 40)
+ *   BENCH_RADIO_TAIL_MS  Radio awake time after each packet (default 50)
+ *   BENCH_TRANSPORTS     Comma-separated transports to run (default mqtt+http,mqtt-inline,coap)
+ *   BENCH_MDNS           1 = resolve desk.local before each HTTP image fetch (default 0)
+ *   STUB_*               Passed through to the stub upstream
+ */
+
+const { spawn } = require('child_process');
+const dgram = require('dgram');
+const fs = require('fs');
+const http = require('http');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+const mqtt = require('mqtt');
+const coap = require('../coap-server');
+const { delay, percentile } = require('./bench-util');
+
+const MQTT_BROKER_URI = process.env.MQTT_BROKER_URI || 'mqtt://localhost:1883';
+const RTT_MS = parseFloat(process.env.BENCH_RTT_MS ?? '10');
+const SCANS = parseInt(process.env.BENCH_SCANS) || 40;
+const RADIO_TAIL_MS = parseFloat(process.env.BENCH_RADIO_TAIL_MS ?? '50');
+const TRANSPORTS = (process.env.BENCH_TRANSPORTS || 'mqtt+http,mqtt-inline,coap').split(',').map(name => name.trim());
+const MDNS = process.env.BENCH_MDNS === '1';
+const STUB_PORT = 4500;
+const RESOLVER_PORT = 3200;
+const COAP_PORT = 5700;
+const MSS = 1460;
+const LOOKUP_TIMEOUT_MS = 10000;
+const INLINE_IMAGE_TIMEOUT_MS = 3000;
+const COAP_ACK_TIMEOUT_MS = 2000;
+const COAP_MAX_RETRANSMIT = 4;
+const COAP_BLOCK_SZX = 6;
+const COAP_BLOCK_WINDOW = 4;
+const START_TIMEOUT_MS = 15000;
+const SCAN_GAP_MS = 200;
+const MDNS_QUERY_BYTES = 28;    // Header, desk.local, type and class
+const MDNS_ANSWER_BYTES = 38;   // Header and one A record
+
+const TAG = 'coap-bench';
+const SERVER_DIR = path.join(__dirname, '..');
+const CLIENT_ID = `esp32c6_bench${process.pid}`;
+
+function now() {
+    return Number(process.hrtime.bigint()) / 1e6;
+}
+
+function startProcess(script, env, readyText) {
+    const child = spawn(process.execPath, [path.join(SERVER_DIR, script)], {
+        cwd: SERVER_DIR,
+        env: { ...process.env, ...env },
+        stdio: ['ignore', 'pipe', 'pipe']
+    });
+    child.stderr.on('data', data => process.stderr.write(data));
+
+    return new Promise((resolve, reject) => {
+        let output = '';
+        const timer = setTimeout(() => reject(new Error(`${script} did not start:\n${output}`)), START_TIMEOUT_MS);
+        child.stdout.on('data', data => {
+            output += data;
+            if (output.includes(readyText)) {
+                clearTimeout(timer);
+                child.stdout.resume();
+                resolve(child);
+            }
+        });
+        child.on('exit', code => {
+            clearTimeout(timer);
+            reject(new Error(`${script} exited (${code}):\n${output}`));
+        });
+    });
+}
+
+function stopProcess(child) {
+    return new Promise(resolve => {
+        if (child.exitCode !== null) {
+            resolve();
+            return;
+        }
+        child.removeAllListeners('exit');
+        child.on('exit', resolve);
+        child.kill('SIGTERM');
+    });
+}
+
+/**
+ * Device-side traffic of the current scan
+ */
+const traffic = {
+    packets: 0,
+    bytes: 0,
+    times: [],
+    reset() {
+        this.packets = 0;
+        this.bytes = 0;
+        this.times = [];
+    },
+    record(packets, bytes) {
+        this.packets += packets;
+        this.bytes += bytes;
+        this.times.push(now());
+    },
+    radioOnMs() {
+        let total = 0;
+        let coveredUntil = -Infinity;
+        for (const time of [...this.times].sort((a, b) => a - b)) {
+            const start = Math.max(time, coveredUntil);
+            const end = time + RADIO_TAIL_MS;
+            if (end > start) {
+                total += end - start;
+                coveredUntil = end;
+            }
+        }
+        return total;
+    }
+};
+
+/**
+ * TCP proxy adding RTT/2 per direction and a handshake RTT per new connection
+ */
+function startTcpProxy(targetHost, targetPort) {
+    const server = net.createServer(device => {
+        const acceptedAt = now();
+        const upstream = net.connect(targetPort, targetHost);
+        let lastDeviceWrite = 0;
+        let lastUpstreamWrite = 0;
+        traffic.record(3, 0);
+
+        const segments = length => Math.max(1, Math.ceil(length / MSS));
+        device.on('data', chunk => {
+            const sent = segments(chunk.length);
+            traffic.record(sent + Math.ceil(sent / 2), chunk.length);
+            // Data cannot leave before the SYN / SYN-ACK round trip is over
+            const at = Math.max(now() + RTT_MS / 2, acceptedAt + RTT_MS * 1.5, lastDeviceWrite);
+            lastDeviceWrite = at;
+            setTimeout(() => upstream.write(chunk), at - now());
+        });
+        upstream.on('data', chunk => {
+            const at = Math.max(now() + RTT_MS / 2, lastUpstreamWrite);
+            lastUpstreamWrite = at;
+            setTimeout(() => {
+                const received = segments(chunk.length);
+                traffic.record(received + Math.ceil(received / 2), chunk.length);
+                device.write(chunk);
+            }, at - now());
+        });
+        const close = () => {
+            if (!device.destroyed) {
+                traffic.record(4, 0);
+            }
+            device.destroy();
+            upstream.destroy();
+        };
+        device.on('end', close);
+        upstream.on('end', () => setTimeout(close, RTT_MS / 2));
+        device.on('error', close);
+        upstream.on('error', close);
+    });
+    return new Promise(resolve => server.listen(0, '127.0.0.1', () => resolve(server)));
+}
+
+/**
+ * UDP proxy adding RTT/2 per direction; every datagram is one packet
+ */
+function startUdpProxy(targetPort) {
+    const front = dgram.createSocket('udp4');
+    const back = dgram.createSocket('udp4');
+    let device = null;
+    front.on('message', (datagram, remote) => {
+        device = remote;
+        traffic.record(1, datagram.length);
+        setTimeout(() => back.send(datagram, targetPort, '127.0.0.1'), RTT_MS / 2);
+    });
+    back.on('message', datagram => {
+        setTimeout(() => {
+            traffic.record(1, datagram.length);
+            front.send(datagram, device.port, device.address);
+        }, RTT_MS / 2);
+    });
+    return new Promise(resolve => front.bind(0, '127.0.0.1', () => back.bind(0, '127.0.0.1', () => resolve({ front, back }))));
+}
+
+/**
+ * MQTT side of the device: one pending lookup, inline chunks reassembled by offset
+ */
+class MqttDevice {
+    constructor(brokerPort) {
+        this.brokerPort = brokerPort;
+        this.responseTopic = `barcode/lookup/response/${CLIENT_ID}`;
+        this.pending = null;
+        this.inline = null;
+    }
+
+    connect() {
+        this.client = mqtt.connect(`mqtt://127.0.0.1:${this.brokerPort}`, { clientId: CLIENT_ID, keepalive: 30, protocolVersion: 4 });
+        this.client.on('message', (topic, message) => {
+            if (topic === this.responseTopic) {
+                const response = JSON.parse(message.toString());
+                if (this.pending && response.request_id === this.pending.requestId) {
+                    this.pending.resolve(response);
+                    this.pending = null;
+                }
+            } else if (this.inline && message.length >= 16 && message.readUInt32BE(0) === this.inline.requestId) {
+                const total = message.readUInt32BE(4);
+                this.inline.received += message.length - 16;
+                if (total === 0 || this.inline.received >= total) {
+                    this.inline.resolve(total > 0);
+                    this.inline = null;
+                }
+            }
+        });
+        return new Promise(resolve => this.client.on('connect', () => {
+            this.client.subscribe(this.responseTopic, { qos: 1 });
+            this.client.subscribe(`${this.responseTopic}/image`, { qos: 1 }, () => resolve());
+        }));
+    }
+
+    lookup(barcode, inline) {
+        const requestId = Math.floor(Math.random() * 0x100000000);
+        const request = { barcode, request_id: requestId, timestamp: Math.floor(Date.now() / 1000) };
+        if (inline) {
+            request.image_transport = 'mqtt';
+        }
+        const imageDone = inline
+            ? new Promise(resolve => {
+                this.inline = { requestId, received: 0, resolve };
+                setTimeout(() => resolve(false), INLINE_IMAGE_TIMEOUT_MS);
+            })
+            : null;
+        const response = new Promise((resolve, reject) => {
+            this.pending = { requestId, resolve };
+            setTimeout(() => reject(new Error('lookup timeout')), LOOKUP_TIMEOUT_MS);
+        });
+        this.client.publish(`barcode/lookup/request/${CLIENT_ID}`, JSON.stringify(request, null, '\t'), { qos: 1 });
+        return { response, imageDone };
+    }
+
+    close() {
+        this.client.end(true);
+    }
+}
+
+/**
+ * desk.local over mDNS: a multicast query, and the answer a round trip later
+ */
+async function resolveDeskLocal() {
+    traffic.record(1, MDNS_QUERY_BYTES);
+    await delay(RTT_MS);
+    traffic.record(1, MDNS_ANSWER_BYTES);
+}
+
+/**
+ * HTTP image fetch on a fresh connection, as image_downloader.c does it
+ */
+function httpImage(imageUrl, httpPort) {
+    const url = new URL(imageUrl);
+    return new Promise(resolve => {
+        const request = http.get({ host: '127.0.0.1', port: httpPort, path: url.pathname + url.search, agent: false }, response => {
+            let size = 0;
+            response.on('data', chunk => size += chunk.length);
+            response.on('end', () => resolve(response.statusCode === 200 && size > 0));
+        });
+        request.on('error', () => resolve(false));
+    });
+}
+
+/**
+ * CoAP side of the device: confirmable GETs with Block2, separate responses acknowledged
+ */
+class CoapDevice {
+    constructor(proxyPort) {
+        this.proxyPort = proxyPort;
+        this.socket = dgram.createSocket('udp4');
+        this.messageId = Math.floor(Math.random() * 0x10000);
+        this.waiters = new Map();   // messageId -> {token, blockNum, onMessage}
+        this.socket.on('message', datagram => {
+            let message;
+            try {
+                message = coap.decode(datagram);
+            } catch (error) {
+                return;
+            }
+            if (message.type === coap.TYPE.CON) {
+                this.socket.send(coap.encode({ type: coap.TYPE.ACK, code: coap.CODE.EMPTY, messageId: message.messageId }),
+                    this.proxyPort, '127.0.0.1');
+            }
+            if (message.type === coap.TYPE.ACK) {
+                const waiter = this.waiters.get(message.messageId);
+                if (waiter) {
+                    waiter.onMessage(message);
+                }
+                return;
+            }
+            if (message.code === coap.CODE.EMPTY) {
+                return;
+            }
+            // Separate response: match on token and block number
+            const blockOption = coap.optionValues(message, coap.OPTION.BLOCK2)[0];
+            const blockNum = blockOption ? coap.decodeBlock(blockOption).num : 0;
+            for (const waiter of this.waiters.values()) {
+                if (waiter.token.equals(message.token) && waiter.blockNum === blockNum) {
+                    waiter.onMessage(message);
+                    return;
+                }
+            }
+        });
+    }
+
+    bind() {
+        return new Promise(resolve => this.socket.bind(0, '127.0.0.1', resolve));
+    }
+
+    exchange(pathSegments, queryPairs, token, blockNum) {
+        this.messageId = (this.messageId + 1) & 0xffff;
+        const messageId = this.messageId;
+        const options = [
+            ...pathSegments.map(segment => ({ number: coap.OPTION.URI_PATH, value: Buffer.from(segment) })),
+            ...queryPairs.map(pair => ({ number: coap.OPTION.URI_QUERY, value: Buffer.from(pair) })),
+            { number: coap.OPTION.BLOCK2, value: coap.encodeBlock(blockNum, false, COAP_BLOCK_SZX) }
+        ];
+        if (blockNum === 0) {
+            options.push({ number: coap.OPTION.SIZE2, value: Buffer.alloc(0) });
+        }
+        const datagram = coap.encode({ type: coap.TYPE.CON, code: coap.CODE.GET, messageId, token, options });
+
+        return new Promise((resolve, reject) => {
+            let timeout = COAP_ACK_TIMEOUT_MS;
+            let attempts = 0;
+            let acknowledged = false;
+            let timer = null;
+            const deadline = setTimeout(() => finish(new Error('coap timeout')), LOOKUP_TIMEOUT_MS);
+            const finish = (error, message) => {
+                clearTimeout(timer);
+                clearTimeout(deadline);
+                this.waiters.delete(messageId);
+                if (error) {
+                    reject(error);
+                } else {
+                    resolve(message);
+                }
+            };
+            const transmit = () => {
+                this.socket.send(datagram, this.proxyPort, '127.0.0.1');
+                timer = setTimeout(() => {
+                    if (acknowledged || attempts++ >= COAP_MAX_RETRANSMIT) {
+                        return;
+                    }
+                    timeout *= 2;
+                    transmit();
+                }, timeout);
+            };
+            const onMessage = message => {
+                if (message.type === coap.TYPE.ACK) {
+                    acknowledged = true;
+                    clearTimeout(timer);
+                    if (message.code !== coap.CODE.EMPTY) {
+                        finish(null, message);
+                    }
+                } else {
+                    finish(null, message);
+                }
+            };
+            this.waiters.set(messageId, { token, blockNum, onMessage });
+            transmit();
+        });
+    }
+
+    /**
+     * GET a resource, following Block2 until the last block. Block 0 carries
+     * Size2; the rest are fetched with up to COAP_BLOCK_WINDOW requests in
+     * flight, as the device does.
+     * @returns {Promise<Buffer>} Representation, or null on an error code
+     */
+    async get(pathSegments, queryPairs, token) {
+        const first = await this.exchange(pathSegments, queryPairs, token, 0);
+        if (first.code !== coap.CODE.CONTENT) {
+            return null;
+        }
+        const firstBlock = coap.optionValues(first, coap.OPTION.BLOCK2)[0];
+        if (!firstBlock || !coap.decodeBlock(firstBlock).more) {
+            return first.payload;
+        }
+        const size2 = coap.optionValues(first, coap.OPTION.SIZE2)[0];
+        const blockSize = 16 << COAP_BLOCK_SZX;
+        const totalBlocks = size2 ? Math.ceil(coap.decodeUint(size2) / blockSize) : Infinity;
+
+        const blocks = [first.payload];
+        let nextNum = 1;
+        let lastNum = totalBlocks - 1;
+        let failed = false;
+        const worker = async () => {
+            while (!failed && nextNum <= lastNum) {
+                const num = nextNum++;
+                const message = await this.exchange(pathSegments, queryPairs, token, num);
+                if (message.code !== coap.CODE.CONTENT) {
+                    failed = true;
+                    return;
+                }
+                blocks[num] = message.payload;
+                const blockOption = coap.optionValues(message, coap.OPTION.BLOCK2)[0];
+                if (!blockOption || !coap.decodeBlock(blockOption).more) {
+                    lastNum = Math.min(lastNum, num);
+                }
+            }
+        };
+        await Promise.all(Array.from({ length: COAP_BLOCK_WINDOW }, worker));
+        return failed ? null : Buffer.concat(blocks.slice(0, lastNum + 1));
+    }
+
+    async lookup(barcode) {
+        const requestId = Math.floor(Math.random() * 0x100000000);
+        const token = Buffer.alloc(4);
+        token.writeUInt32BE(requestId);
+        const body = await this.get(['lookup', barcode], [`d=${CLIENT_ID}`], token);
+        const response = JSON.parse(body.toString());
+        const imageDone = async () => {
+            if (!response.image_inline) {
+                return false;
+            }
+            const url = new URL(response.product.image_url);
+            const image = await this.get(url.pathname.split('/').filter(Boolean), url.search.slice(1).split('&'), token);
+            return !!image && image.length > 0;
+        };
+        return { response, imageDone };
+    }
+
+    close() {
+        this.socket.close();
+    }
+}
+
+function summarize(name, samples) {
+    const sorted = key => samples.map(sample => sample[key]).sort((a, b) => a - b);
+    const mean = key => samples.reduce((sum, sample) => sum + sample[key], 0) / samples.length;
+    const lookup = sorted('lookupMs');
+    const image = sorted('imageMs');
+    const failures = samples.filter(sample => !sample.image).length;
+    console.log(`[${TAG}] ${name.padEnd(11)}  lookup p50 ${percentile(lookup, 0.5).toFixed(1)}  p90 ${percentile(lookup, 0.9).toFixed(1)} ms  ` +
+        `scan-to-image p50 ${percentile(image, 0.5).toFixed(1)}  p90 ${percentile(image, 0.9).toFixed(1)} ms  ` +
+        `packets/scan ${mean('packets').toFixed(1)}  bytes/scan ${mean('bytes').toFixed(0)}  ` +
+        `radio-on/scan ${mean('radioOnMs').toFixed(0)} ms${failures ? `  image failures ${failures}` : ''}`);
+}
+
+async function main() {
+    const unknown = TRANSPORTS.filter(mode => !['mqtt+http', 'mqtt-inline', 'coap'].includes(mode));
+    if (unknown.length > 0) {
+        throw new Error(`Unknown transport ${unknown.join(', ')}; choose from mqtt+http, mqtt-inline, coap`);
+    }
+    const brokerUrl = new URL(MQTT_BROKER_URI);
+    const dbPath = path.join(os.tmpdir(), `coap-bench-${process.pid}.db`);
+    const stub = await startProcess('tools/stub-upstream.js', { STUB_PORT: String(STUB_PORT) }, 'Listening');
+    const resolver = await startProcess('barcode-resolver.js', {
+        PORT: String(RESOLVER_PORT),
+        COAP_PORT: String(COAP_PORT),
+        BARCODE_API_BASE: `http://localhost:${STUB_PORT}/v3/products`,
+        BARCODELOOKUP_API_KEY: 'bench',
+        PRODUCT_PROVIDERS: 'barcodelookup',
+        PRODUCT_CACHE_DB: dbPath,
+        RESOLVER_SHARE_GROUP: `coap-bench-${process.pid}`,
+        UPSTREAM_RATE_PER_MIN: '0',
+        LOG_LEVEL: 'info',
+        MQTT_BROKER_URI
+    }, 'Barcode resolver service ready!');
+
+    const brokerProxy = await startTcpProxy(brokerUrl.hostname, parseInt(brokerUrl.port) || 1883);
+    const httpProxy = await startTcpProxy('127.0.0.1', RESOLVER_PORT);
+    const udpProxy = await startUdpProxy(COAP_PORT);
+    const mqttDevice = new MqttDevice(brokerProxy.address().port);
+    await mqttDevice.connect();
+    const coapDevice = new CoapDevice(udpProxy.front.address().port);
+    await coapDevice.bind();
+
+    // Warm product and image caches; products without an image are left out
+    const barcodes = [];
+    for (let i = 0; barcodes.length < SCANS && i < SCANS * 4; i++) {
+        const barcode = String(700000000000 + process.pid * 1000 + i);
+        const { response, imageDone } = await coapDevice.lookup(barcode);
+        if (response.success && await imageDone()) {
+            barcodes.push(barcode);
+        }
+    }
+    console.log(`[${TAG}] RTT ${RTT_MS}ms, ${barcodes.length} scans per transport, warm caches, radio tail ${RADIO_TAIL_MS}ms` +
+        (MDNS ? ', mDNS before each HTTP image' : ''));
+
+    const results = Object.fromEntries(TRANSPORTS.map(mode => [mode, []]));
+    const httpPort = httpProxy.address().port;
+    for (const barcode of barcodes) {
+        for (const mode of Object.keys(results)) {
+            await delay(SCAN_GAP_MS);
+            traffic.reset();
+            const start = now();
+            let lookupMs;
+            let image;
+            if (mode === 'coap') {
+                const lookup = await coapDevice.lookup(barcode);
+                lookupMs = now() - start;
+                image = await lookup.imageDone();
+            } else {
+                const { response, imageDone } = mqttDevice.lookup(barcode, mode === 'mqtt-inline');
+                const answer = await response;
+                lookupMs = now() - start;
+                if (!imageDone && MDNS) {
+                    await resolveDeskLocal();
+                }
+                image = imageDone ? await imageDone : await httpImage(answer.product.image_url, httpPort);
+            }
+            const imageMs = now() - start;
+            // Let trailing ACKs and connection teardown land in this scan's count
+            await delay(RTT_MS + 20);
+            results[mode].push({ lookupMs, imageMs, image, packets: traffic.packets, bytes: traffic.bytes, radioOnMs: traffic.radioOnMs() });
+        }
+    }
+
+    for (const [mode, samples] of Object.entries(results)) {
+        summarize(mode, samples);
+    }
+    console.log(`[${TAG}] idle: MQTT keepalive costs a PINGREQ/PINGRESP pair (plus ACKs) every 30s; CoAP sends nothing`);
+
+    mqttDevice.close();
+    coapDevice.close();
+    brokerProxy.close();
+    httpProxy.close();
+    udpProxy.front.close();
+    udpProxy.back.close();
+    await stopProcess(resolver);
+    await stopProcess(stub);
+    for (const suffix of ['', '-wal', '-shm']) {
+        fs.rmSync(dbPath + suffix, { force: true });
+    }
+    process.exit(0);
+}
+
+main().catch(error => {
+    console.error(`[${TAG}] ${error.message}`);
+    process.exit(1);
+});
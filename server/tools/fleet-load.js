@@ -0,0 +1,533 @@
+#!/usr/bin/env node
+/**
+ * @file fleet-load.js
+ * @brief Synthetic scanner fleet for load testing the lookup pipeline
+ *
+ * Emulates N devices, each with its own MQTT connection, client ID and
+ * response topics, speaking the same protocol as the firmware:
+ *
+ * - mqtt_barcode.c: client ID esp32c6_xxxxxx, keepalive 30 s, QoS 1
+ *   subscriptions to barcode/lookup/response/<id> and .../image, requests
+ *   as pretty-printed JSON { barcode, request_id (random u32), timestamp,
+ *   image_transport }, a 10 s timeout, a new scan cancelling the pending
+ *   one, and responses over 2048 bytes truncated.
+ * - image_downloader.c: one image at a time. An inline image arrives as
+ *   16-byte-header chunks; if it is not complete 3 s after the response,
+ *   the device falls back to HTTP. An HTTP fetch opens a new connection
+ *   (no keep-alive), sends If-None-Match from a 4-entry ETag cache, allows
+ *   at most 50 KB and times out after 10 s.
+ *
+ * Scans follow a Zipf popularity distribution over a barcode catalog and
+ * arrive in bursts (inventory sessions) or as a Poisson stream. Throughput,
+ * lookup and time-to-image percentiles and error rates are reported every
+ * few seconds and at the end, followed by the resolver's image counters
+ * from /metrics: how device image requests were served, prewarms, source
+ * fetches and the most image fetches in flight at once. Run it once
+ * against a resolver started with IMAGE_PREWARM=1 and once with
+ * IMAGE_PREWARM=0 to see what prewarming cuts from time-to-image.
+ *
+ * Run against a local broker, the stub upstream and a resolver:
+ *   mosquitto -p 1883 &
+ *   node tools/stub-upstream.js &
+ *   MQTT_BROKER_URI=mqtt://localhost:1883 BARCODE_API_BASE=http://localhost:4000/v3/products npm start &
+ *   node tools/fleet-load.js
+ *
+ * Environment:
+ *   MQTT_BROKER_URI       Broker (default mqtt://localhost:1883)
+ *   FLEET_DEVICES         Devices (default 50)
+ *   FLEET_SCANS_PER_MIN   Mean scans per minute per device (default 6)
+ *   FLEET_DURATION_S      Test length after all devices connected (default 60)
+ *   FLEET_CATALOG         Distinct barcodes (default 10000)
+ *   FLEET_ZIPF_S          Popularity skew; 0 = uniform, ~1 = retail-like (default 1.0)
+ *   FLEET_BURST           Mean scans per burst; 1 = independent scans (default 1)
+ *   FLEET_BURST_GAP_MS    Time between scans inside a burst (default 1500)
+ *   FLEET_INLINE          1 = ask for inline images like MQTT_INLINE_IMAGES firmware (default 1)
+ *   FLEET_IMAGE_ORIGIN    Replaces the resolver's desk.local origin in image URLs (default http://localhost:3000)
+ *   FLEET_CONNECT_RATE    Device connections per second during ramp-up (default 50)
+ *   FLEET_REPORT_S        Progress report interval (default 5)
+ */
+
+const http = require('http');
+const https = require('https');
+const mqtt = require('mqtt');
+const { percentile } = require('./bench-util');
+
+const MQTT_BROKER_URI = process.env.MQTT_BROKER_URI || 'mqtt://localhost:1883';
+const DEVICES = parseInt(process.env.FLEET_DEVICES) || 50;
+const SCANS_PER_MIN = parseFloat(process.env.FLEET_SCANS_PER_MIN) || 6;
+const DURATION_MS = (parseFloat(process.env.FLEET_DURATION_S) || 60) * 1000;
+const CATALOG = parseInt(process.env.FLEET_CATALOG) || 10000;
+const ZIPF_S = parseFloat(process.env.FLEET_ZIPF_S ?? '1.0');
+const BURST = Math.max(1, parseFloat(process.env.FLEET_BURST) || 1);
+const BURST_GAP_MS = parseFloat(process.env.FLEET_BURST_GAP_MS) || 1500;
+const INLINE = process.env.FLEET_INLINE !== '0';
+const IMAGE_ORIGIN = process.env.FLEET_IMAGE_ORIGIN || 'http://localhost:3000';
+const CONNECT_RATE = parseFloat(process.env.FLEET_CONNECT_RATE) || 50;
+const REPORT_MS = (parseFloat(process.env.FLEET_REPORT_S) || 5) * 1000;
+
+// Mirrors of the firmware constants (app_config.h, mqtt_barcode.c, image_downloader.c)
+const REQUEST_TOPIC = 'barcode/lookup/request';
+const RESPONSE_TOPIC = 'barcode/lookup/response';
+const KEEPALIVE_SEC = 30;
+const RECONNECT_MS = 5000;
+const REQUEST_TIMEOUT_MS = 10000;
+const RESPONSE_MAX_BYTES = 2048;
+const INLINE_HEADER_SIZE = 16;
+const INLINE_IMAGE_TIMEOUT_MS = 3000;
+const MAX_IMAGE_SIZE = 50 * 1024;
+const DOWNLOAD_TIMEOUT_MS = 10000;
+const MAX_REDIRECTS = 3;
+const ETAG_CACHE_ENTRIES = 4;
+
+const TAG = 'fleet-load';
+
+function summarize(values) {
+    const sorted = [...values].sort((a, b) => a - b);
+    return `p50 ${percentile(sorted, 0.5).toFixed(0)}  p90 ${percentile(sorted, 0.9).toFixed(0)}  ` +
+        `p99 ${percentile(sorted, 0.99).toFixed(0)}  max ${(sorted[sorted.length - 1] ?? NaN).toFixed(0)} ms`;
+}
+
+function exponential(mean) {
+    return -Math.log(1 - Math.random()) * mean;
+}
+
+function elapsedMs(start) {
+    return Number(process.hrtime.bigint() - start) / 1e6;
+}
+
+/**
+ * Zipf sampler over catalog ranks 0..n-1 (rank 0 is the most scanned product)
+ */
+function zipfSampler(n, s) {
+    const cdf = new Float64Array(n);
+    let total = 0;
+    for (let rank = 0; rank < n; rank++) {
+        total += 1 / Math.pow(rank + 1, s);
+        cdf[rank] = total;
+    }
+    return () => {
+        const target = Math.random() * total;
+        let low = 0;
+        let high = n - 1;
+        while (low < high) {
+            const mid = (low + high) >> 1;
+            if (cdf[mid] < target) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    };
+}
+
+const sampleRank = zipfSampler(CATALOG, ZIPF_S);
+
+function barcodeFor(rank) {
+    return String(600000000000 + rank);
+}
+
+/**
+ * Counters for one reporting interval and for the whole run
+ */
+function newStats() {
+    return {
+        scans: 0,
+        answered: 0,
+        found: 0,
+        timeouts: 0,
+        superseded: 0,      // Pending lookup cancelled by the next scan
+        truncated: 0,       // Response larger than the device's 2 KB parse limit
+        strays: 0,          // Responses for a request the device no longer waits for
+        imagesInline: 0,
+        imagesHttp: 0,
+        imagesNotModified: 0,
+        imageFallbacks: 0,  // Inline image incomplete after 3 s, fetched over HTTP instead
+        imageErrors: 0,
+        imageBusy: 0,       // Download skipped because the previous one was still running
+        lookupMs: [],
+        imageMs: [],
+        afterLookupMs: []   // Lookup response to complete image: the wait prewarming shortens
+    };
+}
+
+let interval = newStats();
+const total = newStats();
+
+function count(key, amount = 1) {
+    interval[key] += amount;
+    total[key] += amount;
+}
+
+function sample(key, value) {
+    interval[key].push(value);
+    total[key].push(value);
+}
+
+class Device {
+    constructor(index) {
+        // Same shape as the firmware's MAC-derived ID; the index keeps them distinct
+        this.clientId = `esp32c6_${(0xa00000 + index).toString(16)}`;
+        this.responseTopic = `${RESPONSE_TOPIC}/${this.clientId}`;
+        this.imageTopic = `${this.responseTopic}/image`;
+        this.pending = null;         // { requestId, sentAt, timer }
+        this.image = null;           // Download in progress: { start, inline, ... }
+        this.etagCache = new Map();  // url -> { etag, size }; Map order is LRU order
+        this.burstLeft = 0;
+        this.timer = null;
+        this.client = null;
+    }
+
+    connect() {
+        return new Promise(resolve => {
+            this.client = mqtt.connect(MQTT_BROKER_URI, {
+                clientId: this.clientId,
+                keepalive: KEEPALIVE_SEC,
+                reconnectPeriod: RECONNECT_MS,
+                protocolVersion: 4
+            });
+            this.client.on('connect', () => {
+                this.client.subscribe(this.responseTopic, { qos: 1 });
+                if (INLINE) {
+                    this.client.subscribe(this.imageTopic, { qos: 1 }, () => resolve());
+                } else {
+                    resolve();
+                }
+            });
+            this.client.on('message', (topic, message) => {
+                if (topic === this.responseTopic) {
+                    this.handleResponse(message);
+                } else if (topic === this.imageTopic) {
+                    this.handleImageChunk(message);
+                }
+            });
+            this.client.on('error', () => {});
+        });
+    }
+
+    /**
+     * Next scan time: inside a burst a short fixed gap, between bursts an
+     * exponential wait sized so the long-run rate stays SCANS_PER_MIN
+     */
+    scheduleNext() {
+        let wait;
+        if (this.burstLeft > 0) {
+            wait = BURST_GAP_MS;
+        } else {
+            const meanCycleMs = BURST * 60000 / SCANS_PER_MIN;
+            wait = exponential(Math.max(meanCycleMs - (BURST - 1) * BURST_GAP_MS, BURST_GAP_MS));
+            // Geometric burst length with mean BURST
+            this.burstLeft = 1;
+            while (Math.random() < 1 - 1 / BURST) {
+                this.burstLeft++;
+            }
+        }
+        this.burstLeft--;
+        this.timer = setTimeout(() => {
+            this.scan();
+            this.scheduleNext();
+        }, wait);
+    }
+
+    scan() {
+        if (!this.client.connected) {
+            return;
+        }
+        if (this.pending) {
+            clearTimeout(this.pending.timer);
+            this.pending = null;
+            count('superseded');
+        }
+
+        const requestId = Math.floor(Math.random() * 0x100000000);
+        const request = {
+            barcode: barcodeFor(sampleRank()),
+            request_id: requestId,
+            timestamp: Math.floor(Date.now() / 1000)
+        };
+        if (INLINE) {
+            request.image_transport = 'mqtt';
+        }
+
+        this.pending = {
+            requestId,
+            sentAt: process.hrtime.bigint(),
+            timer: setTimeout(() => {
+                this.pending = null;
+                count('timeouts');
+            }, REQUEST_TIMEOUT_MS)
+        };
+        count('scans');
+        // cJSON_Print output: tab-indented, so payload sizes match the firmware's
+        this.client.publish(`${REQUEST_TOPIC}/${this.clientId}`, JSON.stringify(request, null, '\t'), { qos: 1 });
+    }
+
+    handleResponse(message) {
+        let response;
+        try {
+            response = JSON.parse(message.subarray(0, RESPONSE_MAX_BYTES).toString());
+        } catch (error) {
+            if (message.length > RESPONSE_MAX_BYTES) {
+                count('truncated');
+            }
+            return;
+        }
+
+        if (!this.pending || this.pending.requestId !== response.request_id) {
+            count('strays');
+            return;
+        }
+        const { sentAt } = this.pending;
+        clearTimeout(this.pending.timer);
+        this.pending = null;
+        count('answered');
+        sample('lookupMs', elapsedMs(sentAt));
+
+        const product = response.success && response.product;
+        if (!product) {
+            return;
+        }
+        count('found');
+        if (product.image_url) {
+            this.startImage(response.request_id, product.image_url, response.image_inline, sentAt,
+                process.hrtime.bigint());
+        }
+    }
+
+    startImage(requestId, imageUrl, inline, scanStart, responseAt) {
+        // A new lookup supersedes an inline image still arriving, but not an HTTP download
+        if (this.image && this.image.inline) {
+            clearTimeout(this.image.timer);
+            this.image = null;
+        }
+        if (this.image) {
+            count('imageBusy');
+            return;
+        }
+
+        const url = imageUrl.replace(/^https?:\/\/desk\.local:\d+/, IMAGE_ORIGIN);
+        if (!inline) {
+            this.download(url, scanStart, responseAt);
+            return;
+        }
+
+        this.image = {
+            inline: true,
+            requestId,
+            url,
+            scanStart,
+            responseAt,
+            received: 0,
+            timer: setTimeout(() => {
+                this.image = null;
+                count('imageFallbacks');
+                this.download(url, scanStart, responseAt);
+            }, INLINE_IMAGE_TIMEOUT_MS)
+        };
+    }
+
+    handleImageChunk(message) {
+        const image = this.image;
+        if (!image || !image.inline || message.length < INLINE_HEADER_SIZE) {
+            return;
+        }
+        const requestId = message.readUInt32BE(0);
+        const totalSize = message.readUInt32BE(4);
+        const offset = message.readUInt32BE(8);
+        const length = message.length - INLINE_HEADER_SIZE;
+        if (requestId !== image.requestId) {
+            return;
+        }
+
+        if (totalSize === 0 || totalSize > MAX_IMAGE_SIZE) {
+            clearTimeout(image.timer);
+            this.image = null;
+            count('imageErrors');
+            return;
+        }
+        // Redelivered chunks fall before the write position; gaps wait for the HTTP fallback
+        if (offset + length <= image.received || offset !== image.received) {
+            return;
+        }
+        image.received += length;
+        if (image.received >= totalSize) {
+            clearTimeout(image.timer);
+            this.image = null;
+            count('imagesInline');
+            sample('imageMs', elapsedMs(image.scanStart));
+            sample('afterLookupMs', elapsedMs(image.responseAt));
+        }
+    }
+
+    download(url, scanStart, responseAt) {
+        this.image = { inline: false };
+        const cached = this.etagCache.get(url);
+
+        const finish = (outcome) => {
+            this.image = null;
+            if (outcome === 'error') {
+                count('imageErrors');
+                return;
+            }
+            count(outcome === 'not_modified' ? 'imagesNotModified' : 'imagesHttp');
+            sample('imageMs', elapsedMs(scanStart));
+            sample('afterLookupMs', elapsedMs(responseAt));
+        };
+
+        const get = (target, redirects) => {
+            const client = target.startsWith('https:') ? https : http;
+            const headers = cached ? { 'If-None-Match': cached.etag } : {};
+            // agent: false = a fresh connection per download, like esp_http_client_init/cleanup
+            const request = client.get(target, { agent: false, headers, timeout: DOWNLOAD_TIMEOUT_MS }, response => {
+                const status = response.statusCode;
+                if (status >= 300 && status < 400 && status !== 304 && response.headers.location && redirects < MAX_REDIRECTS) {
+                    response.resume();
+                    get(new URL(response.headers.location, target).href, redirects + 1);
+                    return;
+                }
+
+                let size = 0;
+                let tooLarge = false;
+                response.on('data', chunk => {
+                    size += chunk.length;
+                    if (size > MAX_IMAGE_SIZE && !tooLarge) {
+                        tooLarge = true;
+                        request.destroy();
+                    }
+                });
+                response.on('end', () => {
+                    if (status === 304 && cached) {
+                        this.touchEtag(url, cached);
+                        finish('not_modified');
+                    } else if (status === 200 && size > 0 && !tooLarge) {
+                        if (response.headers.etag) {
+                            this.touchEtag(url, { etag: response.headers.etag, size });
+                        }
+                        finish('downloaded');
+                    } else {
+                        finish('error');
+                    }
+                });
+                response.on('error', () => finish('error'));
+            });
+            request.on('timeout', () => request.destroy(new Error('timeout')));
+            request.on('error', () => {
+                if (this.image && !this.image.inline) {
+                    finish('error');
+                }
+            });
+        };
+        get(url, 0);
+    }
+
+    touchEtag(url, entry) {
+        this.etagCache.delete(url);
+        this.etagCache.set(url, entry);
+        while (this.etagCache.size > ETAG_CACHE_ENTRIES) {
+            this.etagCache.delete(this.etagCache.keys().next().value);
+        }
+    }
+
+    stop() {
+        clearTimeout(this.timer);
+        if (this.pending) {
+            clearTimeout(this.pending.timer);
+        }
+        if (this.image && this.image.timer) {
+            clearTimeout(this.image.timer);
+        }
+        return new Promise(resolve => this.client.end(false, {}, resolve));
+    }
+}
+
+function rate(value, of) {
+    return of > 0 ? `${(100 * value / of).toFixed(1)}%` : '-';
+}
+
+function report(stats, seconds, label) {
+    const images = stats.imagesInline + stats.imagesHttp + stats.imagesNotModified;
+    console.log(`[${TAG}] ${label} scans ${stats.scans} (${(stats.scans / seconds).toFixed(1)}/s)  ` +
+        `answered ${stats.answered} (${(stats.answered / seconds).toFixed(1)}/s)  ` +
+        `timeouts ${rate(stats.timeouts, stats.scans)}  superseded ${stats.superseded}  ` +
+        `images ${images} (inline ${stats.imagesInline}, http ${stats.imagesHttp}, 304 ${stats.imagesNotModified}, ` +
+        `fallback ${stats.imageFallbacks}, errors ${stats.imageErrors}, busy ${stats.imageBusy})`);
+    if (stats.lookupMs.length > 0) {
+        console.log(`[${TAG}] ${label} lookup ${summarize(stats.lookupMs)}` +
+            (stats.imageMs.length > 0 ? `  |  scan-to-image ${summarize(stats.imageMs)}` : ''));
+    }
+    if (stats.afterLookupMs.length > 0) {
+        console.log(`[${TAG}] ${label} response-to-image ${summarize(stats.afterLookupMs)}`);
+    }
+}
+
+/**
+ * Print the resolver's image counters, or nothing if /metrics is unreachable
+ */
+async function reportResolverImages() {
+    let text;
+    try {
+        const response = await fetch(`${IMAGE_ORIGIN}/metrics`);
+        text = await response.text();
+    } catch (error) {
+        return;
+    }
+    const value = (name, labels = '') => {
+        const line = text.split('\n').find(l => l.startsWith(`${name}${labels} `));
+        return line ? Number(line.slice(line.lastIndexOf(' ') + 1)) : NaN;
+    };
+    const served = from => value('barcode_image_requests_total', `{served_from="${from}"}`);
+    console.log(`[${TAG}] resolver images: prewarmed ${value('barcode_image_prewarms_total')}  ` +
+        `requests cache ${served('cache')}, inflight ${served('inflight')}, miss ${served('miss')}  ` +
+        `source fetches ${value('barcode_image_fetch_duration_seconds_count')}  ` +
+        `peak in flight ${value('barcode_image_inflight_peak')}`);
+}
+
+async function main() {
+    console.log(`[${TAG}] ${DEVICES} devices, ${SCANS_PER_MIN} scans/min each, Zipf s=${ZIPF_S} over ${CATALOG} codes, ` +
+        `bursts of ~${BURST} (${BURST_GAP_MS}ms apart), ${INLINE ? 'inline' : 'HTTP'} images`);
+
+    const devices = Array.from({ length: DEVICES }, (_, i) => new Device(i));
+    const connectStart = Date.now();
+    const connected = [];
+    for (const device of devices) {
+        connected.push(device.connect());
+        await new Promise(resolve => setTimeout(resolve, 1000 / CONNECT_RATE));
+    }
+    await Promise.all(connected);
+    console.log(`[${TAG}] ${DEVICES} devices connected in ${((Date.now() - connectStart) / 1000).toFixed(1)}s`);
+
+    for (const device of devices) {
+        device.scheduleNext();
+    }
+
+    const started = Date.now();
+    let intervalStart = started;
+    const progress = setInterval(() => {
+        const now = Date.now();
+        report(interval, (now - intervalStart) / 1000, `t=${Math.round((now - started) / 1000)}s`);
+        interval = newStats();
+        intervalStart = now;
+    }, REPORT_MS);
+
+    await new Promise(resolve => setTimeout(resolve, DURATION_MS));
+    clearInterval(progress);
+    for (const device of devices) {
+        clearTimeout(device.timer);
+    }
+
+    // Let outstanding lookups finish or time out before the final report
+    const drainUntil = Date.now() + REQUEST_TIMEOUT_MS;
+    while (devices.some(device => device.pending || device.image) && Date.now() < drainUntil) {
+        await new Promise(resolve => setTimeout(resolve, 100));
+    }
+
+    report(total, DURATION_MS / 1000, 'total');
+    console.log(`[${TAG}] found ${rate(total.found, total.answered)} of answers, ` +
+        `truncated ${total.truncated}, stray responses ${total.strays}`);
+    await reportResolverImages();
+
+    await Promise.all(devices.map(device => device.stop()));
+    process.exit(0);
+}
+
+main();
@@ -0,0 +1,118 @@
+#!/usr/bin/env node
+/**
+ * @file hedge-bench.js
+ * @brief Tail latency and cost of hedged multi-provider lookups
+ *
+ * Drives HedgedLookup with in-process stub providers that inject log-normal
+ * latency, a slow tail and failures, and reports lookup latency percentiles,
+ * failed lookups and provider requests per lookup (what hedging costs).
+ * The last scenario degrades the primary halfway through to show the
+ * latency histograms re-ranking providers.
+ *
+ * For an end-to-end run, start tools/stub-upstream.js instances with
+ * different STUB_* settings and point PRODUCT_PROVIDERS /
+ * OPENFOODFACTS_API_BASE / UPCITEMDB_API_BASE at them.
+ *
+ * Environment:
+ *   BENCH_LOOKUPS   Lookups per scenario (default 1000)
+ *   BENCH_RATE      Mean lookups per second (default 250)
+ *   HEDGE_DELAY_MS  Hedge delay (default 300)
+ */
+
+const { HedgedLookup } = require('../hedged-lookup');
+const { delay, percentile } = require('./bench-util');
+
+const LOOKUPS = parseInt(process.env.BENCH_LOOKUPS) || 1000;
+const RATE = parseFloat(process.env.BENCH_RATE) || 250;
+const HEDGE_DELAY_MS = parseInt(process.env.HEDGE_DELAY_MS ?? '300');
+
+const TAG = 'hedge-bench';
+
+function gaussian() {
+    return Math.sqrt(-2 * Math.log(1 - Math.random())) * Math.cos(2 * Math.PI * Math.random());
+}
+
+/**
+ * Stub provider; `profile` can be swapped at runtime to simulate degradation
+ */
+function stubProvider(name, profile) {
+    const provider = {
+        name,
+        profile,
+        lookup(barcode, signal) {
+            const p = provider.profile;
+            let ms = p.medianMs * Math.exp(0.35 * gaussian());
+            if (Math.random() < p.slowRate) {
+                ms += p.slowMs;
+            }
+            return new Promise((resolve, reject) => {
+                const timer = setTimeout(() => {
+                    if (Math.random() < p.failureRate) {
+                        reject(new Error(`${name} injected failure`));
+                    } else {
+                        resolve({ name: `Product ${barcode}`, brand: name, model: '', price: 'Price N/A', source_image: null, upc: barcode });
+                    }
+                }, ms);
+                signal.addEventListener('abort', () => {
+                    clearTimeout(timer);
+                    const error = new Error(`${name} cancelled`);
+                    error.name = 'AbortError';
+                    reject(error);
+                }, { once: true });
+            });
+        }
+    };
+    return provider;
+}
+
+const PRIMARY = { medianMs: 120, slowRate: 0.05, slowMs: 2000, failureRate: 0.02 };
+const SECONDARY = { medianMs: 200, slowRate: 0.01, slowMs: 2000, failureRate: 0.01 };
+const DEGRADED = { medianMs: 700, slowRate: 0.2, slowMs: 2000, failureRate: 0.05 };
+
+async function runScenario(name, providers, degradeAt = null) {
+    const hedged = new HedgedLookup({ providers, hedgeDelayMs: HEDGE_DELAY_MS });
+    const latencies = [];
+    let failed = 0;
+    const lookups = [];
+
+    for (let i = 0; i < LOOKUPS; i++) {
+        if (degradeAt !== null && i === Math.floor(LOOKUPS * degradeAt)) {
+            providers[0].profile = DEGRADED;
+        }
+        const start = process.hrtime.bigint();
+        lookups.push(hedged.lookup(String(i)).then(() => {
+            latencies.push(Number(process.hrtime.bigint() - start) / 1e6);
+        }, () => failed++));
+        await delay(-Math.log(1 - Math.random()) * 1000 / RATE);
+    }
+    await Promise.all(lookups);
+
+    latencies.sort((a, b) => a - b);
+    const stats = hedged.stats();
+    const requests = Object.values(stats.providers).reduce((n, p) => n + p.requests, 0);
+    console.log(`[${TAG}] ${name.padEnd(26)} p50 ${percentile(latencies, 0.5).toFixed(0)}  ` +
+        `p90 ${percentile(latencies, 0.9).toFixed(0)}  p99 ${percentile(latencies, 0.99).toFixed(0)} ms  ` +
+        `failed ${(100 * failed / LOOKUPS).toFixed(1)}%  requests/lookup ${(requests / LOOKUPS).toFixed(2)}`);
+    for (const [provider, p] of Object.entries(stats.providers)) {
+        console.log(`[${TAG}]     ${provider.padEnd(10)} rank ${p.rank}  requests ${p.requests}  wins ${p.wins}  ` +
+            `errors ${p.errors}  cancelled ${p.cancelled}  p90 ${p.p90Ms.toFixed(0)} ms`);
+    }
+}
+
+async function main() {
+    // HedgedLookup logs its provider list and every injected failure; keep the report readable
+    const log = console.log;
+    console.log = (...args) => {
+        if (typeof args[0] === 'string' && args[0].startsWith(`[${TAG}]`)) {
+            log(...args);
+        }
+    };
+    console.error = () => {};
+
+    log(`[${TAG}] ${LOOKUPS} lookups per scenario at ~${RATE}/s, hedge delay ${HEDGE_DELAY_MS}ms`);
+    await runScenario('primary only', [stubProvider('primary', PRIMARY)]);
+    await runScenario('primary + secondary', [stubProvider('primary', PRIMARY), stubProvider('secondary', SECONDARY)]);
+    await runScenario('primary degrades halfway', [stubProvider('primary', PRIMARY), stubProvider('secondary', SECONDARY)], 0.5);
+}
+
+main();
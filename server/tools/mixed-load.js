@@ -0,0 +1,162 @@
+#!/usr/bin/env node
+/**
+ * @file mixed-load.js
+ * @brief Mixed lookup + image load against a running resolver
+ *
+ * Publishes barcode lookups over MQTT at a fixed rate while a number of
+ * concurrent clients hammer /image with uncached conversions, then reports
+ * lookup throughput and latency percentiles alongside image throughput.
+ * Compare IMAGE_WORKERS=0 (everything on the event loop) with the worker
+ * pool, or a single resolver with resolver-cluster.js.
+ *
+ * Run against a local broker and tools/stub-upstream.js:
+ *   node tools/stub-upstream.js &
+ *   MQTT_BROKER_URI=mqtt://localhost:1883 BARCODE_API_BASE=http://localhost:4000/v3/products npm start &
+ *   node tools/mixed-load.js
+ *
+ * Environment:
+ *   MQTT_BROKER_URI    Broker (default mqtt://localhost:1883)
+ *   RESOLVER_URL       Resolver HTTP base (default http://localhost:3000)
+ *   STUB_URL           Image source for the /image burst (default http://localhost:4000)
+ *   LOAD_DURATION_S    Test length (default 30)
+ *   LOOKUP_RATE        Lookups per second (default 20)
+ *   LOOKUP_CODES       Distinct barcodes to draw from (default 500)
+ *   IMAGE_CONCURRENCY  Concurrent /image clients (default 8, 0 = lookups only)
+ */
+
+const mqtt = require('mqtt');
+const { percentile } = require('./bench-util');
+
+const MQTT_BROKER_URI = process.env.MQTT_BROKER_URI || 'mqtt://localhost:1883';
+const RESOLVER_URL = process.env.RESOLVER_URL || 'http://localhost:3000';
+const STUB_URL = process.env.STUB_URL || 'http://localhost:4000';
+const DURATION_MS = (parseFloat(process.env.LOAD_DURATION_S) || 30) * 1000;
+const LOOKUP_RATE = parseFloat(process.env.LOOKUP_RATE) || 20;
+const LOOKUP_CODES = parseInt(process.env.LOOKUP_CODES) || 500;
+const IMAGE_CONCURRENCY = parseInt(process.env.IMAGE_CONCURRENCY ?? '8');
+const LOOKUP_TIMEOUT_MS = 10000;
+const DEVICES = 20;
+
+const TAG = 'mixed-load';
+
+const pending = new Map();   // request_id -> sent time
+const lookupLatencies = [];
+const imageLatencies = [];
+const imageResults = { ok: 0, busy: 0, failed: 0 };
+let lookupsSent = 0;
+let lookupsLost = 0;
+let nextRequestId = 1;
+let running = true;
+
+function summarize(values) {
+    const sorted = [...values].sort((a, b) => a - b);
+    return `p50 ${percentile(sorted, 0.5).toFixed(1)}  p90 ${percentile(sorted, 0.9).toFixed(1)}  ` +
+        `p99 ${percentile(sorted, 0.99).toFixed(1)}  max ${(sorted[sorted.length - 1] ?? NaN).toFixed(1)} ms`;
+}
+
+function barcodeFor(index) {
+    return String(700000000000 + index);
+}
+
+const client = mqtt.connect(MQTT_BROKER_URI, {
+    clientId: `mixed-load-${Math.random().toString(16).substr(2, 8)}`,
+});
+
+client.on('message', (topic, message) => {
+    let response;
+    try {
+        response = JSON.parse(message.toString());
+    } catch (error) {
+        return;
+    }
+    const sentAt = pending.get(response.request_id);
+    if (sentAt !== undefined) {
+        pending.delete(response.request_id);
+        lookupLatencies.push(Number(process.hrtime.bigint() - sentAt) / 1e6);
+    }
+});
+
+function sendLookup() {
+    const requestId = nextRequestId++;
+    const device = `loadtest-${requestId % DEVICES}`;
+    const barcode = barcodeFor(Math.floor(Math.random() * LOOKUP_CODES));
+
+    pending.set(requestId, process.hrtime.bigint());
+    lookupsSent++;
+    client.publish(`barcode/lookup/request/${device}`, JSON.stringify({
+        barcode: barcode,
+        request_id: requestId,
+        timestamp: Math.floor(Date.now() / 1000)
+    }), { qos: 1 });
+
+    setTimeout(() => {
+        if (pending.delete(requestId)) {
+            lookupsLost++;
+        }
+    }, LOOKUP_TIMEOUT_MS);
+}
+
+async function imageClient(id) {
+    let n = 0;
+    while (running) {
+        // Unique source URL + nocache: every request is a full download, decode and convert
+        const source = `${STUB_URL}/images/burst-${id}-${n++}.jpg`;
+        const url = `${RESOLVER_URL}/image/burst?url=${encodeURIComponent(source)}&nocache=1`;
+        const start = process.hrtime.bigint();
+        try {
+            const response = await fetch(url);
+            await response.arrayBuffer();
+            if (response.status === 200) {
+                imageResults.ok++;
+                imageLatencies.push(Number(process.hrtime.bigint() - start) / 1e6);
+            } else if (response.status === 503) {
+                imageResults.busy++;
+                await new Promise(resolve => setTimeout(resolve, 50));
+            } else {
+                imageResults.failed++;
+            }
+        } catch (error) {
+            imageResults.failed++;
+        }
+    }
+}
+
+client.on('connect', () => {
+    client.subscribe('barcode/lookup/response/+', { qos: 1 }, () => {
+        console.log(`[${TAG}] ${DURATION_MS / 1000}s: ${LOOKUP_RATE} lookups/s over ${LOOKUP_CODES} codes, ` +
+            `${IMAGE_CONCURRENCY} image clients`);
+
+        const started = Date.now();
+        const lookupTimer = setInterval(sendLookup, 1000 / LOOKUP_RATE);
+        const imageClients = Array.from({ length: IMAGE_CONCURRENCY }, (_, i) => imageClient(i));
+
+        setTimeout(async () => {
+            clearInterval(lookupTimer);
+            running = false;
+            await Promise.all(imageClients);
+
+            // Give in-flight lookups a chance to land before reporting
+            const drainUntil = Date.now() + LOOKUP_TIMEOUT_MS;
+            while (pending.size > 0 && Date.now() < drainUntil) {
+                await new Promise(resolve => setTimeout(resolve, 100));
+            }
+            lookupsLost += pending.size;
+
+            const seconds = (Date.now() - started) / 1000;
+            console.log(`[${TAG}] Lookups: ${lookupsSent} sent, ${lookupLatencies.length} answered ` +
+                `(${(lookupLatencies.length / seconds).toFixed(1)}/s), ${lookupsLost} lost`);
+            console.log(`[${TAG}] Lookup latency: ${summarize(lookupLatencies)}`);
+            console.log(`[${TAG}] Images: ${imageResults.ok} ok (${(imageResults.ok / seconds).toFixed(1)}/s), ` +
+                `${imageResults.busy} shed (503), ${imageResults.failed} failed`);
+            if (imageLatencies.length > 0) {
+                console.log(`[${TAG}] Image latency: ${summarize(imageLatencies)}`);
+            }
+
+            client.end(() => process.exit(0));
+        }, DURATION_MS);
+    });
+});
+
+client.on('error', (error) => {
+    console.error(`[${TAG}] MQTT Error:`, error.message);
+});
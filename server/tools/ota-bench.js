@@ -0,0 +1,697 @@
+#!/usr/bin/env node
+/**
+ * @file ota-bench.js
+ * @brief OTA download throughput and resumption over a flaky link
+ *
+ * Serves a firmware image from a local HTTP server (with ETag and Range /
+ * If-Range support) and downloads it with a simulated device:
+ *
+ *   baseline   the old loop: read up to 4 KB, esp_ota_write it, sleep 100 ms for the UI
+ *   serial     read 2 KB, esp_ota_write it, no sleep
+ *   pipelined  read 2 KB into one of two 4 KB buffers while the other is
+ *              erased and written (main/network/ota_writer.c)
+ *   resume     serial writes with the checkpoints of main/network/ota_resume.c:
+ *              every 64 KB in flash the offset, SHA-256 of the prefix and ETag
+ *              are saved; each new attempt re-hashes that prefix from flash and
+ *              asks for the rest with Range and If-Range
+ *
+ * Scan latency during an update (BENCH_MODES=scan-idle,scan-foreground,scan-background):
+ *
+ *   scan-idle        scans with no update running, for reference
+ *   scan-foreground  scans while a pipelined update runs flat out
+ *   scan-background  scans while the update runs as ota_manager's background
+ *                    mode: reads spaced to BENCH_CAP_KBPS, none at all while
+ *                    a lookup or image download is in flight
+ *
+ * A scan is a lookup answer (BENCH_RESOLVER_MS late) and then the product
+ * image, both over the link the update uses. While flash is erased or
+ * written the CPU runs nothing from flash, so the device handles neither
+ * until that finishes. Scan-to-result and scan-to-image are reported
+ * against BENCH_SCAN_BUDGET_MS.
+ *
+ * With BENCH_DROP_KB the server cuts connections at random offsets
+ * (exponentially distributed, that many KB apart on average); the first
+ * three modes then fail and resume reports how many attempts and how many
+ * extra bytes it needed. BENCH_REPUBLISH=1 also replaces the image after the
+ * first drop, so the If-Range check must restart the download.
+ *
+ * The device side is simulated, the HTTP transfer is real. Bytes reach the
+ * device over a link of BENCH_LINK_KBPS into a receive window of
+ * BENCH_TCP_WND bytes (lwIP's TCP_WND). The link keeps filling the window
+ * while the device is busy and stalls when it is full. esp_ota_write with
+ * sequential writes erases each 4 KB sector as the image reaches it, which
+ * costs BENCH_FLASH_ERASE_MS, and then BENCH_FLASH_WRITE_MS per 4 KB
+ * written. The SHA-256 of what was "flashed" is checked against the image.
+ *
+ * With BENCH_SERVE=1 it only serves BENCH_FIRMWARE on BENCH_PORT (all
+ * interfaces) and logs each download's throughput, range and drops, for a
+ * real device pointed at http://<host>:<port>/firmware.bin.
+ *
+ *   node tools/ota-bench.js
+ *
+ * Environment:
+ *   BENCH_FIRMWARE        Image to serve (default: 1 MB of random bytes)
+ *   BENCH_MODES           Modes to run (default baseline,serial,pipelined)
+ *   BENCH_LINK_KBPS       Link throughput in KB/s (default 250)
+ *   BENCH_TCP_WND         Device receive window in bytes (default 5760)
+ *   BENCH_FLASH_ERASE_MS  Erase time per 4 KB sector (default 25)
+ *   BENCH_FLASH_WRITE_MS  Write time per 4 KB (default 12)
+ *   BENCH_DROP_KB         Mean KB between dropped connections (default 0: never)
+ *   BENCH_REPUBLISH       1 = publish a different image after the first drop
+ *   BENCH_SERVE           1 = serve only, for a real device
+ *   BENCH_PORT            Server port (default 8070)
+ *   BENCH_SCAN_INTERVAL_MS  Time between scans (default 2000)
+ *   BENCH_RESOLVER_MS     Resolver time per lookup (default 150)
+ *   BENCH_CAP_KBPS        Background download cap, OTA_BACKGROUND_MAX_KBPS (default 32)
+ *   BENCH_SCAN_BUDGET_MS  Scan-to-result budget, SCAN_RESULT_BUDGET_MS (default 1500)
+ */
+
+const crypto = require('crypto');
+const fs = require('fs');
+const http = require('http');
+const { delay, percentile } = require('./bench-util');
+
+const TAG = 'ota-bench';
+const FIRMWARE_PATH = process.env.BENCH_FIRMWARE;
+const MODES = (process.env.BENCH_MODES || 'baseline,serial,pipelined').split(',');
+const LINK_BYTES_PER_MS = (parseFloat(process.env.BENCH_LINK_KBPS) || 250) * 1024 / 1000;
+const TCP_WND = parseInt(process.env.BENCH_TCP_WND) || 5760;
+const FLASH_ERASE_MS = parseFloat(process.env.BENCH_FLASH_ERASE_MS ?? '25');
+const FLASH_WRITE_MS = parseFloat(process.env.BENCH_FLASH_WRITE_MS ?? '12');
+const DROP_BYTES = (parseFloat(process.env.BENCH_DROP_KB) || 0) * 1024;
+const REPUBLISH = process.env.BENCH_REPUBLISH === '1';
+const SERVE_ONLY = process.env.BENCH_SERVE === '1';
+const PORT = parseInt(process.env.BENCH_PORT) || 8070;
+const SCAN_INTERVAL_MS = parseInt(process.env.BENCH_SCAN_INTERVAL_MS) || 2000;
+const RESOLVER_MS = parseInt(process.env.BENCH_RESOLVER_MS ?? '150');
+const CAP_BYTES_PER_MS = parseFloat(process.env.BENCH_CAP_KBPS ?? '32') * 1024 / 1000;
+const SCAN_BUDGET_MS = parseInt(process.env.BENCH_SCAN_BUDGET_MS) || 1500;
+
+const SECTOR_SIZE = 4096;
+const MSS = 1460;
+const RECV_BUF_SIZE = 2048;             // OTA_RECV_BUF_SIZE
+const WRITE_BUFFERS = 2;                // OTA_WRITE_BUFFERS
+const WRITE_BUF_SIZE = 4096;            // OTA_WRITE_BUF_SIZE
+const BASELINE_READ_SIZE = 4096;        // esp_https_ota buffer (http_config.buffer_size)
+const BASELINE_DELAY_MS = 100;          // The old OTA_PROGRESS_UPDATE_DELAY_MS
+const CHECKPOINT_INTERVAL = 64 * 1024;  // OTA_CHECKPOINT_INTERVAL
+const MAX_ATTEMPTS = 200;
+const SEND_CHUNK = 16 * 1024;
+const LOOKUP_BYTES = 600;               // Resolver JSON answer
+const IMAGE_BYTES = 80 * 80 * 2;        // 80x80 RGB565 product image
+const POLL_MS = 100;                    // OTA_BACKGROUND_POLL_MS
+const IDLE_SCANS = 10;
+
+// One radio for every connection, and one CPU that stalls on flash
+const device = { linkFree: 0, flashBusyUntil: 0, scansInFlight: 0 };
+
+function now() {
+    return performance.now();
+}
+
+function sha256(data) {
+    return crypto.createHash('sha256').update(data).digest('hex');
+}
+
+function publish(image) {
+    const digest = sha256(image);
+    return { image, digest, etag: `"${digest.slice(0, 16)}"` };
+}
+
+function serverLog(message) {
+    if (SERVE_ONLY) {
+        console.log(`[${TAG}] ${message}`);
+    }
+}
+
+// Write image[first..] in slices, cutting the connection at dropAt
+async function sendBody(res, image, first, dropAt) {
+    let pos = first;
+    while (pos < image.length) {
+        const end = Math.min(pos + SEND_CHUNK, image.length, dropAt);
+        if (end > pos && !res.write(image.subarray(pos, end))) {
+            await new Promise(resolve => res.once('drain', resolve));
+        }
+        pos = end;
+        if (pos === dropAt) {
+            res.socket.destroy();
+            return pos;
+        }
+        if (res.destroyed) {
+            return pos;
+        }
+    }
+    res.end();
+    return pos;
+}
+
+function startServer(release) {
+    const server = http.createServer(async (req, res) => {
+        if (req.url === '/lookup' || req.url === '/image') {
+            const lookup = req.url === '/lookup';
+            if (lookup) {
+                await delay(RESOLVER_MS);
+            }
+            res.writeHead(200, { 'Content-Length': lookup ? LOOKUP_BYTES : IMAGE_BYTES });
+            res.end(Buffer.alloc(lookup ? LOOKUP_BYTES : IMAGE_BYTES));
+            return;
+        }
+        if (req.url !== '/firmware.bin') {
+            res.writeHead(404).end();
+            return;
+        }
+        const { image, etag } = release.current;
+        const range = /^bytes=(\d+)-$/.exec(req.headers.range || '');
+        const ifRange = req.headers['if-range'];
+        const first = range && (!ifRange || ifRange === etag) ? parseInt(range[1]) : 0;
+        if (first >= image.length && first > 0) {
+            res.writeHead(416, { 'Content-Range': `bytes */${image.length}` }).end();
+            return;
+        }
+
+        const headers = {
+            'Content-Type': 'application/octet-stream',
+            'Content-Length': image.length - first,
+            'Accept-Ranges': 'bytes',
+            'ETag': etag,
+        };
+        if (first > 0) {
+            headers['Content-Range'] = `bytes ${first}-${image.length - 1}/${image.length}`;
+        }
+        res.writeHead(first > 0 ? 206 : 200, headers);
+
+        const peer = req.socket.remoteAddress;
+        const start = now();
+        const dropAt = DROP_BYTES > 0 ? first + 1 + Math.floor(-Math.log(1 - Math.random()) * DROP_BYTES) : Infinity;
+        const end = await sendBody(res, image, first, dropAt);
+        const ms = now() - start;
+        const rate = `${((end - first) / 1024 / (ms / 1000)).toFixed(1)} KB/s`;
+        if (end < image.length) {
+            release.drops++;
+            serverLog(`dropped ${peer} at ${end} of ${image.length} bytes (from ${first}, ${rate})`);
+            if (REPUBLISH && release.drops === 1) {
+                release.current = publish(crypto.randomBytes(image.length));
+                serverLog(`published a new image, ETag ${release.current.etag}`);
+            }
+        } else {
+            serverLog(`served ${first}-${end - 1} to ${peer} in ${ms.toFixed(0)} ms (${rate})`);
+        }
+    });
+    return new Promise(resolve => {
+        server.listen(PORT, SERVE_ONLY ? '0.0.0.0' : '127.0.0.1', () => resolve(server));
+    });
+}
+
+/**
+ * The device's end of the connection: a link of LINK_BYTES_PER_MS feeding a
+ * window of TCP_WND bytes, drained by recv(). Runs on its own while the
+ * device waits on flash, like the radio and lwIP do.
+ */
+class DeviceSocket {
+    constructor(res) {
+        this.res = res;
+        this.chunks = [];
+        this.buffered = 0;
+        this.ended = false;
+        this.wake = null;
+        this.pump();
+    }
+
+    notify() {
+        if (this.wake) {
+            const wake = this.wake;
+            this.wake = null;
+            wake();
+        }
+    }
+
+    waitForChange() {
+        return new Promise(resolve => { this.wake = resolve; });
+    }
+
+    async nextSegment(max) {
+        for (;;) {
+            const data = this.res.read(Math.min(max, this.res.readableLength || max));
+            if (data) {
+                return data;
+            }
+            if (this.res.readableEnded || this.res.destroyed) {
+                return null;
+            }
+            await new Promise(resolve => {
+                const done = () => {
+                    this.res.off('readable', done);
+                    this.res.off('end', done);
+                    this.res.off('close', done);
+                    resolve();
+                };
+                this.res.on('readable', done);
+                this.res.on('end', done);
+                this.res.on('close', done);
+            });
+        }
+    }
+
+    async pump() {
+        for (;;) {
+            while (this.buffered >= TCP_WND) {
+                await this.waitForChange();
+            }
+            const segment = await this.nextSegment(Math.min(MSS, TCP_WND - this.buffered));
+            if (!segment) {
+                break;
+            }
+            device.linkFree = Math.max(device.linkFree, now()) + segment.length / LINK_BYTES_PER_MS;
+            const wait = device.linkFree - now();
+            if (wait >= 1) {
+                await delay(wait);
+            }
+            this.chunks.push(segment);
+            this.buffered += segment.length;
+            this.notify();
+        }
+        this.ended = true;
+        this.notify();
+    }
+
+    // esp_http_client_read: whatever is buffered, up to max bytes; empty at the end
+    async recv(max) {
+        while (this.buffered === 0 && !this.ended) {
+            await this.waitForChange();
+        }
+        const parts = [];
+        let len = 0;
+        while (this.chunks.length > 0 && len < max) {
+            let chunk = this.chunks[0];
+            if (len + chunk.length > max) {
+                this.chunks[0] = chunk.subarray(max - len);
+                chunk = chunk.subarray(0, max - len);
+            } else {
+                this.chunks.shift();
+            }
+            parts.push(chunk);
+            len += chunk.length;
+        }
+        this.buffered -= len;
+        this.notify();
+        return Buffer.concat(parts, len);
+    }
+}
+
+// The inactive OTA partition: erases sectors as sequential writes reach them
+class Flash {
+    constructor(partition = null, offset = 0) {
+        this.partition = partition;
+        this.hash = crypto.createHash('sha256');
+        this.written = offset;
+        this.erased = Math.ceil(offset / SECTOR_SIZE) * SECTOR_SIZE;
+        this.busyMs = 0;
+    }
+
+    async write(data) {
+        let ms = (data.length / SECTOR_SIZE) * FLASH_WRITE_MS;
+        const end = this.written + data.length;
+        while (this.erased < end) {
+            ms += FLASH_ERASE_MS;
+            this.erased += SECTOR_SIZE;
+        }
+        this.busyMs += ms;
+        device.flashBusyUntil = now() + ms;
+        await delay(ms);
+        this.hash.update(data);
+        if (this.partition) {
+            data.copy(this.partition, this.written);
+        }
+        this.written = end;
+    }
+}
+
+function get(url, headers = {}) {
+    return new Promise((resolve, reject) => {
+        const req = http.get(url, { headers }, res => {
+            res.on('error', () => {});    // A dropped connection shows up as a short body
+            res.pause();
+            resolve(res);
+        });
+        req.on('error', reject);
+    });
+}
+
+async function downloadBaseline(socket, flash) {
+    for (;;) {
+        const data = await socket.recv(BASELINE_READ_SIZE);
+        if (data.length === 0) {
+            return;
+        }
+        await flash.write(data);
+        await delay(BASELINE_DELAY_MS);
+    }
+}
+
+async function downloadSerial(socket, flash) {
+    for (;;) {
+        const data = await socket.recv(RECV_BUF_SIZE);
+        if (data.length === 0) {
+            return;
+        }
+        await flash.write(data);
+    }
+}
+
+async function downloadPipelined(socket, flash) {
+    // Full buffers queue for the writer; the reader waits only when none is free
+    const full = [];
+    let freeBuffers = WRITE_BUFFERS - 1;
+    let wakeReader = null;
+    let wakeWriter = null;
+    let finished = false;
+
+    const writer = (async () => {
+        for (;;) {
+            while (full.length === 0 && !finished) {
+                await new Promise(resolve => { wakeWriter = resolve; });
+            }
+            if (full.length === 0) {
+                return;
+            }
+            await flash.write(full.shift());
+            freeBuffers++;
+            if (wakeReader) {
+                wakeReader();
+                wakeReader = null;
+            }
+        }
+    })();
+    const hand = buf => {
+        full.push(buf);
+        if (wakeWriter) {
+            wakeWriter();
+            wakeWriter = null;
+        }
+    };
+
+    let filling = [];
+    let fillLen = 0;
+    for (;;) {
+        const data = await socket.recv(RECV_BUF_SIZE);
+        if (data.length === 0) {
+            break;
+        }
+        let offset = 0;
+        while (offset < data.length) {
+            const n = Math.min(WRITE_BUF_SIZE - fillLen, data.length - offset);
+            filling.push(data.subarray(offset, offset + n));
+            fillLen += n;
+            offset += n;
+            if (fillLen === WRITE_BUF_SIZE) {
+                hand(Buffer.concat(filling, fillLen));
+                filling = [];
+                fillLen = 0;
+                while (freeBuffers === 0) {
+                    await new Promise(resolve => { wakeReader = resolve; });
+                }
+                freeBuffers--;
+            }
+        }
+    }
+    if (fillLen > 0) {
+        hand(Buffer.concat(filling, fillLen));
+    }
+    finished = true;
+    if (wakeWriter) {
+        wakeWriter();
+    }
+    await writer;
+}
+
+/**
+ * One attempt of ota_apply_full with ota_resume.c: load the checkpoint,
+ * re-hash its prefix from flash, request the rest, checkpoint as it goes.
+ * Returns the bytes received; the checkpoint in nvs survives a failed
+ * attempt like it survives a reboot.
+ */
+async function resumeAttempt(partition, nvs, attempt) {
+    let offset = 0;
+    let hash = crypto.createHash('sha256');
+    const checkpoint = nvs.checkpoint;
+    if (checkpoint && sha256(partition.subarray(0, checkpoint.offset)) === checkpoint.digest) {
+        hash.update(partition.subarray(0, checkpoint.offset));
+        offset = checkpoint.offset;
+    } else {
+        nvs.checkpoint = null;
+    }
+
+    const headers = offset > 0 ? { 'Range': `bytes=${offset}-`, 'If-Range': checkpoint.etag } : {};
+    let res;
+    try {
+        res = await get(`http://127.0.0.1:${PORT}/firmware.bin`, headers);
+    } catch {
+        return 0;                   // Dropped before the headers: "Connection failed", try again
+    }
+    const contentRange = /^bytes (\d+)-(\d+)\/(\d+)$/.exec(res.headers['content-range'] || '');
+    let session = checkpoint;
+    if (res.statusCode === 206 && offset > 0 && contentRange &&
+        parseInt(contentRange[1]) === offset && parseInt(contentRange[3]) === checkpoint.imageSize) {
+        attempt.resumed++;
+    } else if (res.statusCode === 200) {
+        if (offset > 0) {
+            attempt.restarted++;
+        }
+        offset = 0;
+        hash = crypto.createHash('sha256');
+        session = { etag: res.headers.etag, imageSize: parseInt(res.headers['content-length']) };
+        nvs.checkpoint = null;
+    } else {
+        nvs.checkpoint = null;
+        res.resume();
+        return 0;
+    }
+
+    const expected = parseInt(res.headers['content-length']);
+    const flash = new Flash(partition, offset);
+    const socket = new DeviceSocket(res);
+    let received = 0;
+    for (;;) {
+        const data = await socket.recv(RECV_BUF_SIZE);
+        if (data.length === 0) {
+            break;
+        }
+        received += data.length;
+        await flash.write(data);
+        // Written serially, so every byte hashed is already in flash
+        let pos = 0;
+        while (pos < data.length) {
+            const n = Math.min(data.length - pos, CHECKPOINT_INTERVAL - (offset % CHECKPOINT_INTERVAL));
+            hash.update(data.subarray(pos, pos + n));
+            offset += n;
+            pos += n;
+            if (offset % CHECKPOINT_INTERVAL === 0 && session.etag) {
+                nvs.checkpoint = { ...session, offset, digest: hash.copy().digest('hex') };
+                attempt.checkpoints++;
+            }
+        }
+    }
+    attempt.done = received === expected && offset === session.imageSize;
+    attempt.imageSize = session.imageSize;
+    return received;
+}
+
+async function runResume(release) {
+    const partition = Buffer.alloc(release.current.image.length);
+    const nvs = { checkpoint: null };
+    const attempt = { done: false, resumed: 0, restarted: 0, checkpoints: 0, imageSize: 0 };
+    const dropsBefore = release.drops;
+    const start = now();
+    let downloaded = 0;
+    let attempts = 0;
+    while (!attempt.done && attempts < MAX_ATTEMPTS) {
+        attempts++;
+        downloaded += await resumeAttempt(partition, nvs, attempt);
+    }
+    const ms = now() - start;
+
+    // esp_ota_end: the finished image must be the one now published
+    const ok = attempt.done && sha256(partition.subarray(0, attempt.imageSize)) === release.current.digest;
+    const size = release.current.image.length;
+    console.log(`[${TAG}] ${'resume'.padEnd(10)} ${(ms / 1000).toFixed(2).padStart(7)} s  ` +
+                `${(size / 1024 / (ms / 1000)).toFixed(1).padStart(6)} KB/s  ` +
+                `${release.drops - dropsBefore} drops, ${attempts} attempts (${attempt.resumed} resumed, ` +
+                `${attempt.restarted} restarted by If-Range), ${attempt.checkpoints} checkpoints, ` +
+                `${downloaded} bytes received (${(100 * downloaded / size).toFixed(1)}% of image)  ${ok ? 'verified' : 'MISMATCH'}`);
+    return { ms, ok };
+}
+
+// The CPU is back once the flash operation in progress has finished
+async function flashIdle() {
+    while (device.flashBusyUntil > now()) {
+        await delay(device.flashBusyUntil - now());
+    }
+}
+
+// Read a whole response as the device would, handling it once the CPU is free
+async function receive(path) {
+    const socket = new DeviceSocket(await get(`http://127.0.0.1:${PORT}${path}`));
+    while ((await socket.recv(RECV_BUF_SIZE)).length > 0) {
+        await flashIdle();
+    }
+}
+
+async function scan(latencies) {
+    const start = now();
+    device.scansInFlight++;
+    try {
+        await receive('/lookup');
+        latencies.result.push(now() - start);
+        await receive('/image');
+        latencies.image.push(now() - start);
+    } finally {
+        device.scansInFlight--;
+    }
+}
+
+/**
+ * recv() of ota_manager's background mode (ota_background_yield): nothing is
+ * read while a scan is in flight, and reads are spaced to the cap
+ */
+class BackgroundSocket {
+    constructor(socket) {
+        this.socket = socket;
+        this.start = now();
+        this.received = 0;
+        this.pausedMs = 0;
+    }
+
+    async recv(max) {
+        if (device.scansInFlight > 0) {
+            const paused = now();
+            while (device.scansInFlight > 0) {
+                await delay(POLL_MS);
+            }
+            this.pausedMs += now() - paused;
+            this.start = now();
+            this.received = 0;
+        } else if (CAP_BYTES_PER_MS > 0) {
+            const ahead = this.start + this.received / CAP_BYTES_PER_MS - now();
+            if (ahead >= 1) {
+                await delay(ahead);
+            }
+        }
+        const data = await this.socket.recv(max);
+        this.received += data.length;
+        return data;
+    }
+}
+
+async function runScans(mode, release) {
+    const latencies = { result: [], image: [] };
+    const start = now();
+    let ota = null;
+    let pausedMs = 0;
+    let ok = true;
+    if (mode === 'scan-idle') {
+        for (let i = 0; i < IDLE_SCANS; i++) {
+            await scan(latencies);
+            await delay(SCAN_INTERVAL_MS);
+        }
+    } else {
+        const flash = new Flash();
+        const update = (async () => {
+            const socket = new DeviceSocket(await get(`http://127.0.0.1:${PORT}/firmware.bin`));
+            const background = mode === 'scan-background' ? new BackgroundSocket(socket) : null;
+            await downloadPipelined(background || socket, flash);
+            pausedMs = background ? background.pausedMs : 0;
+        })();
+        let done = false;
+        update.then(() => { done = true; });
+        while (!done) {
+            await Promise.race([delay(SCAN_INTERVAL_MS), update]);
+            if (!done) {
+                await scan(latencies);
+            }
+        }
+        await update;
+        ota = now() - start;
+        ok = flash.written === release.current.image.length && flash.hash.digest('hex') === release.current.digest;
+    }
+
+    const over = latencies.result.filter(ms => ms > SCAN_BUDGET_MS).length;
+    const fmt = (values) => {
+        const sorted = [...values].sort((a, b) => a - b);
+        return `p50 ${percentile(sorted, 0.5).toFixed(0).padStart(5)} ms, max ${Math.max(0, ...values).toFixed(0).padStart(5)} ms`;
+    };
+    console.log(`[${TAG}] ${mode.padEnd(16)} ${String(latencies.result.length).padStart(3)} scans, result ${fmt(latencies.result)}, ` +
+                `image ${fmt(latencies.image)}, ${over} over ${SCAN_BUDGET_MS} ms` +
+                (ota !== null ? `; update ${(ota / 1000).toFixed(1)} s${pausedMs ? `, paused ${(pausedMs / 1000).toFixed(1)} s` : ''}` +
+                 `  ${ok ? 'verified' : 'MISMATCH'}` : ''));
+    // Foreground is the reference for what background mode fixes; only a bad image fails it
+    return { ms: ota || 0, ok: ok && (over === 0 || mode === 'scan-foreground') };
+}
+
+const DOWNLOADERS = {
+    baseline: downloadBaseline,
+    serial: downloadSerial,
+    pipelined: downloadPipelined,
+};
+
+async function runMode(mode, release) {
+    if (mode === 'resume') {
+        return runResume(release);
+    }
+    if (mode.startsWith('scan-')) {
+        return runScans(mode, release);
+    }
+    const download = DOWNLOADERS[mode];
+    if (!download) {
+        throw new Error(`unknown mode ${mode}`);
+    }
+    const { image, digest } = release.current;
+    const flash = new Flash();
+    const start = now();
+    try {
+        const res = await get(`http://127.0.0.1:${PORT}/firmware.bin`);
+        await download(new DeviceSocket(res), flash);
+    } catch {
+        // Dropped before the headers
+    }
+    const ms = now() - start;
+
+    const ok = flash.written === image.length && flash.hash.digest('hex') === digest;
+    console.log(`[${TAG}] ${mode.padEnd(10)} ${(ms / 1000).toFixed(2).padStart(7)} s  ` +
+                `${(image.length / 1024 / (ms / 1000)).toFixed(1).padStart(6)} KB/s  ` +
+                `flash busy ${(100 * flash.busyMs / ms).toFixed(0).padStart(3)}%  ` +
+                `${ok ? 'verified' : flash.written < image.length ? `interrupted at ${flash.written}` : 'MISMATCH'}`);
+    return { ms, ok };
+}
+
+async function main() {
+    const image = FIRMWARE_PATH ? fs.readFileSync(FIRMWARE_PATH) : crypto.randomBytes(1024 * 1024);
+    const release = { current: publish(image), drops: 0 };
+    const server = await startServer(release);
+
+    if (SERVE_ONLY) {
+        console.log(`[${TAG}] serving ${image.length} byte image at http://<this host>:${PORT}/firmware.bin`);
+        return;
+    }
+
+    const linkMs = image.length / LINK_BYTES_PER_MS;
+    const flashMs = Math.ceil(image.length / SECTOR_SIZE) * FLASH_ERASE_MS + (image.length / SECTOR_SIZE) * FLASH_WRITE_MS;
+    console.log(`[${TAG}] ${image.length} byte image, link ${(LINK_BYTES_PER_MS * 1000 / 1024).toFixed(0)} KB/s ` +
+                `(${(linkMs / 1000).toFixed(2)} s), flash ${FLASH_ERASE_MS}+${FLASH_WRITE_MS} ms per 4 KB ` +
+                `(${(flashMs / 1000).toFixed(2)} s), window ${TCP_WND} bytes`);
+
+    const results = {};
+    for (const mode of MODES) {
+        results[mode] = await runMode(mode, release);
+    }
+    if (results.baseline && results.pipelined) {
+        console.log(`[${TAG}] pipelined is ${(results.baseline.ms / results.pipelined.ms).toFixed(1)}x baseline` +
+                    (results.serial ? `, ${(results.serial.ms / results.pipelined.ms).toFixed(2)}x serial` : ''));
+    }
+    server.close();
+    process.exit(Object.values(results).every(r => r.ok) ? 0 : 1);
+}
+
+main().catch(error => {
+    console.error(`[${TAG}] ${error.message}`);
+    process.exit(1);
+});
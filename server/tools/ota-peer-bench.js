@@ -0,0 +1,371 @@
+#!/usr/bin/env node
+/**
+ * @file ota-peer-bench.js
+ * @brief LAN sharing of OTA images between devices, with emulated peers
+ *
+ * Runs a store's worth of emulated devices on this machine. Each one serves
+ * its image the way main/network/ota_p2p.c does (GET /ota/<app_sha256 hex>,
+ * ETag "<hex>", single byte ranges with If-Range, one request at a time)
+ * and lists the digest in a shared table standing in for the TXT record of
+ * its _esp32._tcp mDNS service. An upstream server plays GitHub behind the
+ * store's uplink.
+ *
+ * Each device then updates the way ota_manager does with a signed manifest:
+ * it browses for peers holding the digest and downloads from one of them.
+ * Whatever it downloaded must hash to the manifest's digest, so an image from
+ * a peer that lies is thrown away and that peer is not asked again. The
+ * BENCH_SEEDERS devices with the lowest ids fetch from upstream if no peer
+ * has the release yet. The rest wait, browsing every BENCH_POLL_MS, and go
+ * upstream only after BENCH_WAIT_MS. Devices start their checks
+ * at random within BENCH_SPREAD_MS, as the background checks would.
+ * BENCH_LIARS of the peers advertise the new digest but serve something
+ * else.
+ *
+ * Before the run each emulated peer's endpoint is probed: whole image
+ * (hash must match the path), a range with a matching If-Range (206), a
+ * range with a stale one (200), a range past the end (416), an unknown
+ * digest (404). With BENCH_PEER_URL=http://<device>/ota/<hex> only that
+ * probe runs, against a real device.
+ *
+ * The emulated peers use a JS copy of ota_peer.c's range and election
+ * logic; main/host_test/test_ota_peer.c checks the same cases against the
+ * C that ships.
+ *
+ *   node tools/ota-peer-bench.js
+ *
+ * Environment:
+ *   BENCH_FIRMWARE     Image to share (default: 1 MB of random bytes)
+ *   BENCH_DEVICES      Emulated devices (default 8)
+ *   BENCH_SEEDERS      Devices that fetch upstream without waiting, OTA_P2P_SEEDERS (default 2)
+ *   BENCH_LIARS        Extra peers advertising the release but serving other bytes (default 1)
+ *   BENCH_UPLINK_KBPS  Store uplink shared by all upstream downloads (default 128)
+ *   BENCH_LAN_KBPS     Upload rate of one device over Wi-Fi (default 400)
+ *   BENCH_SPREAD_MS    Devices start their check at random within this (default 5000)
+ *   BENCH_POLL_MS      Browse interval while waiting for a seeder, OTA_P2P_POLL_MS scaled down (default 1000)
+ *   BENCH_WAIT_MS      Longest wait for a seeder, OTA_P2P_WAIT_MS scaled down (default 60000)
+ *   BENCH_P2P          0 = every device goes upstream, for comparison
+ *   BENCH_PEER_URL     Probe one real device's endpoint and exit
+ */
+
+const crypto = require('crypto');
+const fs = require('fs');
+const http = require('http');
+const { delay } = require('./bench-util');
+
+const TAG = 'ota-peer-bench';
+const FIRMWARE_PATH = process.env.BENCH_FIRMWARE;
+const DEVICES = parseInt(process.env.BENCH_DEVICES) || 8;
+const SEEDERS = parseInt(process.env.BENCH_SEEDERS ?? '2');
+const LIARS = parseInt(process.env.BENCH_LIARS ?? '1');
+const UPLINK_BYTES_PER_MS = (parseFloat(process.env.BENCH_UPLINK_KBPS) || 128) * 1024 / 1000;
+const LAN_BYTES_PER_MS = (parseFloat(process.env.BENCH_LAN_KBPS) || 400) * 1024 / 1000;
+const SPREAD_MS = parseInt(process.env.BENCH_SPREAD_MS ?? '5000');
+const POLL_MS = parseInt(process.env.BENCH_POLL_MS) || 1000;
+const WAIT_MS = parseInt(process.env.BENCH_WAIT_MS) || 60000;
+const P2P = process.env.BENCH_P2P !== '0';
+const PEER_URL = process.env.BENCH_PEER_URL;
+
+const RECV_TIMEOUT_MS = 5000;           // OTA_RECV_TIMEOUT
+const SEND_CHUNK = 4096;                // OTA_P2P_SEND_BUF_SIZE
+const MAX_SOURCES = 4;                  // OTA_P2P_MAX_SOURCES
+
+function now() {
+    return performance.now();
+}
+
+function sha256(data) {
+    return crypto.createHash('sha256').update(data).digest('hex');
+}
+
+// A link that carries one byte stream at a time, in arrival order
+class Link {
+    constructor(bytesPerMs) {
+        this.bytesPerMs = bytesPerMs;
+        this.freeAt = 0;
+    }
+
+    async carry(bytes) {
+        const start = Math.max(now(), this.freeAt);
+        this.freeAt = start + bytes / this.bytesPerMs;
+        await delay(this.freeAt - now());
+    }
+}
+
+// Range handling of ota_peer_plan_response(); keep in step with main/host_test/test_ota_peer.c
+function planResponse(range, ifRange, etag, length) {
+    const whole = { status: 200, first: 0, length };
+    if (!range || (ifRange !== undefined && ifRange !== etag)) {
+        return whole;
+    }
+    const match = /^bytes=(\d{1,9})-(\d{1,9})?$/.exec(range);
+    if (!match) {
+        return whole;
+    }
+    const first = parseInt(match[1]);
+    let last = length - 1;
+    if (match[2] !== undefined) {
+        last = parseInt(match[2]);
+        if (last < first) {
+            return whole;
+        }
+    }
+    if (first >= length) {
+        return { status: 416, first: 0, length: 0 };
+    }
+    last = Math.min(last, length - 1);
+    return { status: 206, first, length: last - first + 1 };
+}
+
+// One device: its image, its HTTP endpoint and its mDNS record
+class Device {
+    constructor(id, image, lan) {
+        this.id = id.toString(16).padStart(12, '0');
+        this.image = image;
+        this.advertised = sha256(image);
+        this.lan = lan;
+        this.queue = Promise.resolve();
+        this.served = 0;
+    }
+
+    get etag() {
+        return `"${this.advertised}"`;
+    }
+
+    async serve(req, res) {
+        // esp_http_server runs one handler at a time; later requests wait for it
+        const turn = this.queue.then(() => this.respond(req, res));
+        this.queue = turn.catch(() => {});
+        await turn;
+    }
+
+    async respond(req, res) {
+        const match = /^\/ota\/([0-9a-fA-F]{64})(\?.*)?$/.exec(req.url);
+        if (req.destroyed || res.destroyed) {
+            return;
+        }
+        if (!match || match[1].toLowerCase() !== this.advertised) {
+            res.writeHead(404, { 'Content-Length': 0 }).end();
+            return;
+        }
+        const plan = planResponse(req.headers.range, req.headers['if-range'], this.etag, this.image.length);
+        if (plan.status === 416) {
+            res.writeHead(416, { 'Content-Range': `bytes */${this.image.length}`, 'Content-Length': 0 }).end();
+            return;
+        }
+        const headers = {
+            'Content-Type': 'application/octet-stream',
+            'Content-Length': plan.length,
+            'ETag': this.etag,
+            'Accept-Ranges': 'bytes',
+        };
+        if (plan.status === 206) {
+            headers['Content-Range'] = `bytes ${plan.first}-${plan.first + plan.length - 1}/${this.image.length}`;
+        }
+        res.writeHead(plan.status, headers);
+        for (let pos = plan.first; pos < plan.first + plan.length && !res.destroyed; pos += SEND_CHUNK) {
+            const chunk = this.image.subarray(pos, Math.min(pos + SEND_CHUNK, plan.first + plan.length));
+            await this.lan.carry(chunk.length);
+            if (!res.write(chunk)) {
+                await new Promise(resolve => res.once('drain', resolve));
+            }
+            this.served += chunk.length;
+        }
+        res.end();
+    }
+
+    listen() {
+        this.server = http.createServer((req, res) => this.serve(req, res));
+        return new Promise(resolve => this.server.listen(0, '127.0.0.1', () => {
+            this.url = `http://127.0.0.1:${this.server.address().port}`;
+            resolve();
+        }));
+    }
+}
+
+// GET url; resolves with status, headers and body, or rejects on timeout / error
+function get(url, headers = {}) {
+    return new Promise((resolve, reject) => {
+        const req = http.get(url, { headers, agent: false }, res => {
+            const chunks = [];
+            res.on('data', chunk => chunks.push(chunk));
+            res.on('end', () => resolve({ status: res.statusCode, headers: res.headers, body: Buffer.concat(chunks) }));
+            res.on('error', reject);
+        });
+        req.setTimeout(RECV_TIMEOUT_MS, () => req.destroy(new Error('timeout')));
+        req.on('error', reject);
+    });
+}
+
+// The checks a device's endpoint must pass; returns what failed
+async function probePeer(url) {
+    const failures = [];
+    const check = (ok, what) => ok || failures.push(what);
+    const digest = /\/ota\/([0-9a-f]{64})$/.exec(url)?.[1];
+    const whole = await get(url);
+    check(whole.status === 200, `whole image: HTTP ${whole.status}`);
+    check(sha256(whole.body) === digest, 'whole image: digest differs from the path');
+    check(whole.headers.etag === `"${digest}"`, `ETag ${whole.headers.etag}`);
+    check(parseInt(whole.headers['content-length']) === whole.body.length, 'Content-Length');
+    const length = whole.body.length;
+    const first = Math.floor(length / 3);
+
+    const part = await get(url, { Range: `bytes=${first}-`, 'If-Range': whole.headers.etag });
+    check(part.status === 206, `range: HTTP ${part.status}`);
+    check(part.headers['content-range'] === `bytes ${first}-${length - 1}/${length}`, `Content-Range ${part.headers['content-range']}`);
+    check(part.body.equals(whole.body.subarray(first)), 'range: bytes differ');
+
+    const stale = await get(url, { Range: `bytes=${first}-`, 'If-Range': '"stale"' });
+    check(stale.status === 200 && stale.body.length === length, `stale If-Range: HTTP ${stale.status}`);
+    const past = await get(url, { Range: `bytes=${length}-` });
+    check(past.status === 416, `range past the end: HTTP ${past.status}`);
+    const unknown = await get(url.replace(/[0-9a-f]{64}$/, '0'.repeat(64)));
+    check(unknown.status === 404, `unknown digest: HTTP ${unknown.status}`);
+    return { length, failures };
+}
+
+// What a device's update did
+class Update {
+    constructor() {
+        this.source = null;
+        this.rejected = 0;
+        this.timeouts = 0;
+        this.ms = 0;
+    }
+}
+
+async function main() {
+    if (PEER_URL) {
+        const { length, failures } = await probePeer(PEER_URL);
+        console.log(`[${TAG}] ${PEER_URL}: ${length} bytes, ${failures.length ? failures.join('; ') : 'all checks passed'}`);
+        process.exit(failures.length ? 1 : 0);
+    }
+
+    const image = FIRMWARE_PATH ? fs.readFileSync(FIRMWARE_PATH) : crypto.randomBytes(1024 * 1024);
+    const digest = sha256(image);
+    const uplink = new Link(UPLINK_BYTES_PER_MS);
+    let upstreamBytes = 0;
+    let upstreamFetches = 0;
+    const upstream = http.createServer(async (req, res) => {
+        upstreamFetches++;
+        res.writeHead(200, { 'Content-Length': image.length });
+        for (let pos = 0; pos < image.length && !res.destroyed; pos += SEND_CHUNK) {
+            const chunk = image.subarray(pos, pos + SEND_CHUNK);
+            await uplink.carry(chunk.length);
+            res.write(chunk);
+            upstreamBytes += chunk.length;
+        }
+        res.end();
+    });
+    await new Promise(resolve => upstream.listen(0, '127.0.0.1', resolve));
+    const upstreamUrl = `http://127.0.0.1:${upstream.address().port}/firmware.bin`;
+
+    // Ids from 1 up; liars come last so they are never the seeders
+    const previous = crypto.randomBytes(image.length);
+    const devices = [];
+    for (let i = 0; i < DEVICES + LIARS; i++) {
+        const device = new Device(i + 1, previous, new Link(LAN_BYTES_PER_MS));
+        device.liar = i >= DEVICES;
+        await device.listen();
+        devices.push(device);
+    }
+    for (const liar of devices.filter(d => d.liar)) {
+        liar.advertised = digest;
+        liar.image = crypto.randomBytes(image.length);
+    }
+
+    // The liars' endpoints fail the probe on the digest and nothing else
+    const honest = devices.find(d => !d.liar);
+    const probe = await probePeer(`${honest.url}/ota/${honest.advertised}`);
+    console.log(`[${TAG}] peer endpoint probe: ${probe.failures.length ? probe.failures.join('; ') : 'all checks passed'}`);
+    honest.served = 0;
+
+    // The mDNS browse: who holds the digest, and whether this device seeds
+    function browse(self) {
+        const others = devices.filter(d => d !== self);
+        const lower = others.filter(d => d.id < self.id).length;
+        const holders = others.filter(d => d.advertised === digest).sort(() => Math.random() - 0.5);
+        return { sources: holders.slice(0, MAX_SOURCES), seeder: lower < SEEDERS };
+    }
+
+    async function download(url, update) {
+        try {
+            const res = await get(url);
+            if (res.status !== 200) {
+                return false;
+            }
+            if (sha256(res.body) !== digest) {
+                update.rejected++;
+                return null;
+            }
+            return true;
+        } catch {
+            update.timeouts++;
+            return false;
+        }
+    }
+
+    async function updateDevice(device) {
+        await delay(Math.random() * SPREAD_MS);
+        const update = new Update();
+        const start = now();
+        const rejected = new Set();
+        const giveUp = start + WAIT_MS;
+        while (P2P) {
+            const { sources, seeder } = browse(device);
+            for (const peer of sources.filter(p => !rejected.has(p))) {
+                const ok = await download(`${peer.url}/ota/${digest}`, update);
+                if (ok) {
+                    update.source = peer.liar ? 'liar' : 'peer';
+                    break;
+                }
+                if (ok === null) {
+                    rejected.add(peer);
+                }
+            }
+            if (update.source || seeder || now() >= giveUp) {
+                break;
+            }
+            await delay(POLL_MS);
+        }
+        while (!update.source) {
+            if (await download(upstreamUrl, update)) {
+                update.source = 'upstream';
+            }
+        }
+        // Staged and advertised: from now on it serves the release
+        device.image = image;
+        device.advertised = digest;
+        update.ms = now() - start;
+        return update;
+    }
+
+    const imageMs = image.length / UPLINK_BYTES_PER_MS;
+    console.log(`[${TAG}] ${image.length} byte image, ${DEVICES} devices + ${LIARS} lying peers, ` +
+                `uplink ${(UPLINK_BYTES_PER_MS * 1000 / 1024).toFixed(0)} KB/s (${(imageMs / 1000).toFixed(1)} s per image), ` +
+                `LAN ${(LAN_BYTES_PER_MS * 1000 / 1024).toFixed(0)} KB/s per device, ` +
+                `${P2P ? `${SEEDERS} seeders` : 'sharing off'}`);
+    const start = now();
+    const updates = await Promise.all(devices.filter(d => !d.liar).map(updateDevice));
+    const totalMs = now() - start;
+
+    const count = source => updates.filter(u => u.source === source).length;
+    const times = updates.map(u => u.ms).sort((a, b) => a - b);
+    const verified = devices.filter(d => !d.liar).every(d => sha256(d.image) === digest) && count('liar') === 0;
+    console.log(`[${TAG}] upstream: ${upstreamFetches} downloads, ${(upstreamBytes / 1024).toFixed(0)} KB ` +
+                `(${(upstreamBytes / image.length).toFixed(1)} images)`);
+    console.log(`[${TAG}] sources: ${count('upstream')} upstream, ${count('peer')} peer; ` +
+                `${updates.reduce((n, u) => n + u.rejected, 0)} images rejected, ` +
+                `${updates.reduce((n, u) => n + u.timeouts, 0)} peer timeouts`);
+    console.log(`[${TAG}] update time p50 ${(times[Math.floor(times.length / 2)] / 1000).toFixed(1)} s, ` +
+                `max ${(times[times.length - 1] / 1000).toFixed(1)} s, all done after ${(totalMs / 1000).toFixed(1)} s; ` +
+                `${verified ? 'every device verified' : 'MISMATCH'}`);
+
+    upstream.close();
+    devices.forEach(d => d.server.close());
+    process.exit(verified && probe.failures.length === 0 ? 0 : 1);
+}
+
+main().catch(error => {
+    console.error(`[${TAG}] ${error.message}`);
+    process.exit(1);
+});
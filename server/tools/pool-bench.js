@@ -0,0 +1,157 @@
+#!/usr/bin/env node
+/**
+ * @file pool-bench.js
+ * @brief Upstream connection pooling and prewarming against a local TLS stub
+ *
+ * Starts an HTTPS stub in-process (self-signed certificate via openssl) that
+ * simulates network round trips: every request costs one RTT and the first
+ * request on a new connection pays the TCP + TLS handshake RTTs on top.
+ * Traffic arrives in bursts separated by idle gaps longer than the server's
+ * keep-alive timeout, which is where cold connections hurt most.
+ *
+ * Compares a connection per request, keep-alive pooling, and pooling with
+ * prewarm/rewarm, reporting latency percentiles, TLS handshakes seen by the
+ * server and the client-side reuse rate.
+ *
+ * Usage: node tools/pool-bench.js
+ *
+ * Environment:
+ *   BENCH_RTT_MS          Simulated round trip (default 40)
+ *   BENCH_HANDSHAKE_RTTS  Extra round trips for a new connection (default 2: TCP + TLS 1.3)
+ *   BENCH_BURSTS          Bursts per scenario (default 3)
+ *   BENCH_CONCURRENCY     Concurrent clients per burst (default 4)
+ *   BENCH_SEQUENTIAL      Requests per client per burst (default 3)
+ *   BENCH_IDLE_MS         Gap between bursts (default 5000)
+ *   BENCH_SERVER_IDLE_MS  Server keep-alive timeout (default 4000; Node's agent retires
+ *                         sockets a second before the advertised timeout)
+ */
+
+const https = require('https');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { execFileSync } = require('child_process');
+const { UpstreamHttp } = require('../upstream-http');
+const { delay, percentile } = require('./bench-util');
+
+const RTT_MS = parseInt(process.env.BENCH_RTT_MS) || 40;
+const HANDSHAKE_RTTS = parseInt(process.env.BENCH_HANDSHAKE_RTTS ?? '2');
+const BURSTS = parseInt(process.env.BENCH_BURSTS) || 3;
+const CONCURRENCY = parseInt(process.env.BENCH_CONCURRENCY) || 4;
+const SEQUENTIAL = parseInt(process.env.BENCH_SEQUENTIAL) || 3;
+const IDLE_MS = parseInt(process.env.BENCH_IDLE_MS) || 5000;
+const SERVER_IDLE_MS = parseInt(process.env.BENCH_SERVER_IDLE_MS) || 4000;
+
+const TAG = 'pool-bench';
+
+function makeCertificate() {
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'pool-bench-'));
+    const keyPath = path.join(dir, 'key.pem');
+    const certPath = path.join(dir, 'cert.pem');
+    execFileSync('openssl', ['req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-days', '1',
+        '-subj', '/CN=localhost', '-addext', 'subjectAltName=DNS:localhost,IP:127.0.0.1',
+        '-keyout', keyPath, '-out', certPath], { stdio: 'ignore' });
+    const cert = { key: fs.readFileSync(keyPath), cert: fs.readFileSync(certPath) };
+    fs.rmSync(dir, { recursive: true, force: true });
+    return cert;
+}
+
+function startStub(cert) {
+    const warmSockets = new WeakSet();
+    const server = https.createServer(cert, async (req, res) => {
+        let wait = RTT_MS;
+        if (!warmSockets.has(req.socket)) {
+            warmSockets.add(req.socket);
+            wait += HANDSHAKE_RTTS * RTT_MS;
+        }
+        await delay(wait);
+        // Content-Length on HEAD too; without it Node closes the connection after the response
+        const body = JSON.stringify({ products: [] });
+        res.writeHead(200, { 'Content-Type': 'application/json', 'Content-Length': Buffer.byteLength(body) });
+        res.end(req.method === 'HEAD' ? undefined : body);
+    });
+    server.keepAliveTimeout = SERVER_IDLE_MS;
+    server.handshakes = 0;
+    server.on('secureConnection', () => server.handshakes++);
+    return new Promise(resolve => server.listen(0, '127.0.0.1', () => resolve(server)));
+}
+
+/**
+ * A new connection for every request, as with no pooling policy after an idle gap
+ */
+function coldRequest(url, ca) {
+    return new Promise((resolve, reject) => {
+        https.get(url, { ca, agent: false }, res => {
+            res.resume();
+            res.on('end', resolve);
+        }).on('error', reject);
+    });
+}
+
+async function runScenario(name, server, request, client) {
+    const base = `https://localhost:${server.address().port}`;
+    const handshakesBefore = server.handshakes;
+    const latencies = [];
+
+    // Let the prewarm (if any) land before the first burst, as it would at startup
+    await delay(IDLE_MS);
+
+    for (let burst = 0; burst < BURSTS; burst++) {
+        await Promise.all(Array.from({ length: CONCURRENCY }, async (_, c) => {
+            for (let i = 0; i < SEQUENTIAL; i++) {
+                const start = process.hrtime.bigint();
+                await request(`${base}/v3/products?barcode=${burst}-${c}-${i}`);
+                latencies.push(Number(process.hrtime.bigint() - start) / 1e6);
+            }
+        }));
+        await delay(IDLE_MS);
+    }
+
+    latencies.sort((a, b) => a - b);
+    const stats = client ? client.stats() : null;
+    console.log(`[${TAG}] ${name.padEnd(18)} p50 ${percentile(latencies, 0.5).toFixed(1)}  ` +
+        `p90 ${percentile(latencies, 0.9).toFixed(1)}  p99 ${percentile(latencies, 0.99).toFixed(1)} ms  ` +
+        `handshakes ${server.handshakes - handshakesBefore}` +
+        (stats ? `  reuse ${(stats.reuseRate * 100).toFixed(0)}% (${stats.reused}/${stats.reused + stats.connections}), ` +
+            `prewarmed ${stats.prewarmedSockets}` : ''));
+    if (client) {
+        client.close();
+    }
+}
+
+async function main() {
+    const cert = makeCertificate();
+    const server = await startStub(cert);
+    const ca = cert.cert;
+    const origin = `https://localhost:${server.address().port}`;
+
+    console.log(`[${TAG}] RTT ${RTT_MS}ms (+${HANDSHAKE_RTTS} per new connection), ${BURSTS} bursts of ` +
+        `${CONCURRENCY}x${SEQUENTIAL} requests, ${IDLE_MS}ms idle gaps, server keep-alive ${SERVER_IDLE_MS}ms`);
+
+    await runScenario('no keep-alive', server, url => coldRequest(url, ca), null);
+
+    const pooled = new UpstreamHttp({
+        maxSockets: CONCURRENCY,
+        socketIdleMs: SERVER_IDLE_MS * 0.75,
+        agentOptions: { ca }
+    });
+    await runScenario('keep-alive pool', server, url => pooled.request(url, { timeoutMs: 10000 }), pooled);
+
+    const warmed = new UpstreamHttp({
+        maxSockets: CONCURRENCY,
+        socketIdleMs: SERVER_IDLE_MS * 0.75,
+        rewarmIntervalMs: SERVER_IDLE_MS / 10,
+        origins: { [origin]: { prewarm: CONCURRENCY } },
+        agentOptions: { ca }
+    });
+    warmed.prewarm();
+    await runScenario('pool + prewarm', server, url => warmed.request(url, { timeoutMs: 10000 }), warmed);
+
+    server.close();
+    process.exit(0);
+}
+
+main().catch(error => {
+    console.error(`[${TAG}] ${error.message}`);
+    process.exit(1);
+});
@@ -0,0 +1,243 @@
+#!/usr/bin/env node
+/**
+ * @file scale-bench.js
+ * @brief Lookup throughput with 1..N resolver instances in one share group
+ *
+ * Starts tools/stub-upstream.js, then for each group size starts that many
+ * barcode-resolver.js processes in a fresh MQTT 5 shared subscription group
+ * (one SQLite file between them, like instances on one host) and drives them
+ * with a closed loop of simulated devices, each keeping one lookup
+ * outstanding. Every lookup is a new barcode, so each one costs an upstream
+ * call and an image conversion. Reports throughput, speedup over one
+ * instance, latency percentiles, timeouts, duplicate answers (should be 0)
+ * and how the broker spread requests across the instances.
+ *
+ * Needs a local broker with MQTT 5 (e.g. mosquitto 2.x):
+ *   mosquitto -p 1883 &
+ *   node tools/scale-bench.js
+ *
+ * Environment:
+ *   MQTT_BROKER_URI     Broker (default mqtt://localhost:1883)
+ *   BENCH_INSTANCES     Group sizes to run (default "1,2,4")
+ *   BENCH_DEVICES       Simulated devices, one lookup outstanding each (default 64)
+ *   BENCH_SECONDS       Measurement time per group size (default 20)
+ *   BENCH_IMAGE_WORKERS Image worker threads per instance (default 1)
+ *   STUB_*              Passed through to the stub upstream (latency, image size, ...)
+ */
+
+const { spawn } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const mqtt = require('mqtt');
+const { delay, percentile } = require('./bench-util');
+
+const MQTT_BROKER_URI = process.env.MQTT_BROKER_URI || 'mqtt://localhost:1883';
+const INSTANCES = (process.env.BENCH_INSTANCES || '1,2,4').split(',').map(n => parseInt(n)).filter(n => n > 0);
+const DEVICES = parseInt(process.env.BENCH_DEVICES) || 64;
+const SECONDS = parseFloat(process.env.BENCH_SECONDS) || 20;
+const IMAGE_WORKERS = process.env.BENCH_IMAGE_WORKERS || '1';
+const STUB_PORT = 4400;
+const FIRST_RESOLVER_PORT = 3100;
+const WARMUP_MS = 2000;
+const LOOKUP_TIMEOUT_MS = 10000;
+const START_TIMEOUT_MS = 15000;
+
+const TAG = 'scale-bench';
+const SERVER_DIR = path.join(__dirname, '..');
+
+/**
+ * Start a child process and resolve once it prints `readyText`
+ */
+function startProcess(script, env, readyText) {
+    const child = spawn(process.execPath, [path.join(SERVER_DIR, script)], {
+        cwd: SERVER_DIR,
+        env: { ...process.env, ...env },
+        stdio: ['ignore', 'pipe', 'pipe']
+    });
+    child.stderr.on('data', data => process.stderr.write(data));
+
+    return new Promise((resolve, reject) => {
+        let output = '';
+        const timer = setTimeout(() => reject(new Error(`${script} did not start:\n${output}`)), START_TIMEOUT_MS);
+        child.stdout.on('data', data => {
+            output += data;
+            if (output.includes(readyText)) {
+                clearTimeout(timer);
+                child.stdout.resume();
+                resolve(child);
+            }
+        });
+        child.on('exit', code => {
+            clearTimeout(timer);
+            reject(new Error(`${script} exited (${code}):\n${output}`));
+        });
+    });
+}
+
+function stopProcess(child) {
+    return new Promise(resolve => {
+        if (child.exitCode !== null) {
+            resolve();
+            return;
+        }
+        child.removeAllListeners('exit');
+        child.on('exit', resolve);
+        child.kill('SIGTERM');
+    });
+}
+
+/**
+ * Run one group size; devices answer each response with their next scan
+ */
+async function runGroup(instances, client, run) {
+    const dbPath = path.join(os.tmpdir(), `scale-bench-${process.pid}-${run}.db`);
+    const resolvers = [];
+    for (let i = 0; i < instances; i++) {
+        resolvers.push(await startProcess('barcode-resolver.js', {
+            PORT: String(FIRST_RESOLVER_PORT + i),
+            BARCODE_API_BASE: `http://localhost:${STUB_PORT}/v3/products`,
+            BARCODELOOKUP_API_KEY: 'bench',
+            PRODUCT_PROVIDERS: 'barcodelookup',
+            PRODUCT_CACHE_DB: dbPath,
+            RESOLVER_SHARE_GROUP: `scale-bench-${process.pid}-${run}`,
+            RESOLVER_SYNC_SECRET: `scale-bench-${process.pid}`,
+            RESOLVER_INSTANCES: String(instances),
+            UPSTREAM_RATE_PER_MIN: '0',
+            IMAGE_WORKERS,
+            LOG_LEVEL: 'info',
+            MQTT_BROKER_URI
+        }, 'Barcode resolver service ready!'));
+    }
+
+    const pending = new Map();   // request_id -> { device, sentAt, timer }
+    const answered = new Set();
+    const latencies = [];
+    let completed = 0;
+    let timeouts = 0;
+    let duplicates = 0;
+    let measuring = false;
+    let running = true;
+    let nextBarcode = run * 1e7;
+
+    const send = device => {
+        if (!running) {
+            return;
+        }
+        // Random 32-bit IDs like the firmware's esp_random()
+        const requestId = Math.floor(Math.random() * 0xFFFFFFFF);
+        const entry = { device, sentAt: process.hrtime.bigint(), timer: null };
+        entry.timer = setTimeout(() => {
+            pending.delete(requestId);
+            if (measuring) {
+                timeouts++;
+            }
+            send(device);
+        }, LOOKUP_TIMEOUT_MS);
+        pending.set(requestId, entry);
+        client.publish(`barcode/lookup/request/scale-${device}`, JSON.stringify({
+            barcode: String(800000000000 + nextBarcode++),
+            request_id: requestId,
+            timestamp: Math.floor(Date.now() / 1000)
+        }), { qos: 1 });
+    };
+
+    const onMessage = (topic, message) => {
+        let response;
+        try {
+            response = JSON.parse(message.toString());
+        } catch (error) {
+            return;
+        }
+        const entry = pending.get(response.request_id);
+        if (!entry) {
+            if (answered.has(response.request_id)) {
+                duplicates++;
+            }
+            return;
+        }
+        pending.delete(response.request_id);
+        answered.add(response.request_id);
+        clearTimeout(entry.timer);
+        if (measuring) {
+            completed++;
+            latencies.push(Number(process.hrtime.bigint() - entry.sentAt) / 1e6);
+        }
+        send(entry.device);
+    };
+    client.on('message', onMessage);
+
+    for (let device = 0; device < DEVICES; device++) {
+        send(device);
+    }
+    await delay(WARMUP_MS);
+    measuring = true;
+    await delay(SECONDS * 1000);
+    measuring = false;
+    running = false;
+
+    // Let stragglers land so late duplicates are still counted
+    await delay(1000);
+    client.removeListener('message', onMessage);
+    for (const entry of pending.values()) {
+        clearTimeout(entry.timer);
+    }
+
+    const spread = [];
+    for (let i = 0; i < instances; i++) {
+        try {
+            const stats = await (await fetch(`http://localhost:${FIRST_RESOLVER_PORT + i}/stats`)).json();
+            spread.push(stats.requests.claimed);
+        } catch (error) {
+            spread.push('?');
+        }
+    }
+
+    await Promise.all(resolvers.map(stopProcess));
+    for (const suffix of ['', '-wal', '-shm']) {
+        fs.rmSync(dbPath + suffix, { force: true });
+    }
+
+    latencies.sort((a, b) => a - b);
+    return {
+        instances,
+        throughput: completed / SECONDS,
+        p50: percentile(latencies, 0.5),
+        p99: percentile(latencies, 0.99),
+        timeouts,
+        duplicates,
+        spread
+    };
+}
+
+async function main() {
+    const stub = await startProcess('tools/stub-upstream.js', { STUB_PORT: String(STUB_PORT) }, 'Listening');
+    const client = mqtt.connect(MQTT_BROKER_URI, {
+        clientId: `scale-bench-${Math.random().toString(16).substr(2, 8)}`
+    });
+    await new Promise((resolve, reject) => {
+        client.once('connect', resolve);
+        client.once('error', reject);
+    });
+    await new Promise(resolve => client.subscribe('barcode/lookup/response/+', { qos: 1 }, resolve));
+
+    console.log(`[${TAG}] ${DEVICES} devices, ${SECONDS}s per group size, ${IMAGE_WORKERS} image worker(s) per instance`);
+    const results = [];
+    for (const [run, instances] of INSTANCES.entries()) {
+        const result = await runGroup(instances, client, run);
+        results.push(result);
+        const base = results[0].throughput / results[0].instances;
+        console.log(`[${TAG}] ${String(instances).padStart(2)} instance(s): ${result.throughput.toFixed(1)} lookups/s  ` +
+            `speedup ${(result.throughput / base).toFixed(2)}x (${(100 * result.throughput / (base * instances)).toFixed(0)}% efficiency)  ` +
+            `p50 ${result.p50.toFixed(0)}  p99 ${result.p99.toFixed(0)} ms  timeouts ${result.timeouts}  ` +
+            `duplicates ${result.duplicates}  per instance ${result.spread.join('/')}`);
+    }
+
+    client.end();
+    await stopProcess(stub);
+}
+
+main().catch(error => {
+    console.error(`[${TAG}] ${error.message}`);
+    process.exit(1);
+});
@@ -0,0 +1,205 @@
+#!/usr/bin/env node
+/**
+ * @file stub-upstream.js
+ * @brief Local stand-in for the BarcodeLookup API and product image hosts
+ *
+ * Serves deterministic fake products for any barcode and a JPEG for every
+ * product image, with configurable latency, so the resolver can be load
+ * tested without paying for (or being rate limited by) the real API.
+ * Like the real API, `barcode=a,b,c` returns every known product in one
+ * call, and each call is billed regardless of how many codes it carries.
+ * Open Food Facts and UPCitemdb style endpoints serve the same products, so
+ * one or more stub instances (with different latency and failure settings)
+ * can stand in for every provider of the hedged lookup.
+ *
+ * Point the resolver at it with:
+ *   BARCODE_API_BASE=http://localhost:4000/v3/products
+ *
+ * Environment:
+ *   STUB_PORT            Listen port (default 4000)
+ *   STUB_API_LATENCY_MS  Delay before each product response (default 150)
+ *   STUB_API_PER_CODE_MS Extra delay per barcode in a multi-code call (default 2)
+ *   STUB_COST_PER_CALL   Billed per API call, reported in /stats (default 0.01)
+ *   STUB_API_JITTER_MS   Random extra delay per product request, 0..N (default 0)
+ *   STUB_SLOW_RATE       Fraction of product requests that take STUB_SLOW_MS extra (default 0)
+ *   STUB_SLOW_MS         Slow-tail delay (default 2000)
+ *   STUB_FAILURE_RATE    Fraction of product requests answered with a 500 (default 0)
+ *   STUB_IMAGE_LATENCY_MS Delay before each image response (default 50)
+ *   STUB_IMAGE_SIZE      Source image edge in pixels (default 600)
+ *   STUB_NOT_FOUND_RATE  Fraction of barcodes with no product (default 0.05)
+ */
+
+const http = require('http');
+const crypto = require('crypto');
+const sharp = require('sharp');
+const { delay } = require('./bench-util');
+
+const PORT = parseInt(process.env.STUB_PORT) || 4000;
+const API_LATENCY_MS = parseInt(process.env.STUB_API_LATENCY_MS ?? '150');
+const API_PER_CODE_MS = parseFloat(process.env.STUB_API_PER_CODE_MS ?? '2');
+const COST_PER_CALL = parseFloat(process.env.STUB_COST_PER_CALL ?? '0.01');
+const API_JITTER_MS = parseFloat(process.env.STUB_API_JITTER_MS ?? '0');
+const SLOW_RATE = parseFloat(process.env.STUB_SLOW_RATE ?? '0');
+const SLOW_MS = parseInt(process.env.STUB_SLOW_MS ?? '2000');
+const FAILURE_RATE = parseFloat(process.env.STUB_FAILURE_RATE ?? '0');
+const IMAGE_LATENCY_MS = parseInt(process.env.STUB_IMAGE_LATENCY_MS ?? '50');
+const IMAGE_SIZE = parseInt(process.env.STUB_IMAGE_SIZE) || 600;
+const NOT_FOUND_RATE = parseFloat(process.env.STUB_NOT_FOUND_RATE ?? '0.05');
+
+const TAG = 'stub-upstream';
+
+const stats = {
+    apiCalls: 0,
+    apiCodes: 0,
+    cost: 0,
+    failures: 0,
+    imageCalls: 0
+};
+
+function barcodeHash(barcode) {
+    return crypto.createHash('md5').update(barcode).digest().readUInt32BE(0);
+}
+
+/**
+ * A noisy gradient JPEG tinted per product, so decode cost resembles a real photo
+ */
+async function makeImage(seed) {
+    const raw = Buffer.alloc(IMAGE_SIZE * IMAGE_SIZE * 3);
+    const tint = [seed & 0xFF, (seed >> 8) & 0xFF, (seed >> 16) & 0xFF];
+    for (let y = 0, i = 0; y < IMAGE_SIZE; y++) {
+        for (let x = 0; x < IMAGE_SIZE; x++, i += 3) {
+            const noise = (x * 7 + y * 13 + ((x * y) & 31)) & 63;
+            raw[i] = (tint[0] + x * 255 / IMAGE_SIZE + noise) & 0xFF;
+            raw[i + 1] = (tint[1] + y * 255 / IMAGE_SIZE + noise) & 0xFF;
+            raw[i + 2] = (tint[2] + noise * 2) & 0xFF;
+        }
+    }
+    return sharp(raw, { raw: { width: IMAGE_SIZE, height: IMAGE_SIZE, channels: 3 } })
+        .jpeg({ quality: 85 })
+        .toBuffer();
+}
+
+// A handful of distinct JPEGs is enough; the resolver caches by URL, not by content
+const imagePool = Promise.all(Array.from({ length: 8 }, (_, i) => makeImage(0x9E3779B1 * (i + 1))));
+
+function productFor(barcode, baseUrl) {
+    const hash = barcodeHash(barcode);
+    if ((hash % 10000) / 10000 < NOT_FOUND_RATE) {
+        return null;
+    }
+    return {
+        barcode_number: barcode,
+        title: `Stub Product ${barcode}`,
+        brand: `Brand ${hash % 97}`,
+        mpn: `M-${hash % 100000}`,
+        images: [`${baseUrl}/images/${barcode}.jpg`],
+        stores: [{ price: ((hash % 5000) / 100 + 0.99).toFixed(2) }]
+    };
+}
+
+/**
+ * Latency and failure injection shared by every product endpoint
+ * @returns {Promise<boolean>} true if the request should fail
+ */
+async function productDelay(codes) {
+    let ms = API_LATENCY_MS + API_PER_CODE_MS * Math.max(0, codes - 1) + Math.random() * API_JITTER_MS;
+    if (Math.random() < SLOW_RATE) {
+        ms += SLOW_MS;
+    }
+    await delay(ms);
+    return Math.random() < FAILURE_RATE;
+}
+
+function sendFailure(res) {
+    stats.failures++;
+    res.writeHead(500, { 'Content-Type': 'application/json' });
+    res.end(JSON.stringify({ error: 'injected failure' }));
+}
+
+const server = http.createServer(async (req, res) => {
+    const url = new URL(req.url, `http://${req.headers.host}`);
+    const baseUrl = `http://${req.headers.host}`;
+
+    if (url.pathname === '/v3/products') {
+        const barcodes = (url.searchParams.get('barcode') || '').split(',').filter(Boolean);
+        stats.apiCalls++;
+        stats.apiCodes += barcodes.length;
+        stats.cost += COST_PER_CALL;
+        if (await productDelay(barcodes.length)) {
+            sendFailure(res);
+            return;
+        }
+        const products = barcodes.map(barcode => productFor(barcode, baseUrl)).filter(Boolean);
+        if (products.length === 0) {
+            res.writeHead(404, { 'Content-Type': 'application/json' });
+            res.end(JSON.stringify({ products: [] }));
+            return;
+        }
+        res.writeHead(200, { 'Content-Type': 'application/json' });
+        res.end(JSON.stringify({ products }));
+        return;
+    }
+
+    // Open Food Facts: /api/v2/product/<code>.json
+    const offMatch = url.pathname.match(/^\/api\/v2\/product\/(\d+)\.json$/);
+    if (offMatch) {
+        stats.apiCalls++;
+        stats.apiCodes++;
+        stats.cost += COST_PER_CALL;
+        if (await productDelay(1)) {
+            sendFailure(res);
+            return;
+        }
+        const product = productFor(offMatch[1], baseUrl);
+        res.writeHead(product ? 200 : 404, { 'Content-Type': 'application/json' });
+        res.end(JSON.stringify(product ? {
+            status: 1,
+            product: { code: product.barcode_number, product_name: product.title, brands: product.brand, image_front_url: product.images[0] }
+        } : { status: 0 }));
+        return;
+    }
+
+    // UPCitemdb: /prod/trial/lookup?upc=<code>
+    if (url.pathname === '/prod/trial/lookup') {
+        stats.apiCalls++;
+        stats.apiCodes++;
+        stats.cost += COST_PER_CALL;
+        if (await productDelay(1)) {
+            sendFailure(res);
+            return;
+        }
+        const product = productFor(url.searchParams.get('upc') || '', baseUrl);
+        res.writeHead(200, { 'Content-Type': 'application/json' });
+        res.end(JSON.stringify({
+            items: product ? [{
+                upc: product.barcode_number, title: product.title, brand: product.brand, model: product.mpn,
+                images: product.images, offers: [{ price: product.stores[0].price }]
+            }] : []
+        }));
+        return;
+    }
+
+    if (url.pathname.startsWith('/images/')) {
+        stats.imageCalls++;
+        await delay(IMAGE_LATENCY_MS);
+        const images = await imagePool;
+        const image = images[barcodeHash(url.pathname) % images.length];
+        res.writeHead(200, { 'Content-Type': 'image/jpeg', 'Content-Length': image.length });
+        res.end(image);
+        return;
+    }
+
+    if (url.pathname === '/stats') {
+        res.writeHead(200, { 'Content-Type': 'application/json' });
+        res.end(JSON.stringify(stats));
+        return;
+    }
+
+    res.writeHead(404);
+    res.end();
+});
+
+server.listen(PORT, () => {
+    console.log(`[${TAG}] Listening on port ${PORT} (API ${API_LATENCY_MS}ms, images ${IMAGE_LATENCY_MS}ms, ${IMAGE_SIZE}px)`);
+    console.log(`[${TAG}] Use BARCODE_API_BASE=http://localhost:${PORT}/v3/products`);
+});
@@ -0,0 +1,157 @@
+/**
+ * @file upstream-batcher.js
+ * @brief Micro-batching of upstream product lookups
+ *
+ * Distinct barcodes requested within a short window (or until the batch is
+ * full) go out as one multi-barcode API call, and each result is handed back
+ * to the lookups waiting on that code. Most upstream cost is per call rather
+ * than per code, so a burst of scans from many devices costs one call instead
+ * of one per scan.
+ *
+ * A code missing from a multi-code answer is retried on its own before being
+ * reported as not found, so a provider that ignores extra codes (or reports
+ * them in an unexpected format) costs calls but never loses a product.
+ */
+
+const TAG = 'upstream-batcher';
+
+class UpstreamBatcher {
+    /**
+     * @param {Object} options
+     * @param {function(string[]): Promise<Map<string, Object>>} options.fetchBatch - One upstream call for several codes
+     * @param {number} options.maxBatch - Codes per call; 1 disables batching
+     * @param {number} options.windowMs - How long the first code of a batch waits for company
+     */
+    constructor(options) {
+        this.fetchBatch = options.fetchBatch;
+        this.maxBatch = Math.max(1, options.maxBatch);
+        this.windowMs = options.windowMs;
+
+        this.pending = new Map();   // barcode -> { promise, resolve, reject } for the open batch
+        this.timer = null;
+        this.inflight = 0;
+
+        this.counters = {
+            lookups: 0,
+            coalesced: 0,
+            batches: 0,
+            upstreamCalls: 0,
+            upstreamCodes: 0,
+            singleRetries: 0,
+            upstreamErrors: 0,
+            largestBatch: 0
+        };
+
+        console.log(`[${TAG}] Batching up to ${this.maxBatch} codes per call, ${this.windowMs}ms window`);
+    }
+
+    /**
+     * Resolve one barcode, sharing an upstream call with any others in the window
+     * @param {string} barcode - UPC/EAN code
+     * @returns {Promise<Object|null>} Product, or null when the provider has none
+     */
+    fetch(barcode) {
+        this.counters.lookups++;
+
+        const waiting = this.pending.get(barcode);
+        if (waiting) {
+            this.counters.coalesced++;
+            return waiting.promise;
+        }
+
+        const entry = {};
+        entry.promise = new Promise((resolve, reject) => {
+            entry.resolve = resolve;
+            entry.reject = reject;
+        });
+        this.pending.set(barcode, entry);
+
+        if (this.pending.size >= this.maxBatch) {
+            this.flush();
+        } else if (!this.timer) {
+            this.timer = setTimeout(() => this.flush(), this.windowMs);
+        }
+        return entry.promise;
+    }
+
+    /**
+     * Send the open batch upstream and fan the results out to its waiters
+     */
+    async flush() {
+        clearTimeout(this.timer);
+        this.timer = null;
+
+        const batch = this.pending;
+        this.pending = new Map();
+        if (batch.size === 0) {
+            return;
+        }
+
+        const codes = [...batch.keys()];
+        this.counters.batches++;
+        this.counters.largestBatch = Math.max(this.counters.largestBatch, codes.length);
+
+        let results;
+        try {
+            results = await this.call(codes);
+        } catch (error) {
+            console.error(`[${TAG}] Upstream call for ${codes.length} codes failed: ${error.message}`);
+            for (const entry of batch.values()) {
+                entry.reject(error);
+            }
+            return;
+        }
+
+        const missing = [];
+        for (const [code, entry] of batch) {
+            if (results.has(code)) {
+                entry.resolve(results.get(code));
+            } else if (codes.length === 1) {
+                entry.resolve(null);
+            } else {
+                missing.push(code);
+            }
+        }
+
+        // Only a single-code answer is authoritative for "not found"
+        await Promise.all(missing.map(async code => {
+            this.counters.singleRetries++;
+            const entry = batch.get(code);
+            try {
+                const single = await this.call([code]);
+                entry.resolve(single.get(code) || null);
+            } catch (error) {
+                entry.reject(error);
+            }
+        }));
+    }
+
+    async call(codes) {
+        this.counters.upstreamCalls++;
+        this.counters.upstreamCodes += codes.length;
+        this.inflight++;
+        try {
+            return await this.fetchBatch(codes);
+        } catch (error) {
+            this.counters.upstreamErrors++;
+            throw error;
+        } finally {
+            this.inflight--;
+        }
+    }
+
+    stats() {
+        const c = this.counters;
+        return {
+            ...c,
+            maxBatch: this.maxBatch,
+            windowMs: this.windowMs,
+            inflight: this.inflight,
+            pending: this.pending.size,
+            avgBatchSize: c.batches > 0 ? (c.upstreamCodes - c.singleRetries) / c.batches : 0,
+            callsPerLookup: c.lookups > 0 ? c.upstreamCalls / c.lookups : 0
+        };
+    }
+}
+
+module.exports = { UpstreamBatcher };
@@ -0,0 +1,370 @@
+/**
+ * @file upstream-http.js
+ * @brief Keep-alive connection pools for upstream HTTP(S) requests
+ *
+ * One agent per origin with a bounded socket count, so the lookup API and
+ * each image CDN keep a few warm TLS connections instead of paying a cold
+ * handshake on every request. Origins configured with `prewarm` open their
+ * connections at startup and reopen them after idle periods, so the first
+ * scan after a quiet spell doesn't pay the handshake either.
+ *
+ * Responses are fully buffered: { status, statusText, ok, headers, body, json() }.
+ * Timeouts and cancellation through `signal` reject with error.name
+ * 'AbortError', like fetch.
+ */
+
+const http = require('http');
+const https = require('https');
+
+const TAG = 'upstream-http';
+const MAX_REDIRECTS = 5;
+const PREWARM_TIMEOUT_MS = 5000;
+const REDIRECT_STATUSES = new Set([301, 302, 303, 307, 308]);
+
+function abortError(message) {
+    const error = new Error(message);
+    error.name = 'AbortError';
+    return error;
+}
+
+class UpstreamResponse {
+    constructor(res, body) {
+        this.status = res.statusCode;
+        this.statusText = res.statusMessage || '';
+        this.ok = res.statusCode >= 200 && res.statusCode < 300;
+        this.headers = res.headers;
+        this.body = body;
+    }
+
+    json() {
+        return JSON.parse(this.body.toString('utf8'));
+    }
+}
+
+class OriginPool {
+    /**
+     * @param {string} origin - scheme://host[:port]
+     * @param {Object} options - { maxSockets, socketIdleMs, prewarm, prewarmPath, agentOptions }
+     */
+    constructor(origin, options) {
+        this.origin = origin;
+        this.transport = origin.startsWith('https:') ? https : http;
+        this.maxSockets = options.maxSockets;
+        this.prewarmCount = Math.min(options.prewarm || 0, options.maxSockets);
+        this.prewarmPath = options.prewarmPath || '/';
+        this.agent = new this.transport.Agent({
+            ...options.agentOptions,
+            keepAlive: true,
+            maxSockets: options.maxSockets,
+            maxFreeSockets: options.maxSockets,
+            timeout: options.socketIdleMs,   // Close idle sockets before the server does
+            scheduling: 'lifo'               // Reuse the warmest socket; spares age out
+        });
+
+        this.inflight = 0;
+        this.prewarming = false;
+        this.lastUsed = Date.now();
+
+        this.counters = {
+            requests: 0,
+            reused: 0,
+            connections: 0,
+            retries: 0,
+            errors: 0,
+            timeouts: 0,
+            cancelled: 0,
+            prewarms: 0,
+            prewarmedSockets: 0
+        };
+    }
+
+    freeSockets() {
+        return Object.values(this.agent.freeSockets).reduce((n, list) => n + list.length, 0);
+    }
+
+    activeSockets() {
+        return Object.values(this.agent.sockets).reduce((n, list) => n + list.length, 0);
+    }
+
+    /**
+     * One request/response on a pooled socket; a stale keep-alive socket is retried once on a new one
+     * @param {string} url - Absolute URL on this origin
+     * @param {Object} options - { method, headers, timeoutMs, signal, prewarm }
+     * @returns {Promise<Object>} { res, body }
+     */
+    send(url, options, retry = true) {
+        return new Promise((resolve, reject) => {
+            let settled = false;
+            const finish = (error, value) => {
+                if (settled) {
+                    return;
+                }
+                settled = true;
+                clearTimeout(timer);
+                this.inflight--;
+                this.lastUsed = Date.now();
+                if (error) {
+                    reject(error);
+                } else {
+                    resolve(value);
+                }
+            };
+
+            this.inflight++;
+            const req = this.transport.request(url, {
+                agent: this.agent,
+                method: options.method || 'GET',
+                headers: options.headers
+            }, res => {
+                const chunks = [];
+                res.on('data', chunk => chunks.push(chunk));
+                res.on('end', () => finish(null, { res, body: Buffer.concat(chunks) }));
+                res.on('error', error => finish(error));
+            });
+
+            req.on('socket', () => {
+                if (options.prewarm) {
+                    this.counters.prewarmedSockets += req.reusedSocket ? 0 : 1;
+                } else if (req.reusedSocket) {
+                    this.counters.reused++;
+                } else {
+                    this.counters.connections++;
+                }
+            });
+
+            req.on('error', error => {
+                // The server may close an idle keep-alive socket just as we pick it up
+                if (retry && req.reusedSocket && error.code === 'ECONNRESET' && !settled) {
+                    settled = true;
+                    clearTimeout(timer);
+                    this.inflight--;
+                    this.counters.retries++;
+                    this.send(url, options, false).then(resolve, reject);
+                    return;
+                }
+                finish(error);
+            });
+
+            const timer = setTimeout(() => {
+                this.counters.timeouts++;
+                finish(abortError(`Request to ${this.origin} timed out after ${options.timeoutMs}ms`));
+                req.destroy();
+            }, options.timeoutMs);
+
+            // Cancellation by the caller (e.g. a hedged request that lost) closes the connection
+            const signal = options.signal;
+            if (signal) {
+                const onAbort = () => {
+                    this.counters.cancelled++;
+                    finish(abortError(`Request to ${this.origin} cancelled`));
+                    req.destroy();
+                };
+                if (signal.aborted) {
+                    onAbort();
+                    return;
+                }
+                signal.addEventListener('abort', onAbort, { once: true });
+                req.on('close', () => signal.removeEventListener('abort', onAbort));
+            }
+
+            req.end();
+        });
+    }
+
+    /**
+     * Bring the pool up to `prewarm` open sockets with cheap concurrent HEAD requests.
+     * Concurrent requests take the free sockets first, so only the shortfall is dialled.
+     */
+    async prewarm() {
+        if (this.prewarming || this.prewarmCount === 0) {
+            return;
+        }
+        this.prewarming = true;
+        this.counters.prewarms++;
+        const url = new URL(this.prewarmPath, this.origin).href;
+        try {
+            await Promise.all(Array.from({ length: this.prewarmCount }, () =>
+                this.send(url, { method: 'HEAD', timeoutMs: PREWARM_TIMEOUT_MS, prewarm: true }).catch(error => {
+                    console.error(`[${TAG}] Prewarm of ${this.origin} failed: ${error.message}`);
+                })));
+        } finally {
+            this.prewarming = false;
+        }
+    }
+
+    /**
+     * Top the free pool back up after idle sockets were closed
+     */
+    rewarm() {
+        if (this.inflight === 0 && this.freeSockets() < this.prewarmCount) {
+            this.prewarm();
+        }
+    }
+
+    stats() {
+        const c = this.counters;
+        const total = c.reused + c.connections;
+        return {
+            ...c,
+            inflight: this.inflight,
+            activeSockets: this.activeSockets(),
+            freeSockets: this.freeSockets(),
+            maxSockets: this.maxSockets,
+            reuseRate: total > 0 ? c.reused / total : 0
+        };
+    }
+
+    close() {
+        this.agent.destroy();
+    }
+}
+
+class UpstreamHttp {
+    /**
+     * @param {Object} options
+     * @param {number} options.maxSockets - Default socket limit per origin
+     * @param {number} options.socketIdleMs - Idle keep-alive sockets are closed after this
+     * @param {number} options.rewarmIntervalMs - How often prewarmed origins are topped up
+     * @param {number} options.maxOrigins - Pools kept before the least recently used idle one is closed
+     * @param {Object} options.origins - Per-origin overrides: { maxSockets, prewarm, prewarmPath }
+     * @param {Object} options.agentOptions - Extra agent options (e.g. `ca` for a local TLS stub)
+     */
+    constructor(options) {
+        this.defaults = {
+            maxSockets: options.maxSockets,
+            socketIdleMs: options.socketIdleMs,
+            agentOptions: options.agentOptions || {}
+        };
+        this.maxOrigins = options.maxOrigins || 64;
+        this.configured = new Map();
+        for (const [origin, config] of Object.entries(options.origins || {})) {
+            this.configured.set(new URL(origin).origin, config);
+        }
+
+        this.pools = new Map();   // origin -> OriginPool, least recently used first
+        this.redirects = 0;
+
+        this.rewarmTimer = null;
+        if (options.rewarmIntervalMs > 0 && this.configured.size > 0) {
+            this.rewarmTimer = setInterval(() => {
+                for (const pool of this.pools.values()) {
+                    pool.rewarm();
+                }
+            }, options.rewarmIntervalMs);
+            this.rewarmTimer.unref();
+        }
+    }
+
+    pool(origin) {
+        let pool = this.pools.get(origin);
+        if (pool) {
+            this.pools.delete(origin);
+            this.pools.set(origin, pool);
+            return pool;
+        }
+
+        pool = new OriginPool(origin, { ...this.defaults, ...this.configured.get(origin) });
+        this.pools.set(origin, pool);
+
+        if (this.pools.size > this.maxOrigins) {
+            for (const [key, candidate] of this.pools) {
+                if (candidate.inflight === 0 && !this.configured.has(key)) {
+                    candidate.close();
+                    this.pools.delete(key);
+                    break;
+                }
+            }
+        }
+        return pool;
+    }
+
+    /**
+     * Buffered request through the origin's pool, following redirects
+     * @param {string} url - Absolute URL
+     * @param {Object} options - { method, headers, timeoutMs, signal }
+     * @returns {Promise<UpstreamResponse>}
+     */
+    async request(url, options) {
+        for (let hop = 0; ; hop++) {
+            const target = new URL(url);
+            const pool = this.pool(target.origin);
+            pool.counters.requests++;
+            let result;
+            try {
+                result = await pool.send(target.href, options);
+            } catch (error) {
+                if (!(options.signal && options.signal.aborted)) {
+                    pool.counters.errors++;
+                }
+                throw error;
+            }
+
+            const location = result.res.headers.location;
+            if (REDIRECT_STATUSES.has(result.res.statusCode) && location && hop < MAX_REDIRECTS) {
+                this.redirects++;
+                url = new URL(location, target).href;
+                continue;
+            }
+            return new UpstreamResponse(result.res, result.body);
+        }
+    }
+
+    /**
+     * Open the configured connections for every prewarmed origin
+     */
+    prewarm() {
+        return Promise.all([...this.configured.entries()]
+            .filter(([, config]) => config.prewarm > 0)
+            .map(([origin]) => {
+                return this.pool(origin).prewarm();
+            }));
+    }
+
+    /**
+     * Close pools for origins not used for a while (image CDNs come and go)
+     * @param {number} idleMs - Minimum idle time
+     * @returns {number} Pools closed
+     */
+    prune(idleMs) {
+        const now = Date.now();
+        let closed = 0;
+        for (const [origin, pool] of this.pools) {
+            if (pool.inflight === 0 && !this.configured.has(origin) && now - pool.lastUsed > idleMs) {
+                pool.close();
+                this.pools.delete(origin);
+                closed++;
+            }
+        }
+        return closed;
+    }
+
+    stats() {
+        const origins = {};
+        const totals = { requests: 0, reused: 0, connections: 0, prewarmedSockets: 0, errors: 0, timeouts: 0 };
+        for (const [origin, pool] of this.pools) {
+            const stats = pool.stats();
+            origins[origin] = stats;
+            for (const key of Object.keys(totals)) {
+                totals[key] += stats[key];
+            }
+        }
+        const used = totals.reused + totals.connections;
+        return {
+            ...totals,
+            redirects: this.redirects,
+            reuseRate: used > 0 ? totals.reused / used : 0,
+            pools: this.pools.size,
+            origins
+        };
+    }
+
+    close() {
+        clearInterval(this.rewarmTimer);
+        for (const pool of this.pools.values()) {
+            pool.close();
+        }
+        this.pools.clear();
+    }
+}
+
+module.exports = { UpstreamHttp };
@@ -0,0 +1,156 @@
+/**
+ * @file worker-pool.js
+ * @brief Fixed-size worker_threads pool with a bounded queue
+ *
+ * Tasks beyond the queue limit are rejected immediately (error.code
+ * 'POOL_SATURATED') instead of piling up, so a burst of image work turns into
+ * fast 503s rather than unbounded memory growth and event-loop stalls.
+ * Crashed workers are replaced and their task is rejected.
+ */
+
+const { Worker } = require('worker_threads');
+
+const TAG = 'worker-pool';
+const RESTART_DELAY_MS = 500;   // Keeps a worker that crashes on startup from spinning
+
+class WorkerPool {
+    /**
+     * @param {Object} options
+     * @param {string} options.script - Worker entry point; receives { id, payload }, posts { id, result | error }
+     * @param {number} options.size - Number of worker threads
+     * @param {number} options.maxQueue - Tasks allowed to wait for a free worker
+     */
+    constructor(options) {
+        this.script = options.script;
+        this.size = options.size;
+        this.maxQueue = options.maxQueue;
+
+        this.workers = new Set();
+        this.idle = [];
+        this.queue = [];
+        this.tasks = new Map();   // task id -> { resolve, reject }
+        this.nextId = 1;
+        this.closing = false;
+
+        this.counters = {
+            completed: 0,
+            failed: 0,
+            rejected: 0,
+            restarts: 0,
+            peakQueue: 0,
+            totalQueueMs: 0
+        };
+
+        for (let i = 0; i < this.size; i++) {
+            this.spawn();
+        }
+        console.log(`[${TAG}] Started ${this.size} workers (${this.script}), queue limit ${this.maxQueue}`);
+    }
+
+    spawn() {
+        const worker = new Worker(this.script);
+        worker.currentTask = null;
+        this.workers.add(worker);
+
+        worker.on('message', ({ id, result, error }) => {
+            const task = this.tasks.get(id);
+            this.tasks.delete(id);
+            worker.currentTask = null;
+            if (task) {
+                if (error) {
+                    this.counters.failed++;
+                    task.reject(new Error(error));
+                } else {
+                    this.counters.completed++;
+                    task.resolve(result);
+                }
+            }
+            this.release(worker);
+        });
+
+        worker.on('error', error => {
+            console.error(`[${TAG}] Worker error: ${error.message}`);
+        });
+
+        worker.on('exit', code => {
+            this.workers.delete(worker);
+            this.idle = this.idle.filter(w => w !== worker);
+            const task = worker.currentTask && this.tasks.get(worker.currentTask);
+            if (task) {
+                this.tasks.delete(worker.currentTask);
+                this.counters.failed++;
+                task.reject(new Error(`Worker exited (code ${code})`));
+            }
+            if (!this.closing) {
+                this.counters.restarts++;
+                setTimeout(() => this.spawn(), RESTART_DELAY_MS);
+            }
+        });
+
+        this.release(worker);
+    }
+
+    /**
+     * Hand a free worker the next queued task, or park it
+     */
+    release(worker) {
+        const next = this.queue.shift();
+        if (next) {
+            this.dispatch(worker, next);
+        } else {
+            this.idle.push(worker);
+        }
+    }
+
+    dispatch(worker, job) {
+        this.counters.totalQueueMs += Date.now() - job.queuedAt;
+        worker.currentTask = job.id;
+        worker.postMessage({ id: job.id, payload: job.payload }, job.transferList);
+    }
+
+    /**
+     * Run a task on the next free worker
+     * @param {Object} payload - Structured-cloneable task data
+     * @param {Array} transferList - ArrayBuffers to move (not copy) to the worker
+     * @returns {Promise<Object>} Worker result
+     */
+    run(payload, transferList = []) {
+        if (this.idle.length === 0 && this.queue.length >= this.maxQueue) {
+            this.counters.rejected++;
+            const error = new Error('Worker pool saturated');
+            error.code = 'POOL_SATURATED';
+            return Promise.reject(error);
+        }
+
+        return new Promise((resolve, reject) => {
+            const job = { id: this.nextId++, payload, transferList, queuedAt: Date.now() };
+            this.tasks.set(job.id, { resolve, reject });
+
+            const worker = this.idle.pop();
+            if (worker) {
+                this.dispatch(worker, job);
+            } else {
+                this.queue.push(job);
+                this.counters.peakQueue = Math.max(this.counters.peakQueue, this.queue.length);
+            }
+        });
+    }
+
+    stats() {
+        const started = this.counters.completed + this.counters.failed + this.tasks.size - this.queue.length;
+        return {
+            ...this.counters,
+            size: this.size,
+            busy: this.size - this.idle.length,
+            queued: this.queue.length,
+            avgQueueMs: started > 0 ? this.counters.totalQueueMs / started : 0
+        };
+    }
+
+    close() {
+        this.closing = true;
+        return Promise.all([...this.workers].map(worker => worker.terminate()));
+    }
+}
+
+module.exports = { WorkerPool };